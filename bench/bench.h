@@ -0,0 +1,52 @@
+// bench.h - Timing loop shared by the microbenchmarks
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Each benchmark is its own executable printing one line per case. A case
+// runs its body `iterations` times per round and reports the fastest of
+// several rounds, which is the least disturbed by the scheduler.
+namespace xclipse_bench {
+
+constexpr int kRounds = 7;
+
+// Keeps the compiler from deleting a computation whose result is unused
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename Fn>
+double NsPerIteration(uint64_t iterations, Fn&& body) {
+    using Clock = std::chrono::steady_clock;
+    double best = 0.0;
+    for (int round = 0; round <= kRounds; ++round) {
+        Clock::time_point start = Clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            body();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+        // Round 0 warms caches and page tables and is not counted
+        if (round == 1 || (round > 1 && ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+inline void Report(const char* name, double ns, const char* unit = "iteration") {
+    std::printf("%-48s %10.1f ns/%s\n", name, ns, unit);
+}
+
+template <typename Fn>
+double Run(const char* name, uint64_t iterations, Fn&& body) {
+    double ns = NsPerIteration(iterations, body);
+    Report(name, ns);
+    return ns;
+}
+
+} // namespace xclipse_bench
@@ -0,0 +1,88 @@
+// command_profile_bench.cpp - CommandBufferProfiler::Find, thread-local hit vs locked lookup
+
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "command_buffer_profile.h"
+
+// Find() runs on every recorded command. A recording thread stays on one
+// command buffer, so it should hit the thread-local slot and never take the
+// profiler's lock. Three cases:
+//  - hit: the same command buffer on every call;
+//  - miss: two command buffers in turn, so every call takes the lock, which
+//    is what every call cost before the slot existed;
+//  - threads: each thread records its own command buffer. On one core the
+//    columns only show the cost of the lock being there, not contention.
+
+namespace {
+
+constexpr uint64_t kIterations = 1'000'000;
+constexpr uint32_t kMaxThreads = 8;
+constexpr uint32_t kCommandBuffers = 256;  // a DXVK-sized working set
+
+VkCommandBuffer Handle(uint32_t index) {
+    return reinterpret_cast<VkCommandBuffer>(uintptr_t{0x7c00000000ull} + uintptr_t{index} * 64);
+}
+
+// ns per Find for threads threads, each recording kIterations commands on
+// its own command buffer, or alternating between two when alternate
+double MeasureThreads(CommandBufferProfiler& profiler, uint32_t threads, bool alternate) {
+    using Clock = std::chrono::steady_clock;
+    double best = 0.0;
+    for (int round = 0; round <= xclipse_bench::kRounds; ++round) {
+        std::barrier start(threads + 1);
+        std::vector<std::thread> workers;
+        for (uint32_t thread = 0; thread < threads; ++thread) {
+            workers.emplace_back([&, thread] {
+                VkCommandBuffer own[2] = {Handle(2 * thread), Handle(2 * thread + 1)};
+                start.arrive_and_wait();
+                for (uint64_t i = 0; i < kIterations; ++i) {
+                    CommandBufferProfile* profile = profiler.Find(own[alternate ? i & 1 : 0]);
+                    profile->draws++;
+                }
+            });
+        }
+        start.arrive_and_wait();
+        Clock::time_point begin = Clock::now();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() /
+                    (kIterations * threads);
+        // Round 0 warms up and is not counted
+        if (round == 1 || (round > 1 && ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+int main() {
+    CommandBufferProfiler profiler;
+    std::vector<VkCommandBuffer> handles;
+    for (uint32_t i = 0; i < kCommandBuffers; ++i) {
+        handles.push_back(Handle(i));
+    }
+    profiler.OnAllocate(VK_NULL_HANDLE, kCommandBuffers, handles.data());
+
+    xclipse_bench::Report("Find, same command buffer (thread-local hit)",
+                          MeasureThreads(profiler, 1, false), "call");
+    xclipse_bench::Report("Find, alternating command buffers (locked)",
+                          MeasureThreads(profiler, 1, true), "call");
+
+    std::printf("\n%8s %16s %16s\n", "threads", "hit ns/call", "locked ns/call");
+    for (uint32_t threads = 1; threads <= kMaxThreads; threads *= 2) {
+        std::printf("%8u %16.1f %16.1f\n", threads, MeasureThreads(profiler, threads, false),
+                    MeasureThreads(profiler, threads, true));
+    }
+
+    std::vector<uint32_t> chunks;
+    profiler.OnFree(kCommandBuffers, handles.data(), chunks);
+    return 0;
+}
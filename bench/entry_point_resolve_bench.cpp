@@ -0,0 +1,114 @@
+// entry_point_resolve_bench.cpp - Name lookup cost of vkGet*ProcAddr at startup
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+#include "bench.h"
+#include "entry_point_table.h"
+#include "entry_points.h"
+
+// The loader and the app resolve every entry point they use once at
+// startup, most of which the layer does not intercept. This compares the
+// layer's lookup with the strcmp chain it replaced (4 names, before the
+// layer intercepted anything else) and with a strcmp chain over today's
+// list. Only the layer's side is timed, not the call to the next link.
+
+namespace {
+
+#define XCLIPSE_ENTRY_NAME(name, proc) #name,
+constexpr auto kInterceptedNames =
+    std::to_array<std::string_view>({XCLIPSE_ENTRY_POINTS(XCLIPSE_ENTRY_NAME, XCLIPSE_ENTRY_NAME)});
+#undef XCLIPSE_ENTRY_NAME
+
+constexpr xclipse::EntryPointTable kTable(kInterceptedNames);
+static_assert(kTable.Valid());
+
+// Core entry points a typical renderer resolves that the layer passes on
+const char* const kPassThroughNames[] = {
+    "vkEnumeratePhysicalDevices", "vkGetPhysicalDeviceFeatures", "vkGetPhysicalDeviceFeatures2",
+    "vkGetPhysicalDeviceFormatProperties", "vkGetPhysicalDeviceImageFormatProperties",
+    "vkGetPhysicalDeviceSurfaceSupportKHR", "vkGetPhysicalDeviceSurfaceCapabilitiesKHR",
+    "vkGetPhysicalDeviceSurfaceFormatsKHR", "vkGetPhysicalDeviceSurfacePresentModesKHR",
+    "vkDestroySurfaceKHR", "vkCreateFence", "vkDestroyFence", "vkResetFences", "vkGetFenceStatus",
+    "vkCreateSemaphore", "vkDestroySemaphore", "vkCreateEvent", "vkDestroyEvent", "vkSetEvent",
+    "vkResetEvent", "vkCreateQueryPool", "vkDestroyQueryPool", "vkCreateBuffer", "vkDestroyBuffer",
+    "vkCreateBufferView", "vkDestroyBufferView", "vkCreateImageView", "vkDestroyImageView",
+    "vkGetImageSubresourceLayout", "vkCreatePipelineCache", "vkDestroyPipelineCache",
+    "vkGetPipelineCacheData", "vkMergePipelineCaches", "vkCreatePipelineLayout",
+    "vkDestroyPipelineLayout", "vkCreateSampler", "vkDestroySampler", "vkCreateDescriptorSetLayout",
+    "vkDestroyDescriptorSetLayout", "vkCreateDescriptorPool", "vkDestroyDescriptorPool",
+    "vkResetDescriptorPool", "vkAllocateDescriptorSets", "vkFreeDescriptorSets",
+    "vkUpdateDescriptorSets", "vkCreateFramebuffer", "vkDestroyFramebuffer", "vkCreateRenderPass",
+    "vkDestroyRenderPass", "vkCreateRenderPass2", "vkResetCommandPool",
+    "vkResetCommandBuffer", "vkCmdBindPipeline", "vkCmdSetViewport", "vkCmdSetScissor",
+    "vkCmdSetLineWidth", "vkCmdSetDepthBias", "vkCmdSetBlendConstants", "vkCmdSetDepthBounds",
+    "vkCmdSetStencilCompareMask", "vkCmdSetStencilWriteMask", "vkCmdSetStencilReference",
+    "vkCmdBindDescriptorSets", "vkCmdBindIndexBuffer", "vkCmdBindVertexBuffers", "vkCmdUpdateBuffer",
+    "vkCmdFillBuffer", "vkCmdClearColorImage", "vkCmdClearDepthStencilImage", "vkCmdClearAttachments",
+    "vkCmdResolveImage", "vkCmdBeginQuery", "vkCmdEndQuery", "vkCmdResetQueryPool",
+    "vkCmdWriteTimestamp", "vkCmdCopyQueryPoolResults", "vkCmdPushConstants", "vkCmdNextSubpass",
+    "vkCreateSwapchainKHR", "vkDestroySwapchainKHR", "vkGetSwapchainImagesKHR",
+    "vkAcquireNextImageKHR", "vkCmdSetCullMode", "vkCmdSetFrontFace", "vkCmdSetPrimitiveTopology",
+    "vkCmdBindVertexBuffers2", "vkCmdSetDepthTestEnable", "vkCmdSetDepthWriteEnable",
+    "vkCmdSetDepthCompareOp", "vkGetBufferDeviceAddress", "vkCmdPushDescriptorSetKHR",
+};
+
+// What layer_init.cpp did before the table: one strcmp per intercepted name
+int FindBaseline(const char* name) {
+    if (std::strcmp(name, "vkCreateGraphicsPipelines") == 0) return 0;
+    if (std::strcmp(name, "vkCreateComputePipelines") == 0) return 1;
+    if (std::strcmp(name, "vkQueueSubmit") == 0) return 2;
+    if (std::strcmp(name, "vkAllocateMemory") == 0) return 3;
+    return -1;
+}
+
+// The same chain grown to every name the layer intercepts today
+int FindLinear(const char* name) {
+    for (size_t i = 0; i < kInterceptedNames.size(); ++i) {
+        if (std::strcmp(name, kInterceptedNames[i].data()) == 0) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+} // namespace
+
+int main() {
+    using namespace xclipse_bench;
+
+    // Interleaved the way a loader walks its own dispatch table
+    std::array<const char*, kInterceptedNames.size() + std::size(kPassThroughNames)> names{};
+    size_t count = 0;
+    for (size_t i = 0; i < std::max(kInterceptedNames.size(), std::size(kPassThroughNames)); ++i) {
+        if (i < kInterceptedNames.size()) names[count++] = kInterceptedNames[i].data();
+        if (i < std::size(kPassThroughNames)) names[count++] = kPassThroughNames[i];
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (kTable.Find(names[i]) != FindLinear(names[i])) {
+            std::fprintf(stderr, "table and strcmp chain disagree on %s\n", names[i]);
+            return 1;
+        }
+    }
+
+    std::printf("%zu names: %zu intercepted, %zu passed on\n", count, kInterceptedNames.size(),
+                std::size(kPassThroughNames));
+    constexpr uint64_t kIterations = 20000;
+    auto resolve_all = [&](auto find) {
+        return NsPerIteration(kIterations, [&] {
+            for (size_t i = 0; i < count; ++i) {
+                DoNotOptimize(find(names[i]));
+            }
+        }) / count;
+    };
+
+    double baseline = resolve_all(FindBaseline);
+    double linear = resolve_all(FindLinear);
+    double table = resolve_all([](const char* name) { return kTable.Find(name); });
+    Report("strcmp chain, 4 names (baseline)", baseline, "lookup");
+    Report("strcmp chain, every intercepted name", linear, "lookup");
+    Report("EntryPointTable::Find", table, "lookup");
+    return 0;
+}
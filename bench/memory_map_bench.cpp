@@ -0,0 +1,82 @@
+// memory_map_bench.cpp - vkMapMemory/vkUnmapMemory round-trips, persistent mapping on vs off
+
+#include <cstdlib>
+
+#include "bench.h"
+#include "mock_driver.h"
+
+// Maps, touches and unmaps one host-visible allocation per iteration, the
+// per-frame pattern of D3D9/D3D11 titles updating dynamic buffers. With
+// XCLIPSE_PERSISTENT_MAPPING=0 every call reaches the driver; with 1 the
+// layer maps once and answers from its cache. The mock's map is a hash
+// lookup under a mutex, not the ioctl a real driver makes, so the "off"
+// column understates what the cache saves on a device. The driver-call
+// columns are exact either way.
+
+namespace {
+
+constexpr uint32_t kHostVisibleType = 1;
+constexpr VkDeviceSize kAllocationSize = VkDeviceSize{256} << 10;
+constexpr uint64_t kIterations = 20000;
+
+struct Result {
+    double ns_per_round_trip;
+    double driver_maps_per_round_trip;
+    double driver_unmaps_per_round_trip;
+};
+
+Result Measure(const char* persistent_mapping) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_SUBALLOCATE_MEMORY", "0", 1);
+    setenv("XCLIPSE_PERSISTENT_MAPPING", persistent_mapping, 1);
+    LayerDevice layer;
+    if (!CreateLayerDevice(layer)) {
+        std::fprintf(stderr, "device creation failed\n");
+        std::exit(1);
+    }
+
+    VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    info.allocationSize = kAllocationSize;
+    info.memoryTypeIndex = kHostVisibleType;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    layer.Get<PFN_vkAllocateMemory>("vkAllocateMemory")(layer.device, &info, nullptr, &memory);
+
+    auto map = layer.Get<PFN_vkMapMemory>("vkMapMemory");
+    auto unmap = layer.Get<PFN_vkUnmapMemory>("vkUnmapMemory");
+    uint64_t maps_before = Mock().map_calls;
+    uint64_t unmaps_before = Mock().unmap_calls;
+    uint64_t offset = 0;
+
+    Result result{};
+    result.ns_per_round_trip = xclipse_bench::NsPerIteration(kIterations, [&] {
+        void* data = nullptr;
+        // A different sub-range each time, as ring-buffered constants do
+        map(layer.device, memory, offset, 256, 0, &data);
+        static_cast<uint8_t*>(data)[0] = 1;
+        xclipse_bench::DoNotOptimize(data);
+        unmap(layer.device, memory);
+        offset = (offset + 256) % kAllocationSize;
+    });
+    double round_trips = static_cast<double>(kIterations) * (xclipse_bench::kRounds + 1);
+    result.driver_maps_per_round_trip = (Mock().map_calls - maps_before) / round_trips;
+    result.driver_unmaps_per_round_trip = (Mock().unmap_calls - unmaps_before) / round_trips;
+
+    layer.Get<PFN_vkFreeMemory>("vkFreeMemory")(layer.device, memory, nullptr);
+    DestroyLayerDevice(layer);
+    return result;
+}
+
+void Print(const char* name, const Result& result) {
+    std::printf("%-20s %14.1f %16.4f %18.4f\n", name, result.ns_per_round_trip,
+                result.driver_maps_per_round_trip, result.driver_unmaps_per_round_trip);
+}
+
+} // namespace
+
+int main() {
+    std::printf("%-20s %14s %16s %18s\n", "persistent mapping", "ns/map+unmap", "driver maps", "driver unmaps");
+    Print("off", Measure("0"));
+    Print("on", Measure("1"));
+    return 0;
+}
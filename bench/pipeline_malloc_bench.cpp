@@ -0,0 +1,169 @@
+// pipeline_malloc_bench.cpp - Heap allocations per pipeline creation once warmed up
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "mock_driver.h"
+#include "pipeline_registry.h"
+
+// Every malloc in the process is counted by interposing glibc's malloc
+// family, which also catches operator new. Each case runs once to warm up
+// (registry shards grow, thread-local scratch arenas fill), then reports
+// the average number of allocations per call; the target is zero.
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer ? 0 : 12;  // ENOMEM
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+} // extern "C"
+
+namespace {
+
+constexpr uint32_t kPipelinesPerCall = 4;
+constexpr uint64_t kCalls = 4000;
+
+// Runs call once to warm up, then kCalls times; prints allocations and
+// time per call
+template <typename Fn>
+void Measure(const char* name, Fn&& call) {
+    call();
+    uint64_t before = g_allocations.load(std::memory_order_relaxed);
+    double ns = xclipse_bench::NsPerIteration(kCalls, call);
+    uint64_t after = g_allocations.load(std::memory_order_relaxed);
+    // NsPerIteration runs kRounds + 1 rounds of kCalls
+    double per_call = static_cast<double>(after - before) / (kCalls * (xclipse_bench::kRounds + 1));
+    std::printf("%-48s %8.2f mallocs/call %10.1f ns/call\n", name, per_call, ns);
+}
+
+void MeasureRegistry() {
+    PipelineRegistry registry;
+    uint64_t next_handle = 0x7a00000000ull;
+    Measure("PipelineRegistry, insert+erase 4", [&] {
+        for (uint32_t i = 0; i < kPipelinesPerCall; ++i) {
+            registry.Insert(FakeHandle<VkPipeline>(next_handle + i * 64));
+        }
+        for (uint32_t i = 0; i < kPipelinesPerCall; ++i) {
+            registry.Erase(FakeHandle<VkPipeline>(next_handle + i * 64));
+        }
+        next_handle += kPipelinesPerCall * 64;
+    });
+}
+
+// A vertex and a fragment module created through the layer, so creation
+// looks both up the way a real pipeline's stages are
+struct Shaders {
+    VkShaderModule vertex{VK_NULL_HANDLE};
+    VkShaderModule fragment{VK_NULL_HANDLE};
+    VkPipelineShaderStageCreateInfo stages[2];
+};
+
+void CreateShaders(const LayerDevice& layer, Shaders& shaders) {
+    auto create_module = layer.Get<PFN_vkCreateShaderModule>("vkCreateShaderModule");
+    for (uint32_t i = 0; i < 2; ++i) {
+        std::vector<uint32_t> code(256, 0x11111111u * (i + 1));
+        code[0] = 0x07230203;  // SPIR-V magic
+        VkShaderModuleCreateInfo info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        info.codeSize = code.size() * sizeof(uint32_t);
+        info.pCode = code.data();
+        create_module(layer.device, &info, nullptr, i == 0 ? &shaders.vertex : &shaders.fragment);
+    }
+    shaders.stages[0] = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    shaders.stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaders.stages[0].module = shaders.vertex;
+    shaders.stages[0].pName = "main";
+    shaders.stages[1] = shaders.stages[0];
+    shaders.stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaders.stages[1].module = shaders.fragment;
+}
+
+void MeasureLayer(const char* name, bool parallel) {
+    ResetMock();
+    ResetLayerEnvironment();
+    if (parallel) {
+        setenv("XCLIPSE_PARALLEL_PIPELINES", "1", 1);
+    }
+    LayerDevice layer;
+    if (!CreateLayerDevice(layer)) {
+        std::fprintf(stderr, "device creation failed\n");
+        std::exit(1);
+    }
+    // The mock records every pipeline; keep that out of the count
+    Mock().pipelines.reserve((kCalls * (xclipse_bench::kRounds + 1) + 1) * kPipelinesPerCall);
+
+    Shaders shaders;
+    CreateShaders(layer, shaders);
+    auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+    auto destroy = layer.Get<PFN_vkDestroyPipeline>("vkDestroyPipeline");
+    VkGraphicsPipelineCreateInfo infos[kPipelinesPerCall];
+    for (VkGraphicsPipelineCreateInfo& info : infos) {
+        info = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        info.stageCount = 2;
+        info.pStages = shaders.stages;
+        info.layout = FakeHandle<VkPipelineLayout>(0x77);
+        info.renderPass = FakeHandle<VkRenderPass>(0x78);
+        info.basePipelineIndex = -1;
+    }
+    VkPipeline pipelines[kPipelinesPerCall];
+    Measure(name, [&] {
+        create(layer.device, VK_NULL_HANDLE, kPipelinesPerCall, infos, nullptr, pipelines);
+        for (VkPipeline pipeline : pipelines) {
+            destroy(layer.device, pipeline, nullptr);
+        }
+    });
+
+    DestroyLayerDevice(layer);
+}
+
+} // namespace
+
+int main() {
+    MeasureRegistry();
+    MeasureLayer("vkCreateGraphicsPipelines(4 x 2 stages) + 4 destroys", false);
+    MeasureLayer("  same, fanned out to the compile pool", true);
+    return 0;
+}
@@ -0,0 +1,100 @@
+// pipeline_registry_bench.cpp - PipelineRegistry throughput from 1 to 10 threads
+
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "bench.h"
+#include "pipeline_registry.h"
+
+// Each thread plays a DXVK/vkd3d compile thread: it registers a batch of
+// pipelines, then destroys them. The sharded registry is compared with
+// one mutex around one map, which is what it replaced. Ten threads put one
+// thread on every core of the Exynos 2400 (1 Cortex-X4, 5 Cortex-A720 and
+// 4 Cortex-A520), the most a game's compile threads can run at once.
+
+namespace {
+
+constexpr uint32_t kMaxThreads = 10;
+constexpr uint32_t kBatch = 256;        // pipelines alive per thread at once
+constexpr uint32_t kRounds = 1000;
+constexpr uint64_t kOpsPerRound = kBatch * 2;
+
+class GlobalLockRegistry {
+public:
+    void Insert(VkPipeline pipeline) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pipelines_.insert(pipeline);
+    }
+
+    bool Erase(VkPipeline pipeline) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pipelines_.erase(pipeline) != 0;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_set<VkPipeline> pipelines_;
+};
+
+// Driver handles look like heap pointers: 64-byte aligned, close together
+VkPipeline Handle(uint32_t thread, uint32_t index) {
+    uintptr_t bits = 0x7a00000000ull + (uintptr_t{thread} << 24) + uintptr_t{index} * 64;
+    return reinterpret_cast<VkPipeline>(bits);
+}
+
+template <typename Registry>
+void RunThread(Registry& registry, uint32_t thread) {
+    for (uint32_t round = 0; round < kRounds; ++round) {
+        for (uint32_t i = 0; i < kBatch; ++i) {
+            registry.Insert(Handle(thread, i));
+        }
+        for (uint32_t i = 0; i < kBatch; ++i) {
+            xclipse_bench::DoNotOptimize(registry.Erase(Handle(thread, i)));
+        }
+    }
+}
+
+// Wall time of every thread's work, started together; returns the
+// aggregate rate in millions of operations per second
+template <typename Registry>
+double MeasureOpsPerSecond(uint32_t thread_count) {
+    using Clock = std::chrono::steady_clock;
+    double best = 0.0;
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        Registry registry;
+        std::barrier start(thread_count + 1);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                start.arrive_and_wait();
+                RunThread(registry, t);
+            });
+        }
+        start.arrive_and_wait();
+        Clock::time_point begin = Clock::now();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        double mops = thread_count * kRounds * kOpsPerRound / seconds / 1e6;
+        if (mops > best) best = mops;
+    }
+    return best;
+}
+
+} // namespace
+
+int main() {
+    std::printf("%7s %18s %18s\n", "threads", "sharded Mops/s", "one mutex Mops/s");
+    for (uint32_t threads = 1; threads <= kMaxThreads; ++threads) {
+        double sharded = MeasureOpsPerSecond<PipelineRegistry>(threads);
+        double global = MeasureOpsPerSecond<GlobalLockRegistry>(threads);
+        std::printf("%7u %18.1f %18.1f\n", threads, sharded, global);
+    }
+    return 0;
+}
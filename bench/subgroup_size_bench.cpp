@@ -0,0 +1,396 @@
+// subgroup_size_bench.cpp - GPU time of compute dispatches in wave32 and wave64
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+
+// Unlike the other benchmarks this one runs on the GPU, through the system
+// Vulkan loader; the mock driver and the layer are not involved. It times
+// three workloads (see subgroup_size_bench.comp) at two workgroup sizes,
+// each compiled three ways: as the driver chooses, and with
+// VkPipelineShaderStageRequiredSubgroupSizeCreateInfo requiring 32 and 64,
+// which is what compute_subgroup_size and subgroup_size= pipeline rules
+// chain in. Each cell is GPU time per dispatch from timestamps around
+// kDispatches back-to-back dispatches, the fastest of kRounds rounds after
+// a warmup round. A "-" is a size the device cannot require there.
+
+namespace {
+
+constexpr uint32_t kShaderCode[] = {
+#include "subgroup_size_bench.spv.inc"
+};
+
+constexpr uint32_t kElements = 1u << 22;  // 16 MiB of uint32_t
+constexpr uint32_t kDispatches = 32;
+constexpr uint32_t kWorkgroupSizes[] = {64, 256};
+constexpr uint32_t kSubgroupSizes[] = {0, 32, 64};  // 0 is the driver's choice
+
+// Matches kWorkload in the shader
+enum class Workload : uint32_t { kAlu, kSubgroupAdd, kStridedLoad };
+
+struct WorkloadInfo {
+    Workload workload;
+    const char* name;
+    uint32_t iterations;
+};
+
+constexpr WorkloadInfo kWorkloads[] = {
+    {Workload::kAlu, "alu", 256},
+    {Workload::kSubgroupAdd, "subgroup add", 32},
+    {Workload::kStridedLoad, "strided load", 1},
+};
+
+struct Gpu {
+    VkInstance instance{VK_NULL_HANDLE};
+    VkPhysicalDevice physical_device{VK_NULL_HANDLE};
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceVulkan13Properties properties13{};
+    VkDevice device{VK_NULL_HANDLE};
+    uint32_t family{0};
+    VkQueue queue{VK_NULL_HANDLE};
+    uint64_t tick_mask{0};
+
+    VkBuffer buffer{VK_NULL_HANDLE};
+    VkDeviceMemory memory{VK_NULL_HANDLE};
+    VkDescriptorSetLayout set_layout{VK_NULL_HANDLE};
+    VkDescriptorPool descriptor_pool{VK_NULL_HANDLE};
+    VkDescriptorSet descriptor_set{VK_NULL_HANDLE};
+    VkPipelineLayout pipeline_layout{VK_NULL_HANDLE};
+    VkShaderModule shader{VK_NULL_HANDLE};
+    VkCommandPool command_pool{VK_NULL_HANDLE};
+    VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+    VkQueryPool query_pool{VK_NULL_HANDLE};
+};
+
+void Check(VkResult result, const char* what) {
+    if (result != VK_SUCCESS) {
+        std::fprintf(stderr, "%s failed: %d\n", what, result);
+        std::exit(1);
+    }
+}
+
+// Returns false, with a reason on stderr, if the device cannot run the
+// benchmark at all
+bool CreateGpu(Gpu& gpu) {
+    VkApplicationInfo application{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    application.pApplicationName = "subgroup_size_bench";
+    application.apiVersion = VK_API_VERSION_1_3;
+    VkInstanceCreateInfo instance_info{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+    instance_info.pApplicationInfo = &application;
+    Check(vkCreateInstance(&instance_info, nullptr, &gpu.instance), "vkCreateInstance");
+
+    uint32_t count = 1;
+    VkResult result = vkEnumeratePhysicalDevices(gpu.instance, &count, &gpu.physical_device);
+    if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+        std::fprintf(stderr, "no Vulkan device\n");
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan11Properties properties11{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES};
+    gpu.properties13 = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_PROPERTIES};
+    properties11.pNext = &gpu.properties13;
+    VkPhysicalDeviceProperties2 properties2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties2.pNext = &properties11;
+    vkGetPhysicalDeviceProperties2(gpu.physical_device, &properties2);
+    gpu.properties = properties2.properties;
+    if (gpu.properties.apiVersion < VK_API_VERSION_1_3) {
+        std::fprintf(stderr, "%s: needs Vulkan 1.3\n", gpu.properties.deviceName);
+        return false;
+    }
+    if (!(properties11.subgroupSupportedStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+        !(properties11.subgroupSupportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT)) {
+        std::fprintf(stderr, "%s: no subgroup arithmetic in compute shaders\n", gpu.properties.deviceName);
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan13Features features13{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+    VkPhysicalDeviceFeatures2 features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    features2.pNext = &features13;
+    vkGetPhysicalDeviceFeatures2(gpu.physical_device, &features2);
+    if (!features13.subgroupSizeControl) {
+        std::fprintf(stderr, "%s: no subgroupSizeControl\n", gpu.properties.deviceName);
+        return false;
+    }
+
+    // The first compute family, normally the graphics one most titles
+    // dispatch on
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu.physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu.physical_device, &family_count, families.data());
+    gpu.family = family_count;
+    for (uint32_t i = 0; i < family_count && gpu.family == family_count; ++i) {
+        if ((families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && families[i].timestampValidBits) {
+            gpu.family = i;
+        }
+    }
+    if (gpu.family == family_count || gpu.properties.limits.timestampPeriod <= 0.0f) {
+        std::fprintf(stderr, "%s: no compute queue with timestamps\n", gpu.properties.deviceName);
+        return false;
+    }
+    uint32_t valid_bits = families[gpu.family].timestampValidBits;
+    gpu.tick_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+    queue_info.queueFamilyIndex = gpu.family;
+    queue_info.queueCount = 1;
+    queue_info.pQueuePriorities = &priority;
+    VkPhysicalDeviceVulkan13Features enabled13{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+    enabled13.subgroupSizeControl = VK_TRUE;
+    VkDeviceCreateInfo device_info{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    device_info.pNext = &enabled13;
+    device_info.queueCreateInfoCount = 1;
+    device_info.pQueueCreateInfos = &queue_info;
+    Check(vkCreateDevice(gpu.physical_device, &device_info, nullptr, &gpu.device), "vkCreateDevice");
+    vkGetDeviceQueue(gpu.device, gpu.family, 0, &gpu.queue);
+    return true;
+}
+
+void CreateResources(Gpu& gpu) {
+    VkBufferCreateInfo buffer_info{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.size = VkDeviceSize{kElements} * sizeof(uint32_t);
+    buffer_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    Check(vkCreateBuffer(gpu.device, &buffer_info, nullptr, &gpu.buffer), "vkCreateBuffer");
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(gpu.device, gpu.buffer, &requirements);
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(gpu.physical_device, &memory_properties);
+    uint32_t type = 0;
+    while (type < memory_properties.memoryTypeCount &&
+           (!(requirements.memoryTypeBits & (1u << type)) ||
+            !(memory_properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))) {
+        ++type;
+    }
+    if (type == memory_properties.memoryTypeCount) {
+        std::fprintf(stderr, "no device-local memory type for the buffer\n");
+        std::exit(1);
+    }
+    VkMemoryAllocateInfo allocate_info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocate_info.allocationSize = requirements.size;
+    allocate_info.memoryTypeIndex = type;
+    Check(vkAllocateMemory(gpu.device, &allocate_info, nullptr, &gpu.memory), "vkAllocateMemory");
+    Check(vkBindBufferMemory(gpu.device, gpu.buffer, gpu.memory, 0), "vkBindBufferMemory");
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo set_layout_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    set_layout_info.bindingCount = 1;
+    set_layout_info.pBindings = &binding;
+    Check(vkCreateDescriptorSetLayout(gpu.device, &set_layout_info, nullptr, &gpu.set_layout),
+          "vkCreateDescriptorSetLayout");
+
+    VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1};
+    VkDescriptorPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    Check(vkCreateDescriptorPool(gpu.device, &pool_info, nullptr, &gpu.descriptor_pool),
+          "vkCreateDescriptorPool");
+    VkDescriptorSetAllocateInfo set_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    set_info.descriptorPool = gpu.descriptor_pool;
+    set_info.descriptorSetCount = 1;
+    set_info.pSetLayouts = &gpu.set_layout;
+    Check(vkAllocateDescriptorSets(gpu.device, &set_info, &gpu.descriptor_set), "vkAllocateDescriptorSets");
+    VkDescriptorBufferInfo descriptor_buffer{gpu.buffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = gpu.descriptor_set;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &descriptor_buffer;
+    vkUpdateDescriptorSets(gpu.device, 1, &write, 0, nullptr);
+
+    VkPushConstantRange push_range{VK_SHADER_STAGE_COMPUTE_BIT, 0, 2 * sizeof(uint32_t)};
+    VkPipelineLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &gpu.set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+    Check(vkCreatePipelineLayout(gpu.device, &layout_info, nullptr, &gpu.pipeline_layout),
+          "vkCreatePipelineLayout");
+
+    VkShaderModuleCreateInfo shader_info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    shader_info.codeSize = sizeof(kShaderCode);
+    shader_info.pCode = kShaderCode;
+    Check(vkCreateShaderModule(gpu.device, &shader_info, nullptr, &gpu.shader), "vkCreateShaderModule");
+
+    VkCommandPoolCreateInfo command_pool_info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    command_pool_info.queueFamilyIndex = gpu.family;
+    Check(vkCreateCommandPool(gpu.device, &command_pool_info, nullptr, &gpu.command_pool),
+          "vkCreateCommandPool");
+    VkCommandBufferAllocateInfo command_buffer_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    command_buffer_info.commandPool = gpu.command_pool;
+    command_buffer_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_info.commandBufferCount = 1;
+    Check(vkAllocateCommandBuffers(gpu.device, &command_buffer_info, &gpu.command_buffer),
+          "vkAllocateCommandBuffers");
+
+    VkQueryPoolCreateInfo query_info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_info.queryCount = 2;
+    Check(vkCreateQueryPool(gpu.device, &query_info, nullptr, &gpu.query_pool), "vkCreateQueryPool");
+}
+
+void DestroyGpu(Gpu& gpu) {
+    if (gpu.device) {
+        vkDestroyQueryPool(gpu.device, gpu.query_pool, nullptr);
+        vkDestroyCommandPool(gpu.device, gpu.command_pool, nullptr);
+        vkDestroyShaderModule(gpu.device, gpu.shader, nullptr);
+        vkDestroyPipelineLayout(gpu.device, gpu.pipeline_layout, nullptr);
+        vkDestroyDescriptorPool(gpu.device, gpu.descriptor_pool, nullptr);
+        vkDestroyDescriptorSetLayout(gpu.device, gpu.set_layout, nullptr);
+        vkDestroyBuffer(gpu.device, gpu.buffer, nullptr);
+        vkFreeMemory(gpu.device, gpu.memory, nullptr);
+        vkDestroyDevice(gpu.device, nullptr);
+    }
+    vkDestroyInstance(gpu.instance, nullptr);
+}
+
+// Records into the one command buffer, submits it and waits for it
+template <typename Record>
+void Execute(const Gpu& gpu, Record&& record) {
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    Check(vkBeginCommandBuffer(gpu.command_buffer, &begin), "vkBeginCommandBuffer");
+    record(gpu.command_buffer);
+    Check(vkEndCommandBuffer(gpu.command_buffer), "vkEndCommandBuffer");
+
+    VkSubmitInfo submit{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &gpu.command_buffer;
+    Check(vkQueueSubmit(gpu.queue, 1, &submit, VK_NULL_HANDLE), "vkQueueSubmit");
+    Check(vkQueueWaitIdle(gpu.queue), "vkQueueWaitIdle");
+}
+
+// Whether the device lets a compute shader with this workgroup size
+// require subgroup_size; 0 is always allowed
+bool CanRequire(const Gpu& gpu, uint32_t workgroup_size, uint32_t subgroup_size) {
+    if (subgroup_size == 0) return true;
+    const VkPhysicalDeviceVulkan13Properties& limits = gpu.properties13;
+    return (limits.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+           subgroup_size >= limits.minSubgroupSize && subgroup_size <= limits.maxSubgroupSize &&
+           workgroup_size <= subgroup_size * limits.maxComputeWorkgroupSubgroups;
+}
+
+VkPipeline CreatePipeline(const Gpu& gpu, uint32_t workgroup_size, Workload workload,
+                          uint32_t subgroup_size) {
+    uint32_t constants[2] = {workgroup_size, static_cast<uint32_t>(workload)};
+    VkSpecializationMapEntry entries[2] = {{0, 0, sizeof(uint32_t)},
+                                           {1, sizeof(uint32_t), sizeof(uint32_t)}};
+    VkSpecializationInfo specialization{2, entries, sizeof(constants), constants};
+
+    VkPipelineShaderStageRequiredSubgroupSizeCreateInfo required{
+        VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO};
+    required.requiredSubgroupSize = subgroup_size;
+
+    VkComputePipelineCreateInfo info{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    info.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    info.stage.pNext = subgroup_size ? &required : nullptr;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = gpu.shader;
+    info.stage.pName = "main";
+    info.stage.pSpecializationInfo = &specialization;
+    info.layout = gpu.pipeline_layout;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    Check(vkCreateComputePipelines(gpu.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline),
+          "vkCreateComputePipelines");
+    return pipeline;
+}
+
+// Nanoseconds of GPU time per dispatch, fastest round
+double MeasureDispatch(const Gpu& gpu, VkPipeline pipeline, uint32_t workgroup_size,
+                       const WorkloadInfo& workload) {
+    uint32_t push[2] = {kElements, workload.iterations};
+    // Each dispatch reads what the previous one wrote, as a chain of
+    // passes would
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    double best = 0.0;
+    for (int round = 0; round <= xclipse_bench::kRounds; ++round) {
+        Execute(gpu, [&](VkCommandBuffer command_buffer) {
+            vkCmdResetQueryPool(command_buffer, gpu.query_pool, 0, 2);
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpu.pipeline_layout,
+                                    0, 1, &gpu.descriptor_set, 0, nullptr);
+            vkCmdPushConstants(command_buffer, gpu.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                               sizeof(push), push);
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, gpu.query_pool, 0);
+            for (uint32_t i = 0; i < kDispatches; ++i) {
+                if (i > 0) {
+                    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0,
+                                         nullptr, 0, nullptr);
+                }
+                vkCmdDispatch(command_buffer, kElements / workgroup_size, 1, 1);
+            }
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpu.query_pool, 1);
+        });
+
+        uint64_t ticks[2];
+        Check(vkGetQueryPoolResults(gpu.device, gpu.query_pool, 0, 2, sizeof(ticks), ticks,
+                                    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT),
+              "vkGetQueryPoolResults");
+        double ns = static_cast<double>((ticks[1] - ticks[0]) & gpu.tick_mask) *
+                    gpu.properties.limits.timestampPeriod / kDispatches;
+        // Round 0 warms the shader caches and clocks and is not counted
+        if (round == 1 || (round > 1 && ns < best)) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+int main() {
+    Gpu gpu;
+    if (!CreateGpu(gpu)) {
+        DestroyGpu(gpu);
+        return 1;
+    }
+    CreateResources(gpu);
+    Execute(gpu, [&](VkCommandBuffer command_buffer) {
+        vkCmdFillBuffer(command_buffer, gpu.buffer, 0, VK_WHOLE_SIZE, 1);
+        VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    });
+
+    const VkPhysicalDeviceVulkan13Properties& limits = gpu.properties13;
+    std::printf("%s: subgroup sizes %u-%u, required sizes in stages 0x%x, %u elements, %u dispatches\n",
+                gpu.properties.deviceName, limits.minSubgroupSize, limits.maxSubgroupSize,
+                limits.requiredSubgroupSizeStages, kElements, kDispatches);
+    std::printf("%-14s %9s %18s %18s %18s\n", "workload", "workgroup", "driver ns/dispatch",
+                "wave32 ns/dispatch", "wave64 ns/dispatch");
+    for (const WorkloadInfo& workload : kWorkloads) {
+        for (uint32_t workgroup_size : kWorkgroupSizes) {
+            std::printf("%-14s %9u", workload.name, workgroup_size);
+            for (uint32_t subgroup_size : kSubgroupSizes) {
+                if (!CanRequire(gpu, workgroup_size, subgroup_size)) {
+                    std::printf(" %18s", "-");
+                    continue;
+                }
+                VkPipeline pipeline = CreatePipeline(gpu, workgroup_size, workload.workload, subgroup_size);
+                std::printf(" %18.1f", MeasureDispatch(gpu, pipeline, workgroup_size, workload));
+                vkDestroyPipeline(gpu.device, pipeline, nullptr);
+            }
+            std::printf("\n");
+        }
+    }
+
+    DestroyGpu(gpu);
+    return 0;
+}
@@ -0,0 +1,116 @@
+// submit_paths_bench.cpp - Layer overhead of vkQueueSubmit and vkQueueSubmit2 on each path
+
+#include <cstdlib>
+
+#include "bench.h"
+#include "mock_driver.h"
+
+// Each row submits one pre-recorded command buffer per call, fence-less,
+// and reports the time per app call and how many driver submit calls it
+// turned into. The paths:
+//  - plain: no submit option set, the call is classified and forwarded;
+//  - batched: XCLIPSE_BATCH_SUBMITS=1, calls are held and flushed 256 at a
+//    time;
+//  - async: XCLIPSE_ASYNC_COMPUTE=1, a dispatch-only command buffer is
+//    offloaded to the reserved queue; in the "+ draw" row every other call
+//    is a draw that stays on the app queue and joins the offloaded work.
+// The mock's submit only appends to a vector, so the time is the layer's
+// own cost; a real submit is an ioctl and dwarfs it.
+
+namespace {
+
+constexpr uint64_t kIterations = 5000;
+
+enum class Path { kPlain, kBatched, kAsync };
+
+struct Row {
+    double ns_per_call;
+    double driver_calls_per_call;
+};
+
+VkCommandBuffer Record(const LayerDevice& layer, VkCommandPool pool, bool draw) {
+    VkCommandBuffer command_buffer = layer.AllocateCommandBuffer(pool);
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    layer.Get<PFN_vkBeginCommandBuffer>("vkBeginCommandBuffer")(command_buffer, &begin);
+    if (draw) {
+        layer.Get<PFN_vkCmdDraw>("vkCmdDraw")(command_buffer, 3, 1, 0, 0);
+    } else {
+        layer.Get<PFN_vkCmdDispatch>("vkCmdDispatch")(command_buffer, 8, 8, 1);
+    }
+    layer.Get<PFN_vkEndCommandBuffer>("vkEndCommandBuffer")(command_buffer);
+    return command_buffer;
+}
+
+Row Measure(Path path, bool submit2, bool alternate_draws) {
+    ResetMock();
+    ResetLayerEnvironment();
+    if (path == Path::kBatched) setenv("XCLIPSE_BATCH_SUBMITS", "1", 1);
+    if (path == Path::kAsync) setenv("XCLIPSE_ASYNC_COMPUTE", "1", 1);
+
+    // Async compute needs the app to have enabled timeline semaphores
+    VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    features12.timelineSemaphore = VK_TRUE;
+    LayerDeviceOptions options;
+    options.device_features = &features12;
+    LayerDevice layer;
+    if (!CreateLayerDevice(layer, options)) {
+        std::fprintf(stderr, "device creation failed\n");
+        std::exit(1);
+    }
+
+    VkQueue queue = layer.Queue(0);
+    VkCommandPool pool = layer.CreateCommandPool(0);
+    VkCommandBuffer command_buffers[2] = {Record(layer, pool, false), Record(layer, pool, true)};
+    auto queue_submit = layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit");
+    auto queue_submit2 = layer.Get<PFN_vkQueueSubmit2>("vkQueueSubmit2");
+
+    VkSubmitInfo infos[2];
+    VkCommandBufferSubmitInfo command_buffer_infos[2];
+    VkSubmitInfo2 infos2[2];
+    for (int i = 0; i < 2; ++i) {
+        infos[i] = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        infos[i].commandBufferCount = 1;
+        infos[i].pCommandBuffers = &command_buffers[i];
+        command_buffer_infos[i] = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+        command_buffer_infos[i].commandBuffer = command_buffers[i];
+        infos2[i] = {VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+        infos2[i].commandBufferInfoCount = 1;
+        infos2[i].pCommandBufferInfos = &command_buffer_infos[i];
+    }
+
+    uint32_t driver_calls_before = Mock().submit_calls;
+    uint64_t call = 0;
+    Row row{};
+    row.ns_per_call = xclipse_bench::NsPerIteration(kIterations, [&] {
+        int which = alternate_draws ? static_cast<int>(call++ & 1) : 0;
+        VkResult result = submit2 ? queue_submit2(queue, 1, &infos2[which], VK_NULL_HANDLE)
+                                  : queue_submit(queue, 1, &infos[which], VK_NULL_HANDLE);
+        xclipse_bench::DoNotOptimize(result);
+    });
+    row.driver_calls_per_call = static_cast<double>(Mock().submit_calls - driver_calls_before) /
+                                (kIterations * (xclipse_bench::kRounds + 1));
+
+    DestroyLayerDevice(layer);
+    return row;
+}
+
+void Print(Path path, const char* name, bool submit2, bool alternate_draws) {
+    Row row = Measure(path, submit2, alternate_draws);
+    std::printf("%-10s %-16s %-18s %10.1f %14.3f\n", name, submit2 ? "vkQueueSubmit2" : "vkQueueSubmit",
+                alternate_draws ? "dispatch + draw" : "dispatch", row.ns_per_call,
+                row.driver_calls_per_call);
+}
+
+} // namespace
+
+int main() {
+    std::printf("%-10s %-16s %-18s %10s %14s\n", "path", "entry point", "workload", "ns/call",
+                "driver calls");
+    for (bool submit2 : {false, true}) {
+        Print(Path::kPlain, "plain", submit2, false);
+        Print(Path::kBatched, "batched", submit2, false);
+        Print(Path::kAsync, "async", submit2, false);
+        Print(Path::kAsync, "async", submit2, true);
+    }
+    return 0;
+}
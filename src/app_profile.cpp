@@ -0,0 +1,222 @@
+// app_profile.cpp - Per-application layer settings from a profile file
+
+#include "app_profile.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+// One entry per key; the environment override is XCLIPSE_ plus the key in
+// upper case
+struct SettingField {
+    const char* key;
+    bool LayerSettings::*flag;
+    uint32_t LayerSettings::*number;
+};
+
+constexpr SettingField kSettingFields[] = {
+    {"parallel_pipelines", &LayerSettings::parallel_pipelines, nullptr},
+    {"suballocate_memory", &LayerSettings::suballocate_memory, nullptr},
+    {"remap_memory_types", &LayerSettings::remap_memory_types, nullptr},
+    {"batch_submits", &LayerSettings::batch_submits, nullptr},
+    {"dedicated_images", &LayerSettings::dedicated_images, nullptr},
+    {"dedicated_image_min_kb", nullptr, &LayerSettings::dedicated_image_min_kb},
+    {"dedicated_image_inject", &LayerSettings::dedicated_image_inject, nullptr},
+    {"persistent_mapping", &LayerSettings::persistent_mapping, nullptr},
+    {"async_compute", &LayerSettings::async_compute, nullptr},
+    {"gpu_profiler", &LayerSettings::gpu_profiler, nullptr},
+    {"trace", &LayerSettings::trace, nullptr},
+    {"log_pipelines", &LayerSettings::log_pipelines, nullptr},
+    {"replace_shaders", &LayerSettings::replace_shaders, nullptr},
+    {"dump_shaders", &LayerSettings::dump_shaders, nullptr},
+    {"compute_subgroup_size", nullptr, &LayerSettings::compute_subgroup_size},
+};
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+    return text;
+}
+
+// Case-insensitive, * matches any run and ? any one character
+bool GlobMatch(std::string_view pattern, std::string_view text) {
+    size_t p = 0, t = 0;
+    size_t star = std::string_view::npos, resume = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() &&
+            (pattern[p] == '?' ||
+             std::tolower(static_cast<unsigned char>(pattern[p])) ==
+                 std::tolower(static_cast<unsigned char>(text[t])))) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+// "1"/"0" for flags, a decimal number otherwise; false if the value is not
+// one of those
+bool SetField(const SettingField& field, std::string_view value, LayerSettings& settings) {
+    if (field.flag) {
+        if (value != "1" && value != "0") return false;
+        settings.*field.flag = value == "1";
+        return true;
+    }
+    if (value.empty() || value.size() > 9) return false;
+    uint32_t number = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') return false;
+        number = number * 10 + static_cast<uint32_t>(c - '0');
+    }
+    settings.*field.number = number;
+    return true;
+}
+
+const SettingField* FindField(std::string_view key) {
+    for (const SettingField& field : kSettingFields) {
+        if (key == field.key) return &field;
+    }
+    return nullptr;
+}
+
+// Whether every criterion of a section header body matches; -1 if the
+// header is malformed
+int SectionMatches(std::string_view criteria, const ApplicationIdentity& identity) {
+    bool matches = true;
+    while (!(criteria = Trim(criteria)).empty()) {
+        size_t end = criteria.find_first_of(" \t");
+        std::string_view criterion = criteria.substr(0, end);
+        criteria = end == std::string_view::npos ? std::string_view() : criteria.substr(end);
+        if (criterion == "*") continue;
+
+        size_t equals = criterion.find('=');
+        if (equals == std::string_view::npos) return -1;
+        std::string_view name = criterion.substr(0, equals);
+        std::string_view pattern = criterion.substr(equals + 1);
+        const std::string* value = name == "app"     ? &identity.application
+                                   : name == "engine"  ? &identity.engine
+                                   : name == "process" ? &identity.process
+                                                       : nullptr;
+        if (!value) return -1;
+        matches = matches && GlobMatch(pattern, *value);
+    }
+    return matches;
+}
+
+std::string ReadProfileFile(const std::string& path) {
+    std::string text;
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (!file) {
+        return text;
+    }
+    char buffer[4096];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        text.append(buffer, read);
+    }
+    std::fclose(file);
+    return text;
+}
+
+void ApplyEnvironmentOverrides(LayerSettings& settings) {
+    for (const SettingField& field : kSettingFields) {
+        std::string name = "XCLIPSE_";
+        for (const char* c = field.key; *c; ++c) {
+            name += static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+        }
+        const char* value = std::getenv(name.c_str());
+        if (value && !SetField(field, value, settings)) {
+            XCLIPSE_LOGW("ignoring %s=%s", name.c_str(), value);
+        }
+    }
+}
+
+} // namespace
+
+void ApplyLayerProfiles(std::string_view text, const ApplicationIdentity& identity,
+                        LayerSettings& settings) {
+    bool applies = true;
+    uint32_t line_number = 0;
+    while (!text.empty()) {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        ++line_number;
+
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        if (line.front() == '[') {
+            int matches = line.back() == ']' ? SectionMatches(line.substr(1, line.size() - 2), identity) : -1;
+            if (matches < 0) {
+                XCLIPSE_LOGW("profile line %u: bad section header, skipping the section", line_number);
+            } else if (matches) {
+                XCLIPSE_LOGI("profile line %u: %.*s applies", line_number,
+                             static_cast<int>(line.size()), line.data());
+            }
+            applies = matches > 0;
+            continue;
+        }
+        if (!applies) continue;
+
+        size_t equals = line.find('=');
+        std::string_view key = equals == std::string_view::npos ? line : Trim(line.substr(0, equals));
+        if (key == "pipeline" && equals != std::string_view::npos) {
+            PipelineRule rule;
+            if (ParsePipelineRule(Trim(line.substr(equals + 1)), rule)) {
+                settings.pipeline_rules.push_back(std::move(rule));
+            } else {
+                XCLIPSE_LOGW("profile line %u: bad pipeline rule \"%.*s\"", line_number,
+                             static_cast<int>(line.size()), line.data());
+            }
+            continue;
+        }
+        const SettingField* field = equals == std::string_view::npos ? nullptr : FindField(key);
+        if (!field || !SetField(*field, Trim(line.substr(equals + 1)), settings)) {
+            XCLIPSE_LOGW("profile line %u: ignoring \"%.*s\"", line_number,
+                         static_cast<int>(line.size()), line.data());
+        }
+    }
+}
+
+LayerSettings ResolveLayerSettings(const VkApplicationInfo* application_info) {
+    ApplicationIdentity identity;
+    if (application_info) {
+        if (application_info->pApplicationName) identity.application = application_info->pApplicationName;
+        if (application_info->pEngineName) identity.engine = application_info->pEngineName;
+    }
+    identity.process = GetProcessName();
+
+    LayerSettings settings;
+    std::string path;
+    if (const char* profile = std::getenv("XCLIPSE_PROFILE"); profile && *profile) {
+        path = profile;
+    } else if (std::string directory = GetLayerDataDirectory(); !directory.empty()) {
+        path = directory + "/profiles.conf";
+    }
+    if (!path.empty()) {
+        std::string text = ReadProfileFile(path);
+        if (!text.empty()) {
+            XCLIPSE_LOGI("profiles from %s for app \"%s\", engine \"%s\", process \"%s\"", path.c_str(),
+                         identity.application.c_str(), identity.engine.c_str(), identity.process.c_str());
+            ApplyLayerProfiles(text, identity, settings);
+        }
+    }
+
+    ApplyEnvironmentOverrides(settings);
+    return settings;
+}
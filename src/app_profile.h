@@ -0,0 +1,63 @@
+// app_profile.h - Per-application layer settings from a profile file
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pipeline_rules.h"
+
+// Everything the layer lets a profile turn on, off or tune. Resolved once
+// per instance; devices copy the result, so nothing here is looked up by
+// name after vkCreateInstance.
+struct LayerSettings {
+    bool parallel_pipelines{false};
+    bool suballocate_memory{false};
+    bool remap_memory_types{false};
+    bool batch_submits{false};
+    bool dedicated_images{false};
+    uint32_t dedicated_image_min_kb{4096};  // non-attachment images at least this big
+    bool dedicated_image_inject{false};  // fix up allocations the driver requires dedicated
+    bool persistent_mapping{true};
+    bool async_compute{false};
+    bool gpu_profiler{false};
+    bool trace{false};
+    bool log_pipelines{false};  // each new pipeline fingerprint, for writing rules
+    bool replace_shaders{false};  // from <process>.shaders/<hash>.spv in the data directory
+    bool dump_shaders{false};     // to <process>.shader_dump/<hash>.spv
+    uint32_t compute_subgroup_size{0};  // required for compute shaders; 0 is the driver's choice
+    std::vector<PipelineRule> pipeline_rules;
+};
+
+// What a profile section can match on. process is /proc/self/comm, which
+// the kernel cuts to 15 characters ("Cyberpunk2077.e").
+struct ApplicationIdentity {
+    std::string application;
+    std::string engine;
+    std::string process;
+};
+
+// Profile file format, one setting per line:
+//
+//   # DXVK titles get submit batching
+//   [engine=DXVK]
+//   batch_submits = 1
+//
+//   [engine=vkd3d app=Cyberpunk*]
+//   async_compute = 1
+//
+// A section applies when all of its app=, engine= and process= patterns
+// match, case-insensitively, with * and ? wildcards; settings before the
+// first section apply to everything. Later sections override earlier ones,
+// except for "pipeline =" lines, which all add up (see PipelineRule).
+// Unknown keys and malformed lines are logged and skipped.
+void ApplyLayerProfiles(std::string_view text, const ApplicationIdentity& identity,
+                        LayerSettings& settings);
+
+// Defaults, then the profile file ($XCLIPSE_PROFILE, else profiles.conf in
+// the layer data directory), then XCLIPSE_<KEY> environment variables
+// (1 or 0, or a number), which keep working as per-launch overrides
+LayerSettings ResolveLayerSettings(const VkApplicationInfo* application_info);
@@ -0,0 +1,363 @@
+// async_compute.cpp - Opt-in offload of compute-only submits to a second queue
+
+#include "async_compute.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "log.h"
+
+namespace {
+
+bool TimelineSemaphoresEnabled(const VkDeviceCreateInfo& create_info) {
+    for (auto* next = static_cast<const VkBaseInStructure*>(create_info.pNext); next; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES &&
+            reinterpret_cast<const VkPhysicalDeviceVulkan12Features*>(next)->timelineSemaphore) {
+            return true;
+        }
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES &&
+            reinterpret_cast<const VkPhysicalDeviceTimelineSemaphoreFeatures*>(next)->timelineSemaphore) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Protected and device-group submits, among others, must stay where the
+// app put them
+bool IsPlainSubmit(const VkSubmitInfo& submit) {
+    auto* next = static_cast<const VkBaseInStructure*>(submit.pNext);
+    return !next || (next->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO && !next->pNext);
+}
+
+bool IsPlainSubmit(const VkSubmitInfo2& submit) {
+    return !submit.pNext && submit.flags == 0;
+}
+
+bool HasSignals(const VkSubmitInfo& submit) { return submit.signalSemaphoreCount != 0; }
+bool HasSignals(const VkSubmitInfo2& submit) { return submit.signalSemaphoreInfoCount != 0; }
+
+// Command-less batches that wait on or signal one timeline value. A wait
+// also holds back every later batch on the queue, and a signal covers every
+// earlier one.
+void SetWait(ScratchArena& arena, VkSubmitInfo& info, VkSemaphore semaphore, uint64_t value,
+             VkPipelineStageFlags stages) {
+    auto* timeline = arena.Allocate<VkTimelineSemaphoreSubmitInfo>(1);
+    timeline->sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline->waitSemaphoreValueCount = 1;
+    timeline->pWaitSemaphoreValues = arena.Copy(value);
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.pNext = timeline;
+    info.waitSemaphoreCount = 1;
+    info.pWaitSemaphores = arena.Copy(semaphore);
+    info.pWaitDstStageMask = arena.Copy(stages);
+}
+
+void SetWait(ScratchArena& arena, VkSubmitInfo2& info, VkSemaphore semaphore, uint64_t value,
+             VkPipelineStageFlags stages) {
+    auto* wait = arena.Allocate<VkSemaphoreSubmitInfo>(1);
+    wait->sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    wait->semaphore = semaphore;
+    wait->value = value;
+    wait->stageMask = stages;
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    info.waitSemaphoreInfoCount = 1;
+    info.pWaitSemaphoreInfos = wait;
+}
+
+void SetSignal(ScratchArena& arena, VkSubmitInfo& info, VkSemaphore semaphore, uint64_t value) {
+    auto* timeline = arena.Allocate<VkTimelineSemaphoreSubmitInfo>(1);
+    timeline->sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline->signalSemaphoreValueCount = 1;
+    timeline->pSignalSemaphoreValues = arena.Copy(value);
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    info.pNext = timeline;
+    info.signalSemaphoreCount = 1;
+    info.pSignalSemaphores = arena.Copy(semaphore);
+}
+
+void SetSignal(ScratchArena& arena, VkSubmitInfo2& info, VkSemaphore semaphore, uint64_t value) {
+    auto* signal = arena.Allocate<VkSemaphoreSubmitInfo>(1);
+    signal->sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signal->semaphore = semaphore;
+    signal->value = value;
+    signal->stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    info.signalSemaphoreInfoCount = 1;
+    info.pSignalSemaphoreInfos = signal;
+}
+
+} // namespace
+
+AsyncComputePlan PlanAsyncCompute(const InstanceDispatch& dispatch,
+                                  VkPhysicalDevice physical_device,
+                                  VkDeviceCreateInfo& create_info,
+                                  std::vector<VkDeviceQueueCreateInfo>& queue_infos,
+                                  std::vector<std::vector<float>>& priorities) {
+    AsyncComputePlan plan;
+    if (!TimelineSemaphoresEnabled(create_info)) {
+        XCLIPSE_LOGW("async compute disabled: the app did not enable timeline semaphores");
+        return plan;
+    }
+
+    uint32_t family_count = 0;
+    dispatch.GetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    dispatch.GetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+    queue_infos.assign(create_info.pQueueCreateInfos,
+                       create_info.pQueueCreateInfos + create_info.queueCreateInfoCount);
+    priorities.reserve(queue_infos.size());
+    for (VkDeviceQueueCreateInfo& info : queue_infos) {
+        // Protected queues can only run protected-capable work
+        if (info.flags != 0 || info.queueFamilyIndex >= family_count || info.queueCount == 0) continue;
+        const VkQueueFamilyProperties& family = families[info.queueFamilyIndex];
+        if (!(family.queueFlags & VK_QUEUE_COMPUTE_BIT) || info.queueCount >= family.queueCount) continue;
+
+        std::vector<float>& queue_priorities = priorities.emplace_back(
+            info.pQueuePriorities, info.pQueuePriorities + info.queueCount);
+        queue_priorities.push_back(info.pQueuePriorities[0]);
+        plan.queues.push_back({info.queueFamilyIndex, info.queueCount});
+        info.queueCount++;
+        info.pQueuePriorities = queue_priorities.data();
+    }
+
+    if (plan.queues.empty()) {
+        XCLIPSE_LOGW("async compute disabled: no queue family the app uses has a spare queue");
+        return plan;
+    }
+    create_info.pQueueCreateInfos = queue_infos.data();
+    for (const OffloadQueueInfo& queue : plan.queues) {
+        XCLIPSE_LOGI("async compute: offload queue %u of family %u", queue.index, queue.family);
+    }
+    return plan;
+}
+
+AsyncComputeScheduler::AsyncComputeScheduler(VkDevice device, const DeviceDispatch& dispatch)
+    : device_(device),
+      queue_submit_(dispatch.QueueSubmit),
+      queue_submit2_(dispatch.QueueSubmit2),
+      create_semaphore_(dispatch.CreateSemaphore),
+      destroy_semaphore_(dispatch.DestroySemaphore),
+      wait_semaphores_(dispatch.WaitSemaphores) {}
+
+std::unique_ptr<AsyncComputeScheduler> AsyncComputeScheduler::Create(VkDevice device,
+                                                                     const DeviceDispatch& dispatch,
+                                                                     const AsyncComputePlan& plan) {
+    if (plan.queues.empty() || !plan.set_loader_data || !dispatch.WaitSemaphores) {
+        return nullptr;
+    }
+
+    std::unique_ptr<AsyncComputeScheduler> scheduler(new AsyncComputeScheduler(device, dispatch));
+    for (const OffloadQueueInfo& info : plan.queues) {
+        auto offload = std::make_unique<OffloadQueue>();
+        offload->family = info.family;
+        dispatch.GetDeviceQueue(device, info.family, info.index, &offload->queue);
+        // The loader only fills in the dispatch pointer of queues the app fetches
+        if (!offload->queue || plan.set_loader_data(device, offload->queue) != VK_SUCCESS ||
+            !scheduler->CreateTimeline(offload->timeline)) {
+            XCLIPSE_LOGW("async compute disabled: cannot set up the queue of family %u", info.family);
+            return nullptr;
+        }
+        scheduler->offload_queues_.push_back(std::move(offload));
+    }
+    return scheduler;
+}
+
+AsyncComputeScheduler::~AsyncComputeScheduler() {
+    for (const std::unique_ptr<OffloadQueue>& offload : offload_queues_) {
+        destroy_semaphore_(device_, offload->timeline, nullptr);
+    }
+    for (const auto& [queue, app] : app_queues_) {
+        destroy_semaphore_(device_, app.timeline, nullptr);
+    }
+}
+
+bool AsyncComputeScheduler::CreateTimeline(VkSemaphore& semaphore) {
+    VkSemaphoreTypeCreateInfo type_info{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    VkSemaphoreCreateInfo create_info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &type_info};
+    return create_semaphore_(device_, &create_info, nullptr, &semaphore) == VK_SUCCESS;
+}
+
+void AsyncComputeScheduler::OnGetQueue(VkQueue queue, uint32_t family) {
+    auto offload = std::find_if(offload_queues_.begin(), offload_queues_.end(),
+                                [family](const auto& offload) { return offload->family == family; });
+    if (offload == offload_queues_.end()) return;
+
+    std::lock_guard<std::mutex> lock(queues_mutex_);
+    if (app_queues_.count(queue)) return;
+    AppQueue app;
+    app.offload = offload->get();
+    if (CreateTimeline(app.timeline)) {
+        app_queues_.emplace(queue, app);
+    }
+}
+
+AsyncComputeScheduler::AppQueue* AsyncComputeScheduler::Find(VkQueue queue) {
+    std::lock_guard<std::mutex> lock(queues_mutex_);
+    auto it = app_queues_.find(queue);
+    return it != app_queues_.end() ? &it->second : nullptr;
+}
+
+bool AsyncComputeScheduler::CanOffload(VkQueue queue, const CommandBufferProfile& profile,
+                                       uint32_t count, const VkSubmitInfo* submits) {
+    return CanOffloadImpl(queue, profile, count, submits);
+}
+
+bool AsyncComputeScheduler::CanOffload(VkQueue queue, const CommandBufferProfile& profile,
+                                       uint32_t count, const VkSubmitInfo2* submits) {
+    return CanOffloadImpl(queue, profile, count, submits);
+}
+
+template <typename SubmitInfo>
+bool AsyncComputeScheduler::CanOffloadImpl(VkQueue queue, const CommandBufferProfile& profile,
+                                           uint32_t count, const SubmitInfo* submits) {
+    // Events cannot be waited on from another queue
+    return ClassifyWorkload(profile) == WorkloadClass::kCompute && !profile.events &&
+           std::all_of(submits, submits + count,
+                       [](const SubmitInfo& submit) { return IsPlainSubmit(submit); }) &&
+           Find(queue) != nullptr;
+}
+
+VkResult AsyncComputeScheduler::Offload(VkQueue queue, uint32_t count, const VkSubmitInfo* submits,
+                                        VkFence fence, const CommandBufferProfile& profile) {
+    return OffloadImpl(queue, count, submits, fence, profile);
+}
+
+VkResult AsyncComputeScheduler::Offload(VkQueue queue, uint32_t count, const VkSubmitInfo2* submits,
+                                        VkFence fence, const CommandBufferProfile& profile) {
+    return OffloadImpl(queue, count, submits, fence, profile);
+}
+
+template <typename SubmitInfo>
+VkResult AsyncComputeScheduler::OffloadImpl(VkQueue queue, uint32_t count,
+                                            const SubmitInfo* submits, VkFence fence,
+                                            const CommandBufferProfile& profile) {
+    AppQueue& app = *Find(queue);
+    OffloadQueue& offload = *app.offload;
+    ScratchArena::Scope scratch;
+    ScratchArena& arena = scratch.arena();
+
+    // Mark where the app queue is, unless the last offload already did
+    if (app.submitted) {
+        VkSubmitInfo mark{};
+        SetSignal(arena, mark, app.timeline, app.value + 1);
+        VkResult result = queue_submit_(queue, 1, &mark, VK_NULL_HANDLE);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        app.value++;
+        app.submitted = false;
+    }
+
+    SubmitInfo* infos = arena.Allocate<SubmitInfo>(count + 2);
+    SetWait(arena, infos[0], app.timeline, app.value, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    std::copy(submits, submits + count, infos + 1);
+
+    std::lock_guard<std::mutex> lock(offload.mutex);
+    uint64_t value = offload.value + 1;
+    SetSignal(arena, infos[count + 1], offload.timeline, value);
+    VkResult result = Submit(offload.queue, count + 2, infos, fence);
+    if (result == VK_SUCCESS) {
+        offload.value = value;
+        app.offloaded = value;
+        // On one queue, later work would have waited at these stages
+        app.released_stages |= profile.release_stages;
+        offloaded_calls_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+const VkSubmitInfo* AsyncComputeScheduler::Join(VkQueue queue, uint32_t& count,
+                                                const VkSubmitInfo* submits, VkFence fence,
+                                                const CommandBufferProfile& profile,
+                                                ScratchArena& arena) {
+    return JoinImpl(queue, count, submits, fence, profile, arena);
+}
+
+const VkSubmitInfo2* AsyncComputeScheduler::Join(VkQueue queue, uint32_t& count,
+                                                 const VkSubmitInfo2* submits, VkFence fence,
+                                                 const CommandBufferProfile& profile,
+                                                 ScratchArena& arena) {
+    return JoinImpl(queue, count, submits, fence, profile, arena);
+}
+
+template <typename SubmitInfo>
+const SubmitInfo* AsyncComputeScheduler::JoinImpl(VkQueue queue, uint32_t& count,
+                                                  const SubmitInfo* submits, VkFence fence,
+                                                  const CommandBufferProfile& profile,
+                                                  ScratchArena& arena) {
+    AppQueue* app = Find(queue);
+    if (!app) return submits;
+    app->submitted = true;
+    if (app->offloaded == 0) return submits;
+
+    // A fence or semaphore signal covers everything submitted before it
+    bool signals = fence != VK_NULL_HANDLE ||
+                   std::any_of(submits, submits + count,
+                               [](const SubmitInfo& submit) { return HasSignals(submit); });
+    VkPipelineStageFlags stages = profile.sync_stages | app->released_stages;
+    if (signals || (stages & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT)) {
+        stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    if (!stages) return submits;
+    // Waited for below or by an earlier join; later calls are ordered
+    // after this one anyway
+    app->released_stages = 0;
+
+    if (app->joined == app->offloaded) {
+        if ((app->joined_stages & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT) || !(stages & ~app->joined_stages)) {
+            return submits;
+        }
+        app->joined_stages |= stages;
+    } else {
+        app->joined = app->offloaded;
+        app->joined_stages = stages;
+    }
+
+    SubmitInfo* infos = arena.Allocate<SubmitInfo>(count + 1);
+    SetWait(arena, infos[0], app->offload->timeline, app->offloaded, stages);
+    std::copy(submits, submits + count, infos + 1);
+    count++;
+    joins_.fetch_add(1, std::memory_order_relaxed);
+    return infos;
+}
+
+VkResult AsyncComputeScheduler::WaitOffloaded(VkQueue queue) {
+    AppQueue* app = Find(queue);
+    if (!app || app->offloaded == 0 ||
+        (app->joined == app->offloaded && (app->joined_stages & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT))) {
+        return VK_SUCCESS;
+    }
+
+    VkSemaphoreWaitInfo wait_info{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &app->offload->timeline;
+    wait_info.pValues = &app->offloaded;
+    host_waits_.fetch_add(1, std::memory_order_relaxed);
+    VkResult result = wait_semaphores_(device_, &wait_info, UINT64_MAX);
+    if (result == VK_SUCCESS) {
+        app->joined = app->offloaded;
+        app->joined_stages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        app->released_stages = 0;
+    }
+    return result;
+}
+
+VkResult AsyncComputeScheduler::Submit(VkQueue queue, uint32_t count, const VkSubmitInfo* submits,
+                                       VkFence fence) {
+    return queue_submit_(queue, count, submits, fence);
+}
+
+VkResult AsyncComputeScheduler::Submit(VkQueue queue, uint32_t count, const VkSubmitInfo2* submits,
+                                       VkFence fence) {
+    return queue_submit2_(queue, count, submits, fence);
+}
+
+void AsyncComputeScheduler::LogStats() const {
+    XCLIPSE_LOGI("async compute: %llu calls offloaded, %llu joins on app queues, %llu host waits",
+                 static_cast<unsigned long long>(offloaded_calls_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(joins_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(host_waits_.load(std::memory_order_relaxed)));
+}
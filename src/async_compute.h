@@ -0,0 +1,155 @@
+// async_compute.h - Opt-in offload of compute-only submits to a second queue
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "command_buffer_profile.h"
+#include "dispatch.h"
+#include "scratch_arena.h"
+#include "vk_layer_interface.h"
+
+// A queue vkCreateDevice created for the layer on top of the app's own
+struct OffloadQueueInfo {
+    uint32_t family;
+    uint32_t index;
+};
+
+struct AsyncComputePlan {
+    std::vector<OffloadQueueInfo> queues;
+    PFN_vkSetDeviceLoaderData set_loader_data{nullptr};
+};
+
+// Asks for one more queue in every compute-capable family the app creates
+// queues in without using all of them. The rewritten queue create infos
+// live in queue_infos and priorities. Returns an empty plan, leaving
+// create_info alone, when the app did not enable timeline semaphores or no
+// family has a queue to spare.
+AsyncComputePlan PlanAsyncCompute(const InstanceDispatch& dispatch,
+                                  VkPhysicalDevice physical_device,
+                                  VkDeviceCreateInfo& create_info,
+                                  std::vector<VkDeviceQueueCreateInfo>& queue_infos,
+                                  std::vector<std::vector<float>>& priorities);
+
+// Runs submits that only dispatch and copy on a second queue of the app
+// queue's family, so they overlap with graphics submitted after them, e.g.
+// post-processing with the next frame's geometry. Command buffers only run
+// on queues of their pool's family and exclusive resources belong to one
+// family, so a dedicated compute family would not be transparent.
+//
+// Ordering the app gets from submission order is rebuilt with timeline
+// semaphores, which also carry the memory dependency:
+//  - an offloaded call waits for everything submitted to the app queue
+//    before it;
+//  - a later call on the app queue waits for the offloaded work at the
+//    source stages of its own barriers that could depend on it, at the
+//    destination stages of barriers in the offloaded work, or at
+//    ALL_COMMANDS when it signals a fence or semaphore;
+//  - vkQueueWaitIdle on the app queue also waits for its offloaded work.
+// Calls that use events, or chain anything but timeline values to their
+// submits, stay on the app queue.
+class AsyncComputeScheduler {
+public:
+    // Returns nullptr if the plan is empty or the layer's semaphores cannot
+    // be created.
+    static std::unique_ptr<AsyncComputeScheduler> Create(VkDevice device,
+                                                         const DeviceDispatch& dispatch,
+                                                         const AsyncComputePlan& plan);
+
+    ~AsyncComputeScheduler();
+
+    AsyncComputeScheduler(const AsyncComputeScheduler&) = delete;
+    AsyncComputeScheduler& operator=(const AsyncComputeScheduler&) = delete;
+
+    // vkGetDeviceQueue/vkGetDeviceQueue2 handed out an app queue
+    void OnGetQueue(VkQueue queue, uint32_t family);
+
+    // profile sums the whole call
+    bool CanOffload(VkQueue queue, const CommandBufferProfile& profile, uint32_t count,
+                    const VkSubmitInfo* submits);
+    bool CanOffload(VkQueue queue, const CommandBufferProfile& profile, uint32_t count,
+                    const VkSubmitInfo2* submits);
+
+    // The caller keeps every other submit to queue out until these return
+    VkResult Offload(VkQueue queue, uint32_t count, const VkSubmitInfo* submits, VkFence fence,
+                     const CommandBufferProfile& profile);
+    VkResult Offload(VkQueue queue, uint32_t count, const VkSubmitInfo2* submits, VkFence fence,
+                     const CommandBufferProfile& profile);
+
+    // For a call that stays on queue: prepends a wait for offloaded work it
+    // depends on and updates count, or returns submits unchanged
+    const VkSubmitInfo* Join(VkQueue queue, uint32_t& count, const VkSubmitInfo* submits,
+                             VkFence fence, const CommandBufferProfile& profile, ScratchArena& arena);
+    const VkSubmitInfo2* Join(VkQueue queue, uint32_t& count, const VkSubmitInfo2* submits,
+                              VkFence fence, const CommandBufferProfile& profile, ScratchArena& arena);
+
+    // After the app queue went idle, waits for the work offloaded from it
+    VkResult WaitOffloaded(VkQueue queue);
+
+    void LogStats() const;
+
+private:
+    struct OffloadQueue {
+        uint32_t family{0};
+        VkQueue queue{VK_NULL_HANDLE};
+        VkSemaphore timeline{VK_NULL_HANDLE};
+        std::mutex mutex;  // app queues of one family share the offload queue
+        uint64_t value{0};
+    };
+
+    // Only touched by whoever holds the app queue, which Vulkan requires
+    // to be externally synchronized
+    struct AppQueue {
+        OffloadQueue* offload{nullptr};
+        VkSemaphore timeline{VK_NULL_HANDLE};
+        uint64_t value{0};
+        bool submitted{false};              // since timeline last reached value
+        uint64_t offloaded{0};              // offload timeline value of the last offloaded call
+        uint64_t joined{0};
+        VkPipelineStageFlags joined_stages{0};
+        // Release stages of the work offloaded since the app queue last
+        // waited for it
+        VkPipelineStageFlags released_stages{0};
+    };
+
+    AsyncComputeScheduler(VkDevice device, const DeviceDispatch& dispatch);
+
+    bool CreateTimeline(VkSemaphore& semaphore);
+    AppQueue* Find(VkQueue queue);
+
+    template <typename SubmitInfo>
+    bool CanOffloadImpl(VkQueue queue, const CommandBufferProfile& profile, uint32_t count,
+                        const SubmitInfo* submits);
+    template <typename SubmitInfo>
+    VkResult OffloadImpl(VkQueue queue, uint32_t count, const SubmitInfo* submits, VkFence fence,
+                         const CommandBufferProfile& profile);
+    template <typename SubmitInfo>
+    const SubmitInfo* JoinImpl(VkQueue queue, uint32_t& count, const SubmitInfo* submits,
+                               VkFence fence, const CommandBufferProfile& profile,
+                               ScratchArena& arena);
+
+    VkResult Submit(VkQueue queue, uint32_t count, const VkSubmitInfo* submits, VkFence fence);
+    VkResult Submit(VkQueue queue, uint32_t count, const VkSubmitInfo2* submits, VkFence fence);
+
+    VkDevice device_;
+    PFN_vkQueueSubmit queue_submit_;
+    PFN_vkQueueSubmit2 queue_submit2_;
+    PFN_vkCreateSemaphore create_semaphore_;
+    PFN_vkDestroySemaphore destroy_semaphore_;
+    PFN_vkWaitSemaphores wait_semaphores_;
+
+    std::vector<std::unique_ptr<OffloadQueue>> offload_queues_;
+
+    std::mutex queues_mutex_;
+    std::unordered_map<VkQueue, AppQueue> app_queues_;  // node-based, so entries never move
+
+    std::atomic<uint64_t> offloaded_calls_{0};
+    std::atomic<uint64_t> joins_{0};
+    std::atomic<uint64_t> host_waits_{0};
+};
@@ -0,0 +1,11 @@
+// clock.h - Monotonic timestamps shared by the layer's instrumentation
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+inline uint64_t SteadyNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
@@ -0,0 +1,220 @@
+// command_buffer_profile.cpp - Per-command-buffer workload counters for submit classification
+
+#include "command_buffer_profile.h"
+
+#include "log.h"
+
+thread_local CommandBufferProfiler::LastLookup CommandBufferProfiler::last_lookup_;
+std::atomic<uint64_t> CommandBufferProfiler::epoch_{1};
+
+WorkloadClass ClassifyWorkload(const CommandBufferProfile& profile) {
+    if (profile.draws || profile.render_passes) return WorkloadClass::kGraphics;
+    if (profile.dispatches) return WorkloadClass::kCompute;
+    if (profile.transfers) return WorkloadClass::kTransfer;
+    return WorkloadClass::kEmpty;
+}
+
+namespace {
+
+VkDeviceSize TexelBytes(const VkExtent3D& extent, uint32_t layer_count) {
+    return VkDeviceSize{extent.width} * extent.height * extent.depth * layer_count * 4;
+}
+
+uint32_t Span(int32_t from, int32_t to) {
+    return static_cast<uint32_t>(from < to ? to - from : from - to);
+}
+
+template <typename Blit>
+VkDeviceSize BlitBytes(const Blit& region) {
+    VkExtent3D extent{Span(region.dstOffsets[0].x, region.dstOffsets[1].x),
+                      Span(region.dstOffsets[0].y, region.dstOffsets[1].y),
+                      Span(region.dstOffsets[0].z, region.dstOffsets[1].z)};
+    return TexelBytes(extent, region.dstSubresource.layerCount);
+}
+
+} // namespace
+
+VkDeviceSize RegionBytes(const VkBufferCopy& region) { return region.size; }
+VkDeviceSize RegionBytes(const VkBufferCopy2& region) { return region.size; }
+
+VkDeviceSize RegionBytes(const VkImageCopy& region) {
+    return TexelBytes(region.extent, region.srcSubresource.layerCount);
+}
+
+VkDeviceSize RegionBytes(const VkImageCopy2& region) {
+    return TexelBytes(region.extent, region.srcSubresource.layerCount);
+}
+
+VkDeviceSize RegionBytes(const VkBufferImageCopy& region) {
+    return TexelBytes(region.imageExtent, region.imageSubresource.layerCount);
+}
+
+VkDeviceSize RegionBytes(const VkBufferImageCopy2& region) {
+    return TexelBytes(region.imageExtent, region.imageSubresource.layerCount);
+}
+
+VkDeviceSize RegionBytes(const VkImageBlit& region) { return BlitBytes(region); }
+VkDeviceSize RegionBytes(const VkImageBlit2& region) { return BlitBytes(region); }
+
+void CommandBufferProfile::AddDependency(VkPipelineStageFlags2 src_stages,
+                                         VkPipelineStageFlags2 dst_stages) {
+    // Stages the commands of a compute-only submit execute in
+    constexpr VkPipelineStageFlags2 kComputeStages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+                                                     VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    constexpr VkPipelineStageFlags2 kAllStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT |
+                                                 VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT;
+    // Synchronization2-only stages (copy, blit, clear, ...) have no
+    // VkPipelineStageFlags equivalent
+    if ((src_stages & kAllStages) || (src_stages >> 32)) {
+        sync_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    } else if (src_stages & kComputeStages) {
+        sync_stages |= static_cast<VkPipelineStageFlags>(src_stages);
+    }
+
+    // As a destination, TOP_OF_PIPE waits for nothing and HOST is not
+    // reached by queue work
+    dst_stages &= ~(VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_HOST_BIT);
+    if ((dst_stages & kAllStages) || (dst_stages >> 32)) {
+        release_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    } else {
+        release_stages |= static_cast<VkPipelineStageFlags>(dst_stages);
+    }
+}
+
+void CommandBufferProfile::AddDependency(const VkDependencyInfo& dependency) {
+    for (uint32_t i = 0; i < dependency.memoryBarrierCount; ++i) {
+        const VkMemoryBarrier2& barrier = dependency.pMemoryBarriers[i];
+        AddDependency(barrier.srcStageMask, barrier.dstStageMask);
+    }
+    for (uint32_t i = 0; i < dependency.bufferMemoryBarrierCount; ++i) {
+        const VkBufferMemoryBarrier2& barrier = dependency.pBufferMemoryBarriers[i];
+        AddDependency(barrier.srcStageMask, barrier.dstStageMask);
+    }
+    for (uint32_t i = 0; i < dependency.imageMemoryBarrierCount; ++i) {
+        const VkImageMemoryBarrier2& barrier = dependency.pImageMemoryBarriers[i];
+        AddDependency(barrier.srcStageMask, barrier.dstStageMask);
+    }
+}
+
+CommandBufferProfiler::~CommandBufferProfiler() {
+    // Destroying the device frees its command buffers implicitly
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CommandBufferProfiler::OnCreatePool(VkCommandPool pool, uint32_t queue_family) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_families_[pool] = queue_family;
+}
+
+void CommandBufferProfiler::OnAllocate(VkCommandPool pool, uint32_t count,
+                                       const VkCommandBuffer* command_buffers) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto family = pool_families_.find(pool);
+    Entry entry{{}, pool};
+    if (family != pool_families_.end()) {
+        entry.profile.timestamps.queue_family = family->second;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        entries_[command_buffers[i]] = entry;
+    }
+}
+
+void CommandBufferProfiler::OnFree(uint32_t count, const VkCommandBuffer* command_buffers,
+                                   std::vector<uint32_t>& timestamp_chunks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto it = entries_.find(command_buffers[i]);
+        if (it == entries_.end()) continue;
+        if (it->second.profile.timestamps.chunk != TimestampCursor::kNoChunk) {
+            timestamp_chunks.push_back(it->second.profile.timestamps.chunk);
+        }
+        entries_.erase(it);
+    }
+}
+
+void CommandBufferProfiler::OnDestroyPool(VkCommandPool pool, std::vector<uint32_t>& timestamp_chunks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+    pool_families_.erase(pool);
+    std::erase_if(entries_, [&](const auto& entry) {
+        if (entry.second.pool != pool) return false;
+        if (entry.second.profile.timestamps.chunk != TimestampCursor::kNoChunk) {
+            timestamp_chunks.push_back(entry.second.profile.timestamps.chunk);
+        }
+        return true;
+    });
+}
+
+CommandBufferProfile* CommandBufferProfiler::Begin(VkCommandBuffer command_buffer) {
+    CommandBufferProfile* profile = Find(command_buffer);
+    if (profile) {
+        TimestampCursor timestamps = profile->timestamps;
+        *profile = CommandBufferProfile{};
+        profile->timestamps = timestamps;
+    }
+    return profile;
+}
+
+CommandBufferProfile* CommandBufferProfiler::FindSlow(VkCommandBuffer command_buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(command_buffer);
+    CommandBufferProfile* profile = it != entries_.end() ? &it->second.profile : nullptr;
+    // Misses are not cached, so a handle allocated later is still found
+    if (profile) {
+        last_lookup_ = {command_buffer, profile, epoch_.load(std::memory_order_relaxed)};
+    }
+    return profile;
+}
+
+CommandBufferProfile CommandBufferProfiler::Summarize(uint32_t count,
+                                                      const VkCommandBuffer* command_buffers) {
+    CommandBufferProfile sum;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto it = entries_.find(command_buffers[i]);
+        if (it != entries_.end()) {
+            sum.Add(it->second.profile);
+        }
+    }
+    return sum;
+}
+
+CommandBufferProfile CommandBufferProfiler::Summarize(uint32_t count,
+                                                      const VkCommandBufferSubmitInfo* infos) {
+    CommandBufferProfile sum;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto it = entries_.find(infos[i].commandBuffer);
+        if (it != entries_.end()) {
+            sum.Add(it->second.profile);
+        }
+    }
+    return sum;
+}
+
+void CommandBufferProfiler::RecordSubmit(WorkloadClass workload, const CommandBufferProfile& profile) {
+    submits_[static_cast<size_t>(workload)].fetch_add(1, std::memory_order_relaxed);
+    draws_.fetch_add(profile.draws, std::memory_order_relaxed);
+    dispatches_.fetch_add(profile.dispatches, std::memory_order_relaxed);
+    transfers_.fetch_add(profile.transfers, std::memory_order_relaxed);
+    render_passes_.fetch_add(profile.render_passes, std::memory_order_relaxed);
+    transfer_bytes_.fetch_add(profile.transfer_bytes, std::memory_order_relaxed);
+}
+
+void CommandBufferProfiler::LogStats() const {
+    auto submits = [this](WorkloadClass workload) {
+        return static_cast<unsigned long long>(
+            submits_[static_cast<size_t>(workload)].load(std::memory_order_relaxed));
+    };
+    XCLIPSE_LOGI("submitted work: graphics=%llu compute=%llu transfer=%llu empty=%llu submits; "
+                 "%llu draws, %llu dispatches, %llu render passes, %llu transfers (~%.1f MB)",
+                 submits(WorkloadClass::kGraphics), submits(WorkloadClass::kCompute),
+                 submits(WorkloadClass::kTransfer), submits(WorkloadClass::kEmpty),
+                 static_cast<unsigned long long>(draws_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(dispatches_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(render_passes_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(transfers_.load(std::memory_order_relaxed)),
+                 static_cast<double>(transfer_bytes_.load(std::memory_order_relaxed)) / (1 << 20));
+}
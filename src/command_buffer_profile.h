@@ -0,0 +1,164 @@
+// command_buffer_profile.h - Per-command-buffer workload counters for submit classification
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Bytes moved by one copy or blit region. Image regions are counted at 4
+// bytes per texel; the layer does not track image formats.
+VkDeviceSize RegionBytes(const VkBufferCopy& region);
+VkDeviceSize RegionBytes(const VkBufferCopy2& region);
+VkDeviceSize RegionBytes(const VkImageCopy& region);
+VkDeviceSize RegionBytes(const VkImageCopy2& region);
+VkDeviceSize RegionBytes(const VkBufferImageCopy& region);
+VkDeviceSize RegionBytes(const VkBufferImageCopy2& region);
+VkDeviceSize RegionBytes(const VkImageBlit& region);
+VkDeviceSize RegionBytes(const VkImageBlit2& region);
+
+// What a GPU timestamp pair brackets
+enum class TimestampRegion : uint8_t {
+    kNone,
+    kRenderPass,  // render pass or dynamic rendering instance
+    kDispatches,  // run of dispatches outside render passes
+};
+
+// Where GpuProfiler writes one command buffer's timestamps. Unlike the
+// counters it survives vkBeginCommandBuffer, so the profiler gets its
+// query chunk back.
+struct TimestampCursor {
+    static constexpr uint32_t kNoChunk = UINT32_MAX;
+    uint32_t chunk{kNoChunk};
+    // Of the command buffer's pool; IGNORED if the layer missed its creation
+    uint32_t queue_family{VK_QUEUE_FAMILY_IGNORED};
+    TimestampRegion open{TimestampRegion::kNone};  // awaiting its end timestamp
+};
+
+// What one command buffer records, counted as the app records it. Reset by
+// vkBeginCommandBuffer; vkCmdExecuteCommands folds secondaries in.
+struct CommandBufferProfile {
+    uint32_t draws{0};
+    uint32_t dispatches{0};
+    uint32_t transfers{0};         // copy and blit commands
+    uint32_t render_passes{0};     // render passes and dynamic rendering
+    VkDeviceSize transfer_bytes{0};
+    // Source stages of dependencies that reach back to earlier compute,
+    // transfer or indirect-argument work; ALL_COMMANDS when the layer
+    // cannot tell, as with render pass subpass dependencies
+    VkPipelineStageFlags sync_stages{0};
+    // Destination stages of those dependencies: work submitted later to
+    // the same queue waits at these for what came before, ALL_COMMANDS
+    // when they have no VkPipelineStageFlags equivalent
+    VkPipelineStageFlags release_stages{0};
+    bool events{false};  // sets, resets or waits on events
+    TimestampCursor timestamps;  // not summed
+
+    void Add(const CommandBufferProfile& other) {
+        draws += other.draws;
+        dispatches += other.dispatches;
+        transfers += other.transfers;
+        render_passes += other.render_passes;
+        transfer_bytes += other.transfer_bytes;
+        sync_stages |= other.sync_stages;
+        release_stages |= other.release_stages;
+        events |= other.events;
+    }
+
+    void AddDependency(VkPipelineStageFlags2 src_stages, VkPipelineStageFlags2 dst_stages);
+    void AddDependency(const VkDependencyInfo& dependency);
+
+    template <typename Region>
+    void AddTransfer(uint32_t region_count, const Region* regions) {
+        transfers++;
+        for (uint32_t i = 0; i < region_count; ++i) {
+            transfer_bytes += RegionBytes(regions[i]);
+        }
+    }
+};
+
+// The queue capability a submission actually needs
+enum class WorkloadClass : uint8_t {
+    kEmpty,     // nothing the layer counts, e.g. only barriers or queries
+    kGraphics,  // any draw or render pass
+    kCompute,   // dispatches, possibly with transfers
+    kTransfer,  // copies and blits only
+    kCount,
+};
+
+WorkloadClass ClassifyWorkload(const CommandBufferProfile& profile);
+
+// Profiles are keyed by command buffer handle. Recording calls arrive back
+// to back on one command buffer per thread, so Find() keeps the last hit in
+// a thread-local slot and only takes the lock when the command buffer
+// changes. Any free invalidates every thread's slot, since a freed handle
+// can come back from the next allocation.
+class CommandBufferProfiler {
+public:
+    CommandBufferProfiler() = default;
+    ~CommandBufferProfiler();
+
+    CommandBufferProfiler(const CommandBufferProfiler&) = delete;
+    CommandBufferProfiler& operator=(const CommandBufferProfiler&) = delete;
+
+    void OnCreatePool(VkCommandPool pool, uint32_t queue_family);
+    void OnAllocate(VkCommandPool pool, uint32_t count, const VkCommandBuffer* command_buffers);
+    // Both append the timestamp chunks the released command buffers held
+    void OnFree(uint32_t count, const VkCommandBuffer* command_buffers,
+                std::vector<uint32_t>& timestamp_chunks);
+    void OnDestroyPool(VkCommandPool pool, std::vector<uint32_t>& timestamp_chunks);
+
+    // Recording starts over; nullptr for command buffers the layer did not see
+    CommandBufferProfile* Begin(VkCommandBuffer command_buffer);
+
+    // Called on every recorded command. The returned profile is only
+    // touched by the thread recording command_buffer.
+    CommandBufferProfile* Find(VkCommandBuffer command_buffer) {
+        LastLookup& last = last_lookup_;
+        if (last.command_buffer == command_buffer &&
+            last.epoch == epoch_.load(std::memory_order_relaxed)) {
+            return last.profile;
+        }
+        return FindSlow(command_buffer);
+    }
+
+    // Sum over a submit's command buffers, which recording has finished with
+    CommandBufferProfile Summarize(uint32_t count, const VkCommandBuffer* command_buffers);
+    CommandBufferProfile Summarize(uint32_t count, const VkCommandBufferSubmitInfo* infos);
+
+    void RecordSubmit(WorkloadClass workload, const CommandBufferProfile& profile);
+
+    void LogStats() const;
+
+private:
+    struct Entry {
+        CommandBufferProfile profile;
+        VkCommandPool pool;
+    };
+
+    struct LastLookup {
+        VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+        CommandBufferProfile* profile{nullptr};
+        uint64_t epoch{0};
+    };
+
+    CommandBufferProfile* FindSlow(VkCommandBuffer command_buffer);
+
+    // Shared by every device: handles are unique process-wide
+    static thread_local LastLookup last_lookup_;
+    static std::atomic<uint64_t> epoch_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<VkCommandBuffer, Entry> entries_;  // node-based, so profiles never move
+    std::unordered_map<VkCommandPool, uint32_t> pool_families_;
+
+    std::atomic<uint64_t> submits_[static_cast<size_t>(WorkloadClass::kCount)]{};
+    std::atomic<uint64_t> draws_{0};
+    std::atomic<uint64_t> dispatches_{0};
+    std::atomic<uint64_t> transfers_{0};
+    std::atomic<uint64_t> render_passes_{0};
+    std::atomic<uint64_t> transfer_bytes_{0};
+};
@@ -0,0 +1,195 @@
+// compile_pool.cpp - Worker pool for fanning out pipeline compiles
+
+#include "compile_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <sched.h>
+
+namespace {
+
+uint64_t ReadCpuMaxFrequency(uint32_t cpu) {
+    char path[96];
+    std::snprintf(path, sizeof(path),
+                  "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", cpu);
+
+    unsigned long long frequency = 0;
+    if (FILE* file = std::fopen(path, "r")) {
+        if (std::fscanf(file, "%llu", &frequency) != 1) {
+            frequency = 0;
+        }
+        std::fclose(file);
+    }
+    return frequency;
+}
+
+// CPUs outside the slowest cluster. On a big.LITTLE part like the Exynos 2400
+// (1 + 5 big/mid cores, 4 little cores) that is 6 CPUs. Falls back to every
+// CPU when frequencies are unreadable or uniform.
+std::vector<uint32_t> FindPerformanceCpus() {
+    uint32_t cpu_count = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<uint64_t> frequencies(cpu_count);
+    for (uint32_t cpu = 0; cpu < cpu_count; ++cpu) {
+        frequencies[cpu] = ReadCpuMaxFrequency(cpu);
+    }
+
+    uint64_t slowest = *std::min_element(frequencies.begin(), frequencies.end());
+    std::vector<uint32_t> cpus;
+    for (uint32_t cpu = 0; cpu < cpu_count; ++cpu) {
+        if (slowest == 0 || frequencies[cpu] > slowest) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    if (cpus.empty()) {
+        for (uint32_t cpu = 0; cpu < cpu_count; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+} // namespace
+
+CompileThreadPool& CompileThreadPool::Shared() {
+    static CompileThreadPool pool;
+    return pool;
+}
+
+CompileThreadPool::CompileThreadPool()
+    : performance_cpus_(FindPerformanceCpus()) {
+    // The caller compiles too, so one performance core is left for it
+    uint32_t worker_count = static_cast<uint32_t>(performance_cpus_.size()) - 1;
+    workers_.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back(&CompileThreadPool::WorkerLoop, this);
+    }
+}
+
+CompileThreadPool::~CompileThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stop_ = true;
+    }
+    queue_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void CompileThreadPool::ParallelFor(uint32_t count, void (*fn)(void*, uint32_t), void* callable) {
+    if (count == 0) {
+        return;
+    }
+
+    Job job;
+    job.fn = fn;
+    job.callable = callable;
+    job.count = count;
+
+    if (count > 1 && !workers_.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            Enqueue(&job);
+        }
+        if (count - 1 >= workers_.size()) {
+            queue_cv_.notify_all();
+        } else {
+            for (uint32_t i = 0; i < count - 1; ++i) {
+                queue_cv_.notify_one();
+            }
+        }
+    }
+
+    RunJob(job);
+
+    // No new worker may pick the job up once it leaves the queue; then wait
+    // for the ones already inside it.
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        Dequeue(&job);
+    }
+
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.finished_cv.wait(lock, [&job] {
+        return job.completed == job.count && job.active_workers == 0;
+    });
+}
+
+void CompileThreadPool::RunJob(Job& job) {
+    for (;;) {
+        uint32_t index = job.next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= job.count) {
+            return;
+        }
+
+        job.fn(job.callable, index);
+
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (++job.completed == job.count) {
+            job.finished_cv.notify_all();
+        }
+    }
+}
+
+void CompileThreadPool::Enqueue(Job* job) {
+    job->queue_next = nullptr;
+    if (queue_tail_) {
+        queue_tail_->queue_next = job;
+    } else {
+        queue_head_ = job;
+    }
+    queue_tail_ = job;
+}
+
+void CompileThreadPool::Dequeue(Job* job) {
+    Job* previous = nullptr;
+    for (Job* current = queue_head_; current; previous = current, current = current->queue_next) {
+        if (current != job) continue;
+
+        (previous ? previous->queue_next : queue_head_) = job->queue_next;
+        if (queue_tail_ == job) {
+            queue_tail_ = previous;
+        }
+        return;
+    }
+}
+
+void CompileThreadPool::WorkerLoop() {
+    // Keep compiles off the little cores
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (uint32_t cpu : performance_cpus_) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    sched_setaffinity(0, sizeof(cpu_set), &cpu_set);
+
+    for (;;) {
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return stop_ || queue_head_; });
+            if (stop_) {
+                return;
+            }
+
+            job = queue_head_;
+            if (job->next.load(std::memory_order_relaxed) >= job->count) {
+                // Every index is claimed; the owner is only waiting for stragglers
+                Dequeue(job);
+                continue;
+            }
+
+            std::lock_guard<std::mutex> job_lock(job->mutex);
+            job->active_workers++;
+        }
+
+        RunJob(*job);
+
+        std::lock_guard<std::mutex> job_lock(job->mutex);
+        job->active_workers--;
+        job->finished_cv.notify_all();
+    }
+}
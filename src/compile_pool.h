@@ -0,0 +1,72 @@
+// compile_pool.h - Worker pool for fanning out pipeline compiles
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Threads are pinned to the performance cores (everything faster than the
+// slowest cluster), since compiling on the little cores only adds latency.
+// The calling thread always takes part, so a pool of N workers compiles
+// N + 1 pipelines at once.
+class CompileThreadPool {
+public:
+    // Process-wide pool, started on first use
+    static CompileThreadPool& Shared();
+
+    ~CompileThreadPool();
+
+    CompileThreadPool(const CompileThreadPool&) = delete;
+    CompileThreadPool& operator=(const CompileThreadPool&) = delete;
+
+    uint32_t worker_count() const { return static_cast<uint32_t>(workers_.size()); }
+
+    // Runs fn(i) for every i in [0, count) and returns once all have finished.
+    // Safe to call from several threads at once.
+    template <typename Fn>
+    void ParallelFor(uint32_t count, Fn&& fn) {
+        using Callable = std::remove_reference_t<Fn>;
+        ParallelFor(count, [](void* callable, uint32_t index) {
+            (*static_cast<Callable*>(callable))(index);
+        }, const_cast<void*>(static_cast<const void*>(&fn)));
+    }
+
+    void ParallelFor(uint32_t count, void (*fn)(void*, uint32_t), void* callable);
+
+private:
+    struct Job {
+        void (*fn)(void*, uint32_t);
+        void* callable;
+        uint32_t count;
+        std::atomic<uint32_t> next{0};
+
+        std::mutex mutex;
+        std::condition_variable finished_cv;
+        uint32_t completed{0};
+        uint32_t active_workers{0};
+
+        Job* queue_next{nullptr};  // guarded by queue_mutex_
+    };
+
+    CompileThreadPool();
+
+    static void RunJob(Job& job);
+    // Intrusive so queueing a batch never allocates; queue_mutex_ held
+    void Enqueue(Job* job);
+    void Dequeue(Job* job);
+    void WorkerLoop();
+
+    std::vector<uint32_t> performance_cpus_;
+    std::vector<std::thread> workers_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    Job* queue_head_{nullptr};
+    Job* queue_tail_{nullptr};
+    bool stop_{false};
+};
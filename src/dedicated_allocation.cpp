@@ -0,0 +1,174 @@
+// dedicated_allocation.cpp - Steers large images and render targets into dedicated allocations
+
+#include "dedicated_allocation.h"
+
+#include "log.h"
+
+namespace {
+
+constexpr VkImageCreateFlags kIneligibleCreateFlags =
+    VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_ALIAS_BIT | VK_IMAGE_CREATE_DISJOINT_BIT;
+constexpr VkImageUsageFlags kAttachmentUsage =
+    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+// The last requirements query on this thread that required a dedicated
+// allocation
+struct PendingQuery {
+    const DedicatedImageTracker* tracker;
+    VkImage image;
+    VkDeviceSize size;
+    uint32_t memory_type_bits;
+};
+
+thread_local PendingQuery t_pending_query{};
+
+bool HasChained(const void* next, VkStructureType type) {
+    for (auto* header = static_cast<const VkBaseInStructure*>(next); header; header = header->pNext) {
+        if (header->sType == type) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Only allocation flags and priority may ride along with an injected
+// dedicated info; anything else (import, export) pins the allocation
+bool IsInjectableChain(const void* next) {
+    for (auto* header = static_cast<const VkBaseInStructure*>(next); header; header = header->pNext) {
+        if (header->sType != VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO &&
+            header->sType != VK_STRUCTURE_TYPE_MEMORY_PRIORITY_ALLOCATE_INFO_EXT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool HasDedicatedAllocateInfo(const void* next) {
+    return HasChained(next, VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO);
+}
+
+DedicatedImageTracker::DedicatedImageTracker(VkDeviceSize min_size, bool inject)
+    : min_size_(min_size), inject_(inject) {}
+
+void DedicatedImageTracker::OnCreateImage(VkImage image, const VkImageCreateInfo& info) {
+    ImageState state{};
+    state.eligible = !(info.flags & kIneligibleCreateFlags) &&
+                     !(info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+                     !HasChained(info.pNext, VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO);
+    state.attachment = (info.usage & kAttachmentUsage) != 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    images_[image] = state;
+}
+
+void DedicatedImageTracker::OnDestroyImage(VkImage image) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    images_.erase(image);
+}
+
+void DedicatedImageTracker::OnImageRequirements(VkImage image, const VkMemoryRequirements& requirements,
+                                                VkMemoryDedicatedRequirements* dedicated) {
+    bool eligible = false;
+    bool candidate = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = images_.find(image);
+        if (it != images_.end() && it->second.eligible) {
+            it->second.candidate = it->second.attachment || requirements.size >= min_size_;
+            eligible = true;
+            candidate = it->second.candidate;
+        }
+    }
+
+    // Memory for this image has to be dedicated to it, so an allocation of
+    // exactly its size right after the query can only be meant for it
+    if (inject_ && eligible && dedicated && dedicated->requiresDedicatedAllocation) {
+        t_pending_query = PendingQuery{this, image, requirements.size, requirements.memoryTypeBits};
+    } else {
+        t_pending_query = PendingQuery{};
+    }
+
+    if (candidate && dedicated && !dedicated->prefersDedicatedAllocation) {
+        dedicated->prefersDedicatedAllocation = VK_TRUE;
+        hinted_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void DedicatedImageTracker::ForgetPendingQuery() {
+    t_pending_query = PendingQuery{};
+}
+
+bool DedicatedImageTracker::InjectDedicated(VkMemoryAllocateInfo& info,
+                                            VkMemoryDedicatedAllocateInfo& dedicated) {
+    PendingQuery query = t_pending_query;
+    t_pending_query = PendingQuery{};
+
+    if (query.tracker != this || query.size != info.allocationSize ||
+        info.memoryTypeIndex >= 32 || !(query.memory_type_bits & (1u << info.memoryTypeIndex)) ||
+        !IsInjectableChain(info.pNext)) {
+        return false;
+    }
+
+    {
+        // The image may have been destroyed since the query
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!images_.count(query.image)) {
+            return false;
+        }
+    }
+
+    dedicated = VkMemoryDedicatedAllocateInfo{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO};
+    dedicated.pNext = info.pNext;
+    dedicated.image = query.image;
+    info.pNext = &dedicated;
+    return true;
+}
+
+void DedicatedImageTracker::OnAllocated(VkDeviceMemory memory, const VkMemoryAllocateInfo& info,
+                                        bool injected) {
+    if (injected) {
+        auto* dedicated = static_cast<const VkMemoryDedicatedAllocateInfo*>(info.pNext);
+        injected_count_.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(mutex_);
+        injected_[memory] = dedicated->image;
+        return;
+    }
+
+    for (auto* header = static_cast<const VkBaseInStructure*>(info.pNext); header; header = header->pNext) {
+        if (header->sType != VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO) continue;
+        
+        VkImage image = reinterpret_cast<const VkMemoryDedicatedAllocateInfo*>(header)->image;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = images_.find(image);
+        if (it != images_.end() && it->second.candidate) {
+            app_dedicated_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+}
+
+void DedicatedImageTracker::OnFree(VkDeviceMemory memory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    injected_.erase(memory);
+}
+
+void DedicatedImageTracker::CheckBind(VkImage image, VkDeviceMemory memory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = injected_.find(memory);
+    if (it != injected_.end() && it->second != image) {
+        bind_mismatches_.fetch_add(1, std::memory_order_relaxed);
+        XCLIPSE_LOGW("image %p bound to memory made dedicated for image %p",
+                     static_cast<void*>(image), static_cast<void*>(it->second));
+    }
+}
+
+void DedicatedImageTracker::LogStats() const {
+    XCLIPSE_LOGI("dedicated images: %llu hinted, %llu allocated dedicated by the app, "
+                 "%llu promoted by the layer, %llu bind mismatches",
+                 static_cast<unsigned long long>(hinted_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(app_dedicated_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(injected_count_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(bind_mismatches_.load(std::memory_order_relaxed)));
+}
@@ -0,0 +1,76 @@
+// dedicated_allocation.h - Steers large images and render targets into dedicated allocations
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// True if next chains a VkMemoryDedicatedAllocateInfo
+bool HasDedicatedAllocateInfo(const void* next);
+
+// Translation layers bind big render targets into shared allocations, which
+// costs the driver compression and placement freedom. For candidate images
+// (attachments, or at least min_size bytes) vkGetImageMemoryRequirements2
+// reports prefersDedicatedAllocation, which DXVK, vkd3d-proton and VMA all
+// honour; the app still decides how to allocate.
+//
+// The layer only rewrites an allocation itself when inject is set (the
+// dedicated_image_inject profile key) and the driver reported
+// requiresDedicatedAllocation for the image: such memory can only ever be
+// bound to that image, so an allocation made on the same thread straight
+// after the query, with exactly the reported size and an allowed type, is
+// the app forgetting the dedicated info it owed, and gets it chained in.
+// Sparse, aliased, disjoint, transient and external images are left alone.
+class DedicatedImageTracker {
+public:
+    DedicatedImageTracker(VkDeviceSize min_size, bool inject);
+
+    DedicatedImageTracker(const DedicatedImageTracker&) = delete;
+    DedicatedImageTracker& operator=(const DedicatedImageTracker&) = delete;
+
+    void OnCreateImage(VkImage image, const VkImageCreateInfo& info);
+    void OnDestroyImage(VkImage image);
+
+    // dedicated may be null (vkGetImageMemoryRequirements), which never
+    // leads to an injection
+    void OnImageRequirements(VkImage image, const VkMemoryRequirements& requirements,
+                             VkMemoryDedicatedRequirements* dedicated);
+
+    // A buffer or create-info query came in between
+    void ForgetPendingQuery();
+
+    // Chains dedicated, which the caller owns, into info when it follows a
+    // query that required a dedicated allocation; clears this thread's
+    // pending query
+    bool InjectDedicated(VkMemoryAllocateInfo& info, VkMemoryDedicatedAllocateInfo& dedicated);
+
+    void OnAllocated(VkDeviceMemory memory, const VkMemoryAllocateInfo& info, bool injected);
+    void OnFree(VkDeviceMemory memory);
+
+    // Warns if an injected allocation ends up bound to anything else
+    void CheckBind(VkImage image, VkDeviceMemory memory);
+
+    void LogStats() const;
+
+private:
+    struct ImageState {
+        bool eligible;   // from create info
+        bool candidate;  // eligible and attachment or large, once requirements are known
+        bool attachment;
+    };
+
+    VkDeviceSize min_size_;
+    bool inject_;
+
+    std::mutex mutex_;
+    std::unordered_map<VkImage, ImageState> images_;
+    std::unordered_map<VkDeviceMemory, VkImage> injected_;
+
+    std::atomic<uint64_t> hinted_{0};
+    std::atomic<uint64_t> app_dedicated_{0};
+    std::atomic<uint64_t> injected_count_{0};
+    std::atomic<uint64_t> bind_mismatches_{0};
+};
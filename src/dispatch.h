@@ -0,0 +1,151 @@
+// dispatch.h - Next-layer dispatch tables for the Xclipse 940 layer
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "app_profile.h"
+
+// Every dispatchable handle begins with the loader's dispatch table pointer.
+// Physical devices share it with their instance, queues and command buffers
+// with their device, so it identifies the owning instance/device.
+template <typename DispatchableType>
+inline void* GetDispatchKey(DispatchableType object) {
+    return *reinterpret_cast<void**>(object);
+}
+
+struct InstanceDispatch {
+    VkInstance instance{VK_NULL_HANDLE};
+    // Not an entry point: the app's profile, resolved at vkCreateInstance
+    LayerSettings settings;
+    // Not entry points: what the app created the instance with. Instance
+    // functions of 1.1 and device extensions that need them (such as
+    // VK_EXT_memory_budget) are only valid with properties2 set.
+    uint32_t api_version{VK_API_VERSION_1_0};
+    bool physical_device_properties2{false};  // 1.1, or VK_KHR_get_physical_device_properties2
+    PFN_vkGetInstanceProcAddr GetInstanceProcAddr{nullptr};
+    PFN_vkDestroyInstance DestroyInstance{nullptr};
+    PFN_vkEnumerateDeviceExtensionProperties EnumerateDeviceExtensionProperties{nullptr};
+    PFN_vkGetPhysicalDeviceProperties GetPhysicalDeviceProperties{nullptr};
+    PFN_vkGetPhysicalDeviceProperties2 GetPhysicalDeviceProperties2{nullptr};
+    PFN_vkGetPhysicalDeviceMemoryProperties GetPhysicalDeviceMemoryProperties{nullptr};
+    PFN_vkGetPhysicalDeviceMemoryProperties2 GetPhysicalDeviceMemoryProperties2{nullptr};
+    PFN_vkGetPhysicalDeviceQueueFamilyProperties GetPhysicalDeviceQueueFamilyProperties{nullptr};
+};
+
+struct DeviceDispatch {
+    VkDevice device{VK_NULL_HANDLE};
+    PFN_vkGetDeviceProcAddr GetDeviceProcAddr{nullptr};
+    PFN_vkDestroyDevice DestroyDevice{nullptr};
+    PFN_vkCreateGraphicsPipelines CreateGraphicsPipelines{nullptr};
+    PFN_vkCreateComputePipelines CreateComputePipelines{nullptr};
+    PFN_vkDestroyPipeline DestroyPipeline{nullptr};
+    PFN_vkCreateShaderModule CreateShaderModule{nullptr};
+    PFN_vkDestroyShaderModule DestroyShaderModule{nullptr};
+    PFN_vkCreatePipelineCache CreatePipelineCache{nullptr};
+    PFN_vkDestroyPipelineCache DestroyPipelineCache{nullptr};
+    PFN_vkGetPipelineCacheData GetPipelineCacheData{nullptr};
+    PFN_vkAllocateMemory AllocateMemory{nullptr};
+    PFN_vkFreeMemory FreeMemory{nullptr};
+    PFN_vkMapMemory MapMemory{nullptr};
+    PFN_vkUnmapMemory UnmapMemory{nullptr};
+    PFN_vkFlushMappedMemoryRanges FlushMappedMemoryRanges{nullptr};
+    PFN_vkInvalidateMappedMemoryRanges InvalidateMappedMemoryRanges{nullptr};
+    PFN_vkGetDeviceMemoryCommitment GetDeviceMemoryCommitment{nullptr};
+    PFN_vkBindBufferMemory BindBufferMemory{nullptr};
+    PFN_vkBindImageMemory BindImageMemory{nullptr};
+    PFN_vkBindBufferMemory2 BindBufferMemory2{nullptr};
+    PFN_vkBindImageMemory2 BindImageMemory2{nullptr};
+    PFN_vkCreateImage CreateImage{nullptr};
+    PFN_vkDestroyImage DestroyImage{nullptr};
+    PFN_vkGetBufferMemoryRequirements GetBufferMemoryRequirements{nullptr};
+    PFN_vkGetImageMemoryRequirements GetImageMemoryRequirements{nullptr};
+    PFN_vkGetBufferMemoryRequirements2 GetBufferMemoryRequirements2{nullptr};
+    PFN_vkGetImageMemoryRequirements2 GetImageMemoryRequirements2{nullptr};
+    PFN_vkGetDeviceBufferMemoryRequirements GetDeviceBufferMemoryRequirements{nullptr};
+    PFN_vkGetDeviceImageMemoryRequirements GetDeviceImageMemoryRequirements{nullptr};
+    PFN_vkQueueSubmit QueueSubmit{nullptr};
+    PFN_vkQueueSubmit2 QueueSubmit2{nullptr};
+    PFN_vkQueueWaitIdle QueueWaitIdle{nullptr};
+    PFN_vkDeviceWaitIdle DeviceWaitIdle{nullptr};
+    PFN_vkWaitForFences WaitForFences{nullptr};
+    PFN_vkWaitSemaphores WaitSemaphores{nullptr};
+    PFN_vkGetSemaphoreCounterValue GetSemaphoreCounterValue{nullptr};
+    PFN_vkGetEventStatus GetEventStatus{nullptr};
+    PFN_vkGetQueryPoolResults GetQueryPoolResults{nullptr};
+    PFN_vkCreateQueryPool CreateQueryPool{nullptr};
+    PFN_vkDestroyQueryPool DestroyQueryPool{nullptr};
+    PFN_vkQueueBindSparse QueueBindSparse{nullptr};
+    PFN_vkQueuePresentKHR QueuePresentKHR{nullptr};
+    PFN_vkGetDeviceQueue GetDeviceQueue{nullptr};
+    PFN_vkGetDeviceQueue2 GetDeviceQueue2{nullptr};
+    PFN_vkCreateSemaphore CreateSemaphore{nullptr};
+    PFN_vkDestroySemaphore DestroySemaphore{nullptr};
+    PFN_vkCreateCommandPool CreateCommandPool{nullptr};
+    PFN_vkAllocateCommandBuffers AllocateCommandBuffers{nullptr};
+    PFN_vkFreeCommandBuffers FreeCommandBuffers{nullptr};
+    PFN_vkDestroyCommandPool DestroyCommandPool{nullptr};
+    PFN_vkBeginCommandBuffer BeginCommandBuffer{nullptr};
+    PFN_vkEndCommandBuffer EndCommandBuffer{nullptr};
+    PFN_vkCmdDraw CmdDraw{nullptr};
+    PFN_vkCmdDrawIndexed CmdDrawIndexed{nullptr};
+    PFN_vkCmdDrawIndirect CmdDrawIndirect{nullptr};
+    PFN_vkCmdDrawIndexedIndirect CmdDrawIndexedIndirect{nullptr};
+    PFN_vkCmdDrawIndirectCount CmdDrawIndirectCount{nullptr};
+    PFN_vkCmdDrawIndexedIndirectCount CmdDrawIndexedIndirectCount{nullptr};
+    PFN_vkCmdDispatch CmdDispatch{nullptr};
+    PFN_vkCmdDispatchIndirect CmdDispatchIndirect{nullptr};
+    PFN_vkCmdDispatchBase CmdDispatchBase{nullptr};
+    PFN_vkCmdCopyBuffer CmdCopyBuffer{nullptr};
+    PFN_vkCmdCopyImage CmdCopyImage{nullptr};
+    PFN_vkCmdCopyBufferToImage CmdCopyBufferToImage{nullptr};
+    PFN_vkCmdCopyImageToBuffer CmdCopyImageToBuffer{nullptr};
+    PFN_vkCmdBlitImage CmdBlitImage{nullptr};
+    PFN_vkCmdCopyBuffer2 CmdCopyBuffer2{nullptr};
+    PFN_vkCmdCopyImage2 CmdCopyImage2{nullptr};
+    PFN_vkCmdCopyBufferToImage2 CmdCopyBufferToImage2{nullptr};
+    PFN_vkCmdCopyImageToBuffer2 CmdCopyImageToBuffer2{nullptr};
+    PFN_vkCmdBlitImage2 CmdBlitImage2{nullptr};
+    PFN_vkCmdBeginRenderPass CmdBeginRenderPass{nullptr};
+    PFN_vkCmdBeginRenderPass2 CmdBeginRenderPass2{nullptr};
+    PFN_vkCmdEndRenderPass CmdEndRenderPass{nullptr};
+    PFN_vkCmdEndRenderPass2 CmdEndRenderPass2{nullptr};
+    PFN_vkCmdBeginRendering CmdBeginRendering{nullptr};
+    PFN_vkCmdEndRendering CmdEndRendering{nullptr};
+    PFN_vkCmdExecuteCommands CmdExecuteCommands{nullptr};
+    PFN_vkCmdPipelineBarrier CmdPipelineBarrier{nullptr};
+    PFN_vkCmdPipelineBarrier2 CmdPipelineBarrier2{nullptr};
+    PFN_vkCmdSetEvent CmdSetEvent{nullptr};
+    PFN_vkCmdResetEvent CmdResetEvent{nullptr};
+    PFN_vkCmdWaitEvents CmdWaitEvents{nullptr};
+    PFN_vkCmdSetEvent2 CmdSetEvent2{nullptr};
+    PFN_vkCmdResetEvent2 CmdResetEvent2{nullptr};
+    PFN_vkCmdWaitEvents2 CmdWaitEvents2{nullptr};
+    PFN_vkCmdResetQueryPool CmdResetQueryPool{nullptr};
+    PFN_vkCmdWriteTimestamp CmdWriteTimestamp{nullptr};
+    PFN_vkCmdWriteTimestamp2 CmdWriteTimestamp2{nullptr};
+};
+
+// Extensions enabled on a device, whether the app asked for them or the
+// layer turned them on for its own use in vkCreateDevice.
+struct DeviceExtensions {
+    bool pipeline_creation_feedback{false};
+    bool memory_budget{false};
+    bool map_memory2{false};
+    bool get_memory_requirements2{false};
+    bool dedicated_allocation{false};
+    bool synchronization2{false};  // the feature, from the create info's pNext chain
+    bool subgroup_size_control{false};  // likewise
+};
+
+// Resolve the next layer's entry points into a table.
+void InitInstanceDispatch(InstanceDispatch& table, VkInstance instance,
+                          PFN_vkGetInstanceProcAddr get_instance_proc_addr);
+void InitDeviceDispatch(DeviceDispatch& table, VkDevice device,
+                        PFN_vkGetDeviceProcAddr get_device_proc_addr);
+
+// Lock-free lookups by dispatch key; nullptr if the object was not created
+// through us. Instance tables live in layer_init.cpp, device tables in the
+// wrapper's per-device contexts.
+const InstanceDispatch* GetInstanceDispatch(void* key);
+const DeviceDispatch* GetDeviceDispatch(void* key);
@@ -0,0 +1,117 @@
+// dispatch_key_map.h - Lock-free lookup of per-instance/per-device layer state
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+// Fixed-capacity open-addressing map from loader dispatch key to an owned
+// object. Find() is wait-free and takes no lock, so every intercepted call
+// reaches its own instance/device state in O(1). Insert() and Erase() are
+// rare (create/destroy) and serialize on a mutex.
+//
+// Erased slots keep their key as a tombstone with a null value so concurrent
+// probes for other keys never stop early. Find() may race with Erase() only
+// for a different key; Vulkan's external synchronization rules already forbid
+// using an instance/device while it is being destroyed.
+template <typename T, size_t kCapacity = 64>
+class DispatchKeyMap {
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+    struct Slot {
+        std::atomic<void*> key{nullptr};
+        std::atomic<T*> value{nullptr};
+    };
+
+public:
+    DispatchKeyMap() = default;
+    ~DispatchKeyMap() {
+        for (Slot& slot : slots_) {
+            delete slot.value.load(std::memory_order_relaxed);
+        }
+    }
+
+    DispatchKeyMap(const DispatchKeyMap&) = delete;
+    DispatchKeyMap& operator=(const DispatchKeyMap&) = delete;
+
+    T* Find(void* key) const {
+        size_t index = Hash(key);
+        for (size_t probe = 0; probe < kCapacity; ++probe) {
+            const Slot& slot = slots_[index];
+            void* slot_key = slot.key.load(std::memory_order_acquire);
+            if (slot_key == key) {
+                return slot.value.load(std::memory_order_acquire);
+            }
+            if (!slot_key) {
+                return nullptr;
+            }
+            index = (index + 1) & (kCapacity - 1);
+        }
+        return nullptr;
+    }
+
+    // Takes ownership of value. Fails only when kCapacity objects are live.
+    bool Insert(void* key, std::unique_ptr<T> value) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        Slot* target = nullptr;
+        size_t index = Hash(key);
+        for (size_t probe = 0; probe < kCapacity; ++probe) {
+            Slot& slot = slots_[index];
+            void* slot_key = slot.key.load(std::memory_order_relaxed);
+            if (slot_key == key) {
+                // Key reused after destroy (or a stale entry); replace in place
+                delete slot.value.exchange(value.release(), std::memory_order_acq_rel);
+                return true;
+            }
+            if (!target && !slot.value.load(std::memory_order_relaxed)) {
+                target = &slot;  // first tombstone or empty slot
+            }
+            if (!slot_key) {
+                break;
+            }
+            index = (index + 1) & (kCapacity - 1);
+        }
+
+        if (!target) {
+            return false;
+        }
+
+        // Publish the value before the key so readers never see a half-filled slot
+        target->value.store(value.release(), std::memory_order_release);
+        target->key.store(key, std::memory_order_release);
+        return true;
+    }
+
+    std::unique_ptr<T> Erase(void* key) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+
+        size_t index = Hash(key);
+        for (size_t probe = 0; probe < kCapacity; ++probe) {
+            Slot& slot = slots_[index];
+            void* slot_key = slot.key.load(std::memory_order_relaxed);
+            if (slot_key == key) {
+                return std::unique_ptr<T>(slot.value.exchange(nullptr, std::memory_order_acq_rel));
+            }
+            if (!slot_key) {
+                break;
+            }
+            index = (index + 1) & (kCapacity - 1);
+        }
+        return nullptr;
+    }
+
+private:
+    static size_t Hash(void* key) {
+        // Fibonacci hashing; dispatch tables are heap allocations so drop the
+        // low alignment bits first.
+        uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key) >> 4);
+        return static_cast<size_t>((bits * 0x9E3779B97F4A7C15ull) >> 32) & (kCapacity - 1);
+    }
+
+    Slot slots_[kCapacity];
+    std::mutex write_mutex_;
+};
@@ -0,0 +1,126 @@
+// entry_point_table.h - Compile-time perfect hash over intercepted entry point names
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace xclipse {
+
+// FNV-1a, shared by the compile-time builder and the runtime lookup
+constexpr uint32_t kNameHashBasis = 2166136261u;
+constexpr uint32_t kNameHashPrime = 16777619u;
+
+constexpr uint32_t HashName(std::string_view name) {
+    uint32_t hash = kNameHashBasis;
+    for (char c : name) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * kNameHashPrime;
+    }
+    return hash;
+}
+
+// Finalizer that turns one name hash into a different slot per seed, so the
+// seed search only rehashes 32-bit values instead of whole names.
+constexpr uint32_t MixSeed(uint32_t hash, uint32_t seed) {
+    hash ^= seed;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Maps a name to its index in the list it was built from with one hash, two
+// table loads and one string compare. Names are split into small buckets and
+// the constructor searches, largest bucket first, for a per-bucket seed that
+// moves every name of the bucket into a free slot. Instances are meant to be
+// constexpr and checked with static_assert(table.Valid()).
+template <size_t N>
+class EntryPointTable {
+public:
+    static constexpr size_t kSlotCount = std::bit_ceil(N * 2);
+    static constexpr size_t kBucketCount = std::bit_ceil((N + 3) / 4);
+    static constexpr uint8_t kEmptySlot = 0xFF;
+    static constexpr uint16_t kMaxSeed = 1u << 12;
+    static_assert(N < kEmptySlot, "entry point indices must fit in a slot");
+
+    constexpr explicit EntryPointTable(const std::array<std::string_view, N>& names)
+        : names_(names) {
+        std::array<uint32_t, N> hashes{};
+        std::array<size_t, kBucketCount> sizes{};
+        for (size_t i = 0; i < N; ++i) {
+            hashes[i] = HashName(names[i]);
+            sizes[Bucket(hashes[i])]++;
+        }
+        for (uint8_t& slot : slots_) {
+            slot = kEmptySlot;
+        }
+
+        // Big buckets are the hard ones, so they go while the table is empty
+        for (size_t size = N; size > 0; --size) {
+            for (size_t bucket = 0; bucket < kBucketCount; ++bucket) {
+                if (sizes[bucket] == size && !PlaceBucket(hashes, bucket)) {
+                    return;
+                }
+            }
+        }
+        valid_ = true;
+    }
+
+    constexpr bool Valid() const { return valid_; }
+
+    // Index of name in the original list, or -1 if it is not in the table
+    int Find(const char* name) const {
+        uint32_t hash = kNameHashBasis;
+        size_t length = 0;
+        for (; name[length]; ++length) {
+            hash = (hash ^ static_cast<uint8_t>(name[length])) * kNameHashPrime;
+        }
+
+        uint8_t index = slots_[Slot(hash, seeds_[Bucket(hash)])];
+        if (index == kEmptySlot || names_[index] != std::string_view(name, length)) {
+            return -1;
+        }
+        return index;
+    }
+
+private:
+    static constexpr size_t Bucket(uint32_t hash) { return MixSeed(hash, 0) & (kBucketCount - 1); }
+    static constexpr size_t Slot(uint32_t hash, uint16_t seed) {
+        return MixSeed(hash, seed) & (kSlotCount - 1);
+    }
+
+    constexpr bool PlaceBucket(const std::array<uint32_t, N>& hashes, size_t bucket) {
+        for (uint16_t seed = 1; seed < kMaxSeed; ++seed) {
+            size_t placed = 0;
+            for (; placed < N; ++placed) {
+                if (Bucket(hashes[placed]) != bucket) continue;
+                uint8_t& slot = slots_[Slot(hashes[placed], seed)];
+                if (slot != kEmptySlot) break;
+                slot = static_cast<uint8_t>(placed);
+            }
+            if (placed == N) {
+                seeds_[bucket] = seed;
+                return true;
+            }
+            // Undo this seed's partial placement
+            for (size_t i = 0; i < placed; ++i) {
+                if (Bucket(hashes[i]) == bucket) {
+                    slots_[Slot(hashes[i], seed)] = kEmptySlot;
+                }
+            }
+        }
+        return false;
+    }
+
+    std::array<std::string_view, N> names_{};
+    std::array<uint8_t, kSlotCount> slots_{};
+    std::array<uint16_t, kBucketCount> seeds_{};
+    bool valid_{false};
+};
+
+} // namespace xclipse
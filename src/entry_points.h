@@ -0,0 +1,121 @@
+// entry_points.h - The list of entry points the layer intercepts
+
+#pragma once
+
+// Expands INSTANCE(name, proc) or DEVICE(name, proc) once per entry point.
+// Instance-level entries are only returned from vkGetInstanceProcAddr;
+// device-level entries from both. Kept apart from layer_init.cpp so the
+// resolve benchmark can build the same table without the layer.
+#define XCLIPSE_ENTRY_POINTS(INSTANCE, DEVICE)                                      \
+    INSTANCE(vkGetInstanceProcAddr, vkGetInstanceProcAddr)                          \
+    INSTANCE(vkCreateInstance, vkCreateInstance)                                    \
+    INSTANCE(vkDestroyInstance, vkDestroyInstance)                                  \
+    INSTANCE(vkCreateDevice, vkCreateDevice)                                        \
+    INSTANCE(vkEnumerateInstanceLayerProperties, vkEnumerateInstanceLayerProperties) \
+    INSTANCE(vkEnumerateInstanceExtensionProperties, vkEnumerateInstanceExtensionProperties) \
+    INSTANCE(vkEnumerateDeviceLayerProperties, vkEnumerateDeviceLayerProperties)    \
+    INSTANCE(vkEnumerateDeviceExtensionProperties, vkEnumerateDeviceExtensionProperties) \
+    DEVICE(vkGetDeviceProcAddr, vkGetDeviceProcAddr)                                \
+    DEVICE(vkDestroyDevice, vkDestroyDevice)                                        \
+    DEVICE(vkCreateGraphicsPipelines, xclipse::CreateGraphicsPipelines)             \
+    DEVICE(vkCreateComputePipelines, xclipse::CreateComputePipelines)               \
+    DEVICE(vkDestroyPipeline, xclipse::DestroyPipeline)                             \
+    DEVICE(vkCreateShaderModule, xclipse::CreateShaderModule)                       \
+    DEVICE(vkDestroyShaderModule, xclipse::DestroyShaderModule)                     \
+    DEVICE(vkAllocateMemory, xclipse::AllocateMemory)                               \
+    DEVICE(vkFreeMemory, xclipse::FreeMemory)                                       \
+    DEVICE(vkMapMemory, xclipse::MapMemory)                                         \
+    DEVICE(vkUnmapMemory, xclipse::UnmapMemory)                                     \
+    DEVICE(vkFlushMappedMemoryRanges, xclipse::FlushMappedMemoryRanges)             \
+    DEVICE(vkInvalidateMappedMemoryRanges, xclipse::InvalidateMappedMemoryRanges)   \
+    DEVICE(vkGetDeviceMemoryCommitment, xclipse::GetDeviceMemoryCommitment)         \
+    DEVICE(vkBindBufferMemory, xclipse::BindBufferMemory)                           \
+    DEVICE(vkBindImageMemory, xclipse::BindImageMemory)                             \
+    DEVICE(vkBindBufferMemory2, xclipse::BindBufferMemory2)                         \
+    DEVICE(vkBindBufferMemory2KHR, xclipse::BindBufferMemory2)                      \
+    DEVICE(vkBindImageMemory2, xclipse::BindImageMemory2)                           \
+    DEVICE(vkBindImageMemory2KHR, xclipse::BindImageMemory2)                        \
+    DEVICE(vkCreateImage, xclipse::CreateImage)                                     \
+    DEVICE(vkDestroyImage, xclipse::DestroyImage)                                   \
+    DEVICE(vkGetBufferMemoryRequirements, xclipse::GetBufferMemoryRequirements)     \
+    DEVICE(vkGetImageMemoryRequirements, xclipse::GetImageMemoryRequirements)       \
+    DEVICE(vkGetBufferMemoryRequirements2, xclipse::GetBufferMemoryRequirements2)   \
+    DEVICE(vkGetBufferMemoryRequirements2KHR, xclipse::GetBufferMemoryRequirements2) \
+    DEVICE(vkGetImageMemoryRequirements2, xclipse::GetImageMemoryRequirements2)     \
+    DEVICE(vkGetImageMemoryRequirements2KHR, xclipse::GetImageMemoryRequirements2)  \
+    DEVICE(vkGetDeviceBufferMemoryRequirements, xclipse::GetDeviceBufferMemoryRequirements) \
+    DEVICE(vkGetDeviceBufferMemoryRequirementsKHR, xclipse::GetDeviceBufferMemoryRequirements) \
+    DEVICE(vkGetDeviceImageMemoryRequirements, xclipse::GetDeviceImageMemoryRequirements) \
+    DEVICE(vkGetDeviceImageMemoryRequirementsKHR, xclipse::GetDeviceImageMemoryRequirements) \
+    DEVICE(vkQueueSubmit, xclipse::QueueSubmit)                                     \
+    DEVICE(vkQueueSubmit2, xclipse::QueueSubmit2)                                   \
+    DEVICE(vkQueueSubmit2KHR, xclipse::QueueSubmit2)                                \
+    DEVICE(vkQueueWaitIdle, xclipse::QueueWaitIdle)                                 \
+    DEVICE(vkDeviceWaitIdle, xclipse::DeviceWaitIdle)                               \
+    DEVICE(vkWaitForFences, xclipse::WaitForFences)                                 \
+    DEVICE(vkWaitSemaphores, xclipse::WaitSemaphores)                               \
+    DEVICE(vkWaitSemaphoresKHR, xclipse::WaitSemaphores)                            \
+    DEVICE(vkGetSemaphoreCounterValue, xclipse::GetSemaphoreCounterValue)           \
+    DEVICE(vkGetSemaphoreCounterValueKHR, xclipse::GetSemaphoreCounterValue)        \
+    DEVICE(vkGetEventStatus, xclipse::GetEventStatus)                               \
+    DEVICE(vkGetQueryPoolResults, xclipse::GetQueryPoolResults)                     \
+    DEVICE(vkQueueBindSparse, xclipse::QueueBindSparse)                             \
+    DEVICE(vkQueuePresentKHR, xclipse::QueuePresentKHR)                             \
+    DEVICE(vkGetDeviceQueue, xclipse::GetDeviceQueue)                               \
+    DEVICE(vkGetDeviceQueue2, xclipse::GetDeviceQueue2)                             \
+    DEVICE(vkCreateCommandPool, xclipse::CreateCommandPool)                         \
+    DEVICE(vkAllocateCommandBuffers, xclipse::AllocateCommandBuffers)               \
+    DEVICE(vkFreeCommandBuffers, xclipse::FreeCommandBuffers)                       \
+    DEVICE(vkDestroyCommandPool, xclipse::DestroyCommandPool)                       \
+    DEVICE(vkBeginCommandBuffer, xclipse::BeginCommandBuffer)                       \
+    DEVICE(vkEndCommandBuffer, xclipse::EndCommandBuffer)                           \
+    DEVICE(vkCmdDraw, xclipse::CmdDraw)                                             \
+    DEVICE(vkCmdDrawIndexed, xclipse::CmdDrawIndexed)                               \
+    DEVICE(vkCmdDrawIndirect, xclipse::CmdDrawIndirect)                             \
+    DEVICE(vkCmdDrawIndexedIndirect, xclipse::CmdDrawIndexedIndirect)               \
+    DEVICE(vkCmdDrawIndirectCount, xclipse::CmdDrawIndirectCount)                   \
+    DEVICE(vkCmdDrawIndirectCountKHR, xclipse::CmdDrawIndirectCount)                \
+    DEVICE(vkCmdDrawIndexedIndirectCount, xclipse::CmdDrawIndexedIndirectCount)     \
+    DEVICE(vkCmdDrawIndexedIndirectCountKHR, xclipse::CmdDrawIndexedIndirectCount)  \
+    DEVICE(vkCmdDispatch, xclipse::CmdDispatch)                                     \
+    DEVICE(vkCmdDispatchIndirect, xclipse::CmdDispatchIndirect)                     \
+    DEVICE(vkCmdDispatchBase, xclipse::CmdDispatchBase)                             \
+    DEVICE(vkCmdDispatchBaseKHR, xclipse::CmdDispatchBase)                          \
+    DEVICE(vkCmdCopyBuffer, xclipse::CmdCopyBuffer)                                 \
+    DEVICE(vkCmdCopyImage, xclipse::CmdCopyImage)                                   \
+    DEVICE(vkCmdCopyBufferToImage, xclipse::CmdCopyBufferToImage)                   \
+    DEVICE(vkCmdCopyImageToBuffer, xclipse::CmdCopyImageToBuffer)                   \
+    DEVICE(vkCmdBlitImage, xclipse::CmdBlitImage)                                   \
+    DEVICE(vkCmdCopyBuffer2, xclipse::CmdCopyBuffer2)                               \
+    DEVICE(vkCmdCopyBuffer2KHR, xclipse::CmdCopyBuffer2)                            \
+    DEVICE(vkCmdCopyImage2, xclipse::CmdCopyImage2)                                 \
+    DEVICE(vkCmdCopyImage2KHR, xclipse::CmdCopyImage2)                              \
+    DEVICE(vkCmdCopyBufferToImage2, xclipse::CmdCopyBufferToImage2)                 \
+    DEVICE(vkCmdCopyBufferToImage2KHR, xclipse::CmdCopyBufferToImage2)              \
+    DEVICE(vkCmdCopyImageToBuffer2, xclipse::CmdCopyImageToBuffer2)                 \
+    DEVICE(vkCmdCopyImageToBuffer2KHR, xclipse::CmdCopyImageToBuffer2)              \
+    DEVICE(vkCmdBlitImage2, xclipse::CmdBlitImage2)                                 \
+    DEVICE(vkCmdBlitImage2KHR, xclipse::CmdBlitImage2)                              \
+    DEVICE(vkCmdBeginRenderPass, xclipse::CmdBeginRenderPass)                       \
+    DEVICE(vkCmdBeginRenderPass2, xclipse::CmdBeginRenderPass2)                     \
+    DEVICE(vkCmdBeginRenderPass2KHR, xclipse::CmdBeginRenderPass2)                  \
+    DEVICE(vkCmdEndRenderPass, xclipse::CmdEndRenderPass)                           \
+    DEVICE(vkCmdEndRenderPass2, xclipse::CmdEndRenderPass2)                         \
+    DEVICE(vkCmdEndRenderPass2KHR, xclipse::CmdEndRenderPass2)                      \
+    DEVICE(vkCmdBeginRendering, xclipse::CmdBeginRendering)                         \
+    DEVICE(vkCmdBeginRenderingKHR, xclipse::CmdBeginRendering)                      \
+    DEVICE(vkCmdEndRendering, xclipse::CmdEndRendering)                             \
+    DEVICE(vkCmdEndRenderingKHR, xclipse::CmdEndRendering)                          \
+    DEVICE(vkCmdExecuteCommands, xclipse::CmdExecuteCommands)                       \
+    DEVICE(vkCmdPipelineBarrier, xclipse::CmdPipelineBarrier)                       \
+    DEVICE(vkCmdPipelineBarrier2, xclipse::CmdPipelineBarrier2)                     \
+    DEVICE(vkCmdPipelineBarrier2KHR, xclipse::CmdPipelineBarrier2)                  \
+    DEVICE(vkCmdSetEvent, xclipse::CmdSetEvent)                                     \
+    DEVICE(vkCmdResetEvent, xclipse::CmdResetEvent)                                 \
+    DEVICE(vkCmdWaitEvents, xclipse::CmdWaitEvents)                                 \
+    DEVICE(vkCmdSetEvent2, xclipse::CmdSetEvent2)                                   \
+    DEVICE(vkCmdSetEvent2KHR, xclipse::CmdSetEvent2)                                \
+    DEVICE(vkCmdResetEvent2, xclipse::CmdResetEvent2)                               \
+    DEVICE(vkCmdResetEvent2KHR, xclipse::CmdResetEvent2)                            \
+    DEVICE(vkCmdWaitEvents2, xclipse::CmdWaitEvents2)                               \
+    DEVICE(vkCmdWaitEvents2KHR, xclipse::CmdWaitEvents2)
@@ -0,0 +1,164 @@
+// frame_timing.cpp - Per-frame CPU and present pacing measurements
+
+#include "frame_timing.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <vector>
+
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+// Nearest-rank quantile of an ascending, non-empty list
+uint64_t Quantile(const std::vector<uint64_t>& sorted, double quantile) {
+    return sorted[static_cast<size_t>(quantile * static_cast<double>(sorted.size() - 1) + 0.5)];
+}
+
+double Milliseconds(uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e6;
+}
+
+} // namespace
+
+FrameTimer::FrameTimer(std::string export_path)
+    : export_path_(std::move(export_path)) {}
+
+void FrameTimer::OnPresent() {
+    uint64_t now = SteadyNanoseconds();
+    uint64_t previous = last_present_ns_.exchange(now, std::memory_order_relaxed);
+    uint64_t returned = last_return_ns_.load(std::memory_order_relaxed);
+    uint64_t first_submit = first_submit_ns_.exchange(0, std::memory_order_relaxed);
+
+    // Another queue presenting concurrently may have moved the clocks past now
+    uint64_t interval = previous && previous < now ? now - previous : 0;
+    uint64_t cpu = returned && returned < now ? now - returned : 0;
+    uint64_t submit_to_present = first_submit && first_submit < now ? now - first_submit : 0;
+
+    uint64_t frame = frames_.fetch_add(1, std::memory_order_relaxed) + 1;
+    Slot& slot = slots_[(frame - 1) % kCapacity];
+    slot.sequence.store(2 * frame - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.present_ns.store(now, std::memory_order_relaxed);
+    slot.interval_ns.store(interval, std::memory_order_relaxed);
+    slot.cpu_ns.store(cpu, std::memory_order_relaxed);
+    slot.submit_to_present_ns.store(submit_to_present, std::memory_order_relaxed);
+    slot.sequence.store(2 * frame, std::memory_order_release);
+}
+
+uint32_t FrameTimer::Snapshot(FrameTiming* frames, uint32_t max) const {
+    uint64_t newest = frames_.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>({newest, kCapacity, max});
+
+    uint32_t copied = 0;
+    for (uint64_t frame = newest - count + 1; frame <= newest; ++frame) {
+        const Slot& slot = slots_[(frame - 1) % kCapacity];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * frame) {
+            continue;  // still being written, or already reused
+        }
+
+        FrameTiming timing;
+        timing.frame = frame;
+        timing.present_ns = slot.present_ns.load(std::memory_order_relaxed);
+        timing.interval_ns = slot.interval_ns.load(std::memory_order_relaxed);
+        timing.cpu_ns = slot.cpu_ns.load(std::memory_order_relaxed);
+        timing.submit_to_present_ns = slot.submit_to_present_ns.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+            frames[copied++] = timing;
+        }
+    }
+    return copied;
+}
+
+FrameTimingSummary FrameTimer::Summarize() const {
+    std::vector<FrameTiming> frames(kCapacity);
+    frames.resize(Snapshot(frames.data(), kCapacity));
+
+    std::vector<uint64_t> intervals;
+    std::vector<uint64_t> cpu_times;
+    intervals.reserve(frames.size());
+    cpu_times.reserve(frames.size());
+    for (const FrameTiming& frame : frames) {
+        if (frame.interval_ns) intervals.push_back(frame.interval_ns);
+        if (frame.cpu_ns) cpu_times.push_back(frame.cpu_ns);
+    }
+
+    FrameTimingSummary summary;
+    summary.frames = static_cast<uint32_t>(frames.size());
+    if (intervals.empty()) {
+        return summary;
+    }
+
+    std::sort(intervals.begin(), intervals.end());
+    uint64_t total = 0;
+    for (uint64_t interval : intervals) {
+        total += interval;
+    }
+    summary.average_fps = 1e9 * static_cast<double>(intervals.size()) / static_cast<double>(total);
+
+    size_t slowest = std::max<size_t>(1, intervals.size() / 100);
+    uint64_t slowest_total = 0;
+    for (size_t i = intervals.size() - slowest; i < intervals.size(); ++i) {
+        slowest_total += intervals[i];
+    }
+    summary.low_1_percent_fps = 1e9 * static_cast<double>(slowest) / static_cast<double>(slowest_total);
+    summary.p99_interval_ns = Quantile(intervals, 0.99);
+
+    double stutter_ns = kStutterFactor * static_cast<double>(Quantile(intervals, 0.50));
+    summary.stutters = static_cast<uint32_t>(
+        intervals.end() - std::upper_bound(intervals.begin(), intervals.end(),
+                                           static_cast<uint64_t>(stutter_ns)));
+
+    if (!cpu_times.empty()) {
+        std::sort(cpu_times.begin(), cpu_times.end());
+        summary.p99_cpu_ns = Quantile(cpu_times, 0.99);
+    }
+    return summary;
+}
+
+void FrameTimer::Report() {
+    uint64_t frames = frames_.load(std::memory_order_relaxed);
+    if (frames == reported_frames_) {
+        return;  // an idle game logs nothing
+    }
+    reported_frames_ = frames;
+    LogSummary(Summarize());
+}
+
+void FrameTimer::LogSummary(const FrameTimingSummary& summary) const {
+    if (summary.frames == 0) {
+        return;
+    }
+    XCLIPSE_LOGI("frame timing: %u frames, avg %.1f fps, 1%% low %.1f fps, p99 %.2f ms "
+                 "(cpu p99 %.2f ms), %u stutters",
+                 summary.frames, summary.average_fps, summary.low_1_percent_fps,
+                 Milliseconds(summary.p99_interval_ns), Milliseconds(summary.p99_cpu_ns),
+                 summary.stutters);
+}
+
+void FrameTimer::Dump() const {
+    LogSummary(Summarize());
+    if (export_path_.empty()) {
+        return;
+    }
+
+    std::vector<FrameTiming> frames(kCapacity);
+    frames.resize(Snapshot(frames.data(), kCapacity));
+    if (frames.empty()) {
+        return;
+    }
+
+    std::string csv = "frame,present_ns,interval_ns,cpu_ns,submit_to_present_ns\n";
+    for (const FrameTiming& frame : frames) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                      frame.frame, frame.present_ns, frame.interval_ns, frame.cpu_ns,
+                      frame.submit_to_present_ns);
+        csv += line;
+    }
+    WriteFileAtomically(export_path_, csv);
+}
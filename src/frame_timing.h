@@ -0,0 +1,99 @@
+// frame_timing.h - Per-frame CPU and present pacing measurements
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "clock.h"
+
+// One presented frame; all times in nanoseconds
+struct FrameTiming {
+    uint64_t frame{0};                 // 1-based present count
+    uint64_t present_ns{0};            // SteadyNanoseconds() when vkQueuePresentKHR was called
+    uint64_t interval_ns{0};           // since the previous present was called
+    uint64_t cpu_ns{0};                // since the previous present returned
+    uint64_t submit_to_present_ns{0};  // since the frame's first submit; 0 without one
+};
+
+// Over the frames still in the ring
+struct FrameTimingSummary {
+    uint32_t frames{0};
+    double average_fps{0.0};
+    double low_1_percent_fps{0.0};  // average rate over the slowest 1% of intervals
+    uint64_t p99_interval_ns{0};
+    uint64_t p99_cpu_ns{0};
+    uint32_t stutters{0};           // intervals above kStutterFactor x the median
+};
+
+// Presents are the only frame boundary the layer sees, so a frame is
+// whatever happens between two vkQueuePresentKHR calls. Recording costs two
+// clock reads per present and one relaxed load per submit. Frames land in
+// a fixed ring of seqlocked slots, so policies and the exporter can read
+// from any thread without stalling the present path; a slot overwritten
+// while it is being copied is just skipped. The device's stats dumper
+// thread calls Report() every kReportIntervalNs, so summarizing and logging
+// never happen on the present path; the frames themselves are exported by
+// Dump().
+class FrameTimer {
+public:
+    static constexpr uint32_t kCapacity = 1024;  // ~17 s at 60 fps
+    static constexpr double kStutterFactor = 2.0;
+    static constexpr uint64_t kReportIntervalNs = 10ull * 1000 * 1000 * 1000;
+
+    // export_path may be empty to log only
+    explicit FrameTimer(std::string export_path);
+
+    FrameTimer(const FrameTimer&) = delete;
+    FrameTimer& operator=(const FrameTimer&) = delete;
+
+    void OnSubmit() {
+        if (first_submit_ns_.load(std::memory_order_relaxed) == 0) {
+            uint64_t expected = 0;
+            first_submit_ns_.compare_exchange_strong(expected, SteadyNanoseconds(),
+                                                     std::memory_order_relaxed);
+        }
+    }
+
+    // Around the driver's vkQueuePresentKHR
+    void OnPresent();
+    void OnPresentReturned() {
+        last_return_ns_.store(SteadyNanoseconds(), std::memory_order_relaxed);
+    }
+
+    // Copies up to max of the newest frames, oldest first, and returns how
+    // many were copied
+    uint32_t Snapshot(FrameTiming* frames, uint32_t max) const;
+
+    FrameTimingSummary Summarize() const;
+
+    // Logs the summary if frames were presented since the last report. For
+    // one background thread only.
+    void Report();
+
+    // Logs the summary and writes the ring as CSV to the export path
+    void Dump() const;
+
+private:
+    // Fields are atomics so concurrent readers are not a data race; the
+    // sequence tells them whether the copy they made is whole
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  // 2 * frame when complete, odd while written
+        std::atomic<uint64_t> present_ns{0};
+        std::atomic<uint64_t> interval_ns{0};
+        std::atomic<uint64_t> cpu_ns{0};
+        std::atomic<uint64_t> submit_to_present_ns{0};
+    };
+
+    void LogSummary(const FrameTimingSummary& summary) const;
+
+    Slot slots_[kCapacity];
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> first_submit_ns_{0};
+    std::atomic<uint64_t> last_present_ns_{0};
+    std::atomic<uint64_t> last_return_ns_{0};
+    uint64_t reported_frames_{0};  // Report() only
+
+    std::string export_path_;
+};
@@ -0,0 +1,430 @@
+// gpu_profiler.cpp - Opt-in GPU timestamps around render passes and dispatches
+
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#include "clock.h"
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+double Milliseconds(uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e6;
+}
+
+struct TimestampFamilies {
+    uint32_t mask{0};         // bit i: family i can record and time our command buffers
+    uint32_t valid_bits{64};  // narrowest of those families
+};
+
+// Transfer-only families and families without timestamp support are left
+// out: their command buffers simply go untimed
+TimestampFamilies GetTimestampFamilies(VkPhysicalDevice physical_device,
+                                       const InstanceDispatch& dispatch) {
+    uint32_t family_count = 0;
+    dispatch.GetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    dispatch.GetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+    TimestampFamilies result;
+    for (uint32_t i = 0; i < family_count && i < 32; ++i) {
+        if ((families[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            families[i].timestampValidBits > 0) {
+            result.mask |= 1u << i;
+            result.valid_bits = std::min(result.valid_bits, families[i].timestampValidBits);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+std::unique_ptr<GpuProfiler> GpuProfiler::Create(VkPhysicalDevice physical_device,
+                                                 const InstanceDispatch& instance_dispatch,
+                                                 VkDevice device, const DeviceDispatch& dispatch,
+                                                 const VkPhysicalDeviceProperties& properties,
+                                                 bool synchronization2, std::string export_path) {
+    if (!dispatch.CreateQueryPool || !dispatch.DestroyQueryPool || !dispatch.GetQueryPoolResults ||
+        !dispatch.CmdResetQueryPool || !dispatch.CmdWriteTimestamp) {
+        return nullptr;
+    }
+
+    // Not gated on timestampComputeAndGraphics: one timeable family is enough
+    TimestampFamilies families = GetTimestampFamilies(physical_device, instance_dispatch);
+    if (!families.mask || properties.limits.timestampPeriod <= 0.0f) {
+        XCLIPSE_LOGW("GPU profiler disabled: no graphics or compute queue family can write timestamps");
+        return nullptr;
+    }
+    uint32_t valid_bits = families.valid_bits;
+
+    VkQueryPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = kChunkCount * kQueriesPerChunk;
+    VkQueryPool pool = VK_NULL_HANDLE;
+    if (dispatch.CreateQueryPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+        XCLIPSE_LOGW("GPU profiler disabled: could not create a query pool");
+        return nullptr;
+    }
+
+    uint64_t tick_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+    XCLIPSE_LOGI("GPU profiler: %u timestamp queries, %.2f ns per tick, %u valid bits, "
+                 "queue families 0x%x%s",
+                 pool_info.queryCount, properties.limits.timestampPeriod, valid_bits, families.mask,
+                 synchronization2 ? ", vkCmdWriteTimestamp2" : "");
+    return std::unique_ptr<GpuProfiler>(new GpuProfiler(
+        device, dispatch, pool, properties.limits.timestampPeriod, tick_mask, families.mask,
+        synchronization2, std::move(export_path)));
+}
+
+GpuProfiler::GpuProfiler(VkDevice device, const DeviceDispatch& dispatch, VkQueryPool pool,
+                         double nanoseconds_per_tick, uint64_t tick_mask,
+                         uint32_t timeable_families, bool synchronization2,
+                         std::string export_path)
+    : device_(device),
+      destroy_query_pool_(dispatch.DestroyQueryPool),
+      get_query_pool_results_(dispatch.GetQueryPoolResults),
+      cmd_reset_query_pool_(dispatch.CmdResetQueryPool),
+      cmd_write_timestamp_(dispatch.CmdWriteTimestamp),
+      cmd_write_timestamp2_(synchronization2 ? dispatch.CmdWriteTimestamp2 : nullptr),
+      pool_(pool),
+      nanoseconds_per_tick_(nanoseconds_per_tick),
+      tick_mask_(tick_mask),
+      timeable_families_(timeable_families),
+      chunks_(new Chunk[kChunkCount]),
+      next_report_ns_(SteadyNanoseconds() + kReportIntervalNs),
+      export_path_(std::move(export_path)) {
+    // Handed out lowest index first
+    free_chunks_.reserve(kChunkCount);
+    pending_.reserve(kChunkCount);
+    for (uint32_t i = kChunkCount; i > 0; --i) {
+        free_chunks_.push_back(i - 1);
+    }
+    history_.resize(kHistoryCapacity);
+    StartFrame(frame_);
+}
+
+GpuProfiler::~GpuProfiler() {
+    destroy_query_pool_(device_, pool_, nullptr);
+}
+
+void GpuProfiler::Begin(VkCommandBuffer command_buffer, const VkCommandBufferBeginInfo& begin_info,
+                        TimestampCursor& cursor) {
+    // Secondaries may start inside a render pass, where the chunk cannot be
+    // reset, and simultaneous-use executions would share one chunk. Pools of
+    // families without timestamps cannot take the reset or the writes.
+    bool timed = cursor.queue_family < 32 && (timeable_families_ >> cursor.queue_family & 1) &&
+                 !begin_info.pInheritanceInfo &&
+                 !(begin_info.flags & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+    cursor.open = TimestampRegion::kNone;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (cursor.chunk != TimestampCursor::kNoChunk) {
+            // The previous recording is done executing, so this never waits
+            if (chunks_[cursor.chunk].submitted_frame) {
+                Resolve(cursor.chunk, true);
+            }
+            if (!timed) {
+                free_chunks_.push_back(cursor.chunk);
+                cursor.chunk = TimestampCursor::kNoChunk;
+            }
+        } else if (timed) {
+            if (free_chunks_.empty()) {
+                untimed_command_buffers_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            cursor.chunk = free_chunks_.back();
+            free_chunks_.pop_back();
+        }
+    }
+    if (cursor.chunk == TimestampCursor::kNoChunk) {
+        return;
+    }
+
+    chunks_[cursor.chunk].region_count = 0;
+    cmd_reset_query_pool_(command_buffer, pool_, cursor.chunk * kQueriesPerChunk, kQueriesPerChunk);
+}
+
+void GpuProfiler::BeforeRenderPass(VkCommandBuffer command_buffer, TimestampCursor& cursor,
+                                   VkExtent2D extent) {
+    if (cursor.chunk == TimestampCursor::kNoChunk) {
+        return;
+    }
+    if (cursor.open != TimestampRegion::kNone) {
+        Close(command_buffer, cursor);
+    }
+    Open(command_buffer, cursor, TimestampRegion::kRenderPass, extent);
+}
+
+void GpuProfiler::BeforeRendering(VkCommandBuffer command_buffer, TimestampCursor& cursor,
+                                  const VkRenderingInfo& rendering_info) {
+    if (cursor.chunk == TimestampCursor::kNoChunk) {
+        return;
+    }
+    if (cursor.open != TimestampRegion::kNone) {
+        Close(command_buffer, cursor);
+    }
+    // Nothing may be recorded between a suspended instance and the one
+    // resuming it, so split instances go untimed
+    if (rendering_info.flags & (VK_RENDERING_SUSPENDING_BIT | VK_RENDERING_RESUMING_BIT)) {
+        return;
+    }
+    Open(command_buffer, cursor, TimestampRegion::kRenderPass, rendering_info.renderArea.extent);
+}
+
+void GpuProfiler::Open(VkCommandBuffer command_buffer, TimestampCursor& cursor, TimestampRegion kind,
+                       VkExtent2D extent) {
+    // Remembered even when the chunk is full, so a long run of dispatches
+    // is only counted as one dropped region
+    cursor.open = kind;
+    Chunk& chunk = chunks_[cursor.chunk];
+    if (chunk.region_count == kRegionsPerChunk) {
+        dropped_regions_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint32_t region = chunk.region_count++;
+    chunk.regions[region] = Region{kind, false, extent};
+    WriteTimestamp(command_buffer, cursor.chunk * kQueriesPerChunk + 2 * region, false);
+}
+
+void GpuProfiler::Close(VkCommandBuffer command_buffer, TimestampCursor& cursor) {
+    cursor.open = TimestampRegion::kNone;
+    Chunk& chunk = chunks_[cursor.chunk];
+    if (chunk.region_count == 0 || chunk.regions[chunk.region_count - 1].closed) {
+        return;
+    }
+    uint32_t region = chunk.region_count - 1;
+    chunk.regions[region].closed = true;
+    WriteTimestamp(command_buffer, cursor.chunk * kQueriesPerChunk + 2 * region + 1, true);
+}
+
+void GpuProfiler::WriteTimestamp(VkCommandBuffer command_buffer, uint32_t query, bool end) {
+    if (cmd_write_timestamp2_) {
+        cmd_write_timestamp2_(command_buffer,
+                              end ? VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                              pool_, query);
+    } else {
+        cmd_write_timestamp_(command_buffer,
+                             end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             pool_, query);
+    }
+}
+
+void GpuProfiler::MarkSubmitted(CommandBufferProfiler& profiles, VkCommandBuffer command_buffer) {
+    CommandBufferProfile* profile = profiles.Find(command_buffer);
+    if (profile && profile->timestamps.chunk != TimestampCursor::kNoChunk) {
+        // A resubmitted command buffer only reports its latest execution
+        Chunk& chunk = chunks_[profile->timestamps.chunk];
+        chunk.submitted_frame = frame_;
+        if (!chunk.pending) {
+            chunk.pending = true;
+            pending_.push_back(profile->timestamps.chunk);
+        }
+    }
+}
+
+void GpuProfiler::OnSubmit(CommandBufferProfiler& profiles, uint32_t count, const VkSubmitInfo* submits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t j = 0; j < submits[i].commandBufferCount; ++j) {
+            MarkSubmitted(profiles, submits[i].pCommandBuffers[j]);
+        }
+    }
+}
+
+void GpuProfiler::OnSubmit(CommandBufferProfiler& profiles, uint32_t count, const VkSubmitInfo2* submits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t j = 0; j < submits[i].commandBufferInfoCount; ++j) {
+            MarkSubmitted(profiles, submits[i].pCommandBufferInfos[j].commandBuffer);
+        }
+    }
+}
+
+bool GpuProfiler::Resolve(uint32_t index, bool last_chance) {
+    Chunk& chunk = chunks_[index];
+    uint64_t frame = chunk.submitted_frame;
+    uint32_t query_count = 2 * chunk.region_count;
+    if (query_count == 0) {
+        chunk.submitted_frame = 0;
+        return true;
+    }
+
+    // Value and availability per query
+    uint64_t results[kQueriesPerChunk][2];
+    VkResult result = get_query_pool_results_(
+        device_, pool_, index * kQueriesPerChunk, query_count, sizeof(results), results,
+        sizeof(results[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    // All or nothing, so one frame never mixes two executions
+    bool available = result >= 0;
+    for (uint32_t i = 0; available && i < chunk.region_count; ++i) {
+        if (chunk.regions[i].closed) {
+            available = results[2 * i][1] && results[2 * i + 1][1];
+        }
+    }
+    if (!available && !last_chance) {
+        return false;
+    }
+    chunk.submitted_frame = 0;
+
+    FrameSlot& slot = frame_slots_[frame % kFrameSlots];
+    if (!available || slot.times.frame != frame) {
+        dropped_chunks_++;
+        return true;
+    }
+
+    for (uint32_t i = 0; i < chunk.region_count; ++i) {
+        const Region& region = chunk.regions[i];
+        if (!region.closed) continue;
+
+        uint64_t begin = results[2 * i][0] & tick_mask_;
+        uint64_t end = results[2 * i + 1][0] & tick_mask_;
+        uint64_t ticks = (end - begin) & tick_mask_;
+        uint64_t nanoseconds = static_cast<uint64_t>(static_cast<double>(ticks) * nanoseconds_per_tick_);
+
+        // Spans that wrap the counter are rare enough to leave out
+        if (begin <= end) {
+            slot.first_tick = std::min(slot.first_tick, begin);
+            slot.last_tick = std::max(slot.last_tick, end);
+        }
+
+        if (region.kind == TimestampRegion::kRenderPass) {
+            slot.times.render_pass_ns += nanoseconds;
+            slot.times.render_passes++;
+            if (nanoseconds > slot.times.slowest_pass_ns) {
+                slot.times.slowest_pass_ns = nanoseconds;
+                slot.times.slowest_pass_extent = region.extent;
+            }
+        } else {
+            slot.times.dispatch_ns += nanoseconds;
+            slot.times.dispatch_groups++;
+        }
+    }
+    return true;
+}
+
+void GpuProfiler::StartFrame(uint64_t frame) {
+    frame_slots_[frame % kFrameSlots] = FrameSlot{};
+    frame_slots_[frame % kFrameSlots].times.frame = frame;
+}
+
+void GpuProfiler::Finalize(uint64_t frame) {
+    FrameSlot& slot = frame_slots_[frame % kFrameSlots];
+    if (slot.times.frame != frame || (slot.times.render_passes == 0 && slot.times.dispatch_groups == 0)) {
+        return;
+    }
+    if (slot.first_tick <= slot.last_tick) {
+        slot.times.span_ns = static_cast<uint64_t>(
+            static_cast<double>(slot.last_tick - slot.first_tick) * nanoseconds_per_tick_);
+    }
+    history_[finalized_++ % kHistoryCapacity] = slot.times;
+
+    report_sum_.render_pass_ns += slot.times.render_pass_ns;
+    report_sum_.dispatch_ns += slot.times.dispatch_ns;
+    report_sum_.span_ns += slot.times.span_ns;
+    report_sum_.render_passes += slot.times.render_passes;
+    report_sum_.dispatch_groups += slot.times.dispatch_groups;
+    if (slot.times.slowest_pass_ns > report_sum_.slowest_pass_ns) {
+        report_sum_.slowest_pass_ns = slot.times.slowest_pass_ns;
+        report_sum_.slowest_pass_extent = slot.times.slowest_pass_extent;
+    }
+    report_frames_++;
+    slot.times.frame = 0;
+}
+
+void GpuProfiler::OnPresent() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Chunks resolved at re-record or release are only dropped from the list here
+    std::erase_if(pending_, [this](uint32_t index) {
+        Chunk& chunk = chunks_[index];
+        uint64_t submitted = chunk.submitted_frame;
+        if (submitted && (submitted + kResolveDelay > frame_ ||
+                          !Resolve(index, submitted + kFinalizeDelay <= frame_ + 1))) {
+            return false;
+        }
+        chunk.pending = false;
+        return true;
+    });
+    if (frame_ + 1 >= kFinalizeDelay + 1) {
+        Finalize(frame_ + 1 - kFinalizeDelay);
+    }
+    StartFrame(++frame_);
+
+    uint64_t now = SteadyNanoseconds();
+    if (now >= next_report_ns_) {
+        next_report_ns_ = now + kReportIntervalNs;
+        LogReport();
+    }
+}
+
+void GpuProfiler::Release(const std::vector<uint32_t>& chunks) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t chunk : chunks) {
+        // Freed command buffers are done executing
+        if (chunks_[chunk].submitted_frame) {
+            Resolve(chunk, true);
+        }
+        free_chunks_.push_back(chunk);
+    }
+}
+
+void GpuProfiler::LogReport() {
+    if (report_frames_ == 0) {
+        return;
+    }
+    double frames = report_frames_;
+    XCLIPSE_LOGI("GPU time over %u frames: render passes %.2f ms (%.1f/frame), dispatches %.2f ms "
+                 "(%.1f groups/frame), span %.2f ms; slowest pass %ux%u %.2f ms",
+                 report_frames_, Milliseconds(report_sum_.render_pass_ns) / frames,
+                 report_sum_.render_passes / frames, Milliseconds(report_sum_.dispatch_ns) / frames,
+                 report_sum_.dispatch_groups / frames, Milliseconds(report_sum_.span_ns) / frames,
+                 report_sum_.slowest_pass_extent.width, report_sum_.slowest_pass_extent.height,
+                 Milliseconds(report_sum_.slowest_pass_ns));
+    report_sum_ = FrameGpuTimes{};
+    report_frames_ = 0;
+}
+
+void GpuProfiler::Dump() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (uint32_t index : pending_) {
+        if (chunks_[index].submitted_frame) {
+            Resolve(index, true);
+        }
+        chunks_[index].pending = false;
+    }
+    pending_.clear();
+    for (uint64_t frame = frame_ >= kFrameSlots ? frame_ - kFrameSlots + 1 : 1; frame <= frame_; ++frame) {
+        Finalize(frame);
+    }
+    LogReport();
+    XCLIPSE_LOGI("GPU profiler: %llu frames timed, %llu regions and %llu command buffers untimed, "
+                 "%llu chunks dropped",
+                 static_cast<unsigned long long>(finalized_),
+                 static_cast<unsigned long long>(dropped_regions_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(untimed_command_buffers_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(dropped_chunks_));
+
+    if (export_path_.empty() || finalized_ == 0) {
+        return;
+    }
+    std::string csv = "frame,render_pass_ns,dispatch_ns,span_ns,render_passes,dispatch_groups,"
+                      "slowest_pass_ns,slowest_pass_width,slowest_pass_height\n";
+    uint64_t first = finalized_ > kHistoryCapacity ? finalized_ - kHistoryCapacity : 0;
+    for (uint64_t i = first; i < finalized_; ++i) {
+        const FrameGpuTimes& times = history_[i % kHistoryCapacity];
+        char line[192];
+        std::snprintf(line, sizeof(line),
+                      "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%u,%u,%" PRIu64 ",%u,%u\n",
+                      times.frame, times.render_pass_ns, times.dispatch_ns, times.span_ns,
+                      times.render_passes, times.dispatch_groups, times.slowest_pass_ns,
+                      times.slowest_pass_extent.width, times.slowest_pass_extent.height);
+        csv += line;
+    }
+    WriteFileAtomically(export_path_, csv);
+}
@@ -0,0 +1,170 @@
+// gpu_profiler.h - Opt-in GPU timestamps around render passes and dispatches
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "command_buffer_profile.h"
+#include "dispatch.h"
+
+// GPU time of the command buffers submitted between one present and the next
+struct FrameGpuTimes {
+    uint64_t frame{0};
+    uint64_t render_pass_ns{0};
+    uint64_t dispatch_ns{0};
+    uint64_t span_ns{0};  // earliest timestamp to latest, across the frame
+    uint64_t slowest_pass_ns{0};
+    VkExtent2D slowest_pass_extent{};
+    uint32_t render_passes{0};
+    uint32_t dispatch_groups{0};
+};
+
+// Brackets render passes and runs of dispatches in primary command buffers
+// with timestamps in a query pool the layer owns. The pool is a ring of
+// fixed-size chunks: a command buffer takes one at vkBeginCommandBuffer and
+// resets it there, outside any render pass. Timestamps also sit just
+// outside render passes, so multiview never multiplies them.
+//
+// Results are read without waiting, kResolveDelay presents after the
+// submit that used them, or as soon as the command buffer is re-recorded,
+// which the app may only do once the GPU is done with it. A frame's
+// breakdown is final kFinalizeDelay presents later; results that show up
+// after that are dropped rather than stalling anything.
+class GpuProfiler {
+public:
+    // Returns nullptr if no graphics or compute queue family can write
+    // timestamps. Command buffers from other families are never timed.
+    static std::unique_ptr<GpuProfiler> Create(VkPhysicalDevice physical_device,
+                                               const InstanceDispatch& instance_dispatch,
+                                               VkDevice device, const DeviceDispatch& dispatch,
+                                               const VkPhysicalDeviceProperties& properties,
+                                               bool synchronization2, std::string export_path);
+
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Recording calls, made by the thread recording command_buffer after
+    // Begin, which follows the driver's vkBeginCommandBuffer
+    void Begin(VkCommandBuffer command_buffer, const VkCommandBufferBeginInfo& begin_info,
+               TimestampCursor& cursor);
+    void BeforeDispatch(VkCommandBuffer command_buffer, TimestampCursor& cursor) {
+        if (cursor.chunk != TimestampCursor::kNoChunk && cursor.open != TimestampRegion::kDispatches) {
+            Open(command_buffer, cursor, TimestampRegion::kDispatches, {});
+        }
+    }
+    void BeforeRenderPass(VkCommandBuffer command_buffer, TimestampCursor& cursor, VkExtent2D extent);
+    void BeforeRendering(VkCommandBuffer command_buffer, TimestampCursor& cursor,
+                         const VkRenderingInfo& rendering_info);
+    void AfterRenderPass(VkCommandBuffer command_buffer, TimestampCursor& cursor) {
+        if (cursor.open == TimestampRegion::kRenderPass) {
+            Close(command_buffer, cursor);
+        }
+    }
+    void BeforeEnd(VkCommandBuffer command_buffer, TimestampCursor& cursor) {
+        if (cursor.open != TimestampRegion::kNone) {
+            Close(command_buffer, cursor);
+        }
+    }
+
+    // Command buffers handed to a queue in the current frame
+    void OnSubmit(CommandBufferProfiler& profiles, uint32_t count, const VkSubmitInfo* submits);
+    void OnSubmit(CommandBufferProfiler& profiles, uint32_t count, const VkSubmitInfo2* submits);
+
+    void OnPresent();
+
+    // Chunks of freed command buffers
+    void Release(const std::vector<uint32_t>& chunks);
+
+    // Resolves what is left, logs a summary and exports the per-frame
+    // history; the device must be idle
+    void Dump();
+
+private:
+    static constexpr uint32_t kChunkCount = 256;
+    static constexpr uint32_t kRegionsPerChunk = 32;
+    static constexpr uint32_t kQueriesPerChunk = 2 * kRegionsPerChunk;  // begin and end
+    static constexpr uint64_t kResolveDelay = 3;
+    static constexpr uint64_t kFinalizeDelay = 8;
+    static constexpr uint32_t kFrameSlots = 16;  // more than kFinalizeDelay
+    static constexpr uint32_t kHistoryCapacity = 1024;
+    static constexpr uint64_t kReportIntervalNs = 10ull * 1000 * 1000 * 1000;
+
+    struct Region {
+        TimestampRegion kind{TimestampRegion::kNone};
+        bool closed{false};
+        VkExtent2D extent{};
+    };
+
+    // Written only by the recording thread between Begin and submit, and
+    // only under mutex_ after that
+    struct Chunk {
+        std::array<Region, kRegionsPerChunk> regions;
+        uint32_t region_count{0};
+        uint64_t submitted_frame{0};  // waiting for results while nonzero
+        bool pending{false};          // listed in pending_
+    };
+
+    struct FrameSlot {
+        FrameGpuTimes times;
+        uint64_t first_tick{UINT64_MAX};
+        uint64_t last_tick{0};
+    };
+
+    GpuProfiler(VkDevice device, const DeviceDispatch& dispatch, VkQueryPool pool,
+                double nanoseconds_per_tick, uint64_t tick_mask, uint32_t timeable_families,
+                bool synchronization2, std::string export_path);
+
+    void Open(VkCommandBuffer command_buffer, TimestampCursor& cursor, TimestampRegion kind,
+              VkExtent2D extent);
+    void Close(VkCommandBuffer command_buffer, TimestampCursor& cursor);
+    void WriteTimestamp(VkCommandBuffer command_buffer, uint32_t query, bool end);
+
+    void MarkSubmitted(CommandBufferProfiler& profiles, VkCommandBuffer command_buffer);
+
+    // With mutex_ held. Returns false if the results are not all there yet
+    // and this is not the last chance to read them.
+    bool Resolve(uint32_t index, bool last_chance);
+    void Finalize(uint64_t frame);
+    void StartFrame(uint64_t frame);
+    void LogReport();
+
+    VkDevice device_;
+    PFN_vkDestroyQueryPool destroy_query_pool_;
+    PFN_vkGetQueryPoolResults get_query_pool_results_;
+    PFN_vkCmdResetQueryPool cmd_reset_query_pool_;
+    PFN_vkCmdWriteTimestamp cmd_write_timestamp_;
+    PFN_vkCmdWriteTimestamp2 cmd_write_timestamp2_;  // null unless synchronization2 is on
+    VkQueryPool pool_;
+    double nanoseconds_per_tick_;
+    uint64_t tick_mask_;
+    uint32_t timeable_families_;  // bit per queue family index
+
+    std::mutex mutex_;
+    std::unique_ptr<Chunk[]> chunks_;
+    std::vector<uint32_t> free_chunks_;
+    std::vector<uint32_t> pending_;  // submitted since they were last resolved
+    uint64_t frame_{1};
+    std::array<FrameSlot, kFrameSlots> frame_slots_;
+    std::vector<FrameGpuTimes> history_;  // ring of finalized frames
+    uint64_t finalized_{0};
+
+    // Since the last report
+    FrameGpuTimes report_sum_;
+    uint32_t report_frames_{0};
+    uint64_t next_report_ns_;
+
+    std::atomic<uint64_t> dropped_regions_{0};          // chunk full
+    std::atomic<uint64_t> untimed_command_buffers_{0};  // ring exhausted
+    uint64_t dropped_chunks_{0};                        // results late or lost
+
+    std::string export_path_;
+};
@@ -1,127 +1,699 @@
 // layer_init.cpp - Vulkan Layer Initialization for Android 16
 
 #include <vulkan/vulkan.h>
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "async_compute.h"
+#include "dispatch.h"
+#include "dispatch_key_map.h"
+#include "entry_point_table.h"
+#include "entry_points.h"
+#include "vk_layer_interface.h"
+#include "xclipse_wrapper.h"
+
+#define XCLIPSE_EXPORT __attribute__((visibility("default")))
 
 // Layer manifest constants
 static const VkLayerProperties layer_properties = {
     "VK_LAYER_XCLIPSE_940",
     VK_MAKE_API_VERSION(0, 1, 3, 0),
-    1,
+    2,
     "Xclipse 940 GPU Optimization Layer"
 };
 
-// Global instance and device dispatch tables
-struct LayerData {
-    PFN_vkGetInstanceProcAddr get_instance_proc_addr;
-    PFN_vkGetDeviceProcAddr get_device_proc_addr;
+// Next-layer instance dispatch tables, keyed by loader dispatch key. Device
+// tables live in the wrapper's per-device contexts.
+static DispatchKeyMap<InstanceDispatch> g_instance_dispatch;
+
+#define XCLIPSE_LOAD(table, gpa, handle, name) \
+    table.name = reinterpret_cast<PFN_vk##name>(gpa(handle, "vk" #name))
+
+void InitInstanceDispatch(InstanceDispatch& table, VkInstance instance,
+                          PFN_vkGetInstanceProcAddr get_instance_proc_addr) {
+    table.instance = instance;
+    table.GetInstanceProcAddr = get_instance_proc_addr;
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, DestroyInstance);
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, EnumerateDeviceExtensionProperties);
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, GetPhysicalDeviceProperties);
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, GetPhysicalDeviceProperties2);
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, GetPhysicalDeviceMemoryProperties);
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, GetPhysicalDeviceMemoryProperties2);
+    XCLIPSE_LOAD(table, get_instance_proc_addr, instance, GetPhysicalDeviceQueueFamilyProperties);
+
+    // The loader resolves 1.1 names whatever version the app asked for, but
+    // they are only valid to call when the instance has them
+    if (!table.physical_device_properties2) {
+        table.GetPhysicalDeviceProperties2 = nullptr;
+        table.GetPhysicalDeviceMemoryProperties2 = nullptr;
+        return;
+    }
+
+    // Vulkan 1.0 instances only have the VK_KHR_get_physical_device_properties2 alias
+    if (table.api_version < VK_API_VERSION_1_1 || !table.GetPhysicalDeviceProperties2) {
+        table.GetPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+            get_instance_proc_addr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+    }
+    if (table.api_version < VK_API_VERSION_1_1 || !table.GetPhysicalDeviceMemoryProperties2) {
+        table.GetPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+            get_instance_proc_addr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+    }
+}
+
+void InitDeviceDispatch(DeviceDispatch& table, VkDevice device,
+                        PFN_vkGetDeviceProcAddr get_device_proc_addr) {
+    table.device = device;
+    table.GetDeviceProcAddr = get_device_proc_addr;
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyDevice);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateGraphicsPipelines);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateComputePipelines);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyPipeline);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateShaderModule);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyShaderModule);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreatePipelineCache);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyPipelineCache);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetPipelineCacheData);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, AllocateMemory);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, FreeMemory);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, MapMemory);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, UnmapMemory);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, FlushMappedMemoryRanges);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, InvalidateMappedMemoryRanges);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetDeviceMemoryCommitment);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, BindBufferMemory);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, BindImageMemory);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, BindBufferMemory2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, BindImageMemory2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateImage);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyImage);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetBufferMemoryRequirements);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetImageMemoryRequirements);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetBufferMemoryRequirements2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetImageMemoryRequirements2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetDeviceBufferMemoryRequirements);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetDeviceImageMemoryRequirements);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, QueueSubmit);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, QueueSubmit2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, QueueWaitIdle);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DeviceWaitIdle);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, WaitForFences);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, WaitSemaphores);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetSemaphoreCounterValue);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetEventStatus);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetQueryPoolResults);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateQueryPool);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyQueryPool);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, QueueBindSparse);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, QueuePresentKHR);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetDeviceQueue);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, GetDeviceQueue2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateSemaphore);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroySemaphore);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CreateCommandPool);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, AllocateCommandBuffers);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, FreeCommandBuffers);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, DestroyCommandPool);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, BeginCommandBuffer);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, EndCommandBuffer);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDraw);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDrawIndexed);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDrawIndirect);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDrawIndexedIndirect);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDrawIndirectCount);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDrawIndexedIndirectCount);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDispatch);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDispatchIndirect);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdDispatchBase);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyBuffer);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyImage);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyBufferToImage);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyImageToBuffer);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdBlitImage);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyBuffer2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyImage2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyBufferToImage2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdCopyImageToBuffer2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdBlitImage2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdBeginRenderPass);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdBeginRenderPass2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdEndRenderPass);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdEndRenderPass2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdBeginRendering);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdEndRendering);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdExecuteCommands);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdPipelineBarrier);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdPipelineBarrier2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdSetEvent);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdResetEvent);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdWaitEvents);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdSetEvent2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdResetEvent2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdWaitEvents2);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdResetQueryPool);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdWriteTimestamp);
+    XCLIPSE_LOAD(table, get_device_proc_addr, device, CmdWriteTimestamp2);
+
+    // Vulkan 1.0 devices only expose the VK_KHR_bind_memory2 aliases
+    if (!table.BindBufferMemory2) {
+        table.BindBufferMemory2 = reinterpret_cast<PFN_vkBindBufferMemory2>(
+            get_device_proc_addr(device, "vkBindBufferMemory2KHR"));
+    }
+    if (!table.BindImageMemory2) {
+        table.BindImageMemory2 = reinterpret_cast<PFN_vkBindImageMemory2>(
+            get_device_proc_addr(device, "vkBindImageMemory2KHR"));
+    }
+    // ...and VK_KHR_get_memory_requirements2 / VK_KHR_maintenance4 aliases
+    if (!table.GetBufferMemoryRequirements2) {
+        table.GetBufferMemoryRequirements2 = reinterpret_cast<PFN_vkGetBufferMemoryRequirements2>(
+            get_device_proc_addr(device, "vkGetBufferMemoryRequirements2KHR"));
+    }
+    if (!table.GetImageMemoryRequirements2) {
+        table.GetImageMemoryRequirements2 = reinterpret_cast<PFN_vkGetImageMemoryRequirements2>(
+            get_device_proc_addr(device, "vkGetImageMemoryRequirements2KHR"));
+    }
+    if (!table.GetDeviceBufferMemoryRequirements) {
+        table.GetDeviceBufferMemoryRequirements = reinterpret_cast<PFN_vkGetDeviceBufferMemoryRequirements>(
+            get_device_proc_addr(device, "vkGetDeviceBufferMemoryRequirementsKHR"));
+    }
+    if (!table.GetDeviceImageMemoryRequirements) {
+        table.GetDeviceImageMemoryRequirements = reinterpret_cast<PFN_vkGetDeviceImageMemoryRequirements>(
+            get_device_proc_addr(device, "vkGetDeviceImageMemoryRequirementsKHR"));
+    }
+    if (!table.WaitSemaphores) {
+        table.WaitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(
+            get_device_proc_addr(device, "vkWaitSemaphoresKHR"));
+    }
+    if (!table.GetSemaphoreCounterValue) {
+        table.GetSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
+            get_device_proc_addr(device, "vkGetSemaphoreCounterValueKHR"));
+    }
+    if (!table.QueueSubmit2) {
+        table.QueueSubmit2 = reinterpret_cast<PFN_vkQueueSubmit2>(
+            get_device_proc_addr(device, "vkQueueSubmit2KHR"));
+    }
+    // Commands promoted to core from VK_KHR_draw_indirect_count,
+    // VK_KHR_device_group, VK_KHR_copy_commands2, VK_KHR_create_renderpass2,
+    // VK_KHR_dynamic_rendering and VK_KHR_synchronization2
+    if (!table.CmdDrawIndirectCount) {
+        table.CmdDrawIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndirectCount>(
+            get_device_proc_addr(device, "vkCmdDrawIndirectCountKHR"));
+    }
+    if (!table.CmdDrawIndexedIndirectCount) {
+        table.CmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+            get_device_proc_addr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    }
+    if (!table.CmdDispatchBase) {
+        table.CmdDispatchBase = reinterpret_cast<PFN_vkCmdDispatchBase>(
+            get_device_proc_addr(device, "vkCmdDispatchBaseKHR"));
+    }
+    if (!table.CmdCopyBuffer2) {
+        table.CmdCopyBuffer2 = reinterpret_cast<PFN_vkCmdCopyBuffer2>(
+            get_device_proc_addr(device, "vkCmdCopyBuffer2KHR"));
+    }
+    if (!table.CmdCopyImage2) {
+        table.CmdCopyImage2 = reinterpret_cast<PFN_vkCmdCopyImage2>(
+            get_device_proc_addr(device, "vkCmdCopyImage2KHR"));
+    }
+    if (!table.CmdCopyBufferToImage2) {
+        table.CmdCopyBufferToImage2 = reinterpret_cast<PFN_vkCmdCopyBufferToImage2>(
+            get_device_proc_addr(device, "vkCmdCopyBufferToImage2KHR"));
+    }
+    if (!table.CmdCopyImageToBuffer2) {
+        table.CmdCopyImageToBuffer2 = reinterpret_cast<PFN_vkCmdCopyImageToBuffer2>(
+            get_device_proc_addr(device, "vkCmdCopyImageToBuffer2KHR"));
+    }
+    if (!table.CmdBlitImage2) {
+        table.CmdBlitImage2 = reinterpret_cast<PFN_vkCmdBlitImage2>(
+            get_device_proc_addr(device, "vkCmdBlitImage2KHR"));
+    }
+    if (!table.CmdBeginRenderPass2) {
+        table.CmdBeginRenderPass2 = reinterpret_cast<PFN_vkCmdBeginRenderPass2>(
+            get_device_proc_addr(device, "vkCmdBeginRenderPass2KHR"));
+    }
+    if (!table.CmdEndRenderPass2) {
+        table.CmdEndRenderPass2 = reinterpret_cast<PFN_vkCmdEndRenderPass2>(
+            get_device_proc_addr(device, "vkCmdEndRenderPass2KHR"));
+    }
+    if (!table.CmdBeginRendering) {
+        table.CmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRendering>(
+            get_device_proc_addr(device, "vkCmdBeginRenderingKHR"));
+    }
+    if (!table.CmdEndRendering) {
+        table.CmdEndRendering = reinterpret_cast<PFN_vkCmdEndRendering>(
+            get_device_proc_addr(device, "vkCmdEndRenderingKHR"));
+    }
+    if (!table.CmdPipelineBarrier2) {
+        table.CmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(
+            get_device_proc_addr(device, "vkCmdPipelineBarrier2KHR"));
+    }
+    if (!table.CmdSetEvent2) {
+        table.CmdSetEvent2 = reinterpret_cast<PFN_vkCmdSetEvent2>(
+            get_device_proc_addr(device, "vkCmdSetEvent2KHR"));
+    }
+    if (!table.CmdResetEvent2) {
+        table.CmdResetEvent2 = reinterpret_cast<PFN_vkCmdResetEvent2>(
+            get_device_proc_addr(device, "vkCmdResetEvent2KHR"));
+    }
+    if (!table.CmdWaitEvents2) {
+        table.CmdWaitEvents2 = reinterpret_cast<PFN_vkCmdWaitEvents2>(
+            get_device_proc_addr(device, "vkCmdWaitEvents2KHR"));
+    }
+    if (!table.CmdWriteTimestamp2) {
+        table.CmdWriteTimestamp2 = reinterpret_cast<PFN_vkCmdWriteTimestamp2>(
+            get_device_proc_addr(device, "vkCmdWriteTimestamp2KHR"));
+    }
+}
+
+#undef XCLIPSE_LOAD
+
+const InstanceDispatch* GetInstanceDispatch(void* key) {
+    return g_instance_dispatch.Find(key);
+}
+
+// Find the loader's link info, or another loader struct, in a create-info
+// pNext chain
+template <typename ChainInfo, typename CreateInfo>
+static ChainInfo* FindLayerLinkInfo(const CreateInfo* create_info, VkStructureType type,
+                                    VkLayerFunction function = VK_LAYER_LINK_INFO) {
+    auto* info = static_cast<const VkBaseInStructure*>(create_info->pNext);
+    while (info) {
+        auto* chain_info = reinterpret_cast<const ChainInfo*>(info);
+        if (info->sType == type && chain_info->function == function) {
+            return const_cast<ChainInfo*>(chain_info);
+        }
+        info = info->pNext;
+    }
+    return nullptr;
+}
+
+struct DeviceExtensionFlag {
+    const char* name;
+    bool DeviceExtensions::*enabled;
+    // Depends on VK_KHR_get_physical_device_properties2 or a 1.1 instance
+    bool needs_properties2{false};
 };
 
-static LayerData g_layer_data;
+// Device extensions the layer turns on for itself when the driver has them
+// and their dependencies are met; each depends only on entries before it.
+// Enabling them adds nothing to what the app sees, except that with
+// dedicated_images on, VK_KHR_dedicated_allocation lets the layer report
+// prefersDedicatedAllocation for images the app never asked about it for.
+static constexpr DeviceExtensionFlag kLayerDeviceExtensions[] = {
+    {VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME, &DeviceExtensions::pipeline_creation_feedback},
+    {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, &DeviceExtensions::memory_budget, true},
+    {VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, &DeviceExtensions::get_memory_requirements2},
+    {VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, &DeviceExtensions::dedicated_allocation},
+};
+
+// App-enabled extensions that change what the layer may safely do
+static constexpr DeviceExtensionFlag kWatchedDeviceExtensions[] = {
+    {VK_KHR_MAP_MEMORY_2_EXTENSION_NAME, &DeviceExtensions::map_memory2},
+};
+
+// Fills names with the app's extensions plus any supported layer extension
+// the app left out, and reports which tracked extensions end up enabled.
+static DeviceExtensions ResolveDeviceExtensions(const InstanceDispatch& dispatch,
+                                                VkPhysicalDevice physical_device,
+                                                const VkDeviceCreateInfo& create_info,
+                                                std::vector<const char*>& names) {
+    DeviceExtensions extensions;
+    names.assign(create_info.ppEnabledExtensionNames,
+                 create_info.ppEnabledExtensionNames + create_info.enabledExtensionCount);
+
+    uint32_t count = 0;
+    std::vector<VkExtensionProperties> supported;
+    if (dispatch.EnumerateDeviceExtensionProperties(physical_device, nullptr, &count, nullptr) == VK_SUCCESS) {
+        supported.resize(count);
+        if (dispatch.EnumerateDeviceExtensionProperties(physical_device, nullptr, &count,
+                                                        supported.data()) < 0) {
+            count = 0;
+        }
+        supported.resize(count);
+    }
+
+    for (const DeviceExtensionFlag& extension : kWatchedDeviceExtensions) {
+        extensions.*extension.enabled = std::any_of(names.begin(), names.end(), [&extension](const char* name) {
+            return std::strcmp(name, extension.name) == 0;
+        });
+    }
+
+    for (const DeviceExtensionFlag& extension : kLayerDeviceExtensions) {
+        auto same_name = [&extension](const char* name) {
+            return std::strcmp(name, extension.name) == 0;
+        };
+        if (std::any_of(names.begin(), names.end(), same_name)) {
+            extensions.*extension.enabled = true;
+            continue;
+        }
+        if (extension.needs_properties2 && !dispatch.physical_device_properties2) {
+            continue;
+        }
+        for (const VkExtensionProperties& properties : supported) {
+            if (same_name(properties.extensionName)) {
+                names.push_back(extension.name);
+                extensions.*extension.enabled = true;
+                break;
+            }
+        }
+    }
+    return extensions;
+}
 
-// Instance functions we intercept
-static PFN_vkCreateInstance vkCreateInstance_original = nullptr;
-static PFN_vkCreateDevice vkCreateDevice_original = nullptr;
+// vkCmdWriteTimestamp2 may only be recorded with the feature on, whether it
+// came from the 1.3 feature struct or VK_KHR_synchronization2's own
+static bool Synchronization2Enabled(const VkDeviceCreateInfo& create_info) {
+    for (auto* next = static_cast<const VkBaseInStructure*>(create_info.pNext); next; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES &&
+            reinterpret_cast<const VkPhysicalDeviceVulkan13Features*>(next)->synchronization2) {
+            return true;
+        }
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES &&
+            reinterpret_cast<const VkPhysicalDeviceSynchronization2Features*>(next)->synchronization2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Required subgroup sizes are only valid with the feature on; the
+// extension's feature struct and the 1.3 one both count
+static bool SubgroupSizeControlEnabled(const VkDeviceCreateInfo& create_info) {
+    for (auto* next = static_cast<const VkBaseInStructure*>(create_info.pNext); next; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES &&
+            reinterpret_cast<const VkPhysicalDeviceVulkan13Features*>(next)->subgroupSizeControl) {
+            return true;
+        }
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES &&
+            reinterpret_cast<const VkPhysicalDeviceSubgroupSizeControlFeatures*>(next)->subgroupSizeControl) {
+            return true;
+        }
+    }
+    return false;
+}
 
 extern "C" {
 
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
+XCLIPSE_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* pName);
+XCLIPSE_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char* pName);
+
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(
     const VkInstanceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator,
     VkInstance* pInstance) {
-    
-    if (!vkCreateInstance_original) {
+
+    auto* chain_info = FindLayerLinkInfo<VkLayerInstanceCreateInfo>(
+        pCreateInfo, VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO);
+    if (!chain_info || !chain_info->u.pLayerInfo) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
-    
-    // Pass through to original function
-    return vkCreateInstance_original(pCreateInfo, pAllocator, pInstance);
+
+    PFN_vkGetInstanceProcAddr next_get_instance_proc_addr =
+        chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    auto next_create_instance = reinterpret_cast<PFN_vkCreateInstance>(
+        next_get_instance_proc_addr(VK_NULL_HANDLE, "vkCreateInstance"));
+    if (!next_create_instance) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Advance the link info so the next layer sees its own entry
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+
+    VkResult result = next_create_instance(pCreateInfo, pAllocator, pInstance);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    auto dispatch = std::make_unique<InstanceDispatch>();
+    if (pCreateInfo->pApplicationInfo && pCreateInfo->pApplicationInfo->apiVersion) {
+        dispatch->api_version = pCreateInfo->pApplicationInfo->apiVersion;
+    }
+    dispatch->physical_device_properties2 =
+        dispatch->api_version >= VK_API_VERSION_1_1 ||
+        std::any_of(pCreateInfo->ppEnabledExtensionNames,
+                    pCreateInfo->ppEnabledExtensionNames + pCreateInfo->enabledExtensionCount,
+                    [](const char* name) {
+                        return std::strcmp(name, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+                    });
+    InitInstanceDispatch(*dispatch, *pInstance, next_get_instance_proc_addr);
+    dispatch->settings = ResolveLayerSettings(pCreateInfo->pApplicationInfo);
+
+    if (!g_instance_dispatch.Insert(GetDispatchKey(*pInstance), std::move(dispatch))) {
+        auto next_destroy_instance = reinterpret_cast<PFN_vkDestroyInstance>(
+            next_get_instance_proc_addr(*pInstance, "vkDestroyInstance"));
+        next_destroy_instance(*pInstance, pAllocator);
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    return VK_SUCCESS;
+}
+
+XCLIPSE_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(
+    VkInstance instance,
+    const VkAllocationCallbacks* pAllocator) {
+
+    if (!instance) {
+        return;
+    }
+
+    std::unique_ptr<InstanceDispatch> dispatch = g_instance_dispatch.Erase(GetDispatchKey(instance));
+    if (dispatch) {
+        dispatch->DestroyInstance(instance, pAllocator);
+    }
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(
     VkPhysicalDevice physicalDevice,
     const VkDeviceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator,
     VkDevice* pDevice) {
-    
-    if (!vkCreateDevice_original) {
+
+    const InstanceDispatch* instance_dispatch = GetInstanceDispatch(GetDispatchKey(physicalDevice));
+    auto* chain_info = FindLayerLinkInfo<VkLayerDeviceCreateInfo>(
+        pCreateInfo, VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO);
+    if (!instance_dispatch || !chain_info || !chain_info->u.pLayerInfo) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
-    
-    VkResult result = vkCreateDevice_original(physicalDevice, pCreateInfo, pAllocator, pDevice);
-    
+
+    PFN_vkGetInstanceProcAddr next_get_instance_proc_addr =
+        chain_info->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkGetDeviceProcAddr next_get_device_proc_addr =
+        chain_info->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+    auto next_create_device = reinterpret_cast<PFN_vkCreateDevice>(
+        next_get_instance_proc_addr(instance_dispatch->instance, "vkCreateDevice"));
+    if (!next_create_device) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    // Advance the link info so the next layer sees its own entry
+    chain_info->u.pLayerInfo = chain_info->u.pLayerInfo->pNext;
+
+    std::vector<const char*> extension_names;
+    DeviceExtensions extensions = ResolveDeviceExtensions(*instance_dispatch, physicalDevice,
+                                                          *pCreateInfo, extension_names);
+    extensions.synchronization2 = Synchronization2Enabled(*pCreateInfo);
+    extensions.subgroup_size_control = SubgroupSizeControlEnabled(*pCreateInfo);
+    VkDeviceCreateInfo create_info = *pCreateInfo;
+    create_info.enabledExtensionCount = static_cast<uint32_t>(extension_names.size());
+    create_info.ppEnabledExtensionNames = extension_names.data();
+
+    std::vector<VkDeviceQueueCreateInfo> queue_infos;
+    std::vector<std::vector<float>> queue_priorities;
+    AsyncComputePlan async_compute;
+    // The queues have to exist before the wrapper sees the device
+    if (instance_dispatch->settings.async_compute) {
+        async_compute = PlanAsyncCompute(*instance_dispatch, physicalDevice, create_info,
+                                         queue_infos, queue_priorities);
+        if (auto* loader_data = FindLayerLinkInfo<VkLayerDeviceCreateInfo>(
+                pCreateInfo, VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO, VK_LOADER_DATA_CALLBACK)) {
+            async_compute.set_loader_data = loader_data->u.pfnSetDeviceLoaderData;
+        }
+    }
+
+    VkResult result = next_create_device(physicalDevice, &create_info, pAllocator, pDevice);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    DeviceDispatch dispatch;
+    InitDeviceDispatch(dispatch, *pDevice, next_get_device_proc_addr);
+
     // Initialize our wrapper with the new device
-    if (result == VK_SUCCESS) {
-        // Device context initialization would happen here
+    if (!xclipse::OnDeviceCreated(physicalDevice, *pDevice, *instance_dispatch, dispatch,
+                                  extensions, async_compute)) {
+        dispatch.DestroyDevice(*pDevice, pAllocator);
+        return VK_ERROR_TOO_MANY_OBJECTS;
     }
-    
-    return result;
+
+    return VK_SUCCESS;
 }
 
-VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(
-    VkInstance instance,
-    const char* pName) {
-    
-    // Intercept functions we need to override
-    if (std::strcmp(pName, "vkCreateGraphicsPipelines") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkCreateGraphicsPipelines);
-    }
-    if (std::strcmp(pName, "vkCreateComputePipelines") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkCreateComputePipelines);
+XCLIPSE_EXPORT VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(
+    VkDevice device,
+    const VkAllocationCallbacks* pAllocator) {
+
+    if (!device) {
+        return;
     }
-    if (std::strcmp(pName, "vkQueueSubmit") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkQueueSubmit);
+
+    const DeviceDispatch* dispatch = GetDeviceDispatch(GetDispatchKey(device));
+    if (!dispatch) {
+        return;
     }
-    if (std::strcmp(pName, "vkAllocateMemory") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkAllocateMemory);
+
+    // The context owns the dispatch table, so grab the pointer first
+    PFN_vkDestroyDevice next_destroy_device = dispatch->DestroyDevice;
+    xclipse::OnDeviceDestroyed(device);
+    next_destroy_device(device, pAllocator);
+}
+
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
+    uint32_t* pPropertyCount,
+    VkLayerProperties* pProperties) {
+
+    if (!pProperties) {
+        *pPropertyCount = 1;
+        return VK_SUCCESS;
     }
-    
-    // For other functions, call the next layer
-    if (g_layer_data.get_instance_proc_addr) {
-        return g_layer_data.get_instance_proc_addr(instance, pName);
+
+    if (*pPropertyCount < 1) {
+        return VK_INCOMPLETE;
     }
-    
-    return nullptr;
+
+    std::memcpy(pProperties, &layer_properties, sizeof(VkLayerProperties));
+    *pPropertyCount = 1;
+    return VK_SUCCESS;
 }
 
-VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(
-    VkDevice device,
-    const char* pName) {
-    
-    // Intercept device-level functions
-    if (std::strcmp(pName, "vkCreateGraphicsPipelines") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkCreateGraphicsPipelines);
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceLayerProperties(
+    VkPhysicalDevice physicalDevice,
+    uint32_t* pPropertyCount,
+    VkLayerProperties* pProperties) {
+
+    return vkEnumerateInstanceLayerProperties(pPropertyCount, pProperties);
+}
+
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties(
+    const char* pLayerName,
+    uint32_t* pPropertyCount,
+    VkExtensionProperties* pProperties) {
+
+    // The layer exposes no instance extensions of its own
+    if (pLayerName && std::strcmp(pLayerName, layer_properties.layerName) == 0) {
+        *pPropertyCount = 0;
+        return VK_SUCCESS;
     }
-    if (std::strcmp(pName, "vkCreateComputePipelines") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkCreateComputePipelines);
+
+    return VK_ERROR_LAYER_NOT_PRESENT;
+}
+
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(
+    VkPhysicalDevice physicalDevice,
+    const char* pLayerName,
+    uint32_t* pPropertyCount,
+    VkExtensionProperties* pProperties) {
+
+    // The layer exposes no device extensions of its own
+    if (pLayerName && std::strcmp(pLayerName, layer_properties.layerName) == 0) {
+        *pPropertyCount = 0;
+        return VK_SUCCESS;
     }
-    if (std::strcmp(pName, "vkQueueSubmit") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkQueueSubmit);
+
+    const InstanceDispatch* dispatch = GetInstanceDispatch(GetDispatchKey(physicalDevice));
+    if (!dispatch) {
+        return VK_ERROR_LAYER_NOT_PRESENT;
     }
-    if (std::strcmp(pName, "vkAllocateMemory") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(vkAllocateMemory);
+
+    return dispatch->EnumerateDeviceExtensionProperties(physicalDevice, pLayerName,
+                                                        pPropertyCount, pProperties);
+}
+
+} // extern "C"
+
+struct InterceptedProc {
+    PFN_vkVoidFunction proc;
+    bool device_level;
+};
+
+#define XCLIPSE_ENTRY_NAME(name, proc) #name,
+static constexpr xclipse::EntryPointTable kEntryPointTable(
+    std::to_array<std::string_view>({XCLIPSE_ENTRY_POINTS(XCLIPSE_ENTRY_NAME, XCLIPSE_ENTRY_NAME)}));
+#undef XCLIPSE_ENTRY_NAME
+static_assert(kEntryPointTable.Valid(), "no collision-free seeds for the entry point table");
+
+// Same order as kEntryPointTable's names
+#define XCLIPSE_INSTANCE_PROC(name, proc) {reinterpret_cast<PFN_vkVoidFunction>(proc), false},
+#define XCLIPSE_DEVICE_PROC(name, proc) {reinterpret_cast<PFN_vkVoidFunction>(proc), true},
+static const InterceptedProc kInterceptedProcs[] = {
+    XCLIPSE_ENTRY_POINTS(XCLIPSE_INSTANCE_PROC, XCLIPSE_DEVICE_PROC)
+};
+#undef XCLIPSE_INSTANCE_PROC
+#undef XCLIPSE_DEVICE_PROC
+
+extern "C" {
+
+XCLIPSE_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(
+    VkInstance instance,
+    const char* pName) {
+
+    // Intercept functions we need to override
+    if (int index = kEntryPointTable.Find(pName); index >= 0) {
+        return kInterceptedProcs[index].proc;
     }
-    
+
     // For other functions, call the next layer
-    if (g_layer_data.get_device_proc_addr) {
-        return g_layer_data.get_device_proc_addr(device, pName);
+    if (!instance) {
+        return nullptr;
     }
-    
+
+    const InstanceDispatch* dispatch = GetInstanceDispatch(GetDispatchKey(instance));
+    if (dispatch && dispatch->GetInstanceProcAddr) {
+        return dispatch->GetInstanceProcAddr(instance, pName);
+    }
+
     return nullptr;
 }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(
-    uint32_t* pPropertyCount,
-    VkLayerProperties* pProperties) {
-    
-    if (pPropertyCount) {
-        *pPropertyCount = 1;
+XCLIPSE_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(
+    VkDevice device,
+    const char* pName) {
+
+    const DeviceDispatch* dispatch = device ? GetDeviceDispatch(GetDispatchKey(device)) : nullptr;
+    PFN_vkVoidFunction next = dispatch && dispatch->GetDeviceProcAddr
+                                  ? dispatch->GetDeviceProcAddr(device, pName)
+                                  : nullptr;
+
+    // Intercept device-level functions, but only those the device really
+    // has; apps probe for optional entry points by checking for null
+    if (int index = kEntryPointTable.Find(pName); index >= 0 && kInterceptedProcs[index].device_level) {
+        return (next || !device) ? kInterceptedProcs[index].proc : nullptr;
     }
-    
-    if (pProperties && pPropertyCount && *pPropertyCount >= 1) {
-        std::memcpy(pProperties, &layer_properties, sizeof(VkLayerProperties));
+
+    // For other functions, call the next layer
+    return next;
+}
+
+// Layer initialization functions
+XCLIPSE_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVersion(
+    VkNegotiateLayerInterface* pVersionStruct) {
+
+    if (pVersionStruct->sType != LAYER_NEGOTIATE_INTERFACE_STRUCT) {
+        return VK_ERROR_INITIALIZATION_FAILED;
     }
-    
+
+    if (pVersionStruct->loaderLayerInterfaceVersion >= 2) {
+        pVersionStruct->pfnGetInstanceProcAddr = vkGetInstanceProcAddr;
+        pVersionStruct->pfnGetDeviceProcAddr = vkGetDeviceProcAddr;
+        pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+    }
+
+    if (pVersionStruct->loaderLayerInterfaceVersion > 2) {
+        pVersionStruct->loaderLayerInterfaceVersion = 2;
+    }
+
     return VK_SUCCESS;
 }
 
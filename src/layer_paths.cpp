@@ -0,0 +1,72 @@
+// layer_paths.cpp - Where the layer keeps per-application files
+
+#include "layer_paths.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static bool MakeDirectory(const std::string& path) {
+    return mkdir(path.c_str(), 0700) == 0 || errno == EEXIST;
+}
+
+std::string GetLayerDataDirectory() {
+    if (const char* dir = std::getenv("XCLIPSE_CACHE_DIR"); dir && *dir) {
+        return MakeDirectory(dir) ? std::string(dir) : std::string();
+    }
+    if (const char* home = std::getenv("HOME"); home && *home) {
+        std::string cache = std::string(home) + "/.cache";
+        std::string dir = cache + "/xclipse940";
+        if (MakeDirectory(cache) && MakeDirectory(dir)) {
+            return dir;
+        }
+    }
+    return {};
+}
+
+std::string GetProcessName() {
+    char name[64] = {};
+    if (FILE* file = std::fopen("/proc/self/comm", "r")) {
+        if (!std::fgets(name, sizeof(name), file)) {
+            name[0] = '\0';
+        }
+        std::fclose(file);
+    }
+
+    std::string result;
+    for (const char* c = name; *c && *c != '\n'; ++c) {
+        result.push_back(*c == '/' ? '_' : *c);
+    }
+    return result.empty() ? std::string("unknown") : result;
+}
+
+bool WriteFileAtomically(const std::string& path, std::string_view contents) {
+    // A unique temporary per write, so two processes or devices saving the
+    // same path never write into each other's half-finished file
+    std::string temp_path = path + ".XXXXXX";
+    int fd = mkostemp(temp_path.data(), O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < contents.size()) {
+        ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    bool ok = written == contents.size() && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,19 @@
+// layer_paths.h - Where the layer keeps per-application files
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// $XCLIPSE_CACHE_DIR, else $HOME/.cache/xclipse940 (created on demand).
+// Empty if neither is usable, in which case file-backed features stay off.
+std::string GetLayerDataDirectory();
+
+// Wine names each process after its executable, so this identifies the game.
+// Safe to use as a file name.
+std::string GetProcessName();
+
+// Write, fsync, then rename over path, so readers such as `adb pull` and
+// the next launch never see a half-written file. Returns false and leaves
+// any previous file alone on failure.
+bool WriteFileAtomically(const std::string& path, std::string_view contents);
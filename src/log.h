@@ -0,0 +1,15 @@
+// log.h - Logcat output for the Xclipse 940 layer
+
+#pragma once
+
+#if defined(__ANDROID__)
+#include <android/log.h>
+#define XCLIPSE_LOG_TAG "xclipse940"
+#define XCLIPSE_LOGI(...) __android_log_print(ANDROID_LOG_INFO, XCLIPSE_LOG_TAG, __VA_ARGS__)
+#define XCLIPSE_LOGW(...) __android_log_print(ANDROID_LOG_WARN, XCLIPSE_LOG_TAG, __VA_ARGS__)
+#else
+// Host builds (tools, local testing) log to stderr instead
+#include <cstdio>
+#define XCLIPSE_LOGI(...) (std::fprintf(stderr, "xclipse940: " __VA_ARGS__), std::fputc('\n', stderr))
+#define XCLIPSE_LOGW(...) (std::fprintf(stderr, "xclipse940 warning: " __VA_ARGS__), std::fputc('\n', stderr))
+#endif
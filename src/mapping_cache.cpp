@@ -0,0 +1,71 @@
+// mapping_cache.cpp - Keeps host-visible device memory mapped for its lifetime
+
+#include "mapping_cache.h"
+
+#include "log.h"
+
+PersistentMappingCache::PersistentMappingCache(
+    VkDevice device, const DeviceDispatch& dispatch,
+    const VkPhysicalDeviceMemoryProperties& memory_properties)
+    : device_(device),
+      map_memory_(dispatch.MapMemory) {
+    for (uint32_t type = 0; type < memory_properties.memoryTypeCount; ++type) {
+        if (memory_properties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            host_visible_types_ |= 1u << type;
+        }
+    }
+}
+
+void PersistentMappingCache::OnAllocate(VkDeviceMemory memory, uint32_t memory_type) {
+    if (memory_type >= 32 || !(host_visible_types_ & (1u << memory_type))) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    mappings_[memory] = nullptr;
+}
+
+void PersistentMappingCache::OnFree(VkDeviceMemory memory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mappings_.erase(memory);
+}
+
+bool PersistentMappingCache::Map(VkDeviceMemory memory, VkDeviceSize offset, void** data,
+                                 VkResult& result) {
+    void** mapping = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = mappings_.find(memory);
+        if (it == mappings_.end()) {
+            return false;
+        }
+        // Nodes never move, and nobody else touches this entry until the
+        // app is done with memory
+        mapping = &it->second;
+    }
+
+    if (*mapping) {
+        cached_maps_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        result = map_memory_(device_, memory, 0, VK_WHOLE_SIZE, 0, mapping);
+        if (result != VK_SUCCESS) {
+            *mapping = nullptr;
+            return true;
+        }
+        driver_maps_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    *data = static_cast<uint8_t*>(*mapping) + offset;
+    result = VK_SUCCESS;
+    return true;
+}
+
+bool PersistentMappingCache::Unmap(VkDeviceMemory memory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mappings_.count(memory) != 0;
+}
+
+void PersistentMappingCache::LogStats() const {
+    XCLIPSE_LOGI("persistent mappings: %llu maps served from cache, %llu driver maps",
+                 static_cast<unsigned long long>(cached_maps_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(driver_maps_.load(std::memory_order_relaxed)));
+}
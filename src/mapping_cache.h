@@ -0,0 +1,48 @@
+// mapping_cache.h - Keeps host-visible device memory mapped for its lifetime
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "dispatch.h"
+
+// D3D9/D3D11 titles under translation map and unmap the same memory every
+// frame, and each round-trip is a syscall in the driver. Host-visible
+// allocations are instead mapped whole on first use and stay mapped until
+// vkFreeMemory, which unmaps implicitly; vkUnmapMemory becomes a no-op.
+//
+// Map/unmap/free of one VkDeviceMemory are externally synchronized by the
+// app, so the driver call happens outside the lock.
+class PersistentMappingCache {
+public:
+    PersistentMappingCache(VkDevice device, const DeviceDispatch& dispatch,
+                           const VkPhysicalDeviceMemoryProperties& memory_properties);
+
+    PersistentMappingCache(const PersistentMappingCache&) = delete;
+    PersistentMappingCache& operator=(const PersistentMappingCache&) = delete;
+
+    // Only host-visible allocations are registered
+    void OnAllocate(VkDeviceMemory memory, uint32_t memory_type);
+    void OnFree(VkDeviceMemory memory);
+
+    // False if memory is not registered; the caller forwards to the driver
+    bool Map(VkDeviceMemory memory, VkDeviceSize offset, void** data, VkResult& result);
+    bool Unmap(VkDeviceMemory memory);
+
+    void LogStats() const;
+
+private:
+    VkDevice device_;
+    PFN_vkMapMemory map_memory_;
+    uint32_t host_visible_types_{0};  // bit per memory type
+
+    std::mutex mutex_;
+    std::unordered_map<VkDeviceMemory, void*> mappings_;  // null until first map
+
+    std::atomic<uint64_t> cached_maps_{0};
+    std::atomic<uint64_t> driver_maps_{0};
+};
@@ -0,0 +1,169 @@
+// memory_budget.cpp - Per-heap device memory usage and budget tracking
+
+#include "memory_budget.h"
+
+#include "clock.h"
+#include "log.h"
+
+MemoryBudgetTracker::MemoryBudgetTracker(VkPhysicalDevice physical_device,
+                                         const InstanceDispatch& dispatch,
+                                         const VkPhysicalDeviceMemoryProperties& memory_properties,
+                                         bool memory_budget_extension)
+    : physical_device_(physical_device),
+      memory_properties_(memory_properties) {
+    if (memory_budget_extension) {
+        get_memory_properties2_ = dispatch.GetPhysicalDeviceMemoryProperties2;
+    }
+
+    for (uint32_t heap = 0; heap < memory_properties_.memoryHeapCount; ++heap) {
+        heaps_[heap].budget.store(static_cast<VkDeviceSize>(
+            memory_properties_.memoryHeaps[heap].size * kFallbackBudgetFraction));
+    }
+    Poll();
+}
+
+void MemoryBudgetTracker::OnAllocate(VkDeviceMemory memory, uint32_t memory_type, VkDeviceSize size) {
+    if (memory_type >= memory_properties_.memoryTypeCount) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(allocations_mutex_);
+        allocations_[memory] = Allocation{memory_type, size};
+    }
+
+    uint32_t heap = HeapOfType(memory_type);
+    type_bytes_[memory_type].fetch_add(size, std::memory_order_relaxed);
+    type_allocations_[memory_type].fetch_add(1, std::memory_order_relaxed);
+    heaps_[heap].allocated.fetch_add(size, std::memory_order_relaxed);
+    UpdatePressure(heap);
+}
+
+void MemoryBudgetTracker::OnFree(VkDeviceMemory memory) {
+    Allocation allocation;
+    {
+        std::lock_guard<std::mutex> lock(allocations_mutex_);
+        auto it = allocations_.find(memory);
+        if (it == allocations_.end()) {
+            return;
+        }
+        allocation = it->second;
+        allocations_.erase(it);
+    }
+
+    uint32_t heap = HeapOfType(allocation.memory_type);
+    type_bytes_[allocation.memory_type].fetch_sub(allocation.size, std::memory_order_relaxed);
+    type_allocations_[allocation.memory_type].fetch_sub(1, std::memory_order_relaxed);
+    heaps_[heap].allocated.fetch_sub(allocation.size, std::memory_order_relaxed);
+    UpdatePressure(heap);
+}
+
+void MemoryBudgetTracker::OnFrameBoundary() {
+    uint64_t now = SteadyNanoseconds();
+    uint64_t deadline = next_poll_ns_.load(std::memory_order_relaxed);
+    if (now < deadline ||
+        !next_poll_ns_.compare_exchange_strong(deadline, now + kPollIntervalNs,
+                                               std::memory_order_relaxed)) {
+        return;
+    }
+    Poll();
+}
+
+void MemoryBudgetTracker::Poll() {
+    if (!get_memory_properties2_) {
+        // Nothing to learn from the driver; usage is just what we allocated
+        for (uint32_t heap = 0; heap < memory_properties_.memoryHeapCount; ++heap) {
+            UpdatePressure(heap);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(poll_mutex_);
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+    VkPhysicalDeviceMemoryProperties2 properties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+    properties.pNext = &budget;
+
+    // Snapshot our totals first so allocations racing the query are
+    // counted by the extrapolation rather than lost
+    VkDeviceSize allocated[VK_MAX_MEMORY_HEAPS];
+    for (uint32_t heap = 0; heap < memory_properties_.memoryHeapCount; ++heap) {
+        allocated[heap] = heaps_[heap].allocated.load(std::memory_order_relaxed);
+    }
+
+    get_memory_properties2_(physical_device_, &properties);
+
+    for (uint32_t heap = 0; heap < memory_properties_.memoryHeapCount; ++heap) {
+        HeapState& state = heaps_[heap];
+        state.allocated_at_poll.store(allocated[heap], std::memory_order_relaxed);
+        state.polled_usage.store(budget.heapUsage[heap], std::memory_order_relaxed);
+        if (budget.heapBudget[heap]) {
+            state.budget.store(budget.heapBudget[heap], std::memory_order_relaxed);
+        }
+        UpdatePressure(heap);
+    }
+}
+
+HeapBudget MemoryBudgetTracker::Heap(uint32_t heap) const {
+    const HeapState& state = heaps_[heap];
+
+    HeapBudget result;
+    result.budget = state.budget.load(std::memory_order_relaxed);
+    result.allocated = state.allocated.load(std::memory_order_relaxed);
+    if (get_memory_properties2_) {
+        VkDeviceSize at_poll = state.allocated_at_poll.load(std::memory_order_relaxed);
+        VkDeviceSize polled = state.polled_usage.load(std::memory_order_relaxed);
+        // Shift the driver's figure by what we allocated or freed since
+        int64_t usage = static_cast<int64_t>(polled) +
+                        (static_cast<int64_t>(result.allocated) - static_cast<int64_t>(at_poll));
+        result.usage = usage > 0 ? static_cast<VkDeviceSize>(usage) : 0;
+    } else {
+        result.usage = result.allocated;
+    }
+    return result;
+}
+
+VkDeviceSize MemoryBudgetTracker::Headroom(uint32_t heap) const {
+    HeapBudget budget = Heap(heap);
+    return budget.usage < budget.budget ? budget.budget - budget.usage : 0;
+}
+
+bool MemoryBudgetTracker::UnderPressure(uint32_t heap) const {
+    return heaps_[heap].under_pressure.load(std::memory_order_relaxed);
+}
+
+void MemoryBudgetTracker::UpdatePressure(uint32_t heap) {
+    HeapBudget budget = Heap(heap);
+    bool pressure = budget.usage + static_cast<VkDeviceSize>(budget.budget * kPressureFraction) >
+                    budget.budget;
+
+    // Only log transitions, not every allocation made while tight
+    if (heaps_[heap].under_pressure.exchange(pressure, std::memory_order_relaxed) != pressure) {
+        XCLIPSE_LOGW("heap %u %s memory pressure: usage %llu MiB of %llu MiB budget", heap,
+                     pressure ? "entered" : "left",
+                     static_cast<unsigned long long>(budget.usage >> 20),
+                     static_cast<unsigned long long>(budget.budget >> 20));
+    }
+}
+
+void MemoryBudgetTracker::LogStats() const {
+    for (uint32_t heap = 0; heap < memory_properties_.memoryHeapCount; ++heap) {
+        HeapBudget budget = Heap(heap);
+        XCLIPSE_LOGI("heap %u: allocated=%llu MiB usage=%llu MiB budget=%llu MiB headroom=%llu MiB%s",
+                     heap,
+                     static_cast<unsigned long long>(budget.allocated >> 20),
+                     static_cast<unsigned long long>(budget.usage >> 20),
+                     static_cast<unsigned long long>(budget.budget >> 20),
+                     static_cast<unsigned long long>(Headroom(heap) >> 20),
+                     get_memory_properties2_ ? "" : " (estimated, no VK_EXT_memory_budget)");
+    }
+    for (uint32_t type = 0; type < memory_properties_.memoryTypeCount; ++type) {
+        uint32_t count = type_allocations_[type].load(std::memory_order_relaxed);
+        if (count) {
+            XCLIPSE_LOGI("memory type %u (heap %u): %u allocations, %llu KiB", type,
+                         HeapOfType(type), count,
+                         static_cast<unsigned long long>(
+                             type_bytes_[type].load(std::memory_order_relaxed) >> 10));
+        }
+    }
+}
@@ -0,0 +1,90 @@
+// memory_budget.h - Per-heap device memory usage and budget tracking
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "dispatch.h"
+
+struct HeapBudget {
+    VkDeviceSize budget{0};
+    VkDeviceSize usage{0};      // best estimate, including our allocations since the last poll
+    VkDeviceSize allocated{0};  // bytes this device holds in driver allocations
+};
+
+// On a UMA phone the GPU shares RAM with Wine, and running out ends in a
+// low-memory kill rather than VK_ERROR_OUT_OF_DEVICE_MEMORY. This tracks
+// every driver allocation the device makes (app passthrough and layer
+// blocks alike) and, when VK_EXT_memory_budget is available, re-reads the
+// driver's budget at frame boundaries. Between polls usage is extrapolated
+// from our own allocations, the same way VMA does it.
+class MemoryBudgetTracker {
+public:
+    MemoryBudgetTracker(VkPhysicalDevice physical_device, const InstanceDispatch& dispatch,
+                        const VkPhysicalDeviceMemoryProperties& memory_properties,
+                        bool memory_budget_extension);
+
+    MemoryBudgetTracker(const MemoryBudgetTracker&) = delete;
+    MemoryBudgetTracker& operator=(const MemoryBudgetTracker&) = delete;
+
+    void OnAllocate(VkDeviceMemory memory, uint32_t memory_type, VkDeviceSize size);
+    void OnFree(VkDeviceMemory memory);
+
+    // Cheap to call every present; polls the driver at most every kPollInterval
+    void OnFrameBoundary();
+
+    uint32_t HeapOfType(uint32_t memory_type) const {
+        return memory_properties_.memoryTypes[memory_type].heapIndex;
+    }
+
+    HeapBudget Heap(uint32_t heap) const;
+
+    // Bytes that can still be allocated from heap before hitting its budget
+    VkDeviceSize Headroom(uint32_t heap) const;
+
+    // Less than kPressureFraction of the heap's budget left
+    bool UnderPressure(uint32_t heap) const;
+
+    void LogStats() const;
+
+private:
+    static constexpr uint64_t kPollIntervalNs = 250ull * 1000 * 1000;
+    static constexpr double kPressureFraction = 0.10;
+    // Without the extension, assume 80% of the heap is ours to use
+    static constexpr double kFallbackBudgetFraction = 0.80;
+
+    struct HeapState {
+        std::atomic<VkDeviceSize> allocated{0};
+        std::atomic<VkDeviceSize> budget{0};
+        // Driver-reported usage and our own total at the last poll
+        std::atomic<VkDeviceSize> polled_usage{0};
+        std::atomic<VkDeviceSize> allocated_at_poll{0};
+        std::atomic<bool> under_pressure{false};
+    };
+
+    struct Allocation {
+        uint32_t memory_type;
+        VkDeviceSize size;
+    };
+
+    void Poll();
+    void UpdatePressure(uint32_t heap);
+
+    VkPhysicalDevice physical_device_;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 get_memory_properties2_{nullptr};
+    VkPhysicalDeviceMemoryProperties memory_properties_;
+
+    HeapState heaps_[VK_MAX_MEMORY_HEAPS];
+    std::atomic<VkDeviceSize> type_bytes_[VK_MAX_MEMORY_TYPES]{};
+    std::atomic<uint32_t> type_allocations_[VK_MAX_MEMORY_TYPES]{};
+
+    std::mutex allocations_mutex_;
+    std::unordered_map<VkDeviceMemory, Allocation> allocations_;
+
+    std::mutex poll_mutex_;
+    std::atomic<uint64_t> next_poll_ns_{0};
+};
@@ -0,0 +1,331 @@
+// memory_suballocator.cpp - Opt-in suballocation of small vkAllocateMemory requests
+
+#include "memory_suballocator.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "log.h"
+
+// Buddy allocator over one driver allocation. Order o covers blocks of
+// min_size << o bytes; a free bitmap per order is the source of truth and
+// the per-order free lists may hold stale entries, skipped on pop, so that
+// merging never has to search a list.
+class BuddyBlock {
+public:
+    BuddyBlock(VkDeviceMemory memory, uint32_t min_size_log2, uint32_t max_order)
+        : memory_(memory),
+          min_size_log2_(min_size_log2),
+          max_order_(max_order),
+          free_bits_(max_order + 1),
+          free_lists_(max_order + 1),
+          free_counts_(max_order + 1) {
+        for (uint32_t order = 0; order <= max_order_; ++order) {
+            free_bits_[order].resize(((1ull << (max_order_ - order)) + 63) / 64);
+        }
+        MarkFree(max_order_, 0);
+    }
+
+    VkDeviceMemory memory() const { return memory_; }
+    bool empty() const { return free_counts_[max_order_] == 1; }
+
+    bool Allocate(uint32_t order, VkDeviceSize& offset) {
+        uint32_t found = order;
+        while (found <= max_order_ && free_counts_[found] == 0) {
+            ++found;
+        }
+        if (found > max_order_) {
+            return false;
+        }
+
+        uint64_t index = PopFree(found);
+        // Split down, leaving the upper half of each split free
+        while (found > order) {
+            --found;
+            index *= 2;
+            MarkFree(found, index + 1);
+        }
+
+        offset = index << (min_size_log2_ + order);
+        return true;
+    }
+
+    void Free(VkDeviceSize offset, uint32_t order) {
+        uint64_t index = offset >> (min_size_log2_ + order);
+        while (order < max_order_ && IsFree(order, index ^ 1)) {
+            ClearFree(order, index ^ 1);
+            index >>= 1;
+            ++order;
+        }
+        MarkFree(order, index);
+    }
+
+    VkDeviceSize free_bytes() const {
+        VkDeviceSize bytes = 0;
+        for (uint32_t order = 0; order <= max_order_; ++order) {
+            bytes += static_cast<VkDeviceSize>(free_counts_[order]) << (min_size_log2_ + order);
+        }
+        return bytes;
+    }
+
+    VkDeviceSize largest_free() const {
+        for (uint32_t order = max_order_ + 1; order-- > 0;) {
+            if (free_counts_[order]) {
+                return VkDeviceSize(1) << (min_size_log2_ + order);
+            }
+        }
+        return 0;
+    }
+
+    // Block-wide mapping shared by every suballocation, kept until the
+    // block is freed; guarded by the suballocator's mutex
+    void* mapped_data{nullptr};
+
+private:
+    bool IsFree(uint32_t order, uint64_t index) const {
+        return (free_bits_[order][index / 64] >> (index % 64)) & 1;
+    }
+
+    void MarkFree(uint32_t order, uint64_t index) {
+        free_bits_[order][index / 64] |= 1ull << (index % 64);
+        free_counts_[order]++;
+        free_lists_[order].push_back(static_cast<uint32_t>(index));
+
+        // Stale entries pile up when blocks keep merging; rebuild from the bitmap
+        std::vector<uint32_t>& list = free_lists_[order];
+        if (list.size() > 2 * static_cast<size_t>(free_counts_[order]) + 32) {
+            list.clear();
+            for (size_t word = 0; word < free_bits_[order].size(); ++word) {
+                for (uint64_t bits = free_bits_[order][word]; bits; bits &= bits - 1) {
+                    list.push_back(static_cast<uint32_t>(word * 64 + std::countr_zero(bits)));
+                }
+            }
+        }
+    }
+
+    void ClearFree(uint32_t order, uint64_t index) {
+        free_bits_[order][index / 64] &= ~(1ull << (index % 64));
+        free_counts_[order]--;
+    }
+
+    uint64_t PopFree(uint32_t order) {
+        std::vector<uint32_t>& list = free_lists_[order];
+        for (;;) {
+            uint64_t index = list.back();
+            list.pop_back();
+            if (IsFree(order, index)) {
+                ClearFree(order, index);
+                return index;
+            }
+        }
+    }
+
+    VkDeviceMemory memory_;
+    uint32_t min_size_log2_;
+    uint32_t max_order_;
+    std::vector<std::vector<uint64_t>> free_bits_;
+    std::vector<std::vector<uint32_t>> free_lists_;
+    std::vector<uint32_t> free_counts_;
+};
+
+DeviceMemorySuballocator::DeviceMemorySuballocator(
+    VkDevice device, const DeviceDispatch& dispatch,
+    const VkPhysicalDeviceProperties& properties,
+    const VkPhysicalDeviceMemoryProperties& memory_properties,
+    MemoryBudgetTracker& budget)
+    : device_(device),
+      budget_(budget),
+      allocate_memory_(dispatch.AllocateMemory),
+      free_memory_(dispatch.FreeMemory),
+      map_memory_(dispatch.MapMemory),
+      memory_type_count_(memory_properties.memoryTypeCount) {
+
+    VkDeviceSize min_size = std::max<VkDeviceSize>({256, properties.limits.bufferImageGranularity,
+                                                    properties.limits.nonCoherentAtomSize});
+    min_size_log2_ = static_cast<uint32_t>(std::bit_width(std::bit_ceil(min_size)) - 1);
+
+    for (uint32_t type = 0; type < memory_type_count_; ++type) {
+        const VkMemoryType& memory_type = memory_properties.memoryTypes[type];
+        if (memory_type.propertyFlags &
+            (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT)) {
+            continue;
+        }
+        // Small heaps get smaller blocks so one block never hogs them
+        VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_type.heapIndex].size;
+        VkDeviceSize block_size = std::min(kBlockSize, std::bit_floor(heap_size / 16));
+        if (block_size >= (VkDeviceSize(4) << min_size_log2_)) {
+            pools_[type].block_size = block_size;
+        }
+    }
+}
+
+DeviceMemorySuballocator::~DeviceMemorySuballocator() {
+    for (const Suballocation* allocation : live_) {
+        delete allocation;
+    }
+    for (uint32_t type = 0; type < memory_type_count_; ++type) {
+        for (std::unique_ptr<BuddyBlock>& block : pools_[type].blocks) {
+            budget_.OnFree(block->memory());
+            free_memory_(device_, block->memory(), nullptr);
+        }
+    }
+}
+
+bool DeviceMemorySuballocator::TryAllocate(const VkMemoryAllocateInfo& info, VkDeviceMemory* memory) {
+    // Anything chained (dedicated, export/import, device address, priority)
+    // needs a real allocation of its own
+    if (info.pNext || info.memoryTypeIndex >= memory_type_count_ || info.allocationSize == 0) {
+        return false;
+    }
+
+    MemoryTypePool& pool = pools_[info.memoryTypeIndex];
+    if (info.allocationSize > std::min(kMaxSuballocationSize, pool.block_size / 4)) {
+        return false;
+    }
+
+    uint32_t size_log2 = static_cast<uint32_t>(std::bit_width(std::bit_ceil(info.allocationSize)) - 1);
+    uint32_t order = size_log2 > min_size_log2_ ? size_log2 - min_size_log2_ : 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    BuddyBlock* block = nullptr;
+    VkDeviceSize offset = 0;
+    for (std::unique_ptr<BuddyBlock>& candidate : pool.blocks) {
+        if (candidate->Allocate(order, offset)) {
+            block = candidate.get();
+            break;
+        }
+    }
+    if (!block) {
+        block = CreateBlock(info.memoryTypeIndex);
+        if (!block || !block->Allocate(order, offset)) {
+            return false;
+        }
+    }
+
+    auto* allocation = new Suballocation{};
+    allocation->memory = block->memory();
+    allocation->offset = offset;
+    allocation->size = VkDeviceSize(1) << (min_size_log2_ + order);
+    allocation->requested = info.allocationSize;
+    allocation->memory_type = info.memoryTypeIndex;
+    allocation->order = order;
+    allocation->block = block;
+    live_.insert(allocation);
+
+    pool.requested_bytes += allocation->requested;
+    pool.used_bytes += allocation->size;
+    pool.live_allocations++;
+
+    *memory = reinterpret_cast<VkDeviceMemory>(allocation);
+    return true;
+}
+
+Suballocation* DeviceMemorySuballocator::Find(VkDeviceMemory memory) {
+    auto* allocation = reinterpret_cast<Suballocation*>(memory);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return live_.count(allocation) ? allocation : nullptr;
+}
+
+void DeviceMemorySuballocator::Free(Suballocation* allocation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    MemoryTypePool& pool = pools_[allocation->memory_type];
+    pool.requested_bytes -= allocation->requested;
+    pool.used_bytes -= allocation->size;
+    pool.live_allocations--;
+
+    uint32_t allocation_type = allocation->memory_type;
+    BuddyBlock* block = allocation->block;
+    block->Free(allocation->offset, allocation->order);
+    live_.erase(allocation);
+    delete allocation;
+
+    if (block->empty()) {
+        ReleaseBlock(allocation_type, block);
+    }
+}
+
+VkResult DeviceMemorySuballocator::Map(Suballocation* allocation, VkDeviceSize offset, void** data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    BuddyBlock* block = allocation->block;
+    if (!block->mapped_data) {
+        VkResult result = map_memory_(device_, block->memory(), 0, VK_WHOLE_SIZE, 0,
+                                      &block->mapped_data);
+        if (result != VK_SUCCESS) {
+            block->mapped_data = nullptr;
+            return result;
+        }
+    }
+
+    *data = static_cast<uint8_t*>(block->mapped_data) + allocation->offset + offset;
+    return VK_SUCCESS;
+}
+
+BuddyBlock* DeviceMemorySuballocator::CreateBlock(uint32_t memory_type) {
+    MemoryTypePool& pool = pools_[memory_type];
+
+    VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    info.allocationSize = pool.block_size;
+    info.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (allocate_memory_(device_, &info, nullptr, &memory) != VK_SUCCESS) {
+        return nullptr;
+    }
+    budget_.OnAllocate(memory, memory_type, pool.block_size);
+
+    uint32_t block_log2 = static_cast<uint32_t>(std::bit_width(pool.block_size) - 1);
+    pool.blocks.push_back(std::make_unique<BuddyBlock>(memory, min_size_log2_,
+                                                       block_log2 - min_size_log2_));
+    return pool.blocks.back().get();
+}
+
+void DeviceMemorySuballocator::ReleaseBlock(uint32_t memory_type, BuddyBlock* block) {
+    MemoryTypePool& pool = pools_[memory_type];
+
+    // Keep one empty block per type so alloc/free churn never hits the
+    // driver, unless the heap is short on memory
+    size_t empty_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+                                        [](const std::unique_ptr<BuddyBlock>& b) { return b->empty(); });
+    if (empty_blocks < 2 && !budget_.UnderPressure(budget_.HeapOfType(memory_type))) {
+        return;
+    }
+
+    auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(),
+                           [block](const std::unique_ptr<BuddyBlock>& b) { return b.get() == block; });
+    budget_.OnFree(block->memory());
+    free_memory_(device_, block->memory(), nullptr);
+    pool.blocks.erase(it);
+}
+
+void DeviceMemorySuballocator::LogStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t type = 0; type < memory_type_count_; ++type) {
+        const MemoryTypePool& pool = pools_[type];
+        if (pool.blocks.empty()) {
+            continue;
+        }
+
+        VkDeviceSize free_bytes = 0;
+        VkDeviceSize largest_free = 0;
+        for (const std::unique_ptr<BuddyBlock>& block : pool.blocks) {
+            free_bytes += block->free_bytes();
+            largest_free = std::max(largest_free, block->largest_free());
+        }
+        // Share of free space unusable for the largest possible request
+        double fragmentation = free_bytes ? 1.0 - double(largest_free) / double(free_bytes) : 0.0;
+
+        XCLIPSE_LOGI("memory type %u: %zu blocks x %llu KiB, %llu live, requested=%llu KiB "
+                     "used=%llu KiB free=%llu KiB largest free=%llu KiB fragmentation=%.1f%%",
+                     type, pool.blocks.size(),
+                     static_cast<unsigned long long>(pool.block_size >> 10),
+                     static_cast<unsigned long long>(pool.live_allocations),
+                     static_cast<unsigned long long>(pool.requested_bytes >> 10),
+                     static_cast<unsigned long long>(pool.used_bytes >> 10),
+                     static_cast<unsigned long long>(free_bytes >> 10),
+                     static_cast<unsigned long long>(largest_free >> 10),
+                     fragmentation * 100.0);
+    }
+}
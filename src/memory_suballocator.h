@@ -0,0 +1,93 @@
+// memory_suballocator.h - Opt-in suballocation of small vkAllocateMemory requests
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "dispatch.h"
+#include "memory_budget.h"
+
+class BuddyBlock;
+
+// One app-visible VkDeviceMemory living inside a larger driver allocation.
+// The app's handle is the address of this struct.
+struct Suballocation {
+    VkDeviceMemory memory;     // driver allocation it lives in
+    VkDeviceSize offset;       // within memory, aligned to size
+    VkDeviceSize size;         // buddy block size, >= requested
+    VkDeviceSize requested;
+    uint32_t memory_type;
+    uint32_t order;
+    BuddyBlock* block;
+};
+
+// Older titles under translation make thousands of tiny allocations, which
+// costs a kernel round-trip each and runs into maxMemoryAllocationCount.
+// Small, plain requests (no pNext chain) are instead carved out of large
+// per-memory-type blocks with a buddy allocator. Buddy blocks are aligned
+// to their own power-of-two size, which covers any resource alignment up
+// to the allocation size and keeps neighbours on separate
+// bufferImageGranularity and nonCoherentAtomSize boundaries.
+//
+// Every entry point taking a VkDeviceMemory must translate through Find().
+class DeviceMemorySuballocator {
+public:
+    // Blocks are reported to budget, which must outlive the suballocator
+    DeviceMemorySuballocator(VkDevice device, const DeviceDispatch& dispatch,
+                             const VkPhysicalDeviceProperties& properties,
+                             const VkPhysicalDeviceMemoryProperties& memory_properties,
+                             MemoryBudgetTracker& budget);
+    ~DeviceMemorySuballocator();
+
+    DeviceMemorySuballocator(const DeviceMemorySuballocator&) = delete;
+    DeviceMemorySuballocator& operator=(const DeviceMemorySuballocator&) = delete;
+
+    // False if the request is not eligible or no block could be created;
+    // the caller then forwards it to the driver unchanged.
+    bool TryAllocate(const VkMemoryAllocateInfo& info, VkDeviceMemory* memory);
+
+    // nullptr for handles the driver created
+    Suballocation* Find(VkDeviceMemory memory);
+
+    void Free(Suballocation* allocation);
+
+    // The containing block is mapped once, shared by its suballocations and
+    // left mapped until it is freed, so there is no Unmap
+    VkResult Map(Suballocation* allocation, VkDeviceSize offset, void** data);
+
+    // Per memory type usage and fragmentation, to logcat
+    void LogStats();
+
+private:
+    static constexpr VkDeviceSize kBlockSize = 16ull << 20;
+    static constexpr VkDeviceSize kMaxSuballocationSize = 256ull << 10;
+
+    struct MemoryTypePool {
+        std::vector<std::unique_ptr<BuddyBlock>> blocks;
+        VkDeviceSize block_size{0};   // 0 when the type is never suballocated
+        VkDeviceSize requested_bytes{0};
+        VkDeviceSize used_bytes{0};
+        uint64_t live_allocations{0};
+    };
+
+    BuddyBlock* CreateBlock(uint32_t memory_type);
+    void ReleaseBlock(uint32_t memory_type, BuddyBlock* block);
+
+    VkDevice device_;
+    MemoryBudgetTracker& budget_;
+    PFN_vkAllocateMemory allocate_memory_;
+    PFN_vkFreeMemory free_memory_;
+    PFN_vkMapMemory map_memory_;
+
+    uint32_t min_size_log2_{8};
+    uint32_t memory_type_count_{0};
+
+    std::mutex mutex_;
+    MemoryTypePool pools_[VK_MAX_MEMORY_TYPES];
+    std::unordered_set<const Suballocation*> live_;
+};
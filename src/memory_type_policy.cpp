@@ -0,0 +1,165 @@
+// memory_type_policy.cpp - Remaps allocations to the fastest compatible memory type
+
+#include "memory_type_policy.h"
+
+#include <bit>
+
+#include "log.h"
+
+namespace {
+
+// First match wins. Only applied on UMA, where moving host memory onto a
+// device-local type costs no scarce VRAM.
+constexpr MemoryTypeRule kUmaRules[] = {
+    // Readback: keep the CPU cache, move onto the device-local alias
+    {"readback",
+     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+    // Upload and staging: write-combined device-local host memory
+    {"upload",
+     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT},
+    // DEVICE_LOCAL types are already the fastest the GPU has
+};
+
+// The last buffer or image requirements query made on this thread
+struct PendingQuery {
+    const MemoryTypePolicy* policy;
+    VkDeviceSize size;
+    uint32_t memory_type_bits;
+};
+
+thread_local PendingQuery t_pending_query{};
+
+bool IsUma(const VkPhysicalDeviceMemoryProperties& memory_properties) {
+    for (uint32_t heap = 0; heap < memory_properties.memoryHeapCount; ++heap) {
+        if (!(memory_properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+            return false;
+        }
+    }
+    return memory_properties.memoryHeapCount > 0;
+}
+
+// Chained structs that say nothing about where the memory must come from;
+// imports and exports pin the type and are never remapped
+bool IsRemappableChain(const void* next) {
+    for (auto* header = static_cast<const VkBaseInStructure*>(next); header; header = header->pNext) {
+        switch (header->sType) {
+        case VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO:
+        case VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO:
+        case VK_STRUCTURE_TYPE_MEMORY_PRIORITY_ALLOCATE_INFO_EXT:
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+MemoryTypePolicy::MemoryTypePolicy(const VkPhysicalDeviceMemoryProperties& memory_properties)
+    : memory_properties_(memory_properties) {
+    for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type) {
+        targets_[type] = type;
+    }
+    if (!IsUma(memory_properties_)) {
+        return;
+    }
+
+    for (uint32_t type = 0; type < memory_properties_.memoryTypeCount; ++type) {
+        VkMemoryPropertyFlags flags = memory_properties_.memoryTypes[type].propertyFlags;
+        if (flags & kSpecialFlags) {
+            continue;
+        }
+
+        for (const MemoryTypeRule& rule : kUmaRules) {
+            if ((flags & rule.match) != rule.match || (flags & rule.exclude)) {
+                continue;
+            }
+
+            // The closest superset wins; ties go to the lower index, which
+            // the driver lists first because it prefers it
+            VkMemoryPropertyFlags wanted = flags | rule.add;
+            int best_extra = 33;
+            for (uint32_t candidate = 0; candidate < memory_properties_.memoryTypeCount; ++candidate) {
+                VkMemoryPropertyFlags candidate_flags =
+                    memory_properties_.memoryTypes[candidate].propertyFlags;
+                if (candidate == type || (candidate_flags & kSpecialFlags) ||
+                    (candidate_flags & wanted) != wanted) {
+                    continue;
+                }
+                int extra = std::popcount(candidate_flags & ~wanted);
+                if (extra < best_extra) {
+                    best_extra = extra;
+                    targets_[type] = candidate;
+                    rules_[type] = &rule;
+                }
+            }
+            break;
+        }
+
+        if (rules_[type]) {
+            XCLIPSE_LOGI("memory type %u (flags 0x%x) -> %u (flags 0x%x): %s", type, flags,
+                         targets_[type],
+                         memory_properties_.memoryTypes[targets_[type]].propertyFlags,
+                         rules_[type]->name);
+        }
+    }
+}
+
+void MemoryTypePolicy::OnResourceRequirements(const VkMemoryRequirements& requirements) {
+    t_pending_query = PendingQuery{this, requirements.size, requirements.memoryTypeBits};
+}
+
+void MemoryTypePolicy::ForgetPendingQuery() {
+    t_pending_query = PendingQuery{};
+}
+
+uint32_t MemoryTypePolicy::Select(const VkMemoryAllocateInfo& info, const MemoryBudgetTracker& budget) {
+    PendingQuery query = t_pending_query;
+    t_pending_query = PendingQuery{};
+
+    uint32_t type = info.memoryTypeIndex;
+    if (type >= memory_properties_.memoryTypeCount || targets_[type] == type) {
+        return type;
+    }
+
+    // Only an allocation sized for the resource just queried is known to
+    // hold that resource and nothing else
+    if (query.policy != this || query.size != info.allocationSize ||
+        !(query.memory_type_bits & (1u << type))) {
+        unmatched_.fetch_add(1, std::memory_order_relaxed);
+        return type;
+    }
+
+    uint32_t target = targets_[type];
+    uint32_t target_heap = budget.HeapOfType(target);
+    bool safe = (query.memory_type_bits & (1u << target)) &&
+                IsRemappableChain(info.pNext) &&
+                budget.Headroom(target_heap) > info.allocationSize &&
+                !budget.UnderPressure(target_heap);
+    if (!safe) {
+        kept_.fetch_add(1, std::memory_order_relaxed);
+        return type;
+    }
+
+    remapped_[type].fetch_add(1, std::memory_order_relaxed);
+    return target;
+}
+
+void MemoryTypePolicy::LogStats() const {
+    for (uint32_t type = 0; type < memory_properties_.memoryTypeCount; ++type) {
+        uint64_t remapped = remapped_[type].load(std::memory_order_relaxed);
+        if (remapped) {
+            XCLIPSE_LOGI("memory type %u -> %u: %llu allocations remapped (%s)", type,
+                         targets_[type], static_cast<unsigned long long>(remapped),
+                         rules_[type]->name);
+        }
+    }
+    XCLIPSE_LOGI("memory type policy: %llu allocations kept their type, %llu more not matched to a query",
+                 static_cast<unsigned long long>(kept_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(unmatched_.load(std::memory_order_relaxed)));
+}
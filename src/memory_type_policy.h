@@ -0,0 +1,66 @@
+// memory_type_policy.h - Remaps allocations to the fastest compatible memory type
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+
+#include "memory_budget.h"
+
+// One row of the remap table: an app-chosen type with all of match and
+// none of exclude moves to the closest type that also has add.
+struct MemoryTypeRule {
+    const char* name;
+    VkMemoryPropertyFlags match;
+    VkMemoryPropertyFlags exclude;
+    VkMemoryPropertyFlags add;
+};
+
+// Apps written for discrete GPUs pick plain host memory for staging and
+// readback. On the Xclipse's UMA every heap is the same RAM, and the
+// device-local aliases of those types take the GPU's fast path. The remap
+// targets are precomputed from the memory properties at device creation.
+//
+// An allocation may only land in a type listed in the memoryTypeBits of
+// every resource later bound to it, which vkAllocateMemory cannot see. So
+// only the allocate-after-query pattern is remapped: an allocation made on
+// the same thread straight after a buffer or image requirements query,
+// with exactly the reported size, is for that resource, and moves only if
+// the target is in its memoryTypeBits. Block allocators that carve many
+// resources out of one allocation keep the type they asked for.
+class MemoryTypePolicy {
+public:
+    explicit MemoryTypePolicy(const VkPhysicalDeviceMemoryProperties& memory_properties);
+
+    MemoryTypePolicy(const MemoryTypePolicy&) = delete;
+    MemoryTypePolicy& operator=(const MemoryTypePolicy&) = delete;
+
+    // Called with the result of vkGet{Buffer,Image}MemoryRequirements*;
+    // remembered until this thread's next allocation or query
+    void OnResourceRequirements(const VkMemoryRequirements& requirements);
+
+    // A create-info query came in between: no resource to match against
+    void ForgetPendingQuery();
+
+    // The type to allocate info from; info.memoryTypeIndex when no rule
+    // applies or the remap is not known to be safe. Clears this thread's
+    // pending query.
+    uint32_t Select(const VkMemoryAllocateInfo& info, const MemoryBudgetTracker& budget);
+
+    void LogStats() const;
+
+private:
+    // Never remapped from or to: special-purpose or much slower memory
+    static constexpr VkMemoryPropertyFlags kSpecialFlags =
+        VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT |
+        VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD | VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD;
+
+    VkPhysicalDeviceMemoryProperties memory_properties_;
+    uint32_t targets_[VK_MAX_MEMORY_TYPES];          // == type when nothing applies
+    const MemoryTypeRule* rules_[VK_MAX_MEMORY_TYPES]{};
+
+    std::atomic<uint64_t> remapped_[VK_MAX_MEMORY_TYPES]{};
+    std::atomic<uint64_t> unmatched_{0};  // no requirements query for the allocation
+    std::atomic<uint64_t> kept_{0};
+};
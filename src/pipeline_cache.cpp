@@ -0,0 +1,215 @@
+// pipeline_cache.cpp - Layer-owned VkPipelineCache persisted across launches
+
+#include "pipeline_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+constexpr uint32_t kCacheFileMagic = 0x43504358;  // "XCPC"
+constexpr uint32_t kCacheFileVersion = 1;
+constexpr auto kSaveInterval = std::chrono::seconds(20);
+
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t pipeline_cache_uuid[VK_UUID_SIZE];
+    uint32_t reserved;
+    uint64_t data_size;
+    uint64_t data_hash;  // catches truncated or torn files before the driver sees them
+};
+
+// One file per process and GPU: <process>.<vendor>-<device>-<uuid>.xcpc.
+// A blob from another device or driver build would only be discarded at
+// load, and sharing a name made two devices overwrite each other's cache.
+std::string CacheFileName(const VkPhysicalDeviceProperties& properties) {
+    char id[2 * 8 + 2 * VK_UUID_SIZE + 3];
+    int length = std::snprintf(id, sizeof(id), "%04x-%04x-", properties.vendorID, properties.deviceID);
+    for (uint32_t i = 0; i < VK_UUID_SIZE && length > 0; ++i) {
+        length += std::snprintf(id + length, sizeof(id) - length, "%02x", properties.pipelineCacheUUID[i]);
+    }
+    return GetProcessName() + "." + id + ".xcpc";
+}
+
+uint64_t HashData(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+} // namespace
+
+std::unique_ptr<PersistentPipelineCache> PersistentPipelineCache::Create(
+    VkDevice device,
+    const DeviceDispatch& dispatch,
+    const VkPhysicalDeviceProperties& properties) {
+
+    if (!dispatch.CreatePipelineCache || !dispatch.DestroyPipelineCache ||
+        !dispatch.GetPipelineCacheData) {
+        return nullptr;
+    }
+
+    std::string directory = GetLayerDataDirectory();
+    if (directory.empty()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<PersistentPipelineCache> cache(new PersistentPipelineCache());
+    cache->device_ = device;
+    cache->destroy_pipeline_cache_ = dispatch.DestroyPipelineCache;
+    cache->get_pipeline_cache_data_ = dispatch.GetPipelineCacheData;
+    cache->path_ = directory + "/" + CacheFileName(properties);
+    cache->vendor_id_ = properties.vendorID;
+    cache->device_id_ = properties.deviceID;
+    cache->driver_version_ = properties.driverVersion;
+    std::memcpy(cache->pipeline_cache_uuid_, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // Seed from disk; the mapping only has to live until the driver copies it
+    const void* initial_data = nullptr;
+    size_t initial_size = 0;
+    void* mapping = MAP_FAILED;
+    size_t mapping_size = 0;
+
+    int fd = open(cache->path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > sizeof(CacheFileHeader)) {
+            mapping_size = static_cast<size_t>(st.st_size);
+            mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    if (mapping != MAP_FAILED) {
+        const auto* header = static_cast<const CacheFileHeader*>(mapping);
+        const auto* data = static_cast<const uint8_t*>(mapping) + sizeof(CacheFileHeader);
+        bool valid = header->magic == kCacheFileMagic &&
+                     header->version == kCacheFileVersion &&
+                     header->vendor_id == properties.vendorID &&
+                     header->device_id == properties.deviceID &&
+                     header->driver_version == properties.driverVersion &&
+                     std::memcmp(header->pipeline_cache_uuid, properties.pipelineCacheUUID,
+                                 VK_UUID_SIZE) == 0 &&
+                     header->data_size == mapping_size - sizeof(CacheFileHeader) &&
+                     header->data_hash == HashData(data, header->data_size);
+        if (valid) {
+            initial_data = data;
+            initial_size = header->data_size;
+        } else {
+            XCLIPSE_LOGW("discarding stale pipeline cache %s", cache->path_.c_str());
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    create_info.initialDataSize = initial_size;
+    create_info.pInitialData = initial_data;
+    VkResult result = dispatch.CreatePipelineCache(device, &create_info, nullptr, &cache->cache_);
+    if (result != VK_SUCCESS && initial_size) {
+        // The driver rejected the blob; start empty rather than go without
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        initial_size = 0;
+        result = dispatch.CreatePipelineCache(device, &create_info, nullptr, &cache->cache_);
+    }
+
+    if (mapping != MAP_FAILED) {
+        munmap(mapping, mapping_size);
+    }
+
+    if (result != VK_SUCCESS) {
+        cache->cache_ = VK_NULL_HANDLE;
+        return nullptr;
+    }
+
+    XCLIPSE_LOGI("pipeline cache %s: loaded %zu bytes", cache->path_.c_str(), initial_size);
+    cache->saved_size_ = initial_size;
+    cache->saver_ = std::thread(&PersistentPipelineCache::SaverLoop, cache.get());
+    return cache;
+}
+
+PersistentPipelineCache::~PersistentPipelineCache() {
+    if (saver_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(saver_mutex_);
+            stop_saver_ = true;
+        }
+        saver_cv_.notify_one();
+        saver_.join();
+    }
+
+    if (cache_ != VK_NULL_HANDLE) {
+        Save();
+        destroy_pipeline_cache_(device_, cache_, nullptr);
+    }
+}
+
+void PersistentPipelineCache::SaverLoop() {
+    std::unique_lock<std::mutex> lock(saver_mutex_);
+    while (!saver_cv_.wait_for(lock, kSaveInterval, [this] { return stop_saver_; })) {
+        lock.unlock();
+        Save();
+        lock.lock();
+    }
+}
+
+void PersistentPipelineCache::Save() {
+    // Only the saver thread and the destructor (after joining it) get here
+    uint64_t generation = dirty_generation_.load(std::memory_order_relaxed);
+    if (generation == saved_generation_) {
+        return;
+    }
+
+    size_t size = 0;
+    if (get_pipeline_cache_data_(device_, cache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+
+    // Creating a pipeline that was already cached does not grow the blob
+    if (size == saved_size_) {
+        saved_generation_ = generation;
+        return;
+    }
+
+    std::vector<uint8_t> file(sizeof(CacheFileHeader) + size);
+    if (get_pipeline_cache_data_(device_, cache_, &size,
+                                 file.data() + sizeof(CacheFileHeader)) != VK_SUCCESS) {
+        return;
+    }
+    file.resize(sizeof(CacheFileHeader) + size);
+
+    CacheFileHeader header{};
+    header.magic = kCacheFileMagic;
+    header.version = kCacheFileVersion;
+    header.vendor_id = vendor_id_;
+    header.device_id = device_id_;
+    header.driver_version = driver_version_;
+    std::memcpy(header.pipeline_cache_uuid, pipeline_cache_uuid_, VK_UUID_SIZE);
+    header.data_size = size;
+    header.data_hash = HashData(file.data() + sizeof(CacheFileHeader), size);
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    std::string_view contents(reinterpret_cast<const char*>(file.data()), file.size());
+    if (!WriteFileAtomically(path_, contents)) {
+        return;
+    }
+
+    saved_generation_ = generation;
+    saved_size_ = size;
+}
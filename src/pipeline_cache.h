@@ -0,0 +1,65 @@
+// pipeline_cache.h - Layer-owned VkPipelineCache persisted across launches
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "dispatch.h"
+
+// Translated D3D titles usually pass VK_NULL_HANDLE as their pipeline cache,
+// so every launch recompiles everything. This cache is substituted for them:
+// it is seeded from a memory-mapped file at device creation, validated
+// against the device's pipelineCacheUUID, and written back by a background
+// thread whenever new pipelines have been compiled into it.
+class PersistentPipelineCache {
+public:
+    // Returns nullptr if no cache directory is available or the driver
+    // refuses to create a cache.
+    static std::unique_ptr<PersistentPipelineCache> Create(
+        VkDevice device,
+        const DeviceDispatch& dispatch,
+        const VkPhysicalDeviceProperties& properties);
+
+    ~PersistentPipelineCache();
+
+    PersistentPipelineCache(const PersistentPipelineCache&) = delete;
+    PersistentPipelineCache& operator=(const PersistentPipelineCache&) = delete;
+
+    VkPipelineCache handle() const { return cache_; }
+
+    // Called after pipelines were compiled through handle()
+    void MarkDirty() { dirty_generation_.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    PersistentPipelineCache() = default;
+
+    void Save();
+    void SaverLoop();
+
+    VkDevice device_{VK_NULL_HANDLE};
+    PFN_vkDestroyPipelineCache destroy_pipeline_cache_{nullptr};
+    PFN_vkGetPipelineCacheData get_pipeline_cache_data_{nullptr};
+    VkPipelineCache cache_{VK_NULL_HANDLE};
+
+    std::string path_;
+    uint32_t vendor_id_{0};
+    uint32_t device_id_{0};
+    uint32_t driver_version_{0};
+    uint8_t pipeline_cache_uuid_[VK_UUID_SIZE]{};
+
+    std::atomic<uint64_t> dirty_generation_{0};
+    uint64_t saved_generation_{0};
+    size_t saved_size_{0};
+
+    std::mutex saver_mutex_;
+    std::condition_variable saver_cv_;
+    bool stop_saver_{false};
+    std::thread saver_;
+};
@@ -0,0 +1,174 @@
+// pipeline_registry.h - Concurrent per-device pipeline metadata store
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+struct PipelineRegistryStats {
+    uint64_t live{0};
+    uint64_t created{0};
+    uint64_t destroyed{0};
+    uint64_t replaced{0};      // handle re-registered without a destroy in between
+    size_t memory_bytes{0};    // estimated resident size of the registry
+};
+
+// The live pipeline handles of a device, for the lifecycle counts logged
+// at vkDestroyDevice. Handles are spread over independently locked shards so that
+// DXVK/vkd3d-proton compile threads registering pipelines at the same time
+// almost never contend. Each shard sits on its own cache line (the Exynos
+// 2400 cores use 64-byte lines) so neighbouring locks never false-share.
+//
+// A shard stores its entries inline in one open-addressed array instead of
+// a node per pipeline, so once a shard has grown to the game's working set,
+// creating and destroying pipelines never touches the heap.
+class PipelineRegistry {
+public:
+    static constexpr size_t kShardCount = 64;
+    static constexpr size_t kCacheLineSize = 64;
+
+    PipelineRegistry() = default;
+
+    PipelineRegistry(const PipelineRegistry&) = delete;
+    PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+    void Insert(VkPipeline pipeline) {
+        Shard& shard = ShardFor(pipeline);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.created++;
+        if (shard.pipelines.Find(pipeline)) {
+            // The driver recycled a handle we never saw destroyed; the old
+            // entry is stale
+            shard.replaced++;
+        } else {
+            shard.pipelines.Insert(pipeline);
+        }
+    }
+
+    bool Erase(VkPipeline pipeline) {
+        Shard& shard = ShardFor(pipeline);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (!shard.pipelines.Erase(pipeline)) {
+            return false;
+        }
+        shard.destroyed++;
+        return true;
+    }
+
+    PipelineRegistryStats Stats() {
+        PipelineRegistryStats stats;
+        stats.memory_bytes = sizeof(*this);
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            stats.live += shard.pipelines.size();
+            stats.created += shard.created;
+            stats.destroyed += shard.destroyed;
+            stats.replaced += shard.replaced;
+            stats.memory_bytes += shard.pipelines.capacity() * sizeof(VkPipeline);
+        }
+        return stats;
+    }
+
+private:
+    // Linear probing keyed on the pipeline handle, VK_NULL_HANDLE marking a
+    // free slot. At most half full, and erasing shifts later entries back
+    // instead of leaving tombstones, so probes stay short under churn.
+    class Table {
+    public:
+        size_t size() const { return size_; }
+        size_t capacity() const { return mask_ ? mask_ + 1 : 0; }
+
+        VkPipeline* Find(VkPipeline pipeline) {
+            if (!slots_ || pipeline == VK_NULL_HANDLE) {
+                return nullptr;
+            }
+            for (size_t i = Home(pipeline);; i = (i + 1) & mask_) {
+                if (slots_[i] == pipeline) return &slots_[i];
+                if (slots_[i] == VK_NULL_HANDLE) return nullptr;
+            }
+        }
+
+        // pipeline must not be in the table yet
+        void Insert(VkPipeline pipeline) {
+            if ((size_ + 1) * 2 > capacity()) {
+                Grow();
+            }
+            size_t i = Home(pipeline);
+            while (slots_[i] != VK_NULL_HANDLE) {
+                i = (i + 1) & mask_;
+            }
+            slots_[i] = pipeline;
+            size_++;
+        }
+
+        bool Erase(VkPipeline pipeline) {
+            VkPipeline* entry = Find(pipeline);
+            if (!entry) {
+                return false;
+            }
+            size_t hole = static_cast<size_t>(entry - slots_.get());
+            for (size_t i = (hole + 1) & mask_; slots_[i] != VK_NULL_HANDLE; i = (i + 1) & mask_) {
+                // Move back every entry whose probe sequence passes the hole
+                if (((i - Home(slots_[i])) & mask_) >= ((i - hole) & mask_)) {
+                    slots_[hole] = slots_[i];
+                    hole = i;
+                }
+            }
+            slots_[hole] = VK_NULL_HANDLE;
+            size_--;
+            return true;
+        }
+
+    private:
+        static constexpr size_t kInitialCapacity = 16;
+
+        size_t Home(VkPipeline pipeline) const {
+            // Bits below the ones ShardFor() uses, so entries of one shard
+            // still spread over its slots
+            uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pipeline));
+            return static_cast<size_t>((bits * 0x9E3779B97F4A7C15ull) >> 24) & mask_;
+        }
+
+        void Grow() {
+            size_t old_capacity = this->capacity();
+            size_t capacity = old_capacity ? old_capacity * 2 : kInitialCapacity;
+            std::unique_ptr<VkPipeline[]> old = std::move(slots_);
+            slots_.reset(new VkPipeline[capacity]);
+            for (size_t i = 0; i < capacity; ++i) {
+                slots_[i] = VK_NULL_HANDLE;
+            }
+            mask_ = capacity - 1;
+            size_ = 0;
+            for (size_t i = 0; i < old_capacity; ++i) {
+                if (old[i] != VK_NULL_HANDLE) {
+                    Insert(old[i]);
+                }
+            }
+        }
+
+        std::unique_ptr<VkPipeline[]> slots_;
+        size_t mask_{0};
+        size_t size_{0};
+    };
+
+    struct alignas(kCacheLineSize) Shard {
+        std::mutex mutex;
+        Table pipelines;
+        // Lifecycle counters, kept per shard so they ride the shard's lock
+        uint64_t created{0};
+        uint64_t destroyed{0};
+        uint64_t replaced{0};
+    };
+
+    Shard& ShardFor(VkPipeline pipeline) {
+        // Drivers hand out either pointers or small sequential ids; mix both
+        // into the top bits before picking a shard.
+        uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pipeline));
+        return shards_[((bits * 0x9E3779B97F4A7C15ull) >> 58) & (kShardCount - 1)];
+    }
+
+    Shard shards_[kShardCount];
+};
@@ -0,0 +1,299 @@
+// pipeline_rules.cpp - Per-pipeline rasterization and multisample overrides
+
+#include "pipeline_rules.h"
+
+#include "log.h"
+
+namespace {
+
+constexpr const char* kCullModeNames[] = {"none", "front", "back", "both"};
+
+bool ParseCullMode(std::string_view value, VkCullModeFlags& cull_mode) {
+    for (uint32_t mode = 0; mode < 4; ++mode) {
+        if (value == kCullModeNames[mode]) {
+            cull_mode = mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseSamples(std::string_view value, VkSampleCountFlagBits& samples) {
+    constexpr std::string_view kCounts[] = {"1", "2", "4", "8", "16"};
+    for (uint32_t i = 0; i < 5; ++i) {
+        if (value == kCounts[i]) {
+            samples = static_cast<VkSampleCountFlagBits>(1u << i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseFlag(std::string_view value, bool& flag) {
+    if (value != "1" && value != "0") return false;
+    flag = value == "1";
+    return true;
+}
+
+bool ParseSubgroupSize(std::string_view value, uint32_t& size) {
+    constexpr std::string_view kSizes[] = {"0", "8", "16", "32", "64", "128"};
+    for (uint32_t i = 0; i < 6; ++i) {
+        if (value == kSizes[i]) {
+            size = i == 0 ? 0 : 4u << i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseFingerprint(std::string_view value, uint64_t& fingerprint) {
+    if (value.empty() || value.size() > 16) return false;
+    fingerprint = 0;
+    for (char c : value) {
+        uint32_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        fingerprint = fingerprint << 4 | digit;
+    }
+    return true;
+}
+
+// Whitespace-separated name=value fields; false on anything the side of
+// the arrow does not allow
+bool ParseFields(std::string_view text, bool criteria, uint32_t& fields, PipelineRule::State& state) {
+    constexpr std::string_view kSpace = " \t";
+    size_t start;
+    while ((start = text.find_first_not_of(kSpace)) != std::string_view::npos) {
+        text.remove_prefix(start);
+        size_t end = text.find_first_of(kSpace);
+        std::string_view field = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end);
+
+        size_t equals = field.find('=');
+        if (equals == std::string_view::npos) return false;
+        std::string_view name = field.substr(0, equals);
+        std::string_view value = field.substr(equals + 1);
+
+        bool parsed;
+        if (name == "fingerprint" && criteria) {
+            parsed = ParseFingerprint(value, state.fingerprint);
+            fields |= PipelineRule::kFingerprint;
+        } else if (name == "shader" && criteria) {
+            parsed = ParseShaderHash(value, state.shader);
+            fields |= PipelineRule::kShader;
+        } else if (name == "cull") {
+            parsed = ParseCullMode(value, state.cull_mode);
+            fields |= PipelineRule::kCullMode;
+        } else if (name == "samples") {
+            parsed = ParseSamples(value, state.samples);
+            fields |= PipelineRule::kSamples;
+        } else if (name == "depth_bias") {
+            parsed = ParseFlag(value, state.depth_bias);
+            fields |= PipelineRule::kDepthBias;
+        } else if (name == "depth_clamp" && !criteria) {
+            parsed = ParseFlag(value, state.depth_clamp);
+            fields |= PipelineRule::kDepthClamp;
+        } else if (name == "subgroup_size" && !criteria) {
+            parsed = ParseSubgroupSize(value, state.subgroup_size);
+            fields |= PipelineRule::kSubgroupSize;
+        } else {
+            parsed = false;
+        }
+        if (!parsed) return false;
+    }
+    return true;
+}
+
+bool Matches(const PipelineRule& rule, const PipelineRule::State& state, uint32_t known_fields,
+             const ShaderHash* shaders, uint32_t shader_count) {
+    uint32_t fields = rule.match_fields;
+    if ((fields & known_fields) != fields) return false;
+    const PipelineRule::State& match = rule.match;
+    if (fields & PipelineRule::kShader) {
+        uint32_t i = 0;
+        while (i < shader_count && shaders[i] != match.shader) ++i;
+        if (i == shader_count) return false;
+    }
+    return (!(fields & PipelineRule::kFingerprint) || match.fingerprint == state.fingerprint) &&
+           (!(fields & PipelineRule::kCullMode) || match.cull_mode == state.cull_mode) &&
+           (!(fields & PipelineRule::kSamples) || match.samples == state.samples) &&
+           (!(fields & PipelineRule::kDepthBias) || match.depth_bias == state.depth_bias);
+}
+
+// FNV-1a, a 32-bit value at a time
+void Mix(uint64_t& hash, uint32_t value) {
+    hash = (hash ^ value) * 0x100000001B3ull;
+}
+
+} // namespace
+
+bool ParsePipelineRule(std::string_view text, PipelineRule& rule) {
+    size_t arrow = text.find("->");
+    if (arrow == std::string_view::npos) return false;
+    rule = PipelineRule();
+    rule.text = std::string(text);
+    return ParseFields(text.substr(0, arrow), true, rule.match_fields, rule.match) &&
+           ParseFields(text.substr(arrow + 2), false, rule.override_fields, rule.overrides) &&
+           rule.override_fields != 0;
+}
+
+uint64_t PipelineFingerprint(const VkGraphicsPipelineCreateInfo& info) {
+    VkShaderStageFlags stages = 0;
+    for (uint32_t i = 0; i < info.stageCount; ++i) {
+        stages |= info.pStages[i].stage;
+    }
+    uint64_t hash = 0xCBF29CE484222325ull;
+    Mix(hash, stages);
+
+    // Each struct is only read where the spec says the driver reads it;
+    // elsewhere the pointer may be left dangling
+    if (info.pInputAssemblyState && !(stages & VK_SHADER_STAGE_MESH_BIT_EXT)) {
+        Mix(hash, info.pInputAssemblyState->topology);
+        Mix(hash, info.pInputAssemblyState->primitiveRestartEnable);
+    }
+    bool discard = false;
+    if (const VkPipelineRasterizationStateCreateInfo* state = info.pRasterizationState) {
+        discard = state->rasterizerDiscardEnable;
+        Mix(hash, state->depthClampEnable);
+        Mix(hash, state->rasterizerDiscardEnable);
+        Mix(hash, state->polygonMode);
+        Mix(hash, state->cullMode);
+        Mix(hash, state->frontFace);
+        Mix(hash, state->depthBiasEnable);
+    }
+    if (info.pMultisampleState && !discard) {
+        Mix(hash, info.pMultisampleState->rasterizationSamples);
+        Mix(hash, info.pMultisampleState->sampleShadingEnable);
+        Mix(hash, info.pMultisampleState->alphaToCoverageEnable);
+    }
+    if (info.pDynamicState) {
+        // The same set in any order is the same pipeline
+        uint64_t dynamic = 0;
+        for (uint32_t i = 0; i < info.pDynamicState->dynamicStateCount; ++i) {
+            uint64_t state_hash = 0xCBF29CE484222325ull;
+            Mix(state_hash, info.pDynamicState->pDynamicStates[i]);
+            dynamic += state_hash;
+        }
+        Mix(hash, static_cast<uint32_t>(dynamic));
+        Mix(hash, static_cast<uint32_t>(dynamic >> 32));
+    }
+    return hash;
+}
+
+PipelineRules::PipelineRules(std::vector<PipelineRule> rules, bool log_fingerprints)
+    : rules_(std::move(rules)),
+      matched_(std::make_unique<std::atomic<uint64_t>[]>(rules_.size())),
+      log_fingerprints_(log_fingerprints) {
+    for (const PipelineRule& rule : rules_) {
+        needs_fingerprint_ |= (rule.match_fields & PipelineRule::kFingerprint) != 0;
+    }
+}
+
+uint32_t PipelineRules::Evaluate(const PipelineRule::State& state, uint32_t known_fields,
+                                 const ShaderHash* shaders, uint32_t shader_count,
+                                 PipelineRule::State& result) {
+    uint32_t overridden = 0;
+    for (size_t i = 0; i < rules_.size(); ++i) {
+        const PipelineRule& rule = rules_[i];
+        if (!Matches(rule, state, known_fields, shaders, shader_count)) continue;
+        matched_[i].fetch_add(1, std::memory_order_relaxed);
+
+        uint32_t fields = rule.override_fields & known_fields;
+        if (fields & PipelineRule::kCullMode) result.cull_mode = rule.overrides.cull_mode;
+        if (fields & PipelineRule::kSamples) result.samples = rule.overrides.samples;
+        if (fields & PipelineRule::kDepthBias) result.depth_bias = rule.overrides.depth_bias;
+        if (fields & PipelineRule::kDepthClamp) result.depth_clamp = rule.overrides.depth_clamp;
+        if (fields & PipelineRule::kSubgroupSize) result.subgroup_size = rule.overrides.subgroup_size;
+        overridden |= fields;
+    }
+    return overridden;
+}
+
+uint32_t PipelineRules::Apply(VkGraphicsPipelineCreateInfo& info, const ShaderHash* shaders,
+                              uint32_t shader_count, uint32_t subgroup_size, ScratchArena& arena) {
+    const VkPipelineRasterizationStateCreateInfo* rasterization = info.pRasterizationState;
+    const VkPipelineMultisampleStateCreateInfo* multisample =
+        rasterization && rasterization->rasterizerDiscardEnable ? nullptr : info.pMultisampleState;
+
+    // What the pipeline itself sets; a criterion on anything else never matches
+    PipelineRule::State state;
+    state.subgroup_size = subgroup_size;
+    uint32_t known_fields = PipelineRule::kSubgroupSize;
+    if (rasterization) {
+        state.cull_mode = rasterization->cullMode;
+        state.depth_bias = rasterization->depthBiasEnable;
+        state.depth_clamp = rasterization->depthClampEnable;
+        known_fields |= PipelineRule::kCullMode | PipelineRule::kDepthBias | PipelineRule::kDepthClamp;
+    }
+    if (multisample) {
+        state.samples = multisample->rasterizationSamples;
+        known_fields |= PipelineRule::kSamples;
+    }
+    if (needs_fingerprint_ || log_fingerprints_) {
+        state.fingerprint = PipelineFingerprint(info);
+        known_fields |= PipelineRule::kFingerprint;
+    }
+    if (shader_count) {
+        known_fields |= PipelineRule::kShader;
+    }
+    if (log_fingerprints_) {
+        LogFingerprint(state.fingerprint, state);
+    }
+
+    PipelineRule::State result = state;
+    uint32_t overridden = Evaluate(state, known_fields, shaders, shader_count, result);
+
+    if (overridden & (PipelineRule::kCullMode | PipelineRule::kDepthBias | PipelineRule::kDepthClamp)) {
+        auto* copy = arena.Copy(*rasterization);
+        copy->cullMode = result.cull_mode;
+        copy->depthBiasEnable = result.depth_bias;
+        copy->depthClampEnable = result.depth_clamp;
+        info.pRasterizationState = copy;
+    }
+    if (overridden & PipelineRule::kSamples) {
+        auto* copy = arena.Copy(*multisample);
+        copy->rasterizationSamples = result.samples;
+        info.pMultisampleState = copy;
+    }
+    return result.subgroup_size;
+}
+
+uint32_t PipelineRules::ApplyCompute(const ShaderHash& shader, uint32_t subgroup_size) {
+    PipelineRule::State state;
+    state.subgroup_size = subgroup_size;
+    uint32_t known_fields = PipelineRule::kSubgroupSize;
+    if (!shader.IsZero()) {
+        known_fields |= PipelineRule::kShader;
+    }
+    PipelineRule::State result = state;
+    Evaluate(state, known_fields, &shader, 1, result);
+    return result.subgroup_size;
+}
+
+void PipelineRules::LogFingerprint(uint64_t fingerprint, const PipelineRule::State& state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (logged_fingerprints_.size() == kMaxLoggedFingerprints ||
+            !logged_fingerprints_.insert(fingerprint).second) {
+            return;
+        }
+    }
+    XCLIPSE_LOGI("pipeline fingerprint=%016llx cull=%s samples=%u depth_bias=%u",
+                 static_cast<unsigned long long>(fingerprint),
+                 kCullModeNames[state.cull_mode & VK_CULL_MODE_FRONT_AND_BACK],
+                 static_cast<unsigned>(state.samples), state.depth_bias ? 1u : 0u);
+}
+
+void PipelineRules::LogStats() const {
+    for (size_t i = 0; i < rules_.size(); ++i) {
+        XCLIPSE_LOGI("pipeline rule \"%s\": matched %llu pipelines", rules_[i].text.c_str(),
+                     static_cast<unsigned long long>(matched_[i].load(std::memory_order_relaxed)));
+    }
+}
@@ -0,0 +1,105 @@
+// pipeline_rules.h - Per-pipeline rasterization and multisample overrides
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "scratch_arena.h"
+#include "spirv_hash.h"
+
+// One "pipeline = <criteria> -> <overrides>" line of a profile, e.g.
+//
+//   pipeline = cull=none samples=8 -> samples=4
+//   pipeline = fingerprint=9c41e07a5d3b2f18 -> cull=back depth_bias=0
+//   pipeline = shader=0b5c840bec9e6d6c726ca7d7d69feb86 -> cull=none
+//
+// Criteria: fingerprint=<16 hex digits>, shader=<32 hex digits> (the
+// SPIR-V hash of any one stage), cull=none|front|back|both,
+// samples=1|2|4|8|16, depth_bias=0|1. A rule with no criteria matches every
+// pipeline; compute pipelines only have a shader to match on. Overrides:
+// cull=, samples=, depth_bias=, depth_clamp=, and subgroup_size=8..128 or 0
+// for the driver's choice (see SubgroupSizeControl).
+// Overridden state has to stay valid for the pipeline: a new sample count
+// must match its attachments, depth_clamp=1 needs the depthClamp feature,
+// and state the pipeline makes dynamic is left as the app sets it.
+struct PipelineRule {
+    enum Field : uint32_t {
+        kFingerprint = 1u << 0,
+        kCullMode = 1u << 1,
+        kSamples = 1u << 2,
+        kDepthBias = 1u << 3,
+        kDepthClamp = 1u << 4,
+        kShader = 1u << 5,
+        kSubgroupSize = 1u << 6,
+    };
+
+    struct State {
+        uint64_t fingerprint{0};
+        ShaderHash shader;
+        VkCullModeFlags cull_mode{VK_CULL_MODE_NONE};
+        VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+        bool depth_bias{false};
+        bool depth_clamp{false};
+        uint32_t subgroup_size{0};
+    };
+
+    uint32_t match_fields{0};  // Field bits set in match
+    State match;
+    uint32_t override_fields{0};  // Field bits set in overrides, never kFingerprint or kShader
+    State overrides;
+    std::string text;  // as written, for the log
+};
+
+// False if text is not "<criteria> -> <overrides>" with at least one override
+bool ParsePipelineRule(std::string_view text, PipelineRule& rule);
+
+// Stable across runs and devices: only the fixed-function state and the
+// stage mask go in, never handles or pointers
+uint64_t PipelineFingerprint(const VkGraphicsPipelineCreateInfo& info);
+
+// Evaluated once per pipeline at creation, where the overrides are baked
+// into the create info, so binding a pipeline costs nothing extra. Every
+// matching rule applies, in profile order, later ones winning; criteria
+// always see the app's own state.
+class PipelineRules {
+public:
+    PipelineRules(std::vector<PipelineRule> rules, bool log_fingerprints);
+
+    PipelineRules(const PipelineRules&) = delete;
+    PipelineRules& operator=(const PipelineRules&) = delete;
+
+    // Points info at rewritten copies in arena of the state structs a rule
+    // overrides; the app's structs are never written. shaders are the
+    // pipeline's stage hashes, zero where unknown. Returns subgroup_size,
+    // or what the last matching rule sets it to.
+    uint32_t Apply(VkGraphicsPipelineCreateInfo& info, const ShaderHash* shaders,
+                   uint32_t shader_count, uint32_t subgroup_size, ScratchArena& arena);
+    uint32_t ApplyCompute(const ShaderHash& shader, uint32_t subgroup_size);
+
+    void LogStats() const;
+
+private:
+    static constexpr size_t kMaxLoggedFingerprints = 4096;
+
+    // Overrides of every rule that matches state into result; returns the
+    // Field bits overridden
+    uint32_t Evaluate(const PipelineRule::State& state, uint32_t known_fields,
+                      const ShaderHash* shaders, uint32_t shader_count, PipelineRule::State& result);
+    void LogFingerprint(uint64_t fingerprint, const PipelineRule::State& state);
+
+    std::vector<PipelineRule> rules_;
+    std::unique_ptr<std::atomic<uint64_t>[]> matched_;  // per rule
+    bool needs_fingerprint_{false};
+    bool log_fingerprints_;
+
+    std::mutex mutex_;
+    std::unordered_set<uint64_t> logged_fingerprints_;
+};
@@ -0,0 +1,200 @@
+// pipeline_stats.cpp - Pipeline compile latency and driver cache hit tracking
+
+#include "pipeline_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+constexpr const char* kBindPointNames[] = {"graphics", "compute"};
+constexpr const char* kOutcomeNames[] = {"cache-hit", "cache-miss", "no-feedback"};
+
+// Bucket 0 holds sub-microsecond compiles; after that each power of two is
+// split in four by the two bits below the leading one.
+uint32_t BucketFor(uint64_t nanoseconds) {
+    uint64_t micros = nanoseconds / 1000;
+    if (micros == 0) {
+        return 0;
+    }
+    uint32_t msb = 63 - static_cast<uint32_t>(std::countl_zero(micros));
+    uint32_t sub = msb >= 2 ? static_cast<uint32_t>(micros >> (msb - 2)) & 3
+                            : static_cast<uint32_t>(micros << (2 - msb)) & 3;
+    uint32_t bucket = 1 + msb * 4 + sub;
+    return bucket < kLatencyBucketCount ? bucket : kLatencyBucketCount - 1;
+}
+
+uint64_t BucketUpperMicros(uint32_t bucket) {
+    if (bucket == 0) {
+        return 1;
+    }
+    uint32_t msb = (bucket - 1) / 4;
+    uint32_t sub = (bucket - 1) % 4;
+    return ((5ull + sub) << msb) >> 2;
+}
+
+uint32_t BindPointIndex(VkPipelineBindPoint bind_point) {
+    return bind_point == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0;
+}
+
+void AppendRow(std::string& report, const char* bind_point, const char* outcome,
+               const LatencySnapshot& snapshot) {
+    char line[160];
+    std::snprintf(line, sizeof(line),
+                  "%s %s: n=%llu p50=%llu p95=%llu p99=%llu max=%llu\n",
+                  bind_point, outcome,
+                  static_cast<unsigned long long>(snapshot.count),
+                  static_cast<unsigned long long>(snapshot.PercentileMicros(0.50)),
+                  static_cast<unsigned long long>(snapshot.PercentileMicros(0.95)),
+                  static_cast<unsigned long long>(snapshot.PercentileMicros(0.99)),
+                  static_cast<unsigned long long>((snapshot.max_ns + 999) / 1000));
+    report += line;
+}
+
+} // namespace
+
+void LatencySnapshot::Add(const LatencySnapshot& other) {
+    for (uint32_t i = 0; i < kLatencyBucketCount; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    max_ns = max_ns > other.max_ns ? max_ns : other.max_ns;
+}
+
+uint64_t LatencySnapshot::PercentileMicros(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(count - 1)) + 1;
+    uint64_t max_micros = (max_ns + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kLatencyBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(BucketUpperMicros(i), max_micros);
+        }
+    }
+    return max_micros;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds) {
+    buckets_[BucketFor(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (nanoseconds > max &&
+           !max_ns_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySnapshot LatencyHistogram::Snapshot() const {
+    LatencySnapshot snapshot;
+    for (uint32_t i = 0; i < kLatencyBucketCount; ++i) {
+        snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.max_ns = max_ns_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+PipelineCompileStats::PipelineCompileStats(std::string export_path, uint64_t dump_interval_ns,
+                                           BackgroundReport report)
+    : export_path_(std::move(export_path)), report_(std::move(report)) {
+    dumper_ = std::thread(&PipelineCompileStats::DumperLoop, this, dump_interval_ns);
+}
+
+PipelineCompileStats::~PipelineCompileStats() {
+    {
+        std::lock_guard<std::mutex> lock(dumper_mutex_);
+        stop_dumper_ = true;
+    }
+    dumper_cv_.notify_one();
+    dumper_.join();
+}
+
+void PipelineCompileStats::Record(VkPipelineBindPoint bind_point, CacheOutcome outcome,
+                                  uint64_t duration_ns) {
+    histograms_[BindPointIndex(bind_point)][static_cast<uint32_t>(outcome)].Record(duration_ns);
+}
+
+uint64_t PipelineCompileStats::RecordedCount() const {
+    uint64_t count = 0;
+    for (const auto& bind_point : histograms_) {
+        for (const LatencyHistogram& histogram : bind_point) {
+            count += histogram.Snapshot().count;
+        }
+    }
+    return count;
+}
+
+void PipelineCompileStats::DumperLoop(uint64_t dump_interval_ns) {
+    uint64_t dumped_count = 0;
+    uint64_t next_dump_ns = SteadyNanoseconds() + dump_interval_ns;
+    uint64_t next_report_ns = report_.run ? SteadyNanoseconds() + report_.interval_ns : UINT64_MAX;
+
+    std::unique_lock<std::mutex> lock(dumper_mutex_);
+    for (;;) {
+        uint64_t now = SteadyNanoseconds();
+        uint64_t wake_ns = std::min(next_dump_ns, next_report_ns);
+        if (dumper_cv_.wait_for(lock, std::chrono::nanoseconds(wake_ns > now ? wake_ns - now : 0),
+                                [this] { return stop_dumper_; })) {
+            return;
+        }
+        lock.unlock();
+        now = SteadyNanoseconds();
+        if (now >= next_dump_ns) {
+            next_dump_ns = now + dump_interval_ns;
+            uint64_t count = RecordedCount();
+            if (count != dumped_count) {
+                dumped_count = count;
+                Dump();
+            }
+        }
+        if (now >= next_report_ns) {
+            next_report_ns = now + report_.interval_ns;
+            report_.run();
+        }
+        lock.lock();
+    }
+}
+
+void PipelineCompileStats::Dump() {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+
+    std::string report = "pipeline compile latency (us)\n";
+    for (uint32_t bind_point = 0; bind_point < kBindPointCount; ++bind_point) {
+        LatencySnapshot total;
+        LatencySnapshot outcomes[static_cast<uint32_t>(CacheOutcome::kCount)];
+        for (uint32_t outcome = 0; outcome < static_cast<uint32_t>(CacheOutcome::kCount); ++outcome) {
+            outcomes[outcome] = histograms_[bind_point][outcome].Snapshot();
+            total.Add(outcomes[outcome]);
+        }
+        if (total.count == 0) {
+            continue;
+        }
+
+        AppendRow(report, kBindPointNames[bind_point], "all", total);
+        for (uint32_t outcome = 0; outcome < static_cast<uint32_t>(CacheOutcome::kCount); ++outcome) {
+            if (outcomes[outcome].count) {
+                AppendRow(report, kBindPointNames[bind_point], kOutcomeNames[outcome],
+                          outcomes[outcome]);
+            }
+        }
+    }
+
+    std::string_view lines = report;
+    while (!lines.empty()) {
+        size_t end = lines.find('\n');
+        XCLIPSE_LOGI("%.*s", static_cast<int>(end), lines.data());
+        lines.remove_prefix(end + 1);
+    }
+
+    if (!export_path_.empty()) {
+        WriteFileAtomically(export_path_, report);
+    }
+}
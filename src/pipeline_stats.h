@@ -0,0 +1,99 @@
+// pipeline_stats.h - Pipeline compile latency and driver cache hit tracking
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "clock.h"
+
+// Four buckets per power of two microseconds, up to ~2 minutes
+inline constexpr uint32_t kLatencyBucketCount = 112;
+
+struct LatencySnapshot {
+    uint64_t buckets[kLatencyBucketCount]{};
+    uint64_t count{0};
+    uint64_t max_ns{0};
+
+    void Add(const LatencySnapshot& other);
+
+    // Upper edge of the bucket holding the quantile (0..1), capped at the
+    // maximum; at most ~25% above the true value
+    uint64_t PercentileMicros(double quantile) const;
+};
+
+// Recording is a couple of relaxed atomics, so compile threads never
+// serialize on it. Snapshots taken while recording may be slightly torn.
+class LatencyHistogram {
+public:
+    void Record(uint64_t nanoseconds);
+    LatencySnapshot Snapshot() const;
+
+private:
+    std::atomic<uint64_t> buckets_[kLatencyBucketCount]{};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+// What VkPipelineCreationFeedback said about the driver's own cache
+enum class CacheOutcome : uint32_t {
+    kHit,
+    kMiss,
+    kNoFeedback,
+    kCount,
+};
+
+// Another per-device report for the dumper thread to run, so the hot path
+// that feeds it never summarizes or logs
+struct BackgroundReport {
+    std::function<void()> run;
+    uint64_t interval_ns{0};
+};
+
+// Per-device compile latency, split by bind point and cache outcome. A
+// background thread logs the report every kDumpIntervalNs and mirrors it to
+// a text file, skipping intervals without new compiles so an idle game logs
+// nothing. Compile threads only ever touch the histograms. The same thread
+// runs the device's other background report, if it has one.
+class PipelineCompileStats {
+public:
+    static constexpr uint64_t kDumpIntervalNs = 30ull * 1000 * 1000 * 1000;
+
+    // export_path may be empty to log only. report must stay valid until
+    // this is destroyed.
+    explicit PipelineCompileStats(std::string export_path,
+                                  uint64_t dump_interval_ns = kDumpIntervalNs,
+                                  BackgroundReport report = {});
+    ~PipelineCompileStats();
+
+    PipelineCompileStats(const PipelineCompileStats&) = delete;
+    PipelineCompileStats& operator=(const PipelineCompileStats&) = delete;
+
+    void Record(VkPipelineBindPoint bind_point, CacheOutcome outcome, uint64_t duration_ns);
+
+    // Logs and exports the current report regardless of the interval
+    void Dump();
+
+private:
+    static constexpr uint32_t kBindPointCount = 2;  // graphics, compute
+
+    void DumperLoop(uint64_t dump_interval_ns);
+    // Compiles recorded so far, across all histograms
+    uint64_t RecordedCount() const;
+
+    LatencyHistogram histograms_[kBindPointCount][static_cast<uint32_t>(CacheOutcome::kCount)];
+
+    std::mutex dump_mutex_;
+    std::string export_path_;
+    BackgroundReport report_;
+
+    std::mutex dumper_mutex_;
+    std::condition_variable dumper_cv_;
+    bool stop_dumper_{false};
+    std::thread dumper_;
+};
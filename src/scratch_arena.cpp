@@ -0,0 +1,33 @@
+// scratch_arena.cpp - Per-thread bump allocator for per-call scratch state
+
+#include "scratch_arena.h"
+
+#include <algorithm>
+
+ScratchArena& ScratchArena::ForThread() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+void* ScratchArena::AllocateBytes(size_t size, size_t alignment) {
+    for (;;) {
+        if (current_ < blocks_.size()) {
+            Block& block = blocks_[current_];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t aligned = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+            if (aligned + size <= block.size) {
+                offset_ = aligned + size;
+                return block.data.get() + aligned;
+            }
+            // Too small for this request; a later block will do
+            ++current_;
+            offset_ = 0;
+            continue;
+        }
+
+        // Out of blocks: grow geometrically so a thread settles after a few calls
+        size_t block_size = blocks_.empty() ? kFirstBlockSize : blocks_.back().size * 2;
+        block_size = std::max(block_size, size + alignment);
+        blocks_.push_back(Block{std::make_unique<std::byte[]>(block_size), block_size});
+    }
+}
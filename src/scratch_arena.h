@@ -0,0 +1,89 @@
+// scratch_arena.h - Per-thread bump allocator for per-call scratch state
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Rewritten create infos and other state that only has to outlive one
+// driver call. Blocks are kept across calls, so once a thread has seen its
+// largest batch, allocating is a pointer bump and never touches the heap.
+// Everything allocated here must be trivially destructible.
+class ScratchArena {
+public:
+    // The calling thread's arena
+    static ScratchArena& ForThread();
+
+    // Rewinds the arena to where it was when the scope opened, so nested
+    // intercepted calls on the same thread never free each other's memory.
+    class Scope {
+    public:
+        Scope() : arena_(ForThread()), block_(arena_.current_), offset_(arena_.offset_) {}
+        ~Scope() {
+            arena_.current_ = block_;
+            arena_.offset_ = offset_;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ScratchArena& arena() { return arena_; }
+
+    private:
+        ScratchArena& arena_;
+        size_t block_;
+        size_t offset_;
+    };
+
+    ScratchArena() = default;
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // Value-initialized array of count elements
+    template <typename T>
+    T* Allocate(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arena memory is never destructed");
+        void* memory = AllocateBytes(sizeof(T) * count, alignof(T));
+        T* result = static_cast<T*>(memory);
+        for (size_t i = 0; i < count; ++i) {
+            ::new (static_cast<void*>(result + i)) T();
+        }
+        return result;
+    }
+
+    template <typename T>
+    T* Copy(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "arena copies are shallow");
+        T* result = static_cast<T*>(AllocateBytes(sizeof(T), alignof(T)));
+        ::new (static_cast<void*>(result)) T(value);
+        return result;
+    }
+
+    template <typename T>
+    T* CopyArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>, "arena copies are shallow");
+        T* result = static_cast<T*>(AllocateBytes(sizeof(T) * count, alignof(T)));
+        for (size_t i = 0; i < count; ++i) {
+            ::new (static_cast<void*>(result + i)) T(values[i]);
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t kFirstBlockSize = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    void* AllocateBytes(size_t size, size_t alignment);
+
+    std::vector<Block> blocks_;
+    size_t current_{0};
+    size_t offset_{0};
+};
@@ -0,0 +1,289 @@
+// shader_modules.cpp - SPIR-V identity of shader modules, with on-disk replacements
+
+#include "shader_modules.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <string_view>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "clock.h"
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+constexpr uint32_t kSpirvMagic = 0x07230203;
+constexpr size_t kSpirvHeaderBytes = 20;
+constexpr std::string_view kExtension = ".spv";
+
+// Module table sizing: rebuilt once half its slots are used, to a quarter
+// full, so probes stay short and erased slots are swept out
+constexpr size_t kInitialModuleCapacity = 64;
+constexpr uint64_t kErasedModule = ~0ull;
+
+uint64_t ModuleKey(VkShaderModule module) {
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(module));
+}
+
+size_t ModuleHome(uint64_t key, size_t mask) {
+    // Drivers hand out either pointers or small sequential ids
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+// Each thread counts its lookups in the same reader slot every time
+size_t ReaderIndex(size_t slots) {
+    static std::atomic<size_t> next_reader{0};
+    thread_local size_t reader = next_reader.fetch_add(1, std::memory_order_relaxed);
+    return reader % slots;
+}
+
+std::string SpirvFileName(const ShaderHash& hash) {
+    return ShaderHashToHex(hash) + std::string(kExtension);
+}
+
+} // namespace
+
+ShaderModuleTracker::ShaderModuleTracker(std::string replacement_directory, std::string dump_directory)
+    : replacement_directory_(std::move(replacement_directory)),
+      dump_directory_(std::move(dump_directory)) {
+    if (!replacement_directory_.empty()) {
+        if (DIR* directory = opendir(replacement_directory_.c_str())) {
+            while (const dirent* entry = readdir(directory)) {
+                std::string_view name = entry->d_name;
+                ShaderHash hash;
+                if (name.size() > kExtension.size() && name.ends_with(kExtension) &&
+                    ParseShaderHash(name.substr(0, name.size() - kExtension.size()), hash)) {
+                    replacements_.insert(hash);
+                }
+            }
+            closedir(directory);
+        }
+        XCLIPSE_LOGI("shader replacements: %zu in %s", replacements_.size(),
+                     replacement_directory_.c_str());
+    }
+    if (!dump_directory_.empty() && mkdir(dump_directory_.c_str(), 0700) != 0 && errno != EEXIST) {
+        XCLIPSE_LOGW("cannot dump shaders to %s", dump_directory_.c_str());
+        dump_directory_.clear();
+    }
+}
+
+ShaderHash ShaderModuleTracker::Prepare(const VkShaderModuleCreateInfo& info,
+                                        std::vector<uint32_t>& replacement) {
+    uint64_t start = SteadyNanoseconds();
+    ShaderHash hash = HashSpirv(info.pCode, info.codeSize);
+    hash_ns_.fetch_add(SteadyNanoseconds() - start, std::memory_order_relaxed);
+    hashed_.fetch_add(1, std::memory_order_relaxed);
+    hashed_bytes_.fetch_add(info.codeSize, std::memory_order_relaxed);
+
+    if (!dump_directory_.empty()) {
+        Dump(hash, info);
+    }
+    if (!replacements_.empty() && replacements_.count(hash) && LoadReplacement(hash, replacement)) {
+        replaced_.fetch_add(1, std::memory_order_relaxed);
+        XCLIPSE_LOGI("shader %s replaced from disk", ShaderHashToHex(hash).c_str());
+    }
+    return hash;
+}
+
+ShaderModuleTracker::~ShaderModuleTracker() {
+    delete table_.load(std::memory_order_relaxed);
+}
+
+void ShaderModuleTracker::Insert(VkShaderModule module, const ShaderHash& hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeRetiredTables();
+    Table* table = table_.load(std::memory_order_relaxed);
+    if (!table || (table->used + 1) * 2 > table->mask + 1) {
+        Rebuild(table ? table->live + 1 : 1);
+        table = table_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t key = ModuleKey(module);
+    Slot* target = nullptr;
+    for (size_t i = ModuleHome(key, table->mask);; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        uint64_t slot_key = slot.module.load(std::memory_order_relaxed);
+        if (slot_key == key) {
+            // The driver recycled a handle we never saw destroyed
+            slot.high.store(hash.high, std::memory_order_relaxed);
+            slot.low.store(hash.low, std::memory_order_relaxed);
+            return;
+        }
+        if (slot_key == kErasedModule && !target) {
+            target = &slot;
+        }
+        if (slot_key == 0) {
+            if (!target) {
+                target = &slot;
+                table->used++;
+            }
+            break;
+        }
+    }
+    // Lookups match on the handle, so it goes in last
+    target->high.store(hash.high, std::memory_order_relaxed);
+    target->low.store(hash.low, std::memory_order_relaxed);
+    target->module.store(key, std::memory_order_release);
+    table->live++;
+}
+
+void ShaderModuleTracker::Erase(VkShaderModule module) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FreeRetiredTables();
+    Table* table = table_.load(std::memory_order_relaxed);
+    if (!table) {
+        return;
+    }
+    uint64_t key = ModuleKey(module);
+    for (size_t i = ModuleHome(key, table->mask);; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        uint64_t slot_key = slot.module.load(std::memory_order_relaxed);
+        if (slot_key == key) {
+            // Lookups may be probing past this slot, so it cannot be emptied
+            slot.module.store(kErasedModule, std::memory_order_release);
+            table->live--;
+            return;
+        }
+        if (slot_key == 0) {
+            return;
+        }
+    }
+}
+
+ShaderHash ShaderModuleTracker::Find(VkShaderModule module) const {
+    // Announce the lookup before loading the table, so a writer that
+    // replaces the table right after either sees it or is seen by it
+    ReaderSlot& reader = readers_[ReaderIndex(kReaderSlots)];
+    reader.lookups.fetch_add(1, std::memory_order_seq_cst);
+
+    ShaderHash hash;
+    if (const Table* table = table_.load(std::memory_order_seq_cst)) {
+        uint64_t key = ModuleKey(module);
+        size_t i = ModuleHome(key, table->mask);
+        for (size_t probe = 0; probe <= table->mask; ++probe, i = (i + 1) & table->mask) {
+            const Slot& slot = table->slots[i];
+            uint64_t slot_key = slot.module.load(std::memory_order_acquire);
+            if (slot_key == key) {
+                hash.high = slot.high.load(std::memory_order_relaxed);
+                hash.low = slot.low.load(std::memory_order_relaxed);
+                break;
+            }
+            if (slot_key == 0) {
+                break;
+            }
+        }
+    }
+
+    reader.lookups.fetch_sub(1, std::memory_order_release);
+    return hash;
+}
+
+void ShaderModuleTracker::Rebuild(size_t live) {
+    size_t capacity = kInitialModuleCapacity;
+    while (live * 4 > capacity) {
+        capacity *= 2;
+    }
+    auto table = std::make_unique<Table>(capacity);
+    Table* old = table_.load(std::memory_order_relaxed);
+    if (old) {
+        for (size_t i = 0; i <= old->mask; ++i) {
+            const Slot& from = old->slots[i];
+            uint64_t key = from.module.load(std::memory_order_relaxed);
+            if (key == 0 || key == kErasedModule) {
+                continue;
+            }
+            size_t j = ModuleHome(key, table->mask);
+            while (table->slots[j].module.load(std::memory_order_relaxed) != 0) {
+                j = (j + 1) & table->mask;
+            }
+            Slot& to = table->slots[j];
+            to.module.store(key, std::memory_order_relaxed);
+            to.high.store(from.high.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to.low.store(from.low.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            table->live++;
+            table->used++;
+        }
+    }
+
+    table_.store(table.release(), std::memory_order_seq_cst);
+    if (old) {
+        retired_.emplace_back(old);
+        FreeRetiredTables();
+    }
+}
+
+void ShaderModuleTracker::FreeRetiredTables() {
+    if (retired_.empty()) {
+        return;
+    }
+    for (const ReaderSlot& reader : readers_) {
+        if (reader.lookups.load(std::memory_order_seq_cst) != 0) {
+            // Kept for a later write to try again
+            return;
+        }
+    }
+    retired_.clear();
+}
+
+ShaderHash ShaderModuleTracker::HashStage(const VkPipelineShaderStageCreateInfo& stage) {
+    if (stage.module != VK_NULL_HANDLE) {
+        return Find(stage.module);
+    }
+    // Inline code is hashed on every use rather than cached: apps reuse and
+    // rewrite the buffers pCode points to, so the only safe cache key is the
+    // code itself, and reading all of it is what hashing costs anyway.
+    for (auto* next = static_cast<const VkBaseInStructure*>(stage.pNext); next; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO) {
+            auto* info = reinterpret_cast<const VkShaderModuleCreateInfo*>(next);
+            return HashSpirv(info->pCode, info->codeSize);
+        }
+    }
+    return ShaderHash();
+}
+
+bool ShaderModuleTracker::LoadReplacement(const ShaderHash& hash, std::vector<uint32_t>& code) {
+    std::string path = replacement_directory_ + "/" + SpirvFileName(hash);
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        XCLIPSE_LOGW("cannot open %s", path.c_str());
+        return false;
+    }
+    struct stat st{};
+    size_t size = fstat(fileno(file), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    bool ok = size >= kSpirvHeaderBytes && size % sizeof(uint32_t) == 0;
+    if (ok) {
+        code.resize(size / sizeof(uint32_t));
+        ok = std::fread(code.data(), 1, size, file) == size && code[0] == kSpirvMagic;
+    }
+    std::fclose(file);
+    if (!ok) {
+        XCLIPSE_LOGW("%s is not SPIR-V, keeping the original shader", path.c_str());
+        code.clear();
+    }
+    return ok;
+}
+
+void ShaderModuleTracker::Dump(const ShaderHash& hash, const VkShaderModuleCreateInfo& info) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dumped_.insert(hash).second) {
+            return;
+        }
+    }
+    std::string path = dump_directory_ + "/" + SpirvFileName(hash);
+    std::string_view code(reinterpret_cast<const char*>(info.pCode), info.codeSize);
+    if (!WriteFileAtomically(path, code)) {
+        XCLIPSE_LOGW("could not write %s", path.c_str());
+    }
+}
+
+void ShaderModuleTracker::LogStats() const {
+    XCLIPSE_LOGI("shader modules: %llu hashed (%.1f MiB in %.2f ms), %llu replaced",
+                 static_cast<unsigned long long>(hashed_.load(std::memory_order_relaxed)),
+                 hashed_bytes_.load(std::memory_order_relaxed) / (1024.0 * 1024.0),
+                 hash_ns_.load(std::memory_order_relaxed) / 1e6,
+                 static_cast<unsigned long long>(replaced_.load(std::memory_order_relaxed)));
+}
@@ -0,0 +1,113 @@
+// shader_modules.h - SPIR-V identity of shader modules, with on-disk replacements
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "spirv_hash.h"
+
+// Vertex, two tessellation stages, geometry and fragment; or task, mesh
+// and fragment
+constexpr uint32_t kMaxPipelineShaders = 5;
+
+// The shaders a pipeline is created from
+struct PipelineShaders {
+    uint32_t shader_stages{0};
+    // SPIR-V of each stage in shader_stages, lowest stage bit first; zero
+    // where the layer never saw the code
+    ShaderHash shaders[kMaxPipelineShaders];
+};
+
+// Hashes the SPIR-V of every module the app creates and remembers the hash
+// per handle, so pipelines can be tied to the shaders they were built from.
+//
+// A module whose hash has a <hash>.spv file in the replacement directory is
+// created from that file instead; the directory is listed once, up front,
+// so a miss costs a set lookup rather than a file system call. Dumping
+// writes each distinct module to the dump directory under the same name,
+// as the starting point for a replacement.
+//
+// Pipeline creation looks a hash up for every stage, from as many threads
+// as the app compiles on, while modules come and go far less often. The
+// handles therefore live in an open-addressed table that lookups probe
+// without a lock; writers serialize on mutex_ and publish a rebuilt table
+// when it fills up. Replaced tables are freed once no lookup is in flight.
+class ShaderModuleTracker {
+public:
+    // Either directory may be empty to turn its feature off
+    ShaderModuleTracker(std::string replacement_directory, std::string dump_directory);
+    ~ShaderModuleTracker();
+
+    ShaderModuleTracker(const ShaderModuleTracker&) = delete;
+    ShaderModuleTracker& operator=(const ShaderModuleTracker&) = delete;
+
+    // The hash of info's code. replacement is filled with the code to
+    // create the module from instead, and left empty when there is none.
+    ShaderHash Prepare(const VkShaderModuleCreateInfo& info, std::vector<uint32_t>& replacement);
+
+    void Insert(VkShaderModule module, const ShaderHash& hash);
+    void Erase(VkShaderModule module);
+
+    // The stage's module hash, or its inline VkShaderModuleCreateInfo's
+    // (VK_KHR_maintenance5); zero when neither is known
+    ShaderHash HashStage(const VkPipelineShaderStageCreateInfo& stage);
+
+    void LogStats() const;
+
+private:
+    // Lookups in flight are counted in one of these, picked per thread, so
+    // compile threads do not bounce a single counter between cores
+    static constexpr size_t kReaderSlots = 16;
+    static constexpr size_t kCacheLineSize = 64;
+
+    struct Slot {
+        std::atomic<uint64_t> module{0};  // 0 free, kErased after a destroy
+        std::atomic<uint64_t> high{0};
+        std::atomic<uint64_t> low{0};
+    };
+
+    struct Table {
+        explicit Table(size_t capacity) : slots(new Slot[capacity]), mask(capacity - 1) {}
+
+        std::unique_ptr<Slot[]> slots;
+        size_t mask;
+        size_t live{0};
+        size_t used{0};  // live plus erased slots, which still lengthen probes
+    };
+
+    struct alignas(kCacheLineSize) ReaderSlot {
+        std::atomic<uint32_t> lookups{0};
+    };
+
+    ShaderHash Find(VkShaderModule module) const;
+    // Requires mutex_
+    void Rebuild(size_t live);
+    void FreeRetiredTables();
+
+    bool LoadReplacement(const ShaderHash& hash, std::vector<uint32_t>& code);
+    void Dump(const ShaderHash& hash, const VkShaderModuleCreateInfo& info);
+
+    std::string replacement_directory_;
+    std::unordered_set<ShaderHash, ShaderHashHasher> replacements_;  // fixed after construction
+    std::string dump_directory_;
+
+    std::atomic<Table*> table_{nullptr};
+    mutable ReaderSlot readers_[kReaderSlots];
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Table>> retired_;  // may still be probed
+    std::unordered_set<ShaderHash, ShaderHashHasher> dumped_;
+
+    std::atomic<uint64_t> hashed_{0};
+    std::atomic<uint64_t> hashed_bytes_{0};
+    std::atomic<uint64_t> hash_ns_{0};
+    std::atomic<uint64_t> replaced_{0};
+};
@@ -0,0 +1,157 @@
+// spirv_hash.cpp - 128-bit identity hash of SPIR-V blobs
+
+#include "spirv_hash.h"
+
+#include <cstring>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The XXH3 accumulator loop: each 64-bit lane adds its neighbour's input
+// and the product of its keyed input's two 32-bit halves. Every
+// kStripesPerScramble stripes the lanes are scrambled so that high bits
+// feed back into the multiplies.
+constexpr size_t kStripeBytes = 32;
+constexpr size_t kStripesPerScramble = 16;
+constexpr uint64_t kKeys[4] = {0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull,
+                               0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull};
+constexpr uint64_t kPrime32 = 0x9E3779B1ull;
+constexpr uint64_t kPrime64a = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime64b = 0xC2B2AE3D27D4EB4Full;
+
+#if defined(__ARM_NEON)
+void AccumulateStripes(uint64_t acc[4], const uint8_t* data, size_t stripes) {
+    uint64x2_t acc0 = vld1q_u64(acc);
+    uint64x2_t acc1 = vld1q_u64(acc + 2);
+    const uint64x2_t key0 = vld1q_u64(kKeys);
+    const uint64x2_t key1 = vld1q_u64(kKeys + 2);
+    for (size_t i = 0; i < stripes; ++i, data += kStripeBytes) {
+        uint64x2_t data0 = vreinterpretq_u64_u8(vld1q_u8(data));
+        uint64x2_t data1 = vreinterpretq_u64_u8(vld1q_u8(data + 16));
+        uint64x2_t keyed0 = veorq_u64(data0, key0);
+        uint64x2_t keyed1 = veorq_u64(data1, key1);
+        acc0 = vaddq_u64(acc0, vextq_u64(data0, data0, 1));
+        acc1 = vaddq_u64(acc1, vextq_u64(data1, data1, 1));
+        acc0 = vmlal_u32(acc0, vmovn_u64(keyed0), vshrn_n_u64(keyed0, 32));
+        acc1 = vmlal_u32(acc1, vmovn_u64(keyed1), vshrn_n_u64(keyed1, 32));
+    }
+    vst1q_u64(acc, acc0);
+    vst1q_u64(acc + 2, acc1);
+}
+#elif defined(__SSE2__)
+void AccumulateStripes(uint64_t acc[4], const uint8_t* data, size_t stripes) {
+    __m128i acc0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc));
+    __m128i acc1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 2));
+    const __m128i key0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kKeys));
+    const __m128i key1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kKeys + 2));
+    for (size_t i = 0; i < stripes; ++i, data += kStripeBytes) {
+        __m128i data0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i data1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+        __m128i keyed0 = _mm_xor_si128(data0, key0);
+        __m128i keyed1 = _mm_xor_si128(data1, key1);
+        acc0 = _mm_add_epi64(acc0, _mm_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc1 = _mm_add_epi64(acc1, _mm_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc0 = _mm_add_epi64(acc0, _mm_mul_epu32(keyed0, _mm_shuffle_epi32(keyed0, _MM_SHUFFLE(0, 3, 0, 1))));
+        acc1 = _mm_add_epi64(acc1, _mm_mul_epu32(keyed1, _mm_shuffle_epi32(keyed1, _MM_SHUFFLE(0, 3, 0, 1))));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), acc0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), acc1);
+}
+#else
+void AccumulateStripes(uint64_t acc[4], const uint8_t* data, size_t stripes) {
+    for (size_t i = 0; i < stripes; ++i, data += kStripeBytes) {
+        uint64_t words[4];
+        std::memcpy(words, data, sizeof(words));
+        for (size_t lane = 0; lane < 4; ++lane) {
+            uint64_t keyed = words[lane] ^ kKeys[lane];
+            acc[lane] += words[lane ^ 1] + (keyed & 0xFFFFFFFFu) * (keyed >> 32);
+        }
+    }
+}
+#endif
+
+void Scramble(uint64_t acc[4]) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+        acc[lane] = ((acc[lane] ^ (acc[lane] >> 47)) ^ kKeys[lane]) * kPrime32;
+    }
+}
+
+uint64_t Avalanche(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+uint64_t Rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+} // namespace
+
+ShaderHash HashSpirv(const void* code, size_t size) {
+    uint64_t acc[4] = {kPrime32, kPrime64a, kPrime64b, kPrime64a ^ kPrime64b};
+    const uint8_t* data = static_cast<const uint8_t*>(code);
+    size_t stripes = size / kStripeBytes;
+    for (size_t done = 0; done < stripes; done += kStripesPerScramble) {
+        size_t count = stripes - done < kStripesPerScramble ? stripes - done : kStripesPerScramble;
+        AccumulateStripes(acc, data + done * kStripeBytes, count);
+        if (count == kStripesPerScramble) {
+            Scramble(acc);
+        }
+    }
+
+    // Zero padding is told apart from real zeros by the length
+    if (size_t tail = size % kStripeBytes) {
+        uint8_t last[kStripeBytes] = {};
+        std::memcpy(last, data + stripes * kStripeBytes, tail);
+        AccumulateStripes(acc, last, 1);
+    }
+
+    uint64_t length = static_cast<uint64_t>(size);
+    ShaderHash hash;
+    hash.low = Avalanche(acc[0] ^ Rotate(acc[1], 17) ^ Rotate(acc[2], 31) ^ Rotate(acc[3], 47) ^
+                         length * kPrime64a);
+    hash.high = Avalanche(acc[3] + Rotate(acc[2], 13) + Rotate(acc[1], 29) + Rotate(acc[0], 43) +
+                          (length ^ hash.low) * kPrime64b);
+    return hash;
+}
+
+std::string ShaderHashToHex(const ShaderHash& hash) {
+    static constexpr char kDigits[] = "0123456789abcdef";
+    std::string hex(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        hex[15 - i] = kDigits[(hash.high >> (4 * i)) & 0xF];
+        hex[31 - i] = kDigits[(hash.low >> (4 * i)) & 0xF];
+    }
+    return hex;
+}
+
+bool ParseShaderHash(std::string_view hex, ShaderHash& hash) {
+    if (hex.size() != 32) return false;
+    ShaderHash result;
+    for (size_t i = 0; i < 32; ++i) {
+        char c = hex[i];
+        uint64_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        uint64_t& half = i < 16 ? result.high : result.low;
+        half = half << 4 | digit;
+    }
+    hash = result;
+    return true;
+}
@@ -0,0 +1,30 @@
+// spirv_hash.h - 128-bit identity hash of SPIR-V blobs
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Names a shader across runs and devices: replacement files and profile
+// rules refer to it. Not cryptographic.
+struct ShaderHash {
+    uint64_t high{0};
+    uint64_t low{0};
+
+    bool operator==(const ShaderHash&) const = default;
+    bool IsZero() const { return (high | low) == 0; }
+};
+
+struct ShaderHashHasher {
+    size_t operator()(const ShaderHash& hash) const { return static_cast<size_t>(hash.low); }
+};
+
+// Hashes 32 bytes per step with NEON on arm64 and SSE2 on x86-64 hosts,
+// and has a scalar fallback; all three produce the same value
+ShaderHash HashSpirv(const void* code, size_t size);
+
+// 32 lower-case hex digits, high half first
+std::string ShaderHashToHex(const ShaderHash& hash);
+bool ParseShaderHash(std::string_view hex, ShaderHash& hash);
@@ -0,0 +1,112 @@
+// subgroup_size.cpp - Required subgroup sizes for pipeline stages
+
+#include "subgroup_size.h"
+
+#include <bit>
+
+#include "log.h"
+
+std::unique_ptr<SubgroupSizeControl> SubgroupSizeControl::Create(
+    VkPhysicalDevice physical_device,
+    const InstanceDispatch& instance_dispatch,
+    const VkPhysicalDeviceProperties& properties,
+    bool feature_enabled) {
+
+    if (!feature_enabled || !instance_dispatch.GetPhysicalDeviceProperties2) {
+        return nullptr;
+    }
+
+    VkPhysicalDeviceSubgroupSizeControlProperties subgroup_properties{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+                                            &subgroup_properties};
+    instance_dispatch.GetPhysicalDeviceProperties2(physical_device, &properties2);
+    if (!(subgroup_properties.requiredSubgroupSizeStages & kStages)) {
+        return nullptr;
+    }
+
+    XCLIPSE_LOGI("subgroup sizes %u-%u can be required for stages 0x%x",
+                 subgroup_properties.minSubgroupSize, subgroup_properties.maxSubgroupSize,
+                 subgroup_properties.requiredSubgroupSizeStages & kStages);
+    return std::unique_ptr<SubgroupSizeControl>(new SubgroupSizeControl(
+        subgroup_properties, properties.limits.maxComputeWorkGroupInvocations));
+}
+
+SubgroupSizeControl::SubgroupSizeControl(
+    const VkPhysicalDeviceSubgroupSizeControlProperties& properties,
+    uint32_t max_workgroup_invocations)
+    : min_size_(properties.minSubgroupSize),
+      max_size_(properties.maxSubgroupSize),
+      max_workgroup_subgroups_(properties.maxComputeWorkgroupSubgroups),
+      max_workgroup_invocations_(max_workgroup_invocations),
+      stages_(properties.requiredSubgroupSizeStages & kStages) {}
+
+bool SubgroupSizeControl::Supports(uint32_t size) const {
+    return std::has_single_bit(size) && size >= min_size_ && size <= max_size_;
+}
+
+bool SubgroupSizeControl::CanRequire(const VkPipelineShaderStageCreateInfo& stage, uint32_t size) const {
+    constexpr VkPipelineShaderStageCreateFlags kAppChoice =
+        VK_PIPELINE_SHADER_STAGE_CREATE_ALLOW_VARYING_SUBGROUP_SIZE_BIT |
+        VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT;
+    if (!Supports(size) || !(stage.stage & stages_) || (stage.flags & kAppChoice)) {
+        return false;
+    }
+    if (stage.stage == VK_SHADER_STAGE_COMPUTE_BIT &&
+        uint64_t{max_workgroup_subgroups_} * size < max_workgroup_invocations_) {
+        return false;
+    }
+    for (auto* next = static_cast<const VkBaseInStructure*>(stage.pNext); next; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SubgroupSizeControl::Chain(VkPipelineShaderStageCreateInfo& stage, uint32_t size,
+                                ScratchArena& arena) {
+    auto* required = arena.Allocate<VkPipelineShaderStageRequiredSubgroupSizeCreateInfo>(1);
+    required->sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO;
+    required->pNext = const_cast<void*>(stage.pNext);
+    required->requiredSubgroupSize = size;
+    stage.pNext = required;
+    required_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SubgroupSizeControl::Require(VkGraphicsPipelineCreateInfo& info, uint32_t size,
+                                  ScratchArena& arena) {
+    if (size == 0 || info.stageCount == 0) {
+        return;
+    }
+    VkPipelineShaderStageCreateInfo* stages = nullptr;
+    for (uint32_t i = 0; i < info.stageCount; ++i) {
+        if (!CanRequire(info.pStages[i], size)) {
+            skipped_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (!stages) {
+            stages = arena.CopyArray(info.pStages, info.stageCount);
+            info.pStages = stages;
+        }
+        Chain(stages[i], size, arena);
+    }
+}
+
+void SubgroupSizeControl::Require(VkComputePipelineCreateInfo& info, uint32_t size,
+                                  ScratchArena& arena) {
+    if (size == 0) {
+        return;
+    }
+    if (!CanRequire(info.stage, size)) {
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Chain(info.stage, size, arena);
+}
+
+void SubgroupSizeControl::LogStats() const {
+    XCLIPSE_LOGI("subgroup size: required for %llu stages, %llu stages left to the driver",
+                 static_cast<unsigned long long>(required_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(skipped_.load(std::memory_order_relaxed)));
+}
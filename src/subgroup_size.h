@@ -0,0 +1,67 @@
+// subgroup_size.h - Required subgroup sizes for pipeline stages
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "dispatch.h"
+#include "scratch_arena.h"
+
+// RDNA runs shaders in wave32 or wave64 and the driver picks per shader,
+// mostly wave64 for compute. This chains
+// VkPipelineShaderStageRequiredSubgroupSizeCreateInfo into the stages the
+// profile asks for, where that is valid without looking into the SPIR-V:
+//
+//  - the device reports the size and the stage in requiredSubgroupSizeStages
+//  - the app did not choose itself: no required size of its own, no
+//    ALLOW_VARYING or REQUIRE_FULL_SUBGROUPS flag (the latter constrains
+//    the workgroup size)
+//  - for compute, any workgroup the device allows still fits in
+//    maxComputeWorkgroupSubgroups subgroups of the size
+//
+// Task and mesh stages have workgroup limits of their own and are left alone.
+class SubgroupSizeControl {
+public:
+    // Returns nullptr unless the app enabled subgroupSizeControl and the
+    // device can require a size in some stage
+    static std::unique_ptr<SubgroupSizeControl> Create(VkPhysicalDevice physical_device,
+                                                       const InstanceDispatch& instance_dispatch,
+                                                       const VkPhysicalDeviceProperties& properties,
+                                                       bool feature_enabled);
+
+    SubgroupSizeControl(const SubgroupSizeControl&) = delete;
+    SubgroupSizeControl& operator=(const SubgroupSizeControl&) = delete;
+
+    // False if size can never be required here, so a setting can be
+    // rejected once instead of per pipeline
+    bool Supports(uint32_t size) const;
+
+    // Rewrites info, through copies in arena, to require size in every
+    // stage where that is valid; 0 leaves info alone
+    void Require(VkGraphicsPipelineCreateInfo& info, uint32_t size, ScratchArena& arena);
+    void Require(VkComputePipelineCreateInfo& info, uint32_t size, ScratchArena& arena);
+
+    void LogStats() const;
+
+private:
+    static constexpr VkShaderStageFlags kStages =
+        VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+    SubgroupSizeControl(const VkPhysicalDeviceSubgroupSizeControlProperties& properties,
+                        uint32_t max_workgroup_invocations);
+
+    bool CanRequire(const VkPipelineShaderStageCreateInfo& stage, uint32_t size) const;
+    void Chain(VkPipelineShaderStageCreateInfo& stage, uint32_t size, ScratchArena& arena);
+
+    uint32_t min_size_;
+    uint32_t max_size_;
+    uint32_t max_workgroup_subgroups_;
+    uint32_t max_workgroup_invocations_;
+    VkShaderStageFlags stages_;  // requiredSubgroupSizeStages within kStages
+
+    std::atomic<uint64_t> required_{0};  // stages
+    std::atomic<uint64_t> skipped_{0};   // stages a size was asked for but not valid
+};
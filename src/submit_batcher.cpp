@@ -0,0 +1,285 @@
+// submit_batcher.cpp - Opt-in coalescing of small vkQueueSubmit calls within a frame
+
+#include "submit_batcher.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "log.h"
+#include "scratch_arena.h"
+
+namespace {
+
+void RecordMax(std::atomic<uint64_t>& max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+template <typename T>
+uint32_t Append(std::vector<T>& to, const T* values, uint32_t count) {
+    uint32_t offset = static_cast<uint32_t>(to.size());
+    if (count) {
+        to.insert(to.end(), values, values + count);
+    }
+    return offset;
+}
+
+} // namespace
+
+SubmitBatcher::SubmitBatcher(const DeviceDispatch& dispatch)
+    : queue_submit_(dispatch.QueueSubmit),
+      queue_submit2_(dispatch.QueueSubmit2) {}
+
+bool SubmitBatcher::IsDeferrable(const VkSubmitInfo& submit) {
+    auto* next = static_cast<const VkBaseInStructure*>(submit.pNext);
+    return !next || (next->sType == VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO && !next->pNext);
+}
+
+bool SubmitBatcher::IsDeferrable(const VkSubmitInfo2& submit) {
+    // Chained structs on the per-semaphore and per-command-buffer infos
+    // would be left pointing into the app's memory
+    auto plain = [](const auto& info) { return info.pNext == nullptr; };
+    return !submit.pNext && submit.flags == 0 &&
+           std::all_of(submit.pWaitSemaphoreInfos,
+                       submit.pWaitSemaphoreInfos + submit.waitSemaphoreInfoCount, plain) &&
+           std::all_of(submit.pCommandBufferInfos,
+                       submit.pCommandBufferInfos + submit.commandBufferInfoCount, plain) &&
+           std::all_of(submit.pSignalSemaphoreInfos,
+                       submit.pSignalSemaphoreInfos + submit.signalSemaphoreInfoCount, plain);
+}
+
+void SubmitBatcher::Defer(QueueBatch& batch, const VkSubmitInfo& submit) {
+    DeferredSubmit deferred{};
+    deferred.wait_count = submit.waitSemaphoreCount;
+    deferred.wait_offset = Append(batch.semaphores, submit.pWaitSemaphores, submit.waitSemaphoreCount);
+    Append(batch.wait_stages, submit.pWaitDstStageMask, submit.waitSemaphoreCount);
+    deferred.command_buffer_count = submit.commandBufferCount;
+    deferred.command_buffer_offset =
+        Append(batch.command_buffers, submit.pCommandBuffers, submit.commandBufferCount);
+    deferred.signal_count = submit.signalSemaphoreCount;
+    deferred.signal_offset =
+        Append(batch.semaphores, submit.pSignalSemaphores, submit.signalSemaphoreCount);
+    // Keep wait_stages index-aligned with semaphores
+    batch.wait_stages.resize(batch.semaphores.size());
+
+    if (submit.pNext) {
+        auto* timeline = static_cast<const VkTimelineSemaphoreSubmitInfo*>(submit.pNext);
+        deferred.timeline = true;
+        deferred.wait_value_count = timeline->waitSemaphoreValueCount;
+        deferred.wait_value_offset =
+            Append(batch.values, timeline->pWaitSemaphoreValues, timeline->waitSemaphoreValueCount);
+        deferred.signal_value_count = timeline->signalSemaphoreValueCount;
+        deferred.signal_value_offset =
+            Append(batch.values, timeline->pSignalSemaphoreValues, timeline->signalSemaphoreValueCount);
+    }
+
+    batch.submits.push_back(deferred);
+    batch.pending.store(static_cast<uint32_t>(batch.submits.size()), std::memory_order_release);
+}
+
+void SubmitBatcher::Defer(QueueBatch& batch, const VkSubmitInfo2& submit) {
+    DeferredSubmit deferred{};
+    deferred.wait_count = submit.waitSemaphoreInfoCount;
+    deferred.wait_offset =
+        Append(batch.semaphore_infos, submit.pWaitSemaphoreInfos, submit.waitSemaphoreInfoCount);
+    deferred.command_buffer_count = submit.commandBufferInfoCount;
+    deferred.command_buffer_offset = Append(batch.command_buffer_infos, submit.pCommandBufferInfos,
+                                            submit.commandBufferInfoCount);
+    deferred.signal_count = submit.signalSemaphoreInfoCount;
+    deferred.signal_offset =
+        Append(batch.semaphore_infos, submit.pSignalSemaphoreInfos, submit.signalSemaphoreInfoCount);
+
+    batch.submits.push_back(deferred);
+    batch.pending.store(static_cast<uint32_t>(batch.submits.size()), std::memory_order_release);
+}
+
+void SubmitBatcher::Clear(QueueBatch& batch) {
+    batch.submits.clear();
+    batch.semaphores.clear();
+    batch.wait_stages.clear();
+    batch.command_buffers.clear();
+    batch.values.clear();
+    batch.semaphore_infos.clear();
+    batch.command_buffer_infos.clear();
+    batch.pending.store(0, std::memory_order_release);
+}
+
+SubmitBatcher::QueueBatch& SubmitBatcher::Batch(VkQueue queue) {
+    std::lock_guard<std::mutex> lock(queues_mutex_);
+    std::unique_ptr<QueueBatch>& batch = queues_[queue];
+    if (!batch) {
+        batch = std::make_unique<QueueBatch>();
+    }
+    return *batch;
+}
+
+VkResult SubmitBatcher::Submit(VkQueue queue, uint32_t count, const VkSubmitInfo* submits,
+                               VkFence fence) {
+    return SubmitImpl(queue, count, submits, fence);
+}
+
+VkResult SubmitBatcher::Submit(VkQueue queue, uint32_t count, const VkSubmitInfo2* submits,
+                               VkFence fence) {
+    return SubmitImpl(queue, count, submits, fence);
+}
+
+template <typename SubmitInfo>
+VkResult SubmitBatcher::SubmitImpl(VkQueue queue, uint32_t count, const SubmitInfo* submits,
+                                   VkFence fence) {
+    constexpr bool submit2 = std::is_same_v<SubmitInfo, VkSubmitInfo2>;
+    app_submits_.fetch_add(1, std::memory_order_relaxed);
+    frame_app_submits_.fetch_add(1, std::memory_order_relaxed);
+
+    QueueBatch& batch = Batch(queue);
+    VkResult result = FlushOthers(queue);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(batch.mutex);
+    // Held submits go out in a single driver call, so they are all one kind
+    if (batch.submit2 != submit2) {
+        result = FlushHeld(queue, batch);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        batch.submit2 = submit2;
+    }
+
+    bool deferrable = fence == VK_NULL_HANDLE &&
+                      batch.submits.size() + count <= kMaxDeferredSubmits &&
+                      std::all_of(submits, submits + count,
+                                  [](const SubmitInfo& submit) { return IsDeferrable(submit); });
+    if (!deferrable) {
+        return FlushLocked(queue, batch, count, submits, fence);
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        Defer(batch, submits[i]);
+    }
+    return VK_SUCCESS;
+}
+
+VkResult SubmitBatcher::FlushOthers(VkQueue except) {
+    std::lock_guard<std::mutex> lock(queues_mutex_);
+    for (auto& [queue, batch] : queues_) {
+        if (queue == except || batch->pending.load(std::memory_order_acquire) == 0) {
+            continue;
+        }
+        std::lock_guard<std::mutex> batch_lock(batch->mutex);
+        VkResult result = FlushHeld(queue, *batch);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+VkResult SubmitBatcher::FlushHeld(VkQueue queue, QueueBatch& batch) {
+    if (batch.submit2) {
+        return FlushLocked(queue, batch, 0, static_cast<const VkSubmitInfo2*>(nullptr), VK_NULL_HANDLE);
+    }
+    return FlushLocked(queue, batch, 0, static_cast<const VkSubmitInfo*>(nullptr), VK_NULL_HANDLE);
+}
+
+VkResult SubmitBatcher::FlushLocked(VkQueue queue, QueueBatch& batch, uint32_t count,
+                                    const VkSubmitInfo* submits, VkFence fence) {
+    if (batch.submits.empty()) {
+        if (count == 0 && fence == VK_NULL_HANDLE) {
+            return VK_SUCCESS;
+        }
+        driver_submits_.fetch_add(1, std::memory_order_relaxed);
+        frame_driver_submits_.fetch_add(1, std::memory_order_relaxed);
+        return queue_submit_(queue, count, submits, fence);
+    }
+
+    ScratchArena::Scope scratch;
+    ScratchArena& arena = scratch.arena();
+
+    uint32_t deferred_count = static_cast<uint32_t>(batch.submits.size());
+    VkSubmitInfo* infos = arena.Allocate<VkSubmitInfo>(deferred_count + count);
+    for (uint32_t i = 0; i < deferred_count; ++i) {
+        const DeferredSubmit& deferred = batch.submits[i];
+        VkSubmitInfo& info = infos[i];
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        info.waitSemaphoreCount = deferred.wait_count;
+        info.pWaitSemaphores = batch.semaphores.data() + deferred.wait_offset;
+        info.pWaitDstStageMask = batch.wait_stages.data() + deferred.wait_offset;
+        info.commandBufferCount = deferred.command_buffer_count;
+        info.pCommandBuffers = batch.command_buffers.data() + deferred.command_buffer_offset;
+        info.signalSemaphoreCount = deferred.signal_count;
+        info.pSignalSemaphores = batch.semaphores.data() + deferred.signal_offset;
+
+        if (deferred.timeline) {
+            auto* timeline = arena.Allocate<VkTimelineSemaphoreSubmitInfo>(1);
+            timeline->sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline->waitSemaphoreValueCount = deferred.wait_value_count;
+            timeline->pWaitSemaphoreValues = batch.values.data() + deferred.wait_value_offset;
+            timeline->signalSemaphoreValueCount = deferred.signal_value_count;
+            timeline->pSignalSemaphoreValues = batch.values.data() + deferred.signal_value_offset;
+            info.pNext = timeline;
+        }
+    }
+    std::copy(submits, submits + count, infos + deferred_count);
+
+    driver_submits_.fetch_add(1, std::memory_order_relaxed);
+    frame_driver_submits_.fetch_add(1, std::memory_order_relaxed);
+    VkResult result = queue_submit_(queue, deferred_count + count, infos, fence);
+    Clear(batch);
+    return result;
+}
+
+VkResult SubmitBatcher::FlushLocked(VkQueue queue, QueueBatch& batch, uint32_t count,
+                                    const VkSubmitInfo2* submits, VkFence fence) {
+    if (batch.submits.empty()) {
+        if (count == 0 && fence == VK_NULL_HANDLE) {
+            return VK_SUCCESS;
+        }
+        driver_submits_.fetch_add(1, std::memory_order_relaxed);
+        frame_driver_submits_.fetch_add(1, std::memory_order_relaxed);
+        return queue_submit2_(queue, count, submits, fence);
+    }
+
+    ScratchArena::Scope scratch;
+    ScratchArena& arena = scratch.arena();
+
+    uint32_t deferred_count = static_cast<uint32_t>(batch.submits.size());
+    VkSubmitInfo2* infos = arena.Allocate<VkSubmitInfo2>(deferred_count + count);
+    for (uint32_t i = 0; i < deferred_count; ++i) {
+        const DeferredSubmit& deferred = batch.submits[i];
+        VkSubmitInfo2& info = infos[i];
+        info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+        info.waitSemaphoreInfoCount = deferred.wait_count;
+        info.pWaitSemaphoreInfos = batch.semaphore_infos.data() + deferred.wait_offset;
+        info.commandBufferInfoCount = deferred.command_buffer_count;
+        info.pCommandBufferInfos = batch.command_buffer_infos.data() + deferred.command_buffer_offset;
+        info.signalSemaphoreInfoCount = deferred.signal_count;
+        info.pSignalSemaphoreInfos = batch.semaphore_infos.data() + deferred.signal_offset;
+    }
+    std::copy(submits, submits + count, infos + deferred_count);
+
+    driver_submits_.fetch_add(1, std::memory_order_relaxed);
+    frame_driver_submits_.fetch_add(1, std::memory_order_relaxed);
+    VkResult result = queue_submit2_(queue, deferred_count + count, infos, fence);
+    Clear(batch);
+    return result;
+}
+
+void SubmitBatcher::OnFrameBoundary() {
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    RecordMax(max_frame_app_submits_, frame_app_submits_.exchange(0, std::memory_order_relaxed));
+    RecordMax(max_frame_driver_submits_, frame_driver_submits_.exchange(0, std::memory_order_relaxed));
+}
+
+void SubmitBatcher::LogStats() const {
+    uint64_t frames = std::max<uint64_t>(frames_.load(std::memory_order_relaxed), 1);
+    XCLIPSE_LOGI("submit batching: %.1f app submits/frame (max %llu) -> %.1f driver submits/frame "
+                 "(max %llu) over %llu frames",
+                 static_cast<double>(app_submits_.load(std::memory_order_relaxed)) / frames,
+                 static_cast<unsigned long long>(max_frame_app_submits_.load(std::memory_order_relaxed)),
+                 static_cast<double>(driver_submits_.load(std::memory_order_relaxed)) / frames,
+                 static_cast<unsigned long long>(max_frame_driver_submits_.load(std::memory_order_relaxed)),
+                 static_cast<unsigned long long>(frames_.load(std::memory_order_relaxed)));
+}
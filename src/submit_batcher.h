@@ -0,0 +1,126 @@
+// submit_batcher.h - Opt-in coalescing of small vkQueueSubmit calls within a frame
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "dispatch.h"
+
+// Some translated titles issue dozens of tiny vkQueueSubmit calls a frame,
+// each a kernel ioctl. Fence-less submits whose only chained struct is
+// VkTimelineSemaphoreSubmitInfo, and fence-less vkQueueSubmit2 submits with
+// no flags or chained structs, are deep-copied and held back. They go to
+// the driver as one call, in their original order, when:
+//  - the queue gets a fenced or non-deferrable submit (the held submits are
+//    prepended to it);
+//  - any other queue of the device submits, since a binary semaphore wait
+//    must be submitted after its signal;
+//  - the queue presents, binds sparse memory or waits idle;
+//  - the host waits on or polls semaphores, events or queries;
+//  - the queue gets a submit through the other entry point.
+// Fences never need a flush: deferred submits carry none, and a fenced
+// submit flushes everything before it.
+//
+// All queue operations go through the queue's lock, because a flush can
+// submit to a queue from another thread. Errors from held submits surface
+// on the call that flushes them.
+class SubmitBatcher {
+public:
+    explicit SubmitBatcher(const DeviceDispatch& dispatch);
+
+    SubmitBatcher(const SubmitBatcher&) = delete;
+    SubmitBatcher& operator=(const SubmitBatcher&) = delete;
+
+    VkResult Submit(VkQueue queue, uint32_t count, const VkSubmitInfo* submits, VkFence fence);
+    VkResult Submit(VkQueue queue, uint32_t count, const VkSubmitInfo2* submits, VkFence fence);
+
+    // Flushes every queue, then runs fn on queue with nothing else
+    // submitting to it
+    template <typename Fn>
+    VkResult Exclusive(VkQueue queue, Fn&& fn) {
+        QueueBatch& batch = Batch(queue);
+        VkResult result = FlushOthers(queue);
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        if (result == VK_SUCCESS) {
+            result = FlushHeld(queue, batch);
+        }
+        return result == VK_SUCCESS ? fn() : result;
+    }
+
+    // Before a host wait that could observe deferred work
+    VkResult FlushAll() { return FlushOthers(VK_NULL_HANDLE); }
+
+    // Closes the per-frame submit counters
+    void OnFrameBoundary();
+
+    void LogStats() const;
+
+private:
+    // Above this many held submits the batch is flushed early
+    static constexpr size_t kMaxDeferredSubmits = 256;
+
+    // Offsets into the batch's arrays; pointers are rebuilt at flush. For
+    // vkQueueSubmit2 submits the semaphore and command buffer offsets index
+    // semaphore_infos and command_buffer_infos, and there are no values.
+    struct DeferredSubmit {
+        uint32_t wait_offset, wait_count;
+        uint32_t command_buffer_offset, command_buffer_count;
+        uint32_t signal_offset, signal_count;
+        bool timeline;
+        uint32_t wait_value_offset, wait_value_count;
+        uint32_t signal_value_offset, signal_value_count;
+    };
+
+    // Capacity is kept across flushes, so steady-state deferral does not
+    // touch the heap
+    struct QueueBatch {
+        std::mutex mutex;
+        std::atomic<uint32_t> pending{0};
+        std::vector<DeferredSubmit> submits;
+        std::vector<VkSemaphore> semaphores;
+        std::vector<VkPipelineStageFlags> wait_stages;  // parallel to the wait semaphores
+        std::vector<VkCommandBuffer> command_buffers;
+        std::vector<uint64_t> values;
+        std::vector<VkSemaphoreSubmitInfo> semaphore_infos;
+        std::vector<VkCommandBufferSubmitInfo> command_buffer_infos;
+        bool submit2{false};  // which entry point the held submits came through
+    };
+
+    static bool IsDeferrable(const VkSubmitInfo& submit);
+    static bool IsDeferrable(const VkSubmitInfo2& submit);
+    static void Defer(QueueBatch& batch, const VkSubmitInfo& submit);
+    static void Defer(QueueBatch& batch, const VkSubmitInfo2& submit);
+    static void Clear(QueueBatch& batch);
+
+    template <typename SubmitInfo>
+    VkResult SubmitImpl(VkQueue queue, uint32_t count, const SubmitInfo* submits, VkFence fence);
+
+    QueueBatch& Batch(VkQueue queue);
+    VkResult FlushOthers(VkQueue except);
+    // Held submits only
+    VkResult FlushHeld(VkQueue queue, QueueBatch& batch);
+    VkResult FlushLocked(VkQueue queue, QueueBatch& batch, uint32_t count,
+                         const VkSubmitInfo* submits, VkFence fence);
+    VkResult FlushLocked(VkQueue queue, QueueBatch& batch, uint32_t count,
+                         const VkSubmitInfo2* submits, VkFence fence);
+
+    PFN_vkQueueSubmit queue_submit_;
+    PFN_vkQueueSubmit2 queue_submit2_;
+
+    std::mutex queues_mutex_;  // taken before any batch mutex, never after
+    std::unordered_map<VkQueue, std::unique_ptr<QueueBatch>> queues_;
+
+    std::atomic<uint64_t> app_submits_{0};
+    std::atomic<uint64_t> driver_submits_{0};
+    std::atomic<uint64_t> frame_app_submits_{0};
+    std::atomic<uint64_t> frame_driver_submits_{0};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> max_frame_app_submits_{0};
+    std::atomic<uint64_t> max_frame_driver_submits_{0};
+};
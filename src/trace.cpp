@@ -0,0 +1,232 @@
+// trace.cpp - Opt-in timeline of layer entry points, exported as a Chrome JSON trace
+
+#include "trace.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <iterator>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "layer_paths.h"
+#include "log.h"
+
+namespace {
+
+struct TraceEventInfo {
+    const char* name;
+    const char* category;
+    const char* arg_name;  // null if the event has no argument
+};
+
+constexpr TraceEventInfo kEventInfo[] = {
+    {"vkCreateGraphicsPipelines", "pipeline", "pipelines"},
+    {"vkCreateComputePipelines", "pipeline", "pipelines"},
+    {"vkQueueSubmit", "submit", "submits"},
+    {"vkQueueSubmit2", "submit", "submits"},
+    {"vkQueuePresentKHR", "present", nullptr},
+    {"vkAllocateMemory", "memory", "bytes"},
+    {"vkFreeMemory", "memory", nullptr},
+    {"vkWaitForFences", "wait", "fences"},
+    {"vkWaitSemaphores", "wait", "semaphores"},
+    {"vkQueueWaitIdle", "wait", nullptr},
+    {"vkDeviceWaitIdle", "wait", nullptr},
+};
+static_assert(std::size(kEventInfo) == static_cast<size_t>(TraceEvent::kCount));
+
+// steady_clock is CLOCK_MONOTONIC, which stops during suspend
+int64_t BoottimeOffsetNs() {
+#if defined(CLOCK_BOOTTIME)
+    timespec boottime{};
+    uint64_t steady = SteadyNanoseconds();
+    if (clock_gettime(CLOCK_BOOTTIME, &boottime) == 0) {
+        return static_cast<int64_t>(boottime.tv_sec) * 1000000000 + boottime.tv_nsec -
+               static_cast<int64_t>(steady);
+    }
+#endif
+    return 0;
+}
+
+void AppendJsonString(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Microseconds with nanosecond digits, as the format expects
+void AppendMicroseconds(std::string& out, uint64_t nanoseconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%" PRIu64 ".%03u", nanoseconds / 1000,
+                  static_cast<unsigned>(nanoseconds % 1000));
+    out += text;
+}
+
+} // namespace
+
+thread_local bool Tracer::thread_ring_assigned_ = false;
+thread_local Tracer::ThreadRing* Tracer::thread_ring_ = nullptr;
+
+Tracer& Tracer::Shared() {
+    // Never destroyed: threads may still record while the process exits
+    static Tracer* tracer = new Tracer();
+    return *tracer;
+}
+
+void Tracer::Enable(std::string export_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    export_path_ = std::move(export_path);
+    enabled_.store(true, std::memory_order_relaxed);
+    XCLIPSE_LOGI("tracing layer calls to %s", export_path_.empty() ? "(nowhere)" : export_path_.c_str());
+}
+
+Tracer::ThreadRing* Tracer::RingForThisThread() {
+    if (thread_ring_assigned_) [[likely]] {
+        return thread_ring_;
+    }
+    thread_ring_assigned_ = true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (rings_.size() == kMaxThreads) {
+        untraced_threads_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    // Rings outlive their threads so the export still has their events
+    auto ring = std::make_unique<ThreadRing>();
+    ring->tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    thread_ring_ = ring.get();
+    rings_.push_back(std::move(ring));
+    return thread_ring_;
+}
+
+void Tracer::Record(TraceEvent event, uint64_t start_ns, uint64_t end_ns, uint64_t arg) {
+    ThreadRing* ring = RingForThisThread();
+    if (!ring) {
+        return;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Slot& slot = ring->slots[head % kEventsPerThread];
+    slot.start_ns.store(start_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+    slot.arg.store(arg, std::memory_order_relaxed);
+    slot.event.store(event, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::Export() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ExportLocked();
+}
+
+void Tracer::ExportIfRecorded() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (RecordedCountLocked() != exported_count_) {
+        ExportLocked();
+    }
+}
+
+uint64_t Tracer::RecordedCountLocked() const {
+    uint64_t count = 0;
+    for (const std::unique_ptr<ThreadRing>& ring : rings_) {
+        count += ring->head.load(std::memory_order_acquire);
+    }
+    return count;
+}
+
+void Tracer::ExportLocked() {
+    if (!enabled_.load(std::memory_order_relaxed) || export_path_.empty()) {
+        return;
+    }
+
+    int64_t offset_ns = BoottimeOffsetNs();
+    uint32_t pid = static_cast<uint32_t>(getpid());
+    char prefix[64];
+    std::snprintf(prefix, sizeof(prefix), "\"ph\":\"X\",\"pid\":%u,\"tid\":", pid);
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) +
+            ",\"args\":{\"name\":";
+    AppendJsonString(json, GetProcessName());
+    json += "}}";
+
+    uint64_t exported = 0;
+    uint64_t overwritten = 0;
+    uint64_t recorded = 0;
+    for (const std::unique_ptr<ThreadRing>& ring : rings_) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        recorded += head;
+        uint64_t first = head > kEventsPerThread ? head - kEventsPerThread : 0;
+
+        struct Copy {
+            uint64_t start_ns, duration_ns, arg;
+            TraceEvent event;
+        };
+        std::vector<Copy> copies;
+        copies.reserve(head - first);
+        for (uint64_t i = first; i < head; ++i) {
+            const Slot& slot = ring->slots[i % kEventsPerThread];
+            copies.push_back({slot.start_ns.load(std::memory_order_relaxed),
+                              slot.duration_ns.load(std::memory_order_relaxed),
+                              slot.arg.load(std::memory_order_relaxed),
+                              slot.event.load(std::memory_order_relaxed)});
+        }
+
+        // Whatever the owner lapped while we copied is torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t new_head = ring->head.load(std::memory_order_relaxed);
+        uint64_t valid_from = new_head > kEventsPerThread ? new_head - kEventsPerThread : 0;
+        overwritten += valid_from;
+
+        std::string tid = std::to_string(ring->tid);
+        for (uint64_t i = std::max(first, valid_from); i < head; ++i) {
+            const Copy& copy = copies[i - first];
+            if (copy.event >= TraceEvent::kCount) continue;
+            const TraceEventInfo& info = kEventInfo[static_cast<size_t>(copy.event)];
+
+            json += ",\n{\"name\":\"";
+            json += info.name;
+            json += "\",\"cat\":\"";
+            json += info.category;
+            json += "\",";
+            json += prefix;
+            json += tid;
+            json += ",\"ts\":";
+            AppendMicroseconds(json, static_cast<uint64_t>(static_cast<int64_t>(copy.start_ns) + offset_ns));
+            json += ",\"dur\":";
+            AppendMicroseconds(json, copy.duration_ns);
+            if (info.arg_name) {
+                json += ",\"args\":{\"";
+                json += info.arg_name;
+                json += "\":";
+                json += std::to_string(copy.arg);
+                json += '}';
+            }
+            json += '}';
+            exported++;
+        }
+    }
+    json += "\n]}\n";
+
+    if (!WriteFileAtomically(export_path_, json)) {
+        XCLIPSE_LOGW("could not write trace to %s", export_path_.c_str());
+        return;
+    }
+    exported_count_ = recorded;
+    XCLIPSE_LOGI("trace: %llu events from %zu threads (%llu overwritten, %u threads untraced)",
+                 static_cast<unsigned long long>(exported), rings_.size(),
+                 static_cast<unsigned long long>(overwritten),
+                 untraced_threads_.load(std::memory_order_relaxed));
+}
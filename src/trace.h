@@ -0,0 +1,122 @@
+// trace.h - Opt-in timeline of layer entry points, exported as a Chrome JSON trace
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "clock.h"
+
+enum class TraceEvent : uint8_t {
+    kCreateGraphicsPipelines,
+    kCreateComputePipelines,
+    kQueueSubmit,
+    kQueueSubmit2,
+    kQueuePresent,
+    kAllocateMemory,
+    kFreeMemory,
+    kWaitForFences,
+    kWaitSemaphores,
+    kQueueWaitIdle,
+    kDeviceWaitIdle,
+    kCount
+};
+
+// Each thread records into its own ring, so recording never locks or
+// shares a cache line with another thread; when a ring wraps, its oldest
+// events are overwritten. Timestamps are exported on CLOCK_BOOTTIME, the
+// clock Perfetto's Android system traces use, so the file can be opened
+// next to one in ui.perfetto.dev (which also reads this JSON format).
+class Tracer {
+public:
+    static constexpr uint32_t kEventsPerThread = 4096;
+    static constexpr uint32_t kMaxThreads = 64;
+
+    static Tracer& Shared();
+
+    // The only cost of a traced call while this is off. Once on, tracing
+    // stays on for the life of the process.
+    static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // The first call picks the export path
+    void Enable(std::string export_path);
+
+    void Record(TraceEvent event, uint64_t start_ns, uint64_t end_ns, uint64_t arg);
+
+    // Writes every ring's events to the export path. Threads may keep
+    // recording meanwhile; events overwritten while being copied are left out.
+    void Export();
+
+    // Export(), skipped when nothing was recorded since the last one. Device
+    // dumper threads call this periodically so a process that is killed
+    // before it destroys its device still leaves a recent trace behind.
+    void ExportIfRecorded();
+
+private:
+    // Fields are atomics so the exporter's reads are not a data race; the
+    // ring's head tells it which copies are whole
+    struct Slot {
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> duration_ns{0};
+        std::atomic<uint64_t> arg{0};
+        std::atomic<TraceEvent> event{TraceEvent::kCount};
+    };
+
+    struct ThreadRing {
+        uint32_t tid{0};
+        std::atomic<uint64_t> head{0};  // events ever recorded; written by the owner only
+        Slot slots[kEventsPerThread];
+    };
+
+    Tracer() = default;
+
+    ThreadRing* RingForThisThread();
+    void ExportLocked();
+    // Events recorded so far, across all rings; needs mutex_
+    uint64_t RecordedCountLocked() const;
+
+    static inline std::atomic<bool> enabled_{false};
+    // Set once the thread has asked for a ring; null after that means it got none
+    static thread_local bool thread_ring_assigned_;
+    static thread_local ThreadRing* thread_ring_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadRing>> rings_;  // never shrinks
+    std::atomic<uint32_t> untraced_threads_{0};       // arrived after kMaxThreads
+    std::string export_path_;
+    uint64_t exported_count_{0};  // RecordedCountLocked() at the last export
+};
+
+// Times the enclosing scope. Only Traced() creates one, once it has seen
+// that tracing is on.
+class TraceScope {
+public:
+    explicit TraceScope(TraceEvent event, uint64_t arg = 0)
+        : start_ns_(SteadyNanoseconds()), arg_(arg), event_(event) {}
+
+    ~TraceScope() { Tracer::Shared().Record(event_, start_ns_, SteadyNanoseconds(), arg_); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    uint64_t start_ns_;
+    uint64_t arg_;
+    TraceEvent event_;
+};
+
+// Runs body and returns its result, timing it when tracing is on. Testing
+// the flag once up front is the only branch a call pays while tracing is
+// off; a scope object that checked it again on the way out would pay two.
+template <typename Body>
+inline decltype(auto) Traced(TraceEvent event, uint64_t arg, Body&& body) {
+    if (!Tracer::Enabled()) [[likely]] {
+        return body();
+    }
+    TraceScope scope(event, arg);
+    return body();
+}
@@ -3,36 +3,113 @@
 
 #include <vulkan/vulkan.h>
 #include <cstdint>
-#include <mutex>
-#include <unordered_map>
+#include <string>
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <bit>
+
+#include "async_compute.h"
+#include "command_buffer_profile.h"
+#include "compile_pool.h"
+#include "dedicated_allocation.h"
+#include "dispatch_key_map.h"
+#include "frame_timing.h"
+#include "gpu_profiler.h"
+#include "layer_paths.h"
+#include "log.h"
+#include "mapping_cache.h"
+#include "memory_budget.h"
+#include "memory_suballocator.h"
+#include "memory_type_policy.h"
+#include "pipeline_cache.h"
+#include "pipeline_registry.h"
+#include "pipeline_rules.h"
+#include "pipeline_stats.h"
+#include "scratch_arena.h"
+#include "shader_modules.h"
+#include "subgroup_size.h"
+#include "submit_batcher.h"
+#include "trace.h"
+#include "xclipse_wrapper.h"
 
 class Xclipse940Wrapper {
 private:
     static constexpr uint32_t kComputeUnits = 12;
-    static constexpr uint32_t kWavefrontSize = 32;
     static constexpr uint32_t kCacheLineSize = 64;
+    // Vertex, tessellation x2, geometry, fragment; task/mesh pipelines fit too
+    static constexpr uint32_t kMaxFeedbackStages = 8;
     
-    struct PipelineState {
-        VkPipeline pipeline;
-        uint64_t usage_count{0};
-        VkPipelineBindPoint bind_point;
-        uint32_t shader_stages{0};
-    };
-    
+    // Per-VkDevice state, owned by the registry and keyed by dispatch key.
+    // Queues and command buffers share their device's key.
     struct DeviceContext {
+        DeviceDispatch dispatch;
         VkPhysicalDevice physical_device;
         VkDevice device;
         VkPhysicalDeviceProperties properties{};
         VkPhysicalDeviceMemoryProperties memory_properties{};
+        DeviceExtensions extensions;
+        
+        // Declared before suballocator, which reports its blocks here
+        std::unique_ptr<MemoryBudgetTracker> memory_budget;
+        
+        // Frame pacing as seen from vkQueuePresentKHR
+        std::unique_ptr<FrameTimer> frame_timer;
+        
+        PipelineRegistry pipelines;
+        std::unique_ptr<PipelineCompileStats> compile_stats;
+        // Substituted when the app compiles without a cache; may be null
+        std::unique_ptr<PersistentPipelineCache> pipeline_cache;
+        
+        // SPIR-V hash of every live shader module
+        std::unique_ptr<ShaderModuleTracker> shader_modules;
+        
+        // Profile rules that rewrite matching pipelines; may be null
+        std::unique_ptr<PipelineRules> pipeline_rules;
+        
+        // Null unless the app enabled subgroupSizeControl
+        std::unique_ptr<SubgroupSizeControl> subgroup_size;
+        uint32_t compute_subgroup_size{0};  // validated against the device; 0 when unset
+        
+        // Opt-in: split multi-pipeline batches across CompileThreadPool
+        bool parallel_compile{false};
+        
+        // Opt-in: carve small allocations out of shared blocks; may be null
+        std::unique_ptr<DeviceMemorySuballocator> suballocator;
+        
+        // Opt-out: keep host-visible driver allocations mapped; may be null
+        std::unique_ptr<PersistentMappingCache> mapping_cache;
+        
+        // Opt-in: move allocations to faster compatible types; may be null
+        std::unique_ptr<MemoryTypePolicy> memory_type_policy;
+        
+        // Opt-in: steer render targets into dedicated allocations; may be null
+        std::unique_ptr<DedicatedImageTracker> dedicated_images;
+        
+        // Opt-in: hold back small submits until the next flush point; may be null
+        std::unique_ptr<SubmitBatcher> submit_batcher;
+        
+        // What each command buffer records, for classifying submits
+        CommandBufferProfiler command_profiles;
+        
+        // Opt-in: GPU timestamps per render pass and dispatch run; may be null
+        std::unique_ptr<GpuProfiler> gpu_profiler;
+        
+        // Opt-in: run compute-only submits on a spare queue; may be null
+        std::unique_ptr<AsyncComputeScheduler> async_compute;
     };
     
-    std::mutex pipeline_mutex_;
-    std::unordered_map<VkPipeline, PipelineState> pipeline_cache_;
-    std::unique_ptr<DeviceContext> device_context_;
-    bool features_initialized_{false};
+    DispatchKeyMap<DeviceContext> device_contexts_;
+    
+    // Where the driver reports on one pipeline of a batch: the app's own
+    // VkPipelineCreationFeedbackCreateInfo if it chained one, else ours
+    struct CreationFeedback {
+        VkPipelineCreationFeedbackCreateInfo info;
+        VkPipelineCreationFeedback pipeline;
+        VkPipelineCreationFeedback stages[kMaxFeedbackStages];
+        const VkPipelineCreationFeedback* result;  // null when unavailable
+        uint64_t elapsed_ns;
+    };
 
 public:
     Xclipse940Wrapper() = default;
@@ -41,18 +118,191 @@ public:
     Xclipse940Wrapper(const Xclipse940Wrapper&) = delete;
     Xclipse940Wrapper& operator=(const Xclipse940Wrapper&) = delete;
 
-    bool InitializeDeviceContext(VkPhysicalDevice physical_device, VkDevice device) {
+    bool InitializeDeviceContext(VkPhysicalDevice physical_device, VkDevice device,
+                                 const InstanceDispatch& instance_dispatch,
+                                 const DeviceDispatch& device_dispatch,
+                                 const DeviceExtensions& extensions,
+                                 const AsyncComputePlan& async_compute) {
         if (!physical_device || !device) return false;
         
-        device_context_ = std::make_unique<DeviceContext>();
-        device_context_->physical_device = physical_device;
-        device_context_->device = device;
+        auto context = std::make_unique<DeviceContext>();
+        context->dispatch = device_dispatch;
+        context->physical_device = physical_device;
+        context->device = device;
+        context->extensions = extensions;
         
-        vkGetPhysicalDeviceProperties(physical_device, &device_context_->properties);
-        vkGetPhysicalDeviceMemoryProperties(physical_device, &device_context_->memory_properties);
+        const LayerSettings& settings = instance_dispatch.settings;
+        instance_dispatch.GetPhysicalDeviceProperties(physical_device, &context->properties);
+        instance_dispatch.GetPhysicalDeviceMemoryProperties(physical_device,
+                                                            &context->memory_properties);
         
-        features_initialized_ = true;
-        return true;
+        context->memory_budget = std::make_unique<MemoryBudgetTracker>(
+            physical_device, instance_dispatch, context->memory_properties,
+            extensions.memory_budget);
+        
+        context->pipeline_cache = PersistentPipelineCache::Create(
+            device, context->dispatch, context->properties);
+        context->parallel_compile = settings.parallel_pipelines;
+        if (!settings.pipeline_rules.empty() || settings.log_pipelines) {
+            context->pipeline_rules = std::make_unique<PipelineRules>(settings.pipeline_rules,
+                                                                      settings.log_pipelines);
+        }
+        context->subgroup_size = SubgroupSizeControl::Create(
+            physical_device, instance_dispatch, context->properties, extensions.subgroup_size_control);
+        if (settings.compute_subgroup_size) {
+            if (context->subgroup_size && context->subgroup_size->Supports(settings.compute_subgroup_size)) {
+                context->compute_subgroup_size = settings.compute_subgroup_size;
+            } else {
+                XCLIPSE_LOGW("compute_subgroup_size=%u ignored: subgroupSizeControl is off or the size unsupported",
+                             settings.compute_subgroup_size);
+            }
+        }
+        
+        // vkMapMemory2/vkUnmapMemory2 (VK_KHR_map_memory2, core in 1.4) are
+        // not intercepted, so they would see suballocated handles and
+        // mappings the layer thinks it still holds
+        bool map_memory2 = extensions.map_memory2 ||
+                           context->properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 4, 0);
+        
+        if (settings.suballocate_memory) {
+            if (map_memory2) {
+                XCLIPSE_LOGW("memory suballocation disabled: vkMapMemory2 is not supported");
+            } else {
+                context->suballocator = std::make_unique<DeviceMemorySuballocator>(
+                    device, context->dispatch, context->properties, context->memory_properties,
+                    *context->memory_budget);
+            }
+        }
+        
+        if (settings.remap_memory_types) {
+            context->memory_type_policy = std::make_unique<MemoryTypePolicy>(
+                context->memory_properties);
+        }
+        
+        if (settings.batch_submits) {
+            context->submit_batcher = std::make_unique<SubmitBatcher>(context->dispatch);
+        }
+        
+        // vkCreateDevice only reserved queues when async_compute is set
+        context->async_compute = AsyncComputeScheduler::Create(device, context->dispatch, async_compute);
+        
+        if (settings.dedicated_images &&
+            (extensions.dedicated_allocation ||
+             context->properties.apiVersion >= VK_MAKE_API_VERSION(0, 1, 1, 0))) {
+            context->dedicated_images = std::make_unique<DedicatedImageTracker>(
+                VkDeviceSize{settings.dedicated_image_min_kb} << 10, settings.dedicated_image_inject);
+        }
+        
+        if (!map_memory2 && settings.persistent_mapping) {
+            context->mapping_cache = std::make_unique<PersistentMappingCache>(
+                device, context->dispatch, context->memory_properties);
+        }
+        
+        std::string stats_directory = GetLayerDataDirectory();
+        auto stats_path = [&](const char* suffix) {
+            return stats_directory.empty() ? std::string()
+                                           : stats_directory + "/" + GetProcessName() + suffix;
+        };
+        context->frame_timer = std::make_unique<FrameTimer>(stats_path(".frame_times.csv"));
+        // The frame summary is logged, and the trace flushed, from the
+        // compile stats' dumper thread rather than the present path;
+        // compile_stats is declared after frame_timer, so it is destroyed,
+        // and its thread joined, first
+        FrameTimer* frame_timer = context->frame_timer.get();
+        auto report = [frame_timer] {
+            frame_timer->Report();
+            if (Tracer::Enabled()) {
+                Tracer::Shared().ExportIfRecorded();
+            }
+        };
+        context->compile_stats = std::make_unique<PipelineCompileStats>(
+            stats_path(".compile_stats.txt"), PipelineCompileStats::kDumpIntervalNs,
+            BackgroundReport{report, FrameTimer::kReportIntervalNs});
+        context->shader_modules = std::make_unique<ShaderModuleTracker>(
+            settings.replace_shaders ? stats_path(".shaders") : std::string(),
+            settings.dump_shaders ? stats_path(".shader_dump") : std::string());
+        if (settings.trace) {
+            Tracer::Shared().Enable(stats_path(".trace.json"));
+        }
+        if (settings.gpu_profiler) {
+            context->gpu_profiler = GpuProfiler::Create(
+                physical_device, instance_dispatch, device, context->dispatch, context->properties,
+                extensions.synchronization2, stats_path(".gpu_times.csv"));
+        }
+        
+        return device_contexts_.Insert(GetDispatchKey(device), std::move(context));
+    }
+
+    void ReleaseDeviceContext(VkDevice device) {
+        std::unique_ptr<DeviceContext> context = device_contexts_.Erase(GetDispatchKey(device));
+        if (!context) return;
+        
+        // The app believes held submits reached the driver; send them before
+        // the device goes, and let them finish, as the app would have
+        if (context->submit_batcher) {
+            VkResult result = context->submit_batcher->FlushAll();
+            if (result != VK_SUCCESS) {
+                XCLIPSE_LOGW("device %p: flushing held submits at destroy failed (%d)",
+                             static_cast<void*>(device), result);
+            }
+            context->dispatch.DeviceWaitIdle(device);
+        }
+        
+        context->compile_stats->Dump();
+        context->frame_timer->Dump();
+        if (Tracer::Enabled()) {
+            Tracer::Shared().Export();
+        }
+        if (context->gpu_profiler) {
+            context->gpu_profiler->Dump();
+        }
+        context->shader_modules->LogStats();
+        if (context->pipeline_rules) {
+            context->pipeline_rules->LogStats();
+        }
+        if (context->subgroup_size) {
+            context->subgroup_size->LogStats();
+        }
+        if (context->suballocator) {
+            context->suballocator->LogStats();
+        }
+        if (context->mapping_cache) {
+            context->mapping_cache->LogStats();
+        }
+        if (context->memory_type_policy) {
+            context->memory_type_policy->LogStats();
+        }
+        if (context->dedicated_images) {
+            context->dedicated_images->LogStats();
+        }
+        if (context->submit_batcher) {
+            context->submit_batcher->LogStats();
+        }
+        if (context->async_compute) {
+            context->async_compute->LogStats();
+        }
+        context->command_profiles.LogStats();
+        context->memory_budget->LogStats();
+        
+        PipelineRegistryStats stats = context->pipelines.Stats();
+        XCLIPSE_LOGI("device %p: pipelines created=%llu destroyed=%llu replaced=%llu leaked=%llu "
+                     "registry=%zu bytes",
+                     static_cast<void*>(device),
+                     static_cast<unsigned long long>(stats.created),
+                     static_cast<unsigned long long>(stats.destroyed),
+                     static_cast<unsigned long long>(stats.replaced),
+                     static_cast<unsigned long long>(stats.live),
+                     stats.memory_bytes);
+    }
+
+    PipelineRegistryStats PipelineStats(VkDevice device) {
+        DeviceContext* context = device_contexts_.Find(GetDispatchKey(device));
+        return context ? context->pipelines.Stats() : PipelineRegistryStats{};
+    }
+
+    const DeviceDispatch* FindDeviceDispatch(void* key) const {
+        DeviceContext* context = device_contexts_.Find(key);
+        return context ? &context->dispatch : nullptr;
     }
 
     VkResult CreateGraphicsPipelines(
@@ -63,42 +313,62 @@ public:
         const VkAllocationCallbacks* pAllocator,
         VkPipeline* pPipelines) {
         
-        if (!features_initialized_) {
-            return vkCreateGraphicsPipelines(device, pipelineCache, createInfoCount,
-                                           pCreateInfos, pAllocator, pPipelines);
-        }
+        return Traced(TraceEvent::kCreateGraphicsPipelines, createInfoCount, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+            VkPipelineCache cache = ResolvePipelineCache(context, pipelineCache);
 
-        std::vector<VkGraphicsPipelineCreateInfo> optimized_infos;
-        optimized_infos.reserve(createInfoCount);
+            ScratchArena::Scope scratch;
+            ScratchArena& arena = scratch.arena();
+            VkGraphicsPipelineCreateInfo* optimized_infos = arena.CopyArray(pCreateInfos, createInfoCount);
+            CreationFeedback* feedback = arena.Allocate<CreationFeedback>(createInfoCount);
+            PipelineShaders* shaders = arena.Allocate<PipelineShaders>(createInfoCount);
 
-        for (uint32_t i = 0; i < createInfoCount; ++i) {
-            VkGraphicsPipelineCreateInfo optimized = pCreateInfos[i];
+            for (uint32_t i = 0; i < createInfoCount; ++i) {
+                VkGraphicsPipelineCreateInfo& optimized = optimized_infos[i];
+                RecordShaders(context, optimized.stageCount, optimized.pStages, shaders[i]);
             
-            // Apply mobile-specific optimizations
-            if (optimized.pRasterizationState) {
-                auto* rasterization = const_cast<VkPipelineRasterizationStateCreateInfo*>(
-                    optimized.pRasterizationState);
-                OptimizeRasterizationState(*rasterization);
-            }
+                // Rules rewrite copies; DXVK hashes and reuses its state structs
+                // after the call returns
+                if (context.pipeline_rules) {
+                    uint32_t shader_count = std::min<uint32_t>(std::popcount(shaders[i].shader_stages),
+                                                               kMaxPipelineShaders);
+                    uint32_t subgroup_size = context.pipeline_rules->Apply(
+                        optimized, shaders[i].shaders, shader_count, 0, arena);
+                    if (context.subgroup_size) {
+                        context.subgroup_size->Require(optimized, subgroup_size, arena);
+                    }
+                }
             
-            if (optimized.pMultisampleState) {
-                auto* multisample = const_cast<VkPipelineMultisampleStateCreateInfo*>(
-                    optimized.pMultisampleState);
-                OptimizeMultisampleState(*multisample);
+                AttachCreationFeedback(context, optimized, optimized.stageCount, feedback[i]);
             }
-            
-            optimized_infos.push_back(optimized);
-        }
 
-        VkResult result = vkCreateGraphicsPipelines(
-            device, pipelineCache, createInfoCount,
-            optimized_infos.data(), pAllocator, pPipelines);
+            VkResult result;
+            if (CanFanOutBatch(context, cache, createInfoCount, optimized_infos, pAllocator)) {
+                result = FanOutBatch(createInfoCount, pPipelines, [&](uint32_t i, VkPipeline* pipeline) {
+                    uint64_t start = SteadyNanoseconds();
+                    VkResult element_result = context.dispatch.CreateGraphicsPipelines(
+                        device, cache, 1, &optimized_infos[i], pAllocator, pipeline);
+                    feedback[i].elapsed_ns = SteadyNanoseconds() - start;
+                    return element_result;
+                });
+            } else {
+                uint64_t start = SteadyNanoseconds();
+                result = context.dispatch.CreateGraphicsPipelines(
+                    device, cache, createInfoCount, optimized_infos, pAllocator, pPipelines);
+                SplitBatchTime(feedback, createInfoCount, SteadyNanoseconds() - start);
+            }
+            RecordCompiles(context, VK_PIPELINE_BIND_POINT_GRAPHICS, pPipelines, feedback,
+                           createInfoCount);
 
-        if (result == VK_SUCCESS) {
-            CachePipelines(pPipelines, createInfoCount, VK_PIPELINE_BIND_POINT_GRAPHICS);
-        }
+            if (cache != pipelineCache) {
+                context.pipeline_cache->MarkDirty();
+            }
 
-        return result;
+            // Failed entries come back as VK_NULL_HANDLE; count the rest
+            RegisterPipelines(context, pPipelines, createInfoCount);
+
+            return result;
+        });
     }
 
     VkResult CreateComputePipelines(
@@ -109,208 +379,2250 @@ public:
         const VkAllocationCallbacks* pAllocator,
         VkPipeline* pPipelines) {
         
-        VkResult result = vkCreateComputePipelines(
-            device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
-
-        if (result == VK_SUCCESS && features_initialized_) {
-            CachePipelines(pPipelines, createInfoCount, VK_PIPELINE_BIND_POINT_COMPUTE);
-            
-            // Apply compute-specific optimizations for Xclipse 940
+        return Traced(TraceEvent::kCreateComputePipelines, createInfoCount, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+            VkPipelineCache cache = ResolvePipelineCache(context, pipelineCache);
+        
+            ScratchArena::Scope scratch;
+            ScratchArena& arena = scratch.arena();
+            VkComputePipelineCreateInfo* infos = arena.CopyArray(pCreateInfos, createInfoCount);
+            CreationFeedback* feedback = arena.Allocate<CreationFeedback>(createInfoCount);
+            PipelineShaders* shaders = arena.Allocate<PipelineShaders>(createInfoCount);
             for (uint32_t i = 0; i < createInfoCount; ++i) {
-                OptimizeComputePipeline(pPipelines[i]);
+                RecordShaders(context, 1, &infos[i].stage, shaders[i]);
+                if (context.subgroup_size) {
+                    uint32_t subgroup_size = context.compute_subgroup_size;
+                    if (context.pipeline_rules) {
+                        subgroup_size = context.pipeline_rules->ApplyCompute(shaders[i].shaders[0], subgroup_size);
+                    }
+                    context.subgroup_size->Require(infos[i], subgroup_size, arena);
+                }
+                AttachCreationFeedback(context, infos[i], 1, feedback[i]);
+            }
+        
+            VkResult result;
+            if (CanFanOutBatch(context, cache, createInfoCount, infos, pAllocator)) {
+                result = FanOutBatch(createInfoCount, pPipelines, [&](uint32_t i, VkPipeline* pipeline) {
+                    uint64_t start = SteadyNanoseconds();
+                    VkResult element_result = context.dispatch.CreateComputePipelines(
+                        device, cache, 1, &infos[i], pAllocator, pipeline);
+                    feedback[i].elapsed_ns = SteadyNanoseconds() - start;
+                    return element_result;
+                });
+            } else {
+                uint64_t start = SteadyNanoseconds();
+                result = context.dispatch.CreateComputePipelines(
+                    device, cache, createInfoCount, infos, pAllocator, pPipelines);
+                SplitBatchTime(feedback, createInfoCount, SteadyNanoseconds() - start);
+            }
+            RecordCompiles(context, VK_PIPELINE_BIND_POINT_COMPUTE, pPipelines, feedback,
+                           createInfoCount);
+
+            if (cache != pipelineCache) {
+                context.pipeline_cache->MarkDirty();
             }
+
+            // Failed entries come back as VK_NULL_HANDLE; count the rest
+            RegisterPipelines(context, pPipelines, createInfoCount);
+
+            return result;
+        });
+    }
+
+    void DestroyPipeline(
+        VkDevice device,
+        VkPipeline pipeline,
+        const VkAllocationCallbacks* pAllocator) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        
+        // Forget the handle before the driver can hand it out again
+        if (pipeline != VK_NULL_HANDLE) {
+            context.pipelines.Erase(pipeline);
         }
+        
+        context.dispatch.DestroyPipeline(device, pipeline, pAllocator);
+    }
 
+    VkResult CreateShaderModule(
+        VkDevice device,
+        const VkShaderModuleCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator,
+        VkShaderModule* pShaderModule) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        
+        std::vector<uint32_t> replacement;
+        ShaderHash hash = context.shader_modules->Prepare(*pCreateInfo, replacement);
+        VkShaderModuleCreateInfo info = *pCreateInfo;
+        if (!replacement.empty()) {
+            info.codeSize = replacement.size() * sizeof(uint32_t);
+            info.pCode = replacement.data();
+        }
+        
+        VkResult result = context.dispatch.CreateShaderModule(device, &info, pAllocator, pShaderModule);
+        if (result == VK_SUCCESS) {
+            // Pipelines are tied to the app's shader, even when replaced
+            context.shader_modules->Insert(*pShaderModule, hash);
+        }
         return result;
     }
 
+    void DestroyShaderModule(
+        VkDevice device,
+        VkShaderModule shaderModule,
+        const VkAllocationCallbacks* pAllocator) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        if (shaderModule != VK_NULL_HANDLE) {
+            context.shader_modules->Erase(shaderModule);
+        }
+        context.dispatch.DestroyShaderModule(device, shaderModule, pAllocator);
+    }
+
     VkResult AllocateMemory(
         VkDevice device,
         const VkMemoryAllocateInfo* pAllocateInfo,
         const VkAllocationCallbacks* pAllocator,
         VkDeviceMemory* pMemory) {
         
-        if (!features_initialized_) {
-            return vkAllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
-        }
+        return Traced(TraceEvent::kAllocateMemory, pAllocateInfo->allocationSize, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        
+            VkMemoryAllocateInfo optimized_info = *pAllocateInfo;
+            VkMemoryDedicatedAllocateInfo dedicated_info;
+            bool injected_dedicated = OptimizeMemoryAllocation(context, optimized_info, dedicated_info);
+        
+            if (context.suballocator && context.suballocator->TryAllocate(optimized_info, pMemory)) {
+                return VK_SUCCESS;
+            }
 
-        VkMemoryAllocateInfo optimized_info = *pAllocateInfo;
-        OptimizeMemoryAllocation(optimized_info);
+            VkResult result = context.dispatch.AllocateMemory(device, &optimized_info, pAllocator, pMemory);
+            if (result == VK_SUCCESS) {
+                context.memory_budget->OnAllocate(*pMemory, optimized_info.memoryTypeIndex,
+                                                  optimized_info.allocationSize);
+                if (context.mapping_cache) {
+                    context.mapping_cache->OnAllocate(*pMemory, optimized_info.memoryTypeIndex);
+                }
+                if (context.dedicated_images) {
+                    context.dedicated_images->OnAllocated(*pMemory, optimized_info, injected_dedicated);
+                }
+            }
+            return result;
+        });
+    }
 
-        return vkAllocateMemory(device, &optimized_info, pAllocator, pMemory);
+    void FreeMemory(
+        VkDevice device,
+        VkDeviceMemory memory,
+        const VkAllocationCallbacks* pAllocator) {
+        
+        return Traced(TraceEvent::kFreeMemory, 0, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        
+            if (Suballocation* allocation = FindSuballocation(context, memory)) {
+                context.suballocator->Free(allocation);
+                return;
+            }
+        
+            if (memory != VK_NULL_HANDLE) {
+                context.memory_budget->OnFree(memory);
+                // The driver unmaps a persistent mapping as part of the free
+                if (context.mapping_cache) {
+                    context.mapping_cache->OnFree(memory);
+                }
+                if (context.dedicated_images) {
+                    context.dedicated_images->OnFree(memory);
+                }
+            }
+            context.dispatch.FreeMemory(device, memory, pAllocator);
+        });
     }
 
-    VkResult QueueSubmit(
-        VkQueue queue,
-        uint32_t submitCount,
-        const VkSubmitInfo* pSubmits,
-        VkFence fence) {
+    VkResult MapMemory(
+        VkDevice device,
+        VkDeviceMemory memory,
+        VkDeviceSize offset,
+        VkDeviceSize size,
+        VkMemoryMapFlags flags,
+        void** ppData) {
         
-        if (features_initialized_) {
-            OptimizeQueueSubmission(pSubmits, submitCount);
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        
+        if (Suballocation* allocation = FindSuballocation(context, memory)) {
+            return context.suballocator->Map(allocation, offset, ppData);
+        }
+        
+        VkResult result;
+        if (context.mapping_cache &&
+            context.mapping_cache->Map(memory, offset, ppData, result)) {
+            return result;
         }
         
-        return vkQueueSubmit(queue, submitCount, pSubmits, fence);
+        return context.dispatch.MapMemory(device, memory, offset, size, flags, ppData);
     }
 
-private:
-    void OptimizeRasterizationState(VkPipelineRasterizationStateCreateInfo& state) {
-        // Mobile-optimized defaults
-        state.depthBiasEnable = VK_FALSE;
-        state.depthClampEnable = VK_FALSE;
-        state.rasterizerDiscardEnable = VK_FALSE;
+    void UnmapMemory(
+        VkDevice device,
+        VkDeviceMemory memory) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
         
-        // Conservative settings for power efficiency
-        if (state.cullMode == VK_CULL_MODE_NONE) {
-            state.cullMode = VK_CULL_MODE_BACK_BIT; // Default to backface culling
+        // Suballocations and cached mappings stay mapped until freed
+        if (FindSuballocation(context, memory)) {
+            return;
+        }
+        if (context.mapping_cache && context.mapping_cache->Unmap(memory)) {
+            return;
         }
+        
+        context.dispatch.UnmapMemory(device, memory);
+    }
+
+    VkResult FlushMappedMemoryRanges(
+        VkDevice device,
+        uint32_t memoryRangeCount,
+        const VkMappedMemoryRange* pMemoryRanges) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        ScratchArena::Scope scratch;
+        
+        return context.dispatch.FlushMappedMemoryRanges(
+            device, memoryRangeCount,
+            TranslateMappedRanges(context, scratch.arena(), pMemoryRanges, memoryRangeCount));
+    }
+
+    VkResult InvalidateMappedMemoryRanges(
+        VkDevice device,
+        uint32_t memoryRangeCount,
+        const VkMappedMemoryRange* pMemoryRanges) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        ScratchArena::Scope scratch;
+        
+        return context.dispatch.InvalidateMappedMemoryRanges(
+            device, memoryRangeCount,
+            TranslateMappedRanges(context, scratch.arena(), pMemoryRanges, memoryRangeCount));
     }
 
-    void OptimizeMultisampleState(VkPipelineMultisampleStateCreateInfo& state) {
-        // Optimize for mobile: prefer no multisampling unless explicitly requested
-        if (state.rasterizationSamples == VK_SAMPLE_COUNT_1_BIT) {
-            // Already optimal for mobile
+    void GetDeviceMemoryCommitment(
+        VkDevice device,
+        VkDeviceMemory memory,
+        VkDeviceSize* pCommittedMemoryInBytes) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        
+        // Suballocated types are never lazily allocated, so fully committed
+        if (Suballocation* allocation = FindSuballocation(context, memory)) {
+            *pCommittedMemoryInBytes = allocation->requested;
             return;
         }
         
-        // For multisampled pipelines, ensure minimal sample count
-        state.rasterizationSamples = std::min(state.rasterizationSamples, VK_SAMPLE_COUNT_4_BIT);
+        context.dispatch.GetDeviceMemoryCommitment(device, memory, pCommittedMemoryInBytes);
     }
 
-    void OptimizeMemoryAllocation(VkMemoryAllocateInfo& info) {
-        // Align for cache performance
-        info.allocationSize = (info.allocationSize + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+    VkResult BindBufferMemory(
+        VkDevice device,
+        VkBuffer buffer,
+        VkDeviceMemory memory,
+        VkDeviceSize memoryOffset) {
         
-        // Prefer device-local memory for performance
-        if (info.memoryTypeIndex < device_context_->memory_properties.memoryTypeCount) {
-            const auto& memory_type = device_context_->memory_properties.memoryTypes[info.memoryTypeIndex];
-            if (memory_type.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
-                // Optimal for performance
-                return;
-            }
-        }
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        TranslateMemory(context, memory, memoryOffset);
+        
+        return context.dispatch.BindBufferMemory(device, buffer, memory, memoryOffset);
     }
 
-    void OptimizeComputePipeline(VkPipeline pipeline) {
-        // Xclipse 940 compute optimizations
-        // - Prefer wave32 for mobile efficiency
-        // - Optimize workgroup sizes for 12 CUs
-        std::lock_guard<std::mutex> lock(pipeline_mutex_);
-        if (auto it = pipeline_cache_.find(pipeline); it != pipeline_cache_.end()) {
-            it->second.usage_count++;
+    VkResult BindImageMemory(
+        VkDevice device,
+        VkImage image,
+        VkDeviceMemory memory,
+        VkDeviceSize memoryOffset) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        if (context.dedicated_images) {
+            context.dedicated_images->CheckBind(image, memory);
         }
+        TranslateMemory(context, memory, memoryOffset);
+        
+        return context.dispatch.BindImageMemory(device, image, memory, memoryOffset);
     }
 
-    void OptimizeQueueSubmission(const VkSubmitInfo* submits, uint32_t count) {
-        // Reorder submissions for better GPU utilization
-        // Priority: Compute -> Graphics -> Transfer
-        std::vector<const VkSubmitInfo*> compute_submits;
-        std::vector<const VkSubmitInfo*> graphics_submits;
-        std::vector<const VkSubmitInfo*> transfer_submits;
+    VkResult BindBufferMemory2(
+        VkDevice device,
+        uint32_t bindInfoCount,
+        const VkBindBufferMemoryInfo* pBindInfos) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        if (!context.suballocator) {
+            return context.dispatch.BindBufferMemory2(device, bindInfoCount, pBindInfos);
+        }
+        
+        ScratchArena::Scope scratch;
+        VkBindBufferMemoryInfo* infos = scratch.arena().CopyArray(pBindInfos, bindInfoCount);
+        for (uint32_t i = 0; i < bindInfoCount; ++i) {
+            TranslateMemory(context, infos[i].memory, infos[i].memoryOffset);
+        }
+        
+        return context.dispatch.BindBufferMemory2(device, bindInfoCount, infos);
+    }
 
-        for (uint32_t i = 0; i < count; ++i) {
-            // Categorize by likely workload type
-            // In practice, this would analyze command buffer contents
-            if (IsLikelyComputeWorkload(submits[i])) {
-                compute_submits.push_back(&submits[i]);
-            } else if (IsLikelyTransferWorkload(submits[i])) {
-                transfer_submits.push_back(&submits[i]);
-            } else {
-                graphics_submits.push_back(&submits[i]);
+    VkResult BindImageMemory2(
+        VkDevice device,
+        uint32_t bindInfoCount,
+        const VkBindImageMemoryInfo* pBindInfos) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        if (context.dedicated_images) {
+            for (uint32_t i = 0; i < bindInfoCount; ++i) {
+                context.dedicated_images->CheckBind(pBindInfos[i].image, pBindInfos[i].memory);
             }
         }
+        if (!context.suballocator) {
+            return context.dispatch.BindImageMemory2(device, bindInfoCount, pBindInfos);
+        }
+        
+        // Swapchain binds (VkBindImageMemorySwapchainInfoKHR) carry a null
+        // memory handle, which TranslateMemory leaves alone
+        ScratchArena::Scope scratch;
+        VkBindImageMemoryInfo* infos = scratch.arena().CopyArray(pBindInfos, bindInfoCount);
+        for (uint32_t i = 0; i < bindInfoCount; ++i) {
+            TranslateMemory(context, infos[i].memory, infos[i].memoryOffset);
+        }
         
-        // Optimal order: Compute (can overlap with other work) -> Graphics -> Transfer
-        // Note: Actual reordering requires more sophisticated analysis
+        return context.dispatch.BindImageMemory2(device, bindInfoCount, infos);
     }
 
-    bool IsLikelyComputeWorkload(const VkSubmitInfo& submit) {
-        // Heuristic: submissions with many command buffers are likely compute
-        return submit.commandBufferCount > 2;
+    VkResult CreateImage(
+        VkDevice device,
+        const VkImageCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator,
+        VkImage* pImage) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        VkResult result = context.dispatch.CreateImage(device, pCreateInfo, pAllocator, pImage);
+        if (result == VK_SUCCESS && context.dedicated_images) {
+            context.dedicated_images->OnCreateImage(*pImage, *pCreateInfo);
+        }
+        return result;
     }
 
-    bool IsLikelyTransferWorkload(const VkSubmitInfo& submit) {
-        // Heuristic: single command buffer often indicates transfer
-        return submit.commandBufferCount == 1;
+    void DestroyImage(
+        VkDevice device,
+        VkImage image,
+        const VkAllocationCallbacks* pAllocator) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        if (image != VK_NULL_HANDLE && context.dedicated_images) {
+            context.dedicated_images->OnDestroyImage(image);
+        }
+        context.dispatch.DestroyImage(device, image, pAllocator);
     }
 
-    void CachePipelines(VkPipeline* pipelines, uint32_t count, VkPipelineBindPoint bind_point) {
-        std::lock_guard<std::mutex> lock(pipeline_mutex_);
-        for (uint32_t i = 0; i < count; ++i) {
-            PipelineState state;
-            state.pipeline = pipelines[i];
-            state.usage_count = 1;
-            state.bind_point = bind_point;
-            pipeline_cache_[pipelines[i]] = state;
+    void GetBufferMemoryRequirements(
+        VkDevice device,
+        VkBuffer buffer,
+        VkMemoryRequirements* pMemoryRequirements) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetBufferMemoryRequirements(device, buffer, pMemoryRequirements);
+        if (context.memory_type_policy) {
+            context.memory_type_policy->OnResourceRequirements(*pMemoryRequirements);
+        }
+        // Whatever is allocated next is not for a queried image
+        if (context.dedicated_images) {
+            context.dedicated_images->ForgetPendingQuery();
         }
     }
-};
-
-// Global wrapper instance
-static Xclipse940Wrapper g_wrapper;
-
-// Required Vulkan layer functions
-extern "C" {
-
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(
-    VkDevice device,
-    VkPipelineCache pipelineCache,
-    uint32_t createInfoCount,
-    const VkGraphicsPipelineCreateInfo* pCreateInfos,
-    const VkAllocationCallbacks* pAllocator,
-    VkPipeline* pPipelines) {
-    
-    return g_wrapper.CreateGraphicsPipelines(device, pipelineCache, createInfoCount,
-                                           pCreateInfos, pAllocator, pPipelines);
-}
-
-VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(
-    VkDevice device,
-    VkPipelineCache pipelineCache,
-    uint32_t createInfoCount,
-    const VkComputePipelineCreateInfo* pCreateInfos,
-    const VkAllocationCallbacks* pAllocator,
-    VkPipeline* pPipelines) {
-    
-    return g_wrapper.CreateComputePipelines(device, pipelineCache, createInfoCount,
-                                          pCreateInfos, pAllocator, pPipelines);
-}
 
-VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(
-    VkDevice device,
-    const VkMemoryAllocateInfo* pAllocateInfo,
-    const VkAllocationCallbacks* pAllocator,
-    VkDeviceMemory* pMemory) {
-    
-    return g_wrapper.AllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
-}
+    void GetImageMemoryRequirements(
+        VkDevice device,
+        VkImage image,
+        VkMemoryRequirements* pMemoryRequirements) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetImageMemoryRequirements(device, image, pMemoryRequirements);
+        if (context.memory_type_policy) {
+            context.memory_type_policy->OnResourceRequirements(*pMemoryRequirements);
+        }
+        if (context.dedicated_images) {
+            context.dedicated_images->OnImageRequirements(image, *pMemoryRequirements, nullptr);
+        }
+    }
 
-VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(
-    VkQueue queue,
-    uint32_t submitCount,
-    const VkSubmitInfo* pSubmits,
-    VkFence fence) {
-    
-    return g_wrapper.QueueSubmit(queue, submitCount, pSubmits, fence);
-}
+    void GetBufferMemoryRequirements2(
+        VkDevice device,
+        const VkBufferMemoryRequirementsInfo2* pInfo,
+        VkMemoryRequirements2* pMemoryRequirements) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetBufferMemoryRequirements2(device, pInfo, pMemoryRequirements);
+        if (context.memory_type_policy) {
+            context.memory_type_policy->OnResourceRequirements(pMemoryRequirements->memoryRequirements);
+        }
+        if (context.dedicated_images) {
+            context.dedicated_images->ForgetPendingQuery();
+        }
+    }
 
-// Layer initialization functions
-VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVersion(VkNegotiateLayerInterface* pVersionStruct) {
-    if (pVersionStruct->sType != LAYER_NEGOTIATE_INTERFACE_STRUCT) {
-        return VK_ERROR_INITIALIZATION_FAILED;
+    void GetImageMemoryRequirements2(
+        VkDevice device,
+        const VkImageMemoryRequirementsInfo2* pInfo,
+        VkMemoryRequirements2* pMemoryRequirements) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetImageMemoryRequirements2(device, pInfo, pMemoryRequirements);
+        if (context.memory_type_policy) {
+            context.memory_type_policy->OnResourceRequirements(pMemoryRequirements->memoryRequirements);
+        }
+        if (context.dedicated_images) {
+            VkMemoryDedicatedRequirements* dedicated = nullptr;
+            for (auto* next = static_cast<VkBaseOutStructure*>(pMemoryRequirements->pNext); next;
+                 next = next->pNext) {
+                if (next->sType == VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS) {
+                    dedicated = reinterpret_cast<VkMemoryDedicatedRequirements*>(next);
+                }
+            }
+            context.dedicated_images->OnImageRequirements(
+                pInfo->image, pMemoryRequirements->memoryRequirements, dedicated);
+        }
     }
-    
-    if (pVersionStruct->loaderLayerInterfaceVersion >= 2) {
-        pVersionStruct->pfnGetInstanceProcAddr = vkGetInstanceProcAddr;
-        pVersionStruct->pfnGetDeviceProcAddr = vkGetDeviceProcAddr;
-        pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+
+    void GetDeviceBufferMemoryRequirements(
+        VkDevice device,
+        const VkDeviceBufferMemoryRequirements* pInfo,
+        VkMemoryRequirements2* pMemoryRequirements) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetDeviceBufferMemoryRequirements(device, pInfo, pMemoryRequirements);
+        // No resource exists yet, so nothing allocated next can be matched
+        if (context.memory_type_policy) {
+            context.memory_type_policy->ForgetPendingQuery();
+        }
+        if (context.dedicated_images) {
+            context.dedicated_images->ForgetPendingQuery();
+        }
     }
-    
-    pVersionStruct->loaderLayerInterfaceVersion = 2;
-    return VK_SUCCESS;
-}
 
-VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* pName);
-VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char* pName);
+    void GetDeviceImageMemoryRequirements(
+        VkDevice device,
+        const VkDeviceImageMemoryRequirements* pInfo,
+        VkMemoryRequirements2* pMemoryRequirements) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetDeviceImageMemoryRequirements(device, pInfo, pMemoryRequirements);
+        // No resource exists yet, so nothing allocated next can be matched
+        if (context.memory_type_policy) {
+            context.memory_type_policy->ForgetPendingQuery();
+        }
+        if (context.dedicated_images) {
+            context.dedicated_images->ForgetPendingQuery();
+        }
+    }
 
-} // extern "C"
+    VkResult QueueSubmit(
+        VkQueue queue,
+        uint32_t submitCount,
+        const VkSubmitInfo* pSubmits,
+        VkFence fence) {
+        
+        return Traced(TraceEvent::kQueueSubmit, submitCount, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(queue));
+            context.frame_timer->OnSubmit();
+            if (context.gpu_profiler) {
+                context.gpu_profiler->OnSubmit(context.command_profiles, submitCount, pSubmits);
+            }
+            CommandBufferProfile profile = ClassifySubmits(context, pSubmits, submitCount);
+        
+            if (context.async_compute) {
+                return ScheduleSubmit(context, queue, submitCount, pSubmits, fence, profile);
+            }
+            return ForwardSubmit(context, queue, submitCount, pSubmits, fence);
+        });
+    }
+
+    VkResult QueueSubmit2(
+        VkQueue queue,
+        uint32_t submitCount,
+        const VkSubmitInfo2* pSubmits,
+        VkFence fence) {
+        
+        return Traced(TraceEvent::kQueueSubmit2, submitCount, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(queue));
+            context.frame_timer->OnSubmit();
+            if (context.gpu_profiler) {
+                context.gpu_profiler->OnSubmit(context.command_profiles, submitCount, pSubmits);
+            }
+            CommandBufferProfile profile = ClassifySubmits(context, pSubmits, submitCount);
+        
+            if (context.async_compute) {
+                return ScheduleSubmit(context, queue, submitCount, pSubmits, fence, profile);
+            }
+            return ForwardSubmit(context, queue, submitCount, pSubmits, fence);
+        });
+    }
+
+    VkResult QueueWaitIdle(VkQueue queue) {
+        return Traced(TraceEvent::kQueueWaitIdle, 0, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(queue));
+            VkResult result = context.submit_batcher
+                                  ? context.submit_batcher->Exclusive(queue, [&] {
+                                        return context.dispatch.QueueWaitIdle(queue);
+                                    })
+                                  : context.dispatch.QueueWaitIdle(queue);
+            if (result == VK_SUCCESS && context.async_compute) {
+                result = context.async_compute->WaitOffloaded(queue);
+            }
+            return result;
+        });
+    }
+
+    VkResult DeviceWaitIdle(VkDevice device) {
+        return Traced(TraceEvent::kDeviceWaitIdle, 0, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+            VkResult result = FlushDeferredSubmits(context);
+            return result == VK_SUCCESS ? context.dispatch.DeviceWaitIdle(device) : result;
+        });
+    }
+
+    VkResult WaitForFences(
+        VkDevice device,
+        uint32_t fenceCount,
+        const VkFence* pFences,
+        VkBool32 waitAll,
+        uint64_t timeout) {
+        
+        return Traced(TraceEvent::kWaitForFences, fenceCount, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+            // Deferred submits carry no fences, so there is nothing to flush
+            return context.dispatch.WaitForFences(device, fenceCount, pFences, waitAll, timeout);
+        });
+    }
+
+    VkResult WaitSemaphores(
+        VkDevice device,
+        const VkSemaphoreWaitInfo* pWaitInfo,
+        uint64_t timeout) {
+        
+        return Traced(TraceEvent::kWaitSemaphores, pWaitInfo->semaphoreCount, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+            VkResult result = FlushDeferredSubmits(context);
+            return result == VK_SUCCESS ? context.dispatch.WaitSemaphores(device, pWaitInfo, timeout) : result;
+        });
+    }
+
+    VkResult GetSemaphoreCounterValue(
+        VkDevice device,
+        VkSemaphore semaphore,
+        uint64_t* pValue) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        VkResult result = FlushDeferredSubmits(context);
+        return result == VK_SUCCESS ? context.dispatch.GetSemaphoreCounterValue(device, semaphore, pValue)
+                                    : result;
+    }
+
+    VkResult GetEventStatus(
+        VkDevice device,
+        VkEvent event) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        VkResult result = FlushDeferredSubmits(context);
+        return result == VK_SUCCESS ? context.dispatch.GetEventStatus(device, event) : result;
+    }
+
+    VkResult GetQueryPoolResults(
+        VkDevice device,
+        VkQueryPool queryPool,
+        uint32_t firstQuery,
+        uint32_t queryCount,
+        size_t dataSize,
+        void* pData,
+        VkDeviceSize stride,
+        VkQueryResultFlags flags) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        VkResult result = FlushDeferredSubmits(context);
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+        return context.dispatch.GetQueryPoolResults(device, queryPool, firstQuery, queryCount,
+                                                    dataSize, pData, stride, flags);
+    }
+
+    VkResult QueueBindSparse(
+        VkQueue queue,
+        uint32_t bindInfoCount,
+        const VkBindSparseInfo* pBindInfo,
+        VkFence fence) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(queue));
+        if (context.submit_batcher) {
+            return context.submit_batcher->Exclusive(queue, [&] {
+                return ForwardBindSparse(context, queue, bindInfoCount, pBindInfo, fence);
+            });
+        }
+        return ForwardBindSparse(context, queue, bindInfoCount, pBindInfo, fence);
+    }
+
+    VkResult QueuePresentKHR(
+        VkQueue queue,
+        const VkPresentInfoKHR* pPresentInfo) {
+        
+        return Traced(TraceEvent::kQueuePresent, 0, [&] {
+            DeviceContext& context = *device_contexts_.Find(GetDispatchKey(queue));
+        
+            // Presents are the only frame boundary the layer can see
+            context.frame_timer->OnPresent();
+            context.memory_budget->OnFrameBoundary();
+            if (context.gpu_profiler) {
+                context.gpu_profiler->OnPresent();
+            }
+        
+            VkResult result;
+            if (context.submit_batcher) {
+                context.submit_batcher->OnFrameBoundary();
+                result = context.submit_batcher->Exclusive(queue, [&] {
+                    return context.dispatch.QueuePresentKHR(queue, pPresentInfo);
+                });
+            } else {
+                result = context.dispatch.QueuePresentKHR(queue, pPresentInfo);
+            }
+            context.frame_timer->OnPresentReturned();
+            return result;
+        });
+    }
+
+    void GetDeviceQueue(
+        VkDevice device,
+        uint32_t queueFamilyIndex,
+        uint32_t queueIndex,
+        VkQueue* pQueue) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
+        if (context.async_compute && *pQueue) {
+            context.async_compute->OnGetQueue(*pQueue, queueFamilyIndex);
+        }
+    }
+
+    void GetDeviceQueue2(
+        VkDevice device,
+        const VkDeviceQueueInfo2* pQueueInfo,
+        VkQueue* pQueue) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        context.dispatch.GetDeviceQueue2(device, pQueueInfo, pQueue);
+        // Protected queues never get their work moved
+        if (context.async_compute && *pQueue && pQueueInfo->flags == 0) {
+            context.async_compute->OnGetQueue(*pQueue, pQueueInfo->queueFamilyIndex);
+        }
+    }
+
+    VkResult CreateCommandPool(
+        VkDevice device,
+        const VkCommandPoolCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator,
+        VkCommandPool* pCommandPool) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        VkResult result = context.dispatch.CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
+        if (result == VK_SUCCESS) {
+            context.command_profiles.OnCreatePool(*pCommandPool, pCreateInfo->queueFamilyIndex);
+        }
+        return result;
+    }
+
+    VkResult AllocateCommandBuffers(
+        VkDevice device,
+        const VkCommandBufferAllocateInfo* pAllocateInfo,
+        VkCommandBuffer* pCommandBuffers) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        VkResult result = context.dispatch.AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+        if (result == VK_SUCCESS) {
+            context.command_profiles.OnAllocate(pAllocateInfo->commandPool,
+                                                pAllocateInfo->commandBufferCount, pCommandBuffers);
+        }
+        return result;
+    }
+
+    void FreeCommandBuffers(
+        VkDevice device,
+        VkCommandPool commandPool,
+        uint32_t commandBufferCount,
+        const VkCommandBuffer* pCommandBuffers) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        std::vector<uint32_t> timestamp_chunks;
+        context.command_profiles.OnFree(commandBufferCount, pCommandBuffers, timestamp_chunks);
+        if (!timestamp_chunks.empty()) {
+            context.gpu_profiler->Release(timestamp_chunks);
+        }
+        context.dispatch.FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+    }
+
+    void DestroyCommandPool(
+        VkDevice device,
+        VkCommandPool commandPool,
+        const VkAllocationCallbacks* pAllocator) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(device));
+        if (commandPool != VK_NULL_HANDLE) {
+            std::vector<uint32_t> timestamp_chunks;
+            context.command_profiles.OnDestroyPool(commandPool, timestamp_chunks);
+            if (!timestamp_chunks.empty()) {
+                context.gpu_profiler->Release(timestamp_chunks);
+            }
+        }
+        context.dispatch.DestroyCommandPool(device, commandPool, pAllocator);
+    }
+
+    VkResult BeginCommandBuffer(
+        VkCommandBuffer commandBuffer,
+        const VkCommandBufferBeginInfo* pBeginInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        // Beginning implicitly resets a recorded command buffer
+        CommandBufferProfile* profile = context.command_profiles.Begin(commandBuffer);
+        VkResult result = context.dispatch.BeginCommandBuffer(commandBuffer, pBeginInfo);
+        if (result == VK_SUCCESS && profile && context.gpu_profiler) {
+            context.gpu_profiler->Begin(commandBuffer, *pBeginInfo, profile->timestamps);
+        }
+        return result;
+    }
+
+    VkResult EndCommandBuffer(VkCommandBuffer commandBuffer) {
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (context.gpu_profiler) {
+            if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+                context.gpu_profiler->BeforeEnd(commandBuffer, profile->timestamps);
+            }
+        }
+        return context.dispatch.EndCommandBuffer(commandBuffer);
+    }
+
+    void CmdDraw(
+        VkCommandBuffer commandBuffer,
+        uint32_t vertexCount,
+        uint32_t instanceCount,
+        uint32_t firstVertex,
+        uint32_t firstInstance) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->draws++;
+        }
+        context.dispatch.CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+    }
+
+    void CmdDrawIndexed(
+        VkCommandBuffer commandBuffer,
+        uint32_t indexCount,
+        uint32_t instanceCount,
+        uint32_t firstIndex,
+        int32_t vertexOffset,
+        uint32_t firstInstance) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->draws++;
+        }
+        context.dispatch.CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex,
+                                        vertexOffset, firstInstance);
+    }
+
+    void CmdDrawIndirect(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        uint32_t drawCount,
+        uint32_t stride) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->draws++;
+        }
+        context.dispatch.CmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+    }
+
+    void CmdDrawIndexedIndirect(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        uint32_t drawCount,
+        uint32_t stride) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->draws++;
+        }
+        context.dispatch.CmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+    }
+
+    void CmdDrawIndirectCount(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkBuffer countBuffer,
+        VkDeviceSize countBufferOffset,
+        uint32_t maxDrawCount,
+        uint32_t stride) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->draws++;
+        }
+        context.dispatch.CmdDrawIndirectCount(commandBuffer, buffer, offset, countBuffer,
+                                              countBufferOffset, maxDrawCount, stride);
+    }
+
+    void CmdDrawIndexedIndirectCount(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset,
+        VkBuffer countBuffer,
+        VkDeviceSize countBufferOffset,
+        uint32_t maxDrawCount,
+        uint32_t stride) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->draws++;
+        }
+        context.dispatch.CmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer,
+                                                     countBufferOffset, maxDrawCount, stride);
+    }
+
+    void CmdDispatch(
+        VkCommandBuffer commandBuffer,
+        uint32_t groupCountX,
+        uint32_t groupCountY,
+        uint32_t groupCountZ) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->dispatches++;
+            if (context.gpu_profiler) {
+                context.gpu_profiler->BeforeDispatch(commandBuffer, profile->timestamps);
+            }
+        }
+        context.dispatch.CmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+    }
+
+    void CmdDispatchIndirect(
+        VkCommandBuffer commandBuffer,
+        VkBuffer buffer,
+        VkDeviceSize offset) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->dispatches++;
+            if (context.gpu_profiler) {
+                context.gpu_profiler->BeforeDispatch(commandBuffer, profile->timestamps);
+            }
+        }
+        context.dispatch.CmdDispatchIndirect(commandBuffer, buffer, offset);
+    }
+
+    void CmdDispatchBase(
+        VkCommandBuffer commandBuffer,
+        uint32_t baseGroupX,
+        uint32_t baseGroupY,
+        uint32_t baseGroupZ,
+        uint32_t groupCountX,
+        uint32_t groupCountY,
+        uint32_t groupCountZ) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->dispatches++;
+            if (context.gpu_profiler) {
+                context.gpu_profiler->BeforeDispatch(commandBuffer, profile->timestamps);
+            }
+        }
+        context.dispatch.CmdDispatchBase(commandBuffer, baseGroupX, baseGroupY, baseGroupZ,
+                                         groupCountX, groupCountY, groupCountZ);
+    }
+
+    void CmdCopyBuffer(
+        VkCommandBuffer commandBuffer,
+        VkBuffer srcBuffer,
+        VkBuffer dstBuffer,
+        uint32_t regionCount,
+        const VkBufferCopy* pRegions) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(regionCount, pRegions);
+        }
+        context.dispatch.CmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+    }
+
+    void CmdCopyImage(
+        VkCommandBuffer commandBuffer,
+        VkImage srcImage,
+        VkImageLayout srcImageLayout,
+        VkImage dstImage,
+        VkImageLayout dstImageLayout,
+        uint32_t regionCount,
+        const VkImageCopy* pRegions) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(regionCount, pRegions);
+        }
+        context.dispatch.CmdCopyImage(commandBuffer, srcImage, srcImageLayout, dstImage,
+                                      dstImageLayout, regionCount, pRegions);
+    }
+
+    void CmdCopyBufferToImage(
+        VkCommandBuffer commandBuffer,
+        VkBuffer srcBuffer,
+        VkImage dstImage,
+        VkImageLayout dstImageLayout,
+        uint32_t regionCount,
+        const VkBufferImageCopy* pRegions) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(regionCount, pRegions);
+        }
+        context.dispatch.CmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout,
+                                              regionCount, pRegions);
+    }
+
+    void CmdCopyImageToBuffer(
+        VkCommandBuffer commandBuffer,
+        VkImage srcImage,
+        VkImageLayout srcImageLayout,
+        VkBuffer dstBuffer,
+        uint32_t regionCount,
+        const VkBufferImageCopy* pRegions) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(regionCount, pRegions);
+        }
+        context.dispatch.CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer,
+                                              regionCount, pRegions);
+    }
+
+    void CmdBlitImage(
+        VkCommandBuffer commandBuffer,
+        VkImage srcImage,
+        VkImageLayout srcImageLayout,
+        VkImage dstImage,
+        VkImageLayout dstImageLayout,
+        uint32_t regionCount,
+        const VkImageBlit* pRegions,
+        VkFilter filter) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(regionCount, pRegions);
+        }
+        context.dispatch.CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage,
+                                      dstImageLayout, regionCount, pRegions, filter);
+    }
+
+    void CmdCopyBuffer2(
+        VkCommandBuffer commandBuffer,
+        const VkCopyBufferInfo2* pCopyBufferInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(pCopyBufferInfo->regionCount, pCopyBufferInfo->pRegions);
+        }
+        context.dispatch.CmdCopyBuffer2(commandBuffer, pCopyBufferInfo);
+    }
+
+    void CmdCopyImage2(
+        VkCommandBuffer commandBuffer,
+        const VkCopyImageInfo2* pCopyImageInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(pCopyImageInfo->regionCount, pCopyImageInfo->pRegions);
+        }
+        context.dispatch.CmdCopyImage2(commandBuffer, pCopyImageInfo);
+    }
+
+    void CmdCopyBufferToImage2(
+        VkCommandBuffer commandBuffer,
+        const VkCopyBufferToImageInfo2* pCopyBufferToImageInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(pCopyBufferToImageInfo->regionCount, pCopyBufferToImageInfo->pRegions);
+        }
+        context.dispatch.CmdCopyBufferToImage2(commandBuffer, pCopyBufferToImageInfo);
+    }
+
+    void CmdCopyImageToBuffer2(
+        VkCommandBuffer commandBuffer,
+        const VkCopyImageToBufferInfo2* pCopyImageToBufferInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(pCopyImageToBufferInfo->regionCount, pCopyImageToBufferInfo->pRegions);
+        }
+        context.dispatch.CmdCopyImageToBuffer2(commandBuffer, pCopyImageToBufferInfo);
+    }
+
+    void CmdBlitImage2(
+        VkCommandBuffer commandBuffer,
+        const VkBlitImageInfo2* pBlitImageInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddTransfer(pBlitImageInfo->regionCount, pBlitImageInfo->pRegions);
+        }
+        context.dispatch.CmdBlitImage2(commandBuffer, pBlitImageInfo);
+    }
+
+    void CmdBeginRenderPass(
+        VkCommandBuffer commandBuffer,
+        const VkRenderPassBeginInfo* pRenderPassBegin,
+        VkSubpassContents contents) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->render_passes++;
+            // Subpass dependencies are not visible to the layer
+            profile->sync_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            profile->release_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            if (context.gpu_profiler) {
+                context.gpu_profiler->BeforeRenderPass(commandBuffer, profile->timestamps,
+                                                       pRenderPassBegin->renderArea.extent);
+            }
+        }
+        context.dispatch.CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+    }
+
+    void CmdEndRenderPass(VkCommandBuffer commandBuffer) {
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        context.dispatch.CmdEndRenderPass(commandBuffer);
+        EndRenderPass(context, commandBuffer);
+    }
+
+    void CmdBeginRenderPass2(
+        VkCommandBuffer commandBuffer,
+        const VkRenderPassBeginInfo* pRenderPassBegin,
+        const VkSubpassBeginInfo* pSubpassBeginInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->render_passes++;
+            // Subpass dependencies are not visible to the layer
+            profile->sync_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            profile->release_stages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            if (context.gpu_profiler) {
+                context.gpu_profiler->BeforeRenderPass(commandBuffer, profile->timestamps,
+                                                       pRenderPassBegin->renderArea.extent);
+            }
+        }
+        context.dispatch.CmdBeginRenderPass2(commandBuffer, pRenderPassBegin, pSubpassBeginInfo);
+    }
+
+    void CmdEndRenderPass2(
+        VkCommandBuffer commandBuffer,
+        const VkSubpassEndInfo* pSubpassEndInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        context.dispatch.CmdEndRenderPass2(commandBuffer, pSubpassEndInfo);
+        EndRenderPass(context, commandBuffer);
+    }
+
+    void CmdBeginRendering(
+        VkCommandBuffer commandBuffer,
+        const VkRenderingInfo* pRenderingInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->render_passes++;
+            if (context.gpu_profiler) {
+                context.gpu_profiler->BeforeRendering(commandBuffer, profile->timestamps, *pRenderingInfo);
+            }
+        }
+        context.dispatch.CmdBeginRendering(commandBuffer, pRenderingInfo);
+    }
+
+    void CmdEndRendering(VkCommandBuffer commandBuffer) {
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        context.dispatch.CmdEndRendering(commandBuffer);
+        EndRenderPass(context, commandBuffer);
+    }
+
+    void CmdExecuteCommands(
+        VkCommandBuffer commandBuffer,
+        uint32_t commandBufferCount,
+        const VkCommandBuffer* pCommandBuffers) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            // Secondaries are fully recorded by now, and re-recording one
+            // invalidates this primary
+            profile->Add(context.command_profiles.Summarize(commandBufferCount, pCommandBuffers));
+        }
+        context.dispatch.CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+    }
+
+    void CmdPipelineBarrier(
+        VkCommandBuffer commandBuffer,
+        VkPipelineStageFlags srcStageMask,
+        VkPipelineStageFlags dstStageMask,
+        VkDependencyFlags dependencyFlags,
+        uint32_t memoryBarrierCount,
+        const VkMemoryBarrier* pMemoryBarriers,
+        uint32_t bufferMemoryBarrierCount,
+        const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+        uint32_t imageMemoryBarrierCount,
+        const VkImageMemoryBarrier* pImageMemoryBarriers) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddDependency(srcStageMask, dstStageMask);
+        }
+        context.dispatch.CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+                                            memoryBarrierCount, pMemoryBarriers,
+                                            bufferMemoryBarrierCount, pBufferMemoryBarriers,
+                                            imageMemoryBarrierCount, pImageMemoryBarriers);
+    }
+
+    void CmdPipelineBarrier2(
+        VkCommandBuffer commandBuffer,
+        const VkDependencyInfo* pDependencyInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->AddDependency(*pDependencyInfo);
+        }
+        context.dispatch.CmdPipelineBarrier2(commandBuffer, pDependencyInfo);
+    }
+
+    // Setting or resetting an event waits for earlier work like a barrier
+    void CmdSetEvent(
+        VkCommandBuffer commandBuffer,
+        VkEvent event,
+        VkPipelineStageFlags stageMask) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->events = true;
+            profile->AddDependency(stageMask, VK_PIPELINE_STAGE_2_NONE);
+        }
+        context.dispatch.CmdSetEvent(commandBuffer, event, stageMask);
+    }
+
+    void CmdResetEvent(
+        VkCommandBuffer commandBuffer,
+        VkEvent event,
+        VkPipelineStageFlags stageMask) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->events = true;
+            profile->AddDependency(stageMask, VK_PIPELINE_STAGE_2_NONE);
+        }
+        context.dispatch.CmdResetEvent(commandBuffer, event, stageMask);
+    }
+
+    void CmdWaitEvents(
+        VkCommandBuffer commandBuffer,
+        uint32_t eventCount,
+        const VkEvent* pEvents,
+        VkPipelineStageFlags srcStageMask,
+        VkPipelineStageFlags dstStageMask,
+        uint32_t memoryBarrierCount,
+        const VkMemoryBarrier* pMemoryBarriers,
+        uint32_t bufferMemoryBarrierCount,
+        const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+        uint32_t imageMemoryBarrierCount,
+        const VkImageMemoryBarrier* pImageMemoryBarriers) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->events = true;
+            // The source stages were recorded when the events were set
+            profile->AddDependency(VK_PIPELINE_STAGE_2_NONE, dstStageMask);
+        }
+        context.dispatch.CmdWaitEvents(commandBuffer, eventCount, pEvents, srcStageMask, dstStageMask,
+                                       memoryBarrierCount, pMemoryBarriers,
+                                       bufferMemoryBarrierCount, pBufferMemoryBarriers,
+                                       imageMemoryBarrierCount, pImageMemoryBarriers);
+    }
+
+    void CmdSetEvent2(
+        VkCommandBuffer commandBuffer,
+        VkEvent event,
+        const VkDependencyInfo* pDependencyInfo) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->events = true;
+            profile->AddDependency(*pDependencyInfo);
+        }
+        context.dispatch.CmdSetEvent2(commandBuffer, event, pDependencyInfo);
+    }
+
+    void CmdResetEvent2(
+        VkCommandBuffer commandBuffer,
+        VkEvent event,
+        VkPipelineStageFlags2 stageMask) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->events = true;
+            profile->AddDependency(stageMask, VK_PIPELINE_STAGE_2_NONE);
+        }
+        context.dispatch.CmdResetEvent2(commandBuffer, event, stageMask);
+    }
+
+    void CmdWaitEvents2(
+        VkCommandBuffer commandBuffer,
+        uint32_t eventCount,
+        const VkEvent* pEvents,
+        const VkDependencyInfo* pDependencyInfos) {
+        
+        DeviceContext& context = *device_contexts_.Find(GetDispatchKey(commandBuffer));
+        if (CommandBufferProfile* profile = context.command_profiles.Find(commandBuffer)) {
+            profile->events = true;
+            for (uint32_t i = 0; i < eventCount; ++i) {
+                profile->AddDependency(pDependencyInfos[i]);
+            }
+        }
+        context.dispatch.CmdWaitEvents2(commandBuffer, eventCount, pEvents, pDependencyInfos);
+    }
+
+private:
+    VkResult ForwardBindSparse(DeviceContext& context, VkQueue queue, uint32_t bindInfoCount,
+                               const VkBindSparseInfo* pBindInfo, VkFence fence) {
+        if (!context.suballocator) {
+            return context.dispatch.QueueBindSparse(queue, bindInfoCount, pBindInfo, fence);
+        }
+        
+        // Every memory reference sits three levels deep; copy the whole tree
+        ScratchArena::Scope scratch;
+        ScratchArena& arena = scratch.arena();
+        VkBindSparseInfo* infos = arena.CopyArray(pBindInfo, bindInfoCount);
+        for (uint32_t i = 0; i < bindInfoCount; ++i) {
+            VkBindSparseInfo& info = infos[i];
+            
+            auto* buffer_binds = arena.CopyArray(info.pBufferBinds, info.bufferBindCount);
+            for (uint32_t j = 0; j < info.bufferBindCount; ++j) {
+                buffer_binds[j].pBinds = TranslateSparseBinds(
+                    context, arena, buffer_binds[j].pBinds, buffer_binds[j].bindCount);
+            }
+            info.pBufferBinds = buffer_binds;
+            
+            auto* opaque_binds = arena.CopyArray(info.pImageOpaqueBinds, info.imageOpaqueBindCount);
+            for (uint32_t j = 0; j < info.imageOpaqueBindCount; ++j) {
+                opaque_binds[j].pBinds = TranslateSparseBinds(
+                    context, arena, opaque_binds[j].pBinds, opaque_binds[j].bindCount);
+            }
+            info.pImageOpaqueBinds = opaque_binds;
+            
+            auto* image_binds = arena.CopyArray(info.pImageBinds, info.imageBindCount);
+            for (uint32_t j = 0; j < info.imageBindCount; ++j) {
+                image_binds[j].pBinds = TranslateSparseBinds(
+                    context, arena, image_binds[j].pBinds, image_binds[j].bindCount);
+            }
+            info.pImageBinds = image_binds;
+        }
+        
+        return context.dispatch.QueueBindSparse(queue, bindInfoCount, infos, fence);
+    }
+
+    // Host waits and polls must not miss work the batcher is holding back
+    VkResult FlushDeferredSubmits(DeviceContext& context) {
+        return context.submit_batcher ? context.submit_batcher->FlushAll() : VK_SUCCESS;
+    }
+
+    Suballocation* FindSuballocation(DeviceContext& context, VkDeviceMemory memory) {
+        if (!context.suballocator || memory == VK_NULL_HANDLE) return nullptr;
+        return context.suballocator->Find(memory);
+    }
+
+    // Rewrites a suballocated handle/offset pair to the driver allocation
+    void TranslateMemory(DeviceContext& context, VkDeviceMemory& memory, VkDeviceSize& offset) {
+        if (Suballocation* allocation = FindSuballocation(context, memory)) {
+            memory = allocation->memory;
+            offset += allocation->offset;
+        }
+    }
+
+    const VkMappedMemoryRange* TranslateMappedRanges(DeviceContext& context, ScratchArena& arena,
+                                                     const VkMappedMemoryRange* ranges,
+                                                     uint32_t count) {
+        if (!context.suballocator) return ranges;
+        
+        VkMappedMemoryRange* translated = arena.CopyArray(ranges, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            Suballocation* allocation = FindSuballocation(context, translated[i].memory);
+            if (!allocation) continue;
+            
+            // Buddy blocks are multiples of nonCoherentAtomSize, so the rest
+            // of the block stays a legal flush size
+            if (translated[i].size == VK_WHOLE_SIZE) {
+                translated[i].size = allocation->size - translated[i].offset;
+            }
+            translated[i].memory = allocation->memory;
+            translated[i].offset += allocation->offset;
+        }
+        return translated;
+    }
+
+    template <typename SparseBind>
+    const SparseBind* TranslateSparseBinds(DeviceContext& context, ScratchArena& arena,
+                                           const SparseBind* binds, uint32_t count) {
+        SparseBind* translated = arena.CopyArray(binds, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            TranslateMemory(context, translated[i].memory, translated[i].memoryOffset);
+        }
+        return translated;
+    }
+
+    template <typename CreateInfo>
+    bool CanFanOutBatch(const DeviceContext& context, VkPipelineCache cache, uint32_t count,
+                        const CreateInfo* infos, const VkAllocationCallbacks* allocator) {
+        if (!context.parallel_compile || count < 2) return false;
+        
+        // App allocation callbacks are not promised to be thread-safe
+        if (allocator) return false;
+        
+        // An app cache may be VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT;
+        // only our own cache is known to tolerate concurrent compiles.
+        if (cache != VK_NULL_HANDLE &&
+            !(context.pipeline_cache && cache == context.pipeline_cache->handle())) {
+            return false;
+        }
+        
+        for (uint32_t i = 0; i < count; ++i) {
+            // Derivatives of another batch element and early-return batches
+            // depend on ordering within the single driver call
+            if (infos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT) return false;
+            if ((infos[i].flags & VK_PIPELINE_CREATE_DERIVATIVE_BIT) && infos[i].basePipelineIndex >= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Compiles each element with its own driver call on the pool and merges
+    // the results the way a single batched call reports them.
+    template <typename CompileFn>
+    VkResult FanOutBatch(uint32_t count, VkPipeline* pipelines, CompileFn&& compile) {
+        VkResult* results = ScratchArena::ForThread().Allocate<VkResult>(count);
+        CompileThreadPool::Shared().ParallelFor(count, [&](uint32_t i) {
+            results[i] = compile(i, &pipelines[i]);
+            if (results[i] != VK_SUCCESS) {
+                pipelines[i] = VK_NULL_HANDLE;
+            }
+        });
+        
+        // First error wins; otherwise VK_PIPELINE_COMPILE_REQUIRED if any
+        // element hit VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT
+        VkResult combined = VK_SUCCESS;
+        for (uint32_t i = 0; i < count; ++i) {
+            VkResult result = results[i];
+            if (result < 0) return result;
+            if (result != VK_SUCCESS && combined == VK_SUCCESS) combined = result;
+        }
+        return combined;
+    }
+
+    // Chains feedback into info unless the app already asked for its own
+    template <typename CreateInfo>
+    void AttachCreationFeedback(const DeviceContext& context, CreateInfo& info,
+                                uint32_t stage_count, CreationFeedback& feedback) {
+        feedback.result = nullptr;
+        feedback.elapsed_ns = 0;
+        
+        for (auto* next = static_cast<const VkBaseInStructure*>(info.pNext); next; next = next->pNext) {
+            if (next->sType == VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO) {
+                feedback.result = reinterpret_cast<const VkPipelineCreationFeedbackCreateInfo*>(next)
+                                      ->pPipelineCreationFeedback;
+                return;
+            }
+        }
+        
+        if (!context.extensions.pipeline_creation_feedback || stage_count > kMaxFeedbackStages) {
+            return;
+        }
+        
+        feedback.info = {VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO};
+        feedback.info.pNext = info.pNext;
+        feedback.info.pPipelineCreationFeedback = &feedback.pipeline;
+        feedback.info.pipelineStageCreationFeedbackCount = stage_count;
+        feedback.info.pPipelineStageCreationFeedbacks = feedback.stages;
+        feedback.pipeline = {};
+        feedback.result = &feedback.pipeline;
+        info.pNext = &feedback.info;
+    }
+    
+    // A batched driver call only has a total; share it out evenly
+    void SplitBatchTime(CreationFeedback* feedback, uint32_t count, uint64_t elapsed_ns) {
+        for (uint32_t i = 0; i < count; ++i) {
+            feedback[i].elapsed_ns = elapsed_ns / count;
+        }
+    }
+    
+    void RecordCompiles(DeviceContext& context, VkPipelineBindPoint bind_point,
+                        const VkPipeline* pipelines, const CreationFeedback* feedback,
+                        uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            // Failed and VK_PIPELINE_COMPILE_REQUIRED entries compiled nothing
+            if (pipelines[i] == VK_NULL_HANDLE) continue;
+            
+            const VkPipelineCreationFeedback* result = feedback[i].result;
+            if (result && (result->flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT)) {
+                // The driver's own duration excludes time spent queued in the layer
+                bool hit = result->flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+                context.compile_stats->Record(bind_point,
+                                              hit ? CacheOutcome::kHit : CacheOutcome::kMiss,
+                                              result->duration);
+            } else {
+                context.compile_stats->Record(bind_point, CacheOutcome::kNoFeedback,
+                                              feedback[i].elapsed_ns);
+            }
+        }
+    }
+
+    VkPipelineCache ResolvePipelineCache(const DeviceContext& context, VkPipelineCache app_cache) {
+        // Respect caches the app manages itself
+        if (app_cache != VK_NULL_HANDLE || !context.pipeline_cache) {
+            return app_cache;
+        }
+        return context.pipeline_cache->handle();
+    }
+
+    // Returns true if dedicated_info was chained into info
+    bool OptimizeMemoryAllocation(const DeviceContext& context, VkMemoryAllocateInfo& info,
+                                  VkMemoryDedicatedAllocateInfo& dedicated_info) {
+        bool injected = context.dedicated_images &&
+                        context.dedicated_images->InjectDedicated(info, dedicated_info);
+        
+        // Move to the fastest type the policy table allows; before rounding,
+        // since the policy matches the size the app was given
+        if (context.memory_type_policy) {
+            info.memoryTypeIndex = context.memory_type_policy->Select(info, *context.memory_budget);
+        }
+        
+        // Align for cache performance; dedicated allocations must match the
+        // resource's size exactly
+        if (!HasDedicatedAllocateInfo(info.pNext)) {
+            info.allocationSize = (info.allocationSize + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+        }
+        return injected;
+    }
+
+    // After the driver's end of a render pass instance
+    void EndRenderPass(DeviceContext& context, VkCommandBuffer command_buffer) {
+        if (!context.gpu_profiler) return;
+        if (CommandBufferProfile* profile = context.command_profiles.Find(command_buffer)) {
+            context.gpu_profiler->AfterRenderPass(command_buffer, profile->timestamps);
+        }
+    }
+
+    // Returns the profile of the whole call
+    CommandBufferProfile ClassifySubmits(DeviceContext& context, const VkSubmitInfo* submits,
+                                         uint32_t count) {
+        CommandBufferProfile sum;
+        for (uint32_t i = 0; i < count; ++i) {
+            CommandBufferProfile profile = context.command_profiles.Summarize(
+                submits[i].commandBufferCount, submits[i].pCommandBuffers);
+            context.command_profiles.RecordSubmit(ClassifyWorkload(profile), profile);
+            sum.Add(profile);
+        }
+        return sum;
+    }
+
+    CommandBufferProfile ClassifySubmits(DeviceContext& context, const VkSubmitInfo2* submits,
+                                         uint32_t count) {
+        CommandBufferProfile sum;
+        for (uint32_t i = 0; i < count; ++i) {
+            CommandBufferProfile profile = context.command_profiles.Summarize(
+                submits[i].commandBufferInfoCount, submits[i].pCommandBufferInfos);
+            context.command_profiles.RecordSubmit(ClassifyWorkload(profile), profile);
+            sum.Add(profile);
+        }
+        return sum;
+    }
+
+    VkResult ForwardSubmit(DeviceContext& context, VkQueue queue, uint32_t count,
+                           const VkSubmitInfo* submits, VkFence fence) {
+        if (context.submit_batcher) {
+            return context.submit_batcher->Submit(queue, count, submits, fence);
+        }
+        return context.dispatch.QueueSubmit(queue, count, submits, fence);
+    }
+
+    VkResult ForwardSubmit(DeviceContext& context, VkQueue queue, uint32_t count,
+                           const VkSubmitInfo2* submits, VkFence fence) {
+        if (context.submit_batcher) {
+            return context.submit_batcher->Submit(queue, count, submits, fence);
+        }
+        return context.dispatch.QueueSubmit2(queue, count, submits, fence);
+    }
+
+    template <typename SubmitInfo>
+    VkResult ScheduleSubmit(DeviceContext& context, VkQueue queue, uint32_t count,
+                            const SubmitInfo* submits, VkFence fence,
+                            const CommandBufferProfile& profile) {
+        AsyncComputeScheduler& scheduler = *context.async_compute;
+        if (scheduler.CanOffload(queue, profile, count, submits)) {
+            // Held submits may signal what the offloaded work waits on
+            if (context.submit_batcher) {
+                return context.submit_batcher->Exclusive(queue, [&] {
+                    return scheduler.Offload(queue, count, submits, fence, profile);
+                });
+            }
+            return scheduler.Offload(queue, count, submits, fence, profile);
+        }
+        
+        ScratchArena::Scope scratch;
+        submits = scheduler.Join(queue, count, submits, fence, profile, scratch.arena());
+        return ForwardSubmit(context, queue, count, submits, fence);
+    }
+
+    // Stage mask and SPIR-V hashes of the stages a pipeline is created from
+    void RecordShaders(DeviceContext& context, uint32_t stage_count,
+                       const VkPipelineShaderStageCreateInfo* stages, PipelineShaders& pipeline) {
+        for (uint32_t i = 0; i < stage_count; ++i) {
+            pipeline.shader_stages |= stages[i].stage;
+        }
+        for (uint32_t i = 0; i < stage_count; ++i) {
+            uint32_t slot = std::popcount(pipeline.shader_stages & (stages[i].stage - 1u));
+            if (slot < kMaxPipelineShaders) {
+                pipeline.shaders[slot] = context.shader_modules->HashStage(stages[i]);
+            }
+        }
+    }
+
+    void RegisterPipelines(DeviceContext& context, const VkPipeline* pipelines, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (pipelines[i] != VK_NULL_HANDLE) {
+                context.pipelines.Insert(pipelines[i]);
+            }
+        }
+    }
+};
+
+// Global wrapper instance
+static Xclipse940Wrapper g_wrapper;
+
+namespace xclipse {
+
+bool OnDeviceCreated(VkPhysicalDevice physical_device, VkDevice device,
+                     const InstanceDispatch& instance_dispatch,
+                     const DeviceDispatch& device_dispatch,
+                     const DeviceExtensions& extensions,
+                     const AsyncComputePlan& async_compute) {
+    return g_wrapper.InitializeDeviceContext(physical_device, device, instance_dispatch,
+                                             device_dispatch, extensions, async_compute);
+}
+
+void OnDeviceDestroyed(VkDevice device) {
+    g_wrapper.ReleaseDeviceContext(device);
+}
+
+PipelineRegistryStats GetPipelineStats(VkDevice device) {
+    return g_wrapper.PipelineStats(device);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateGraphicsPipelines(
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipeline* pPipelines) {
+    
+    return g_wrapper.CreateGraphicsPipelines(device, pipelineCache, createInfoCount,
+                                           pCreateInfos, pAllocator, pPipelines);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateComputePipelines(
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkComputePipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipeline* pPipelines) {
+    
+    return g_wrapper.CreateComputePipelines(device, pipelineCache, createInfoCount,
+                                          pCreateInfos, pAllocator, pPipelines);
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyPipeline(
+    VkDevice device,
+    VkPipeline pipeline,
+    const VkAllocationCallbacks* pAllocator) {
+    
+    g_wrapper.DestroyPipeline(device, pipeline, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateShaderModule(
+    VkDevice device,
+    const VkShaderModuleCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkShaderModule* pShaderModule) {
+    
+    return g_wrapper.CreateShaderModule(device, pCreateInfo, pAllocator, pShaderModule);
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyShaderModule(
+    VkDevice device,
+    VkShaderModule shaderModule,
+    const VkAllocationCallbacks* pAllocator) {
+    
+    g_wrapper.DestroyShaderModule(device, shaderModule, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL AllocateMemory(
+    VkDevice device,
+    const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkDeviceMemory* pMemory) {
+    
+    return g_wrapper.AllocateMemory(device, pAllocateInfo, pAllocator, pMemory);
+}
+
+VKAPI_ATTR void VKAPI_CALL FreeMemory(
+    VkDevice device,
+    VkDeviceMemory memory,
+    const VkAllocationCallbacks* pAllocator) {
+    
+    g_wrapper.FreeMemory(device, memory, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MapMemory(
+    VkDevice device,
+    VkDeviceMemory memory,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    VkMemoryMapFlags flags,
+    void** ppData) {
+    
+    return g_wrapper.MapMemory(device, memory, offset, size, flags, ppData);
+}
+
+VKAPI_ATTR void VKAPI_CALL UnmapMemory(
+    VkDevice device,
+    VkDeviceMemory memory) {
+    
+    g_wrapper.UnmapMemory(device, memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL FlushMappedMemoryRanges(
+    VkDevice device,
+    uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges) {
+    
+    return g_wrapper.FlushMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL InvalidateMappedMemoryRanges(
+    VkDevice device,
+    uint32_t memoryRangeCount,
+    const VkMappedMemoryRange* pMemoryRanges) {
+    
+    return g_wrapper.InvalidateMappedMemoryRanges(device, memoryRangeCount, pMemoryRanges);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetDeviceMemoryCommitment(
+    VkDevice device,
+    VkDeviceMemory memory,
+    VkDeviceSize* pCommittedMemoryInBytes) {
+    
+    g_wrapper.GetDeviceMemoryCommitment(device, memory, pCommittedMemoryInBytes);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL BindBufferMemory(
+    VkDevice device,
+    VkBuffer buffer,
+    VkDeviceMemory memory,
+    VkDeviceSize memoryOffset) {
+    
+    return g_wrapper.BindBufferMemory(device, buffer, memory, memoryOffset);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL BindImageMemory(
+    VkDevice device,
+    VkImage image,
+    VkDeviceMemory memory,
+    VkDeviceSize memoryOffset) {
+    
+    return g_wrapper.BindImageMemory(device, image, memory, memoryOffset);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL BindBufferMemory2(
+    VkDevice device,
+    uint32_t bindInfoCount,
+    const VkBindBufferMemoryInfo* pBindInfos) {
+    
+    return g_wrapper.BindBufferMemory2(device, bindInfoCount, pBindInfos);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL BindImageMemory2(
+    VkDevice device,
+    uint32_t bindInfoCount,
+    const VkBindImageMemoryInfo* pBindInfos) {
+    
+    return g_wrapper.BindImageMemory2(device, bindInfoCount, pBindInfos);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateImage(
+    VkDevice device,
+    const VkImageCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkImage* pImage) {
+    
+    return g_wrapper.CreateImage(device, pCreateInfo, pAllocator, pImage);
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyImage(
+    VkDevice device,
+    VkImage image,
+    const VkAllocationCallbacks* pAllocator) {
+    
+    g_wrapper.DestroyImage(device, image, pAllocator);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements(
+    VkDevice device,
+    VkBuffer buffer,
+    VkMemoryRequirements* pMemoryRequirements) {
+    
+    g_wrapper.GetBufferMemoryRequirements(device, buffer, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements(
+    VkDevice device,
+    VkImage image,
+    VkMemoryRequirements* pMemoryRequirements) {
+    
+    g_wrapper.GetImageMemoryRequirements(device, image, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetBufferMemoryRequirements2(
+    VkDevice device,
+    const VkBufferMemoryRequirementsInfo2* pInfo,
+    VkMemoryRequirements2* pMemoryRequirements) {
+    
+    g_wrapper.GetBufferMemoryRequirements2(device, pInfo, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetImageMemoryRequirements2(
+    VkDevice device,
+    const VkImageMemoryRequirementsInfo2* pInfo,
+    VkMemoryRequirements2* pMemoryRequirements) {
+    
+    g_wrapper.GetImageMemoryRequirements2(device, pInfo, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetDeviceBufferMemoryRequirements(
+    VkDevice device,
+    const VkDeviceBufferMemoryRequirements* pInfo,
+    VkMemoryRequirements2* pMemoryRequirements) {
+    
+    g_wrapper.GetDeviceBufferMemoryRequirements(device, pInfo, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetDeviceImageMemoryRequirements(
+    VkDevice device,
+    const VkDeviceImageMemoryRequirements* pInfo,
+    VkMemoryRequirements2* pMemoryRequirements) {
+    
+    g_wrapper.GetDeviceImageMemoryRequirements(device, pInfo, pMemoryRequirements);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit(
+    VkQueue queue,
+    uint32_t submitCount,
+    const VkSubmitInfo* pSubmits,
+    VkFence fence) {
+    
+    return g_wrapper.QueueSubmit(queue, submitCount, pSubmits, fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueueSubmit2(
+    VkQueue queue,
+    uint32_t submitCount,
+    const VkSubmitInfo2* pSubmits,
+    VkFence fence) {
+    
+    return g_wrapper.QueueSubmit2(queue, submitCount, pSubmits, fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueueWaitIdle(
+    VkQueue queue) {
+    
+    return g_wrapper.QueueWaitIdle(queue);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL DeviceWaitIdle(
+    VkDevice device) {
+    
+    return g_wrapper.DeviceWaitIdle(device);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL WaitForFences(
+    VkDevice device,
+    uint32_t fenceCount,
+    const VkFence* pFences,
+    VkBool32 waitAll,
+    uint64_t timeout) {
+    
+    return g_wrapper.WaitForFences(device, fenceCount, pFences, waitAll, timeout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL WaitSemaphores(
+    VkDevice device,
+    const VkSemaphoreWaitInfo* pWaitInfo,
+    uint64_t timeout) {
+    
+    return g_wrapper.WaitSemaphores(device, pWaitInfo, timeout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetSemaphoreCounterValue(
+    VkDevice device,
+    VkSemaphore semaphore,
+    uint64_t* pValue) {
+    
+    return g_wrapper.GetSemaphoreCounterValue(device, semaphore, pValue);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetEventStatus(
+    VkDevice device,
+    VkEvent event) {
+    
+    return g_wrapper.GetEventStatus(device, event);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL GetQueryPoolResults(
+    VkDevice device,
+    VkQueryPool queryPool,
+    uint32_t firstQuery,
+    uint32_t queryCount,
+    size_t dataSize,
+    void* pData,
+    VkDeviceSize stride,
+    VkQueryResultFlags flags) {
+    
+    return g_wrapper.GetQueryPoolResults(device, queryPool, firstQuery, queryCount,
+                                         dataSize, pData, stride, flags);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueueBindSparse(
+    VkQueue queue,
+    uint32_t bindInfoCount,
+    const VkBindSparseInfo* pBindInfo,
+    VkFence fence) {
+    
+    return g_wrapper.QueueBindSparse(queue, bindInfoCount, pBindInfo, fence);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL QueuePresentKHR(
+    VkQueue queue,
+    const VkPresentInfoKHR* pPresentInfo) {
+    
+    return g_wrapper.QueuePresentKHR(queue, pPresentInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetDeviceQueue(
+    VkDevice device,
+    uint32_t queueFamilyIndex,
+    uint32_t queueIndex,
+    VkQueue* pQueue) {
+    
+    g_wrapper.GetDeviceQueue(device, queueFamilyIndex, queueIndex, pQueue);
+}
+
+VKAPI_ATTR void VKAPI_CALL GetDeviceQueue2(
+    VkDevice device,
+    const VkDeviceQueueInfo2* pQueueInfo,
+    VkQueue* pQueue) {
+    
+    g_wrapper.GetDeviceQueue2(device, pQueueInfo, pQueue);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL CreateCommandPool(
+    VkDevice device,
+    const VkCommandPoolCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkCommandPool* pCommandPool) {
+    
+    return g_wrapper.CreateCommandPool(device, pCreateInfo, pAllocator, pCommandPool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL AllocateCommandBuffers(
+    VkDevice device,
+    const VkCommandBufferAllocateInfo* pAllocateInfo,
+    VkCommandBuffer* pCommandBuffers) {
+    
+    return g_wrapper.AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL FreeCommandBuffers(
+    VkDevice device,
+    VkCommandPool commandPool,
+    uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers) {
+    
+    g_wrapper.FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL DestroyCommandPool(
+    VkDevice device,
+    VkCommandPool commandPool,
+    const VkAllocationCallbacks* pAllocator) {
+    
+    g_wrapper.DestroyCommandPool(device, commandPool, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL BeginCommandBuffer(
+    VkCommandBuffer commandBuffer,
+    const VkCommandBufferBeginInfo* pBeginInfo) {
+    
+    return g_wrapper.BeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL EndCommandBuffer(
+    VkCommandBuffer commandBuffer) {
+    
+    return g_wrapper.EndCommandBuffer(commandBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDraw(
+    VkCommandBuffer commandBuffer,
+    uint32_t vertexCount,
+    uint32_t instanceCount,
+    uint32_t firstVertex,
+    uint32_t firstInstance) {
+    
+    g_wrapper.CmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDrawIndexed(
+    VkCommandBuffer commandBuffer,
+    uint32_t indexCount,
+    uint32_t instanceCount,
+    uint32_t firstIndex,
+    int32_t vertexOffset,
+    uint32_t firstInstance) {
+    
+    g_wrapper.CmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset,
+                             firstInstance);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDrawIndirect(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    uint32_t drawCount,
+    uint32_t stride) {
+    
+    g_wrapper.CmdDrawIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDrawIndexedIndirect(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    uint32_t drawCount,
+    uint32_t stride) {
+    
+    g_wrapper.CmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDrawIndirectCount(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkBuffer countBuffer,
+    VkDeviceSize countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride) {
+    
+    g_wrapper.CmdDrawIndirectCount(commandBuffer, buffer, offset, countBuffer, countBufferOffset,
+                                   maxDrawCount, stride);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDrawIndexedIndirectCount(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkBuffer countBuffer,
+    VkDeviceSize countBufferOffset,
+    uint32_t maxDrawCount,
+    uint32_t stride) {
+    
+    g_wrapper.CmdDrawIndexedIndirectCount(commandBuffer, buffer, offset, countBuffer,
+                                          countBufferOffset, maxDrawCount, stride);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDispatch(
+    VkCommandBuffer commandBuffer,
+    uint32_t groupCountX,
+    uint32_t groupCountY,
+    uint32_t groupCountZ) {
+    
+    g_wrapper.CmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDispatchIndirect(
+    VkCommandBuffer commandBuffer,
+    VkBuffer buffer,
+    VkDeviceSize offset) {
+    
+    g_wrapper.CmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdDispatchBase(
+    VkCommandBuffer commandBuffer,
+    uint32_t baseGroupX,
+    uint32_t baseGroupY,
+    uint32_t baseGroupZ,
+    uint32_t groupCountX,
+    uint32_t groupCountY,
+    uint32_t groupCountZ) {
+    
+    g_wrapper.CmdDispatchBase(commandBuffer, baseGroupX, baseGroupY, baseGroupZ, groupCountX,
+                              groupCountY, groupCountZ);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyBuffer(
+    VkCommandBuffer commandBuffer,
+    VkBuffer srcBuffer,
+    VkBuffer dstBuffer,
+    uint32_t regionCount,
+    const VkBufferCopy* pRegions) {
+    
+    g_wrapper.CmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyImage(
+    VkCommandBuffer commandBuffer,
+    VkImage srcImage,
+    VkImageLayout srcImageLayout,
+    VkImage dstImage,
+    VkImageLayout dstImageLayout,
+    uint32_t regionCount,
+    const VkImageCopy* pRegions) {
+    
+    g_wrapper.CmdCopyImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+                           regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyBufferToImage(
+    VkCommandBuffer commandBuffer,
+    VkBuffer srcBuffer,
+    VkImage dstImage,
+    VkImageLayout dstImageLayout,
+    uint32_t regionCount,
+    const VkBufferImageCopy* pRegions) {
+    
+    g_wrapper.CmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyImageToBuffer(
+    VkCommandBuffer commandBuffer,
+    VkImage srcImage,
+    VkImageLayout srcImageLayout,
+    VkBuffer dstBuffer,
+    uint32_t regionCount,
+    const VkBufferImageCopy* pRegions) {
+    
+    g_wrapper.CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdBlitImage(
+    VkCommandBuffer commandBuffer,
+    VkImage srcImage,
+    VkImageLayout srcImageLayout,
+    VkImage dstImage,
+    VkImageLayout dstImageLayout,
+    uint32_t regionCount,
+    const VkImageBlit* pRegions,
+    VkFilter filter) {
+    
+    g_wrapper.CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+                           regionCount, pRegions, filter);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyBuffer2(
+    VkCommandBuffer commandBuffer,
+    const VkCopyBufferInfo2* pCopyBufferInfo) {
+    
+    g_wrapper.CmdCopyBuffer2(commandBuffer, pCopyBufferInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyImage2(
+    VkCommandBuffer commandBuffer,
+    const VkCopyImageInfo2* pCopyImageInfo) {
+    
+    g_wrapper.CmdCopyImage2(commandBuffer, pCopyImageInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyBufferToImage2(
+    VkCommandBuffer commandBuffer,
+    const VkCopyBufferToImageInfo2* pCopyBufferToImageInfo) {
+    
+    g_wrapper.CmdCopyBufferToImage2(commandBuffer, pCopyBufferToImageInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdCopyImageToBuffer2(
+    VkCommandBuffer commandBuffer,
+    const VkCopyImageToBufferInfo2* pCopyImageToBufferInfo) {
+    
+    g_wrapper.CmdCopyImageToBuffer2(commandBuffer, pCopyImageToBufferInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdBlitImage2(
+    VkCommandBuffer commandBuffer,
+    const VkBlitImageInfo2* pBlitImageInfo) {
+    
+    g_wrapper.CmdBlitImage2(commandBuffer, pBlitImageInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass(
+    VkCommandBuffer commandBuffer,
+    const VkRenderPassBeginInfo* pRenderPassBegin,
+    VkSubpassContents contents) {
+    
+    g_wrapper.CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdBeginRenderPass2(
+    VkCommandBuffer commandBuffer,
+    const VkRenderPassBeginInfo* pRenderPassBegin,
+    const VkSubpassBeginInfo* pSubpassBeginInfo) {
+    
+    g_wrapper.CmdBeginRenderPass2(commandBuffer, pRenderPassBegin, pSubpassBeginInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass(
+    VkCommandBuffer commandBuffer) {
+    
+    g_wrapper.CmdEndRenderPass(commandBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdEndRenderPass2(
+    VkCommandBuffer commandBuffer,
+    const VkSubpassEndInfo* pSubpassEndInfo) {
+    
+    g_wrapper.CmdEndRenderPass2(commandBuffer, pSubpassEndInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdBeginRendering(
+    VkCommandBuffer commandBuffer,
+    const VkRenderingInfo* pRenderingInfo) {
+    
+    g_wrapper.CmdBeginRendering(commandBuffer, pRenderingInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdEndRendering(
+    VkCommandBuffer commandBuffer) {
+    
+    g_wrapper.CmdEndRendering(commandBuffer);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdExecuteCommands(
+    VkCommandBuffer commandBuffer,
+    uint32_t commandBufferCount,
+    const VkCommandBuffer* pCommandBuffers) {
+    
+    g_wrapper.CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier(
+    VkCommandBuffer commandBuffer,
+    VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask,
+    VkDependencyFlags dependencyFlags,
+    uint32_t memoryBarrierCount,
+    const VkMemoryBarrier* pMemoryBarriers,
+    uint32_t bufferMemoryBarrierCount,
+    const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+    uint32_t imageMemoryBarrierCount,
+    const VkImageMemoryBarrier* pImageMemoryBarriers) {
+    
+    g_wrapper.CmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+                                 memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
+                                 pBufferMemoryBarriers, imageMemoryBarrierCount,
+                                 pImageMemoryBarriers);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdPipelineBarrier2(
+    VkCommandBuffer commandBuffer,
+    const VkDependencyInfo* pDependencyInfo) {
+    
+    g_wrapper.CmdPipelineBarrier2(commandBuffer, pDependencyInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdSetEvent(
+    VkCommandBuffer commandBuffer,
+    VkEvent event,
+    VkPipelineStageFlags stageMask) {
+    
+    g_wrapper.CmdSetEvent(commandBuffer, event, stageMask);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdResetEvent(
+    VkCommandBuffer commandBuffer,
+    VkEvent event,
+    VkPipelineStageFlags stageMask) {
+    
+    g_wrapper.CmdResetEvent(commandBuffer, event, stageMask);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdWaitEvents(
+    VkCommandBuffer commandBuffer,
+    uint32_t eventCount,
+    const VkEvent* pEvents,
+    VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask,
+    uint32_t memoryBarrierCount,
+    const VkMemoryBarrier* pMemoryBarriers,
+    uint32_t bufferMemoryBarrierCount,
+    const VkBufferMemoryBarrier* pBufferMemoryBarriers,
+    uint32_t imageMemoryBarrierCount,
+    const VkImageMemoryBarrier* pImageMemoryBarriers) {
+    
+    g_wrapper.CmdWaitEvents(commandBuffer, eventCount, pEvents, srcStageMask, dstStageMask,
+                            memoryBarrierCount, pMemoryBarriers, bufferMemoryBarrierCount,
+                            pBufferMemoryBarriers, imageMemoryBarrierCount, pImageMemoryBarriers);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdSetEvent2(
+    VkCommandBuffer commandBuffer,
+    VkEvent event,
+    const VkDependencyInfo* pDependencyInfo) {
+    
+    g_wrapper.CmdSetEvent2(commandBuffer, event, pDependencyInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdResetEvent2(
+    VkCommandBuffer commandBuffer,
+    VkEvent event,
+    VkPipelineStageFlags2 stageMask) {
+    
+    g_wrapper.CmdResetEvent2(commandBuffer, event, stageMask);
+}
+
+VKAPI_ATTR void VKAPI_CALL CmdWaitEvents2(
+    VkCommandBuffer commandBuffer,
+    uint32_t eventCount,
+    const VkEvent* pEvents,
+    const VkDependencyInfo* pDependencyInfos) {
+    
+    g_wrapper.CmdWaitEvents2(commandBuffer, eventCount, pEvents, pDependencyInfos);
+}
+
+} // namespace xclipse
+
+const DeviceDispatch* GetDeviceDispatch(void* key) {
+    return g_wrapper.FindDeviceDispatch(key);
+}
@@ -0,0 +1,168 @@
+// app_profile_test.cpp - Profile sections, settings and environment overrides
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "app_profile.h"
+#include "layer_paths.h"
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+ApplicationIdentity Identity(const char* application, const char* engine, const char* process) {
+    return ApplicationIdentity{application, engine, process};
+}
+
+LayerSettings Apply(const char* text, const ApplicationIdentity& identity) {
+    LayerSettings settings;
+    ApplyLayerProfiles(text, identity, settings);
+    return settings;
+}
+
+std::string WriteProfile(const char* name, const std::string& text) {
+    std::string path = TestDataDirectory() + "/" + name;
+    if (FILE* file = std::fopen(path.c_str(), "w")) {
+        std::fwrite(text.data(), 1, text.size(), file);
+        std::fclose(file);
+    }
+    return path;
+}
+
+} // namespace
+
+XCLIPSE_TEST(DefaultsWithoutAProfile) {
+    LayerSettings settings = Apply("", Identity("", "", ""));
+    EXPECT_FALSE(settings.batch_submits);
+    EXPECT_TRUE(settings.persistent_mapping);
+    EXPECT_FALSE(settings.dedicated_image_inject);
+    EXPECT_EQ(settings.dedicated_image_min_kb, 4096u);
+    EXPECT_EQ(settings.compute_subgroup_size, 0u);
+    EXPECT_TRUE(settings.pipeline_rules.empty());
+}
+
+XCLIPSE_TEST(GlobalSettingsComeBeforeTheFirstSection) {
+    LayerSettings settings = Apply(
+        "# applies to everything\n"
+        "suballocate_memory = 1\n"
+        "dedicated_image_min_kb = 1024   # trailing comment\n"
+        "[engine=nothing]\n"
+        "persistent_mapping = 0\n",
+        Identity("Game", "DXVK", "game.exe"));
+    EXPECT_TRUE(settings.suballocate_memory);
+    EXPECT_EQ(settings.dedicated_image_min_kb, 1024u);
+    EXPECT_TRUE(settings.persistent_mapping);
+}
+
+XCLIPSE_TEST(SectionsMatchEveryCriterionCaseInsensitively) {
+    const char* profile =
+        "[engine=dxvk]\n"
+        "batch_submits = 1\n"
+        "[engine=vkd3d app=Cyberpunk*]\n"
+        "async_compute = 1\n"
+        "[process=Cyber?unk2077.e]\n"
+        "gpu_profiler = 1\n";
+
+    LayerSettings dxvk = Apply(profile, Identity("Witcher 3", "DXVK", "witcher3.exe"));
+    EXPECT_TRUE(dxvk.batch_submits);
+    EXPECT_FALSE(dxvk.async_compute);
+    EXPECT_FALSE(dxvk.gpu_profiler);
+
+    LayerSettings cyberpunk = Apply(profile, Identity("Cyberpunk 2077", "vkd3d", "Cyberpunk2077.e"));
+    EXPECT_FALSE(cyberpunk.batch_submits);
+    EXPECT_TRUE(cyberpunk.async_compute);
+    EXPECT_TRUE(cyberpunk.gpu_profiler);
+
+    // Only one of the two criteria matches
+    LayerSettings other = Apply(profile, Identity("Elden Ring", "vkd3d", "eldenring.exe"));
+    EXPECT_FALSE(other.async_compute);
+}
+
+XCLIPSE_TEST(LaterSectionsOverrideEarlierOnes) {
+    LayerSettings settings = Apply(
+        "[*]\n"
+        "batch_submits = 1\n"
+        "dedicated_image_min_kb = 2048\n"
+        "[app=game]\n"
+        "batch_submits = 0\n",
+        Identity("Game", "", ""));
+    EXPECT_FALSE(settings.batch_submits);
+    EXPECT_EQ(settings.dedicated_image_min_kb, 2048u);
+}
+
+XCLIPSE_TEST(MalformedLinesAreSkipped) {
+    LayerSettings settings = Apply(
+        "batch_submits = yes\n"
+        "no_such_key = 1\n"
+        "dedicated_image_min_kb = 12abc\n"
+        "compute_subgroup_size = 1234567890\n"
+        "trace\n"
+        "async_compute = 1\n"
+        "[colour=blue]\n"
+        "gpu_profiler = 1\n"
+        "[app=game\n"
+        "dump_shaders = 1\n"
+        "[app=game]\n"
+        "replace_shaders = 1\n",
+        Identity("game", "", ""));
+    EXPECT_FALSE(settings.batch_submits);
+    EXPECT_EQ(settings.dedicated_image_min_kb, 4096u);
+    EXPECT_EQ(settings.compute_subgroup_size, 0u);
+    EXPECT_FALSE(settings.trace);
+    EXPECT_TRUE(settings.async_compute);
+    // Settings under a bad header are skipped with it
+    EXPECT_FALSE(settings.gpu_profiler);
+    EXPECT_FALSE(settings.dump_shaders);
+    EXPECT_TRUE(settings.replace_shaders);
+}
+
+XCLIPSE_TEST(PipelineRulesAddUpAcrossSections) {
+    LayerSettings settings = Apply(
+        "pipeline = cull=none -> cull=back\n"
+        "[engine=DXVK]\n"
+        "pipeline = samples=8 -> samples=4\n"
+        "pipeline = not a rule\n"
+        "[engine=Zink]\n"
+        "pipeline = -> depth_clamp=1\n",
+        Identity("", "DXVK", ""));
+    ASSERT_TRUE(settings.pipeline_rules.size() == 2);
+    EXPECT_EQ(settings.pipeline_rules[0].text, std::string("cull=none -> cull=back"));
+    EXPECT_EQ(settings.pipeline_rules[1].text, std::string("samples=8 -> samples=4"));
+}
+
+XCLIPSE_TEST(ResolveReadsTheProfileThenTheEnvironment) {
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_PROFILE",
+           WriteProfile("resolve.conf",
+                        "[app=Profiled engine=TestEngine process=" + GetProcessName() + "]\n"
+                        "batch_submits = 1\n"
+                        "async_compute = 1\n"
+                        "dedicated_image_min_kb = 512\n")
+               .c_str(),
+           1);
+    setenv("XCLIPSE_ASYNC_COMPUTE", "0", 1);
+    setenv("XCLIPSE_DEDICATED_IMAGE_MIN_KB", "256", 1);
+    setenv("XCLIPSE_TRACE", "maybe", 1);  // ignored
+
+    VkApplicationInfo application{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    application.pApplicationName = "Profiled";
+    application.pEngineName = "TestEngine";
+    LayerSettings settings = ResolveLayerSettings(&application);
+    EXPECT_TRUE(settings.batch_submits);
+    EXPECT_FALSE(settings.async_compute);
+    EXPECT_EQ(settings.dedicated_image_min_kb, 256u);
+    EXPECT_FALSE(settings.trace);
+
+    // Without application info only the process can match
+    settings = ResolveLayerSettings(nullptr);
+    EXPECT_FALSE(settings.batch_submits);
+}
+
+XCLIPSE_TEST(ProfileDefaultsToTheDataDirectory) {
+    ResetLayerEnvironment();
+    unsetenv("XCLIPSE_PROFILE");
+    WriteProfile("profiles.conf", "parallel_pipelines = 1\n");
+    EXPECT_TRUE(ResolveLayerSettings(nullptr).parallel_pipelines);
+    std::remove((TestDataDirectory() + "/profiles.conf").c_str());
+}
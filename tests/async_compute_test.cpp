@@ -0,0 +1,171 @@
+// async_compute_test.cpp - Offloaded compute keeps the ordering of one queue
+
+#include <cstdlib>
+#include <functional>
+
+#include "command_buffer_profile.h"
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+struct Device {
+    LayerDevice layer;
+    VkQueue queue{VK_NULL_HANDLE};
+    VkCommandPool pool{VK_NULL_HANDLE};
+};
+
+bool CreateDevice(Device& device) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_ASYNC_COMPUTE", "1", 1);
+    VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    features12.timelineSemaphore = VK_TRUE;
+    LayerDeviceOptions options;
+    options.device_features = &features12;
+    if (!CreateLayerDevice(device.layer, options)) return false;
+    device.queue = device.layer.Queue(0);
+    device.pool = device.layer.CreateCommandPool(0);
+    return true;
+}
+
+// A command buffer with one dispatch followed by whatever record adds
+VkCommandBuffer RecordDispatch(const Device& device,
+                               const std::function<void(VkCommandBuffer)>& record = nullptr) {
+    const LayerDevice& layer = device.layer;
+    VkCommandBuffer command_buffer = layer.AllocateCommandBuffer(device.pool);
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    layer.Get<PFN_vkBeginCommandBuffer>("vkBeginCommandBuffer")(command_buffer, &begin);
+    layer.Get<PFN_vkCmdDispatch>("vkCmdDispatch")(command_buffer, 8, 8, 1);
+    if (record) record(command_buffer);
+    layer.Get<PFN_vkEndCommandBuffer>("vkEndCommandBuffer")(command_buffer);
+    return command_buffer;
+}
+
+VkCommandBuffer RecordDraw(const Device& device) {
+    const LayerDevice& layer = device.layer;
+    VkCommandBuffer command_buffer = layer.AllocateCommandBuffer(device.pool);
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    layer.Get<PFN_vkBeginCommandBuffer>("vkBeginCommandBuffer")(command_buffer, &begin);
+    layer.Get<PFN_vkCmdDraw>("vkCmdDraw")(command_buffer, 3, 1, 0, 0);
+    layer.Get<PFN_vkEndCommandBuffer>("vkEndCommandBuffer")(command_buffer);
+    return command_buffer;
+}
+
+void Barrier(const Device& device, VkCommandBuffer command_buffer, VkPipelineStageFlags src,
+             VkPipelineStageFlags dst) {
+    device.layer.Get<PFN_vkCmdPipelineBarrier>("vkCmdPipelineBarrier")(
+        command_buffer, src, dst, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+}
+
+void Submit(const Device& device, VkCommandBuffer command_buffer) {
+    VkSubmitInfo info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &command_buffer;
+    EXPECT_EQ(device.layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit")(device.queue, 1, &info, VK_NULL_HANDLE),
+              VK_SUCCESS);
+}
+
+// The stage the app queue's last submit call waited at for offloaded
+// work, 0 if it did not wait
+VkPipelineStageFlags JoinStages() {
+    const std::vector<MockSubmit>& submits = Mock().submits;
+    uint32_t call = submits.back().call;
+    for (const MockSubmit& submit : submits) {
+        if (submit.call == call && submit.command_buffers.empty() && !submit.wait_stages.empty()) {
+            return submit.wait_stages[0];
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+XCLIPSE_TEST(ReleaseStagesComeFromBarrierDestinations) {
+    CommandBufferProfile profile;
+    profile.AddDependency(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT);
+    EXPECT_EQ(profile.release_stages, VkPipelineStageFlags{VK_PIPELINE_STAGE_VERTEX_INPUT_BIT});
+
+    // TOP_OF_PIPE and HOST as a destination hold nothing back on the queue
+    CommandBufferProfile top;
+    top.AddDependency(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                      VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_2_HOST_BIT);
+    EXPECT_EQ(top.release_stages, 0u);
+
+    // BOTTOM_OF_PIPE, ALL_COMMANDS and synchronization2-only stages
+    for (VkPipelineStageFlags2 dst : {VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                      VK_PIPELINE_STAGE_2_COPY_BIT}) {
+        CommandBufferProfile all;
+        all.AddDependency(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, dst);
+        EXPECT_EQ(all.release_stages, VkPipelineStageFlags{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT});
+    }
+
+    CommandBufferProfile sum;
+    sum.Add(profile);
+    EXPECT_EQ(sum.release_stages, VkPipelineStageFlags{VK_PIPELINE_STAGE_VERTEX_INPUT_BIT});
+}
+
+XCLIPSE_TEST(DrawWaitsAtReleaseStagesOfOffloadedBarrier) {
+    Device device;
+    ASSERT_TRUE(CreateDevice(device));
+    VkCommandBuffer compute = RecordDispatch(device, [&](VkCommandBuffer command_buffer) {
+        // The dispatch writes vertices the next submit reads
+        Barrier(device, command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    });
+    VkCommandBuffer draw = RecordDraw(device);
+
+    Submit(device, compute);
+    ASSERT_TRUE(!Mock().submits.empty());
+    EXPECT_NE(Mock().submits.back().queue, device.queue);
+
+    // The draw has no barrier of its own, but on one queue the offloaded
+    // barrier would have held it back
+    Submit(device, draw);
+    EXPECT_EQ(Mock().submits.back().queue, device.queue);
+    EXPECT_EQ(JoinStages(), VkPipelineStageFlags{VK_PIPELINE_STAGE_VERTEX_INPUT_BIT});
+
+    // Waited once; the next draw is ordered after that wait
+    Submit(device, draw);
+    EXPECT_EQ(JoinStages(), 0u);
+    DestroyLayerDevice(device.layer);
+}
+
+XCLIPSE_TEST(OffloadWithoutBarriersIsNotWaitedFor) {
+    Device device;
+    ASSERT_TRUE(CreateDevice(device));
+    Submit(device, RecordDispatch(device));
+    Submit(device, RecordDraw(device));
+    EXPECT_EQ(JoinStages(), 0u);
+    DestroyLayerDevice(device.layer);
+}
+
+XCLIPSE_TEST(ReleaseStagesAccumulateAcrossOffloads) {
+    Device device;
+    ASSERT_TRUE(CreateDevice(device));
+    Submit(device, RecordDispatch(device, [&](VkCommandBuffer command_buffer) {
+        Barrier(device, command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    }));
+    Submit(device, RecordDispatch(device, [&](VkCommandBuffer command_buffer) {
+        Barrier(device, command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }));
+    Submit(device, RecordDraw(device));
+    EXPECT_EQ(JoinStages(), VkPipelineStageFlags{VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT});
+    DestroyLayerDevice(device.layer);
+}
+
+XCLIPSE_TEST(QueueWaitIdleClearsReleaseStages) {
+    Device device;
+    ASSERT_TRUE(CreateDevice(device));
+    Submit(device, RecordDispatch(device, [&](VkCommandBuffer command_buffer) {
+        Barrier(device, command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    }));
+    EXPECT_EQ(device.layer.Get<PFN_vkQueueWaitIdle>("vkQueueWaitIdle")(device.queue), VK_SUCCESS);
+    Submit(device, RecordDraw(device));
+    EXPECT_EQ(JoinStages(), 0u);
+    DestroyLayerDevice(device.layer);
+}
@@ -0,0 +1,118 @@
+// command_buffer_profile_test.cpp - Per-command-buffer counters and the Find fast path
+
+#include <thread>
+#include <vector>
+
+#include "command_buffer_profile.h"
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+VkCommandBuffer Handle(uint64_t value) {
+    return FakeHandle<VkCommandBuffer>(0x7c00000000ull + value * 64);
+}
+
+} // namespace
+
+XCLIPSE_TEST(FindReturnsTheSameProfileUntilFreed) {
+    CommandBufferProfiler profiler;
+    VkCommandBuffer command_buffers[2] = {Handle(1), Handle(2)};
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x10), 2, command_buffers);
+
+    CommandBufferProfile* first = profiler.Find(command_buffers[0]);
+    ASSERT_TRUE(first != nullptr);
+    EXPECT_EQ(profiler.Find(command_buffers[0]), first);
+    EXPECT_NE(profiler.Find(command_buffers[1]), first);
+    EXPECT_EQ(profiler.Find(command_buffers[0]), first);
+    EXPECT_EQ(profiler.Find(Handle(3)), nullptr);
+
+    std::vector<uint32_t> chunks;
+    profiler.OnFree(1, command_buffers, chunks);
+    EXPECT_EQ(profiler.Find(command_buffers[0]), nullptr);
+}
+
+XCLIPSE_TEST(FreeInvalidatesOtherThreadsSlots) {
+    CommandBufferProfiler profiler;
+    VkCommandBuffer command_buffer = Handle(4);
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x10), 1, &command_buffer);
+    profiler.Find(command_buffer)->draws = 7;
+
+    // Freed and handed out again elsewhere: the cached slot must not
+    // return the old profile
+    std::thread([&] {
+        std::vector<uint32_t> chunks;
+        profiler.OnFree(1, &command_buffer, chunks);
+        profiler.OnAllocate(FakeHandle<VkCommandPool>(0x11), 1, &command_buffer);
+    }).join();
+
+    CommandBufferProfile* profile = profiler.Find(command_buffer);
+    ASSERT_TRUE(profile != nullptr);
+    EXPECT_EQ(profile->draws, 0u);
+}
+
+XCLIPSE_TEST(MissIsNotCached) {
+    CommandBufferProfiler profiler;
+    VkCommandBuffer command_buffer = Handle(5);
+    EXPECT_EQ(profiler.Find(command_buffer), nullptr);
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x10), 1, &command_buffer);
+    EXPECT_NE(profiler.Find(command_buffer), nullptr);
+}
+
+XCLIPSE_TEST(DestroyPoolDropsItsCommandBuffers) {
+    CommandBufferProfiler profiler;
+    VkCommandBuffer kept = Handle(6);
+    VkCommandBuffer dropped = Handle(7);
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x10), 1, &kept);
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x11), 1, &dropped);
+    profiler.Find(dropped)->timestamps.chunk = 3;
+
+    std::vector<uint32_t> chunks;
+    profiler.OnDestroyPool(FakeHandle<VkCommandPool>(0x11), chunks);
+    EXPECT_EQ(profiler.Find(dropped), nullptr);
+    EXPECT_NE(profiler.Find(kept), nullptr);
+    // The profiler gets the timestamp chunk back
+    ASSERT_TRUE(chunks.size() == 1);
+    EXPECT_EQ(chunks[0], 3u);
+}
+
+XCLIPSE_TEST(BeginResetsCountersButKeepsTimestamps) {
+    CommandBufferProfiler profiler;
+    VkCommandBuffer command_buffer = Handle(8);
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x10), 1, &command_buffer);
+    CommandBufferProfile* profile = profiler.Find(command_buffer);
+    profile->dispatches = 4;
+    profile->timestamps.chunk = 2;
+
+    profile = profiler.Begin(command_buffer);
+    EXPECT_EQ(profile->dispatches, 0u);
+    EXPECT_EQ(profile->timestamps.chunk, 2u);
+}
+
+XCLIPSE_TEST(SubmitsAreClassifiedByWhatTheyRecord) {
+    CommandBufferProfiler profiler;
+    VkCommandBuffer command_buffers[2] = {Handle(9), Handle(10)};
+    profiler.OnAllocate(FakeHandle<VkCommandPool>(0x10), 2, command_buffers);
+    EXPECT_EQ(ClassifyWorkload(profiler.Summarize(2, command_buffers)), WorkloadClass::kEmpty);
+
+    VkBufferCopy copy{0, 0, 4096};
+    profiler.Find(command_buffers[0])->AddTransfer(1, &copy);
+    EXPECT_EQ(ClassifyWorkload(profiler.Summarize(2, command_buffers)), WorkloadClass::kTransfer);
+    profiler.Find(command_buffers[1])->dispatches++;
+    EXPECT_EQ(ClassifyWorkload(profiler.Summarize(2, command_buffers)), WorkloadClass::kCompute);
+    profiler.Find(command_buffers[1])->draws++;
+    EXPECT_EQ(ClassifyWorkload(profiler.Summarize(2, command_buffers)), WorkloadClass::kGraphics);
+    EXPECT_EQ(profiler.Summarize(2, command_buffers).transfer_bytes, VkDeviceSize{4096});
+}
+
+XCLIPSE_TEST(DependenciesRecordComputeSourceStages) {
+    CommandBufferProfile profile;
+    profile.AddDependency(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_2_NONE);
+    EXPECT_EQ(profile.sync_stages, 0u);
+    profile.AddDependency(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_2_NONE);
+    EXPECT_EQ(profile.sync_stages, VkPipelineStageFlags{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT});
+    // Synchronization2-only stages cannot be expressed, so wait on everything
+    profile.AddDependency(VK_PIPELINE_STAGE_2_COPY_BIT, VK_PIPELINE_STAGE_2_NONE);
+    EXPECT_EQ(profile.sync_stages & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+              VkPipelineStageFlags{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT});
+}
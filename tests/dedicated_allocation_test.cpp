@@ -0,0 +1,171 @@
+// dedicated_allocation_test.cpp - Large images and render targets get dedicated allocations
+
+#include <cstdlib>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+constexpr uint32_t kDeviceLocalType = 0;
+
+bool CreateDevice(LayerDevice& layer, bool dedicated_images = true, bool inject = false) {
+    ResetMock();
+    ResetLayerEnvironment();
+    if (dedicated_images) {
+        setenv("XCLIPSE_DEDICATED_IMAGES", "1", 1);
+    }
+    if (inject) {
+        setenv("XCLIPSE_DEDICATED_IMAGE_INJECT", "1", 1);
+    }
+    return CreateLayerDevice(layer);
+}
+
+VkImage CreateImage(const LayerDevice& layer, VkImageUsageFlags usage, VkImageCreateFlags flags = 0) {
+    VkImageCreateInfo info{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+    info.flags = flags;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    info.extent = {1920, 1080, 1};
+    info.mipLevels = 1;
+    info.arrayLayers = 1;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.usage = usage;
+    VkImage image = VK_NULL_HANDLE;
+    layer.Get<PFN_vkCreateImage>("vkCreateImage")(layer.device, &info, nullptr, &image);
+    return image;
+}
+
+// Whether the layer reports prefersDedicatedAllocation for image
+bool Prefers(const LayerDevice& layer, VkImage image) {
+    VkImageMemoryRequirementsInfo2 info{VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2};
+    info.image = image;
+    VkMemoryDedicatedRequirements dedicated{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+    VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicated};
+    layer.Get<PFN_vkGetImageMemoryRequirements2>("vkGetImageMemoryRequirements2")(
+        layer.device, &info, &requirements);
+    return dedicated.prefersDedicatedAllocation;
+}
+
+// vkGetImageMemoryRequirements2 with the dedicated requirements chained,
+// which is the only query an injection can follow
+VkMemoryRequirements Query(const LayerDevice& layer, VkImage image) {
+    VkImageMemoryRequirementsInfo2 info{VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2};
+    info.image = image;
+    VkMemoryDedicatedRequirements dedicated{VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS};
+    VkMemoryRequirements2 requirements{VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicated};
+    layer.Get<PFN_vkGetImageMemoryRequirements2>("vkGetImageMemoryRequirements2")(
+        layer.device, &info, &requirements);
+    return requirements.memoryRequirements;
+}
+
+// Allocates and reports whether the driver saw a dedicated allocation
+bool AllocateIsDedicated(const LayerDevice& layer, VkDeviceSize size) {
+    VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    info.allocationSize = size;
+    info.memoryTypeIndex = kDeviceLocalType;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (layer.Get<PFN_vkAllocateMemory>("vkAllocateMemory")(layer.device, &info, nullptr, &memory) != VK_SUCCESS) {
+        return false;
+    }
+    return !Mock().allocations.empty() && Mock().allocations.back().dedicated;
+}
+
+} // namespace
+
+XCLIPSE_TEST(AttachmentsPreferDedicated) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer));
+    EXPECT_TRUE(Prefers(layer, CreateImage(layer, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)));
+    EXPECT_TRUE(Prefers(layer, CreateImage(layer, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(OnlyLargeSampledImagesPreferDedicated) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer));
+    // The mock reports 1 MiB, under the 4 MiB default
+    EXPECT_FALSE(Prefers(layer, CreateImage(layer, VK_IMAGE_USAGE_SAMPLED_BIT)));
+    Mock().image_requirements.size = VkDeviceSize{8} << 20;
+    EXPECT_TRUE(Prefers(layer, CreateImage(layer, VK_IMAGE_USAGE_SAMPLED_BIT)));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(IneligibleImagesAreLeftAlone) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer));
+    VkImageUsageFlags attachment = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    EXPECT_FALSE(Prefers(layer, CreateImage(layer, attachment, VK_IMAGE_CREATE_ALIAS_BIT)));
+    EXPECT_FALSE(Prefers(layer, CreateImage(layer, attachment, VK_IMAGE_CREATE_SPARSE_BINDING_BIT)));
+    EXPECT_FALSE(Prefers(layer, CreateImage(layer, attachment | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(DisabledByDefault) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer, false));
+    EXPECT_FALSE(Prefers(layer, CreateImage(layer, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(AllocateAfterRequiredQueryIsMadeDedicated) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer, true, true));
+    Mock().image_requires_dedicated = true;
+    VkImage image = CreateImage(layer, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    VkMemoryRequirements requirements = Query(layer, image);
+    EXPECT_TRUE(AllocateIsDedicated(layer, requirements.size));
+    // The query is used up
+    EXPECT_FALSE(AllocateIsDedicated(layer, requirements.size));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(PreferredOnlyAllocationsAreLeftAlone) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer, true, true));
+    VkImage image = CreateImage(layer, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    // The layer hints, but the app may still sub-allocate the image
+    EXPECT_TRUE(Prefers(layer, image));
+    VkMemoryRequirements requirements = Query(layer, image);
+    EXPECT_FALSE(AllocateIsDedicated(layer, requirements.size));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(InjectionNeedsTheProfileOptIn) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer));
+    Mock().image_requires_dedicated = true;
+    VkImage image = CreateImage(layer, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+    VkMemoryRequirements requirements = Query(layer, image);
+    EXPECT_FALSE(AllocateIsDedicated(layer, requirements.size));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(OtherAllocationsAreNotMadeDedicated) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateDevice(layer, true, true));
+    Mock().image_requires_dedicated = true;
+    VkImage image = CreateImage(layer, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+
+    // A block for several resources
+    VkMemoryRequirements requirements = Query(layer, image);
+    EXPECT_FALSE(AllocateIsDedicated(layer, 4 * requirements.size));
+
+    // The core query cannot say whether the driver requires it
+    layer.Get<PFN_vkGetImageMemoryRequirements>("vkGetImageMemoryRequirements")(
+        layer.device, image, &requirements);
+    EXPECT_FALSE(AllocateIsDedicated(layer, requirements.size));
+
+    // A buffer query in between
+    requirements = Query(layer, image);
+    VkMemoryRequirements buffer_requirements{};
+    layer.Get<PFN_vkGetBufferMemoryRequirements>("vkGetBufferMemoryRequirements")(
+        layer.device, FakeHandle<VkBuffer>(0x51), &buffer_requirements);
+    EXPECT_FALSE(AllocateIsDedicated(layer, requirements.size));
+
+    // The image was destroyed before the allocation
+    requirements = Query(layer, image);
+    layer.Get<PFN_vkDestroyImage>("vkDestroyImage")(layer.device, image, nullptr);
+    EXPECT_FALSE(AllocateIsDedicated(layer, requirements.size));
+    DestroyLayerDevice(layer);
+}
@@ -0,0 +1,67 @@
+// device_extensions_test.cpp - Extensions the layer enables on the app's behalf
+
+#include <algorithm>
+#include <string>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+bool DeviceExtensionEnabled(const char* name) {
+    const std::vector<std::string>& enabled = Mock().enabled_device_extensions;
+    return std::find(enabled.begin(), enabled.end(), name) != enabled.end();
+}
+
+// Creates a device on an instance of the given version and extensions and
+// reports whether the layer asked the driver for VK_EXT_memory_budget
+bool MemoryBudgetEnabled(uint32_t api_version, std::vector<const char*> instance_extensions) {
+    ResetMock();
+    ResetLayerEnvironment();
+    LayerDeviceOptions options;
+    options.api_version = api_version;
+    options.instance_extensions = std::move(instance_extensions);
+    LayerDevice layer;
+    if (!CreateLayerDevice(layer, options)) {
+        return false;
+    }
+    bool enabled = DeviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    DestroyLayerDevice(layer);
+    return enabled;
+}
+
+} // namespace
+
+XCLIPSE_TEST(MemoryBudgetNeedsProperties2OnTheInstance) {
+    // VK_EXT_memory_budget requires VK_KHR_get_physical_device_properties2
+    EXPECT_FALSE(MemoryBudgetEnabled(VK_API_VERSION_1_0, {}));
+    EXPECT_TRUE(MemoryBudgetEnabled(VK_API_VERSION_1_0, {VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME}));
+    EXPECT_TRUE(MemoryBudgetEnabled(VK_API_VERSION_1_1, {}));
+    EXPECT_TRUE(MemoryBudgetEnabled(VK_API_VERSION_1_3, {}));
+}
+
+XCLIPSE_TEST(ZeroApiVersionMeansVulkan10) {
+    ResetMock();
+    ResetLayerEnvironment();
+    LayerDeviceOptions options;
+    options.api_version = 0;
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer, options));
+    EXPECT_FALSE(DeviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+    // Extensions with no instance dependency are still turned on
+    EXPECT_TRUE(DeviceExtensionEnabled(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME));
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(AppRequestedMemoryBudgetIsKept) {
+    ResetMock();
+    ResetLayerEnvironment();
+    LayerDeviceOptions options;
+    options.api_version = VK_API_VERSION_1_0;
+    options.device_extensions = {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer, options));
+    // Validating the app's own list is the loader's job, not the layer's
+    EXPECT_TRUE(DeviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+    DestroyLayerDevice(layer);
+}
@@ -0,0 +1,149 @@
+// frame_timing_test.cpp - Present-to-present frame records, summaries and the CSV export
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "frame_timing.h"
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+void SleepMs(int milliseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+void Present(FrameTimer& timer) {
+    timer.OnPresent();
+    timer.OnPresentReturned();
+}
+
+std::string ReadFile(const std::string& path) {
+    std::string contents;
+    if (FILE* file = std::fopen(path.c_str(), "r")) {
+        char buffer[512];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            contents.append(buffer, n);
+        }
+        std::fclose(file);
+    }
+    return contents;
+}
+
+size_t CountLines(const std::string& text) {
+    size_t lines = 0;
+    for (char c : text) lines += c == '\n';
+    return lines;
+}
+
+} // namespace
+
+XCLIPSE_TEST(FramesAreRecordedOldestFirst) {
+    FrameTimer timer("");
+    timer.OnSubmit();
+    Present(timer);
+    SleepMs(2);
+    timer.OnSubmit();
+    SleepMs(1);
+    Present(timer);
+    SleepMs(2);
+    Present(timer);
+
+    FrameTiming frames[8];
+    ASSERT_TRUE(timer.Snapshot(frames, 8) == 3);
+    EXPECT_EQ(frames[0].frame, 1u);
+    EXPECT_EQ(frames[2].frame, 3u);
+    // The first present has nothing to measure from
+    EXPECT_EQ(frames[0].interval_ns, 0u);
+    EXPECT_GE(frames[1].interval_ns, 2'000'000u);
+    EXPECT_GE(frames[1].cpu_ns, 2'000'000u);
+    EXPECT_GE(frames[1].submit_to_present_ns, 1'000'000u);
+    // No submit in the third frame
+    EXPECT_EQ(frames[2].submit_to_present_ns, 0u);
+    EXPECT_LT(frames[1].present_ns, frames[2].present_ns);
+}
+
+XCLIPSE_TEST(SnapshotKeepsTheNewestFrames) {
+    FrameTimer timer("");
+    for (uint32_t i = 0; i < FrameTimer::kCapacity + 10; ++i) {
+        Present(timer);
+    }
+    FrameTiming newest[4];
+    ASSERT_TRUE(timer.Snapshot(newest, 4) == 4);
+    EXPECT_EQ(newest[0].frame, uint64_t{FrameTimer::kCapacity + 7});
+    EXPECT_EQ(newest[3].frame, uint64_t{FrameTimer::kCapacity + 10});
+    EXPECT_EQ(timer.Summarize().frames, FrameTimer::kCapacity);
+}
+
+XCLIPSE_TEST(SummaryFlagsLongFrames) {
+    FrameTimer timer("");
+    EXPECT_EQ(timer.Summarize().frames, 0u);
+    for (int i = 0; i < 40; ++i) {
+        Present(timer);
+        SleepMs(i == 20 ? 40 : 2);
+    }
+    Present(timer);
+
+    FrameTimingSummary summary = timer.Summarize();
+    EXPECT_EQ(summary.frames, 41u);
+    EXPECT_GT(summary.average_fps, 0.0);
+    EXPECT_LT(summary.low_1_percent_fps, summary.average_fps);
+    EXPECT_GE(summary.p99_interval_ns, 40'000'000u);
+    // Scheduling noise can add stutters on a loaded machine, never remove this one
+    EXPECT_GE(summary.stutters, 1u);
+}
+
+XCLIPSE_TEST(DumpWritesOneCsvLinePerFrame) {
+    std::string path = TestDataDirectory() + "/frames.csv";
+    unlink(path.c_str());
+    FrameTimer timer(path);
+    for (int i = 0; i < 5; ++i) {
+        Present(timer);
+    }
+    timer.Dump();
+    std::string csv = ReadFile(path);
+    EXPECT_EQ(csv.rfind("frame,present_ns,interval_ns,cpu_ns,submit_to_present_ns\n", 0), size_t{0});
+    EXPECT_EQ(CountLines(csv), size_t{6});
+}
+
+XCLIPSE_TEST(LayerExportsFramesAtDeviceDestroy) {
+    ResetMock();
+    ResetLayerEnvironment();
+    LayerDeviceOptions options;
+    options.device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer, options));
+
+    VkQueue queue = layer.Queue(0);
+    VkSwapchainKHR swapchain = FakeHandle<VkSwapchainKHR>(0x5c);
+    uint32_t image_index = 0;
+    VkPresentInfoKHR present{VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
+    present.swapchainCount = 1;
+    present.pSwapchains = &swapchain;
+    present.pImageIndices = &image_index;
+    auto queue_present = layer.Get<PFN_vkQueuePresentKHR>("vkQueuePresentKHR");
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(queue_present(queue, &present), VK_SUCCESS);
+    }
+    EXPECT_EQ(Mock().presents, 3u);
+    DestroyLayerDevice(layer);
+
+    std::string csv;
+    if (DIR* dir = opendir(TestDataDirectory().c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            std::string suffix = ".frame_times.csv";
+            if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                csv = ReadFile(TestDataDirectory() + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    EXPECT_EQ(CountLines(csv), size_t{4});
+}
@@ -0,0 +1,95 @@
+// gpu_profiler_test.cpp - Only command buffers of timestamp-capable queue families are timed
+
+#include <cstdlib>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+constexpr uint32_t kGraphicsFamily = 0;
+constexpr uint32_t kTransferFamily = 2;  // no timestampValidBits in the default mock
+
+bool CreateProfiledDevice(LayerDevice& layer) {
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_GPU_PROFILER", "1", 1);
+    LayerDeviceOptions options;
+    options.queues = {{kGraphicsFamily, 1}, {kTransferFamily, 1}};
+    return CreateLayerDevice(layer, options);
+}
+
+// Records a dispatch into a fresh command buffer from a pool of family
+VkCommandBuffer RecordDispatch(const LayerDevice& layer, uint32_t family) {
+    VkCommandBuffer command_buffer = layer.AllocateCommandBuffer(layer.CreateCommandPool(family));
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    layer.Get<PFN_vkBeginCommandBuffer>("vkBeginCommandBuffer")(command_buffer, &begin);
+    layer.Get<PFN_vkCmdDispatch>("vkCmdDispatch")(command_buffer, 8, 8, 1);
+    layer.Get<PFN_vkEndCommandBuffer>("vkEndCommandBuffer")(command_buffer);
+    return command_buffer;
+}
+
+uint32_t TimestampCommands(VkCommandBuffer command_buffer) {
+    return Mock().CountCommands(command_buffer, "CmdResetQueryPool") +
+           Mock().CountCommands(command_buffer, "CmdWriteTimestamp") +
+           Mock().CountCommands(command_buffer, "CmdWriteTimestamp2");
+}
+
+} // namespace
+
+XCLIPSE_TEST(GraphicsFamilyIsTimed) {
+    ResetMock();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateProfiledDevice(layer));
+    VkCommandBuffer command_buffer = RecordDispatch(layer, kGraphicsFamily);
+    EXPECT_EQ(Mock().CountCommands(command_buffer, "CmdResetQueryPool"), 1u);
+    EXPECT_GT(TimestampCommands(command_buffer), 1u);
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(FamilyWithoutTimestampsIsNotTimed) {
+    ResetMock();
+    // Compute-capable, but without valid bits it cannot take the query
+    // reset or a timestamp write
+    Mock().queue_families[kTransferFamily].queueFlags |= VK_QUEUE_COMPUTE_BIT;
+    LayerDevice layer;
+    ASSERT_TRUE(CreateProfiledDevice(layer));
+    VkCommandBuffer command_buffer = RecordDispatch(layer, kTransferFamily);
+    EXPECT_EQ(TimestampCommands(command_buffer), 0u);
+
+    // The other family is unaffected
+    EXPECT_GT(TimestampCommands(RecordDispatch(layer, kGraphicsFamily)), 1u);
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(TransferOnlyFamilyIsNotTimed) {
+    ResetMock();
+    Mock().queue_families[kTransferFamily].timestampValidBits = 64;
+    LayerDevice layer;
+    ASSERT_TRUE(CreateProfiledDevice(layer));
+    EXPECT_EQ(TimestampCommands(RecordDispatch(layer, kTransferFamily)), 0u);
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(TimestampComputeAndGraphicsIsNotRequired) {
+    ResetMock();
+    // False whenever any graphics or compute family lacks timestamps; the
+    // families that have them are still timed
+    Mock().properties.limits.timestampComputeAndGraphics = VK_FALSE;
+    LayerDevice layer;
+    ASSERT_TRUE(CreateProfiledDevice(layer));
+    EXPECT_EQ(Mock().live_query_pools, 1u);
+    EXPECT_GT(TimestampCommands(RecordDispatch(layer, kGraphicsFamily)), 1u);
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(NoTimeableFamilyDisablesTheProfiler) {
+    ResetMock();
+    for (VkQueueFamilyProperties& family : Mock().queue_families) {
+        family.timestampValidBits = 0;
+    }
+    LayerDevice layer;
+    ASSERT_TRUE(CreateProfiledDevice(layer));
+    EXPECT_EQ(Mock().live_query_pools, 0u);
+    EXPECT_EQ(TimestampCommands(RecordDispatch(layer, kGraphicsFamily)), 0u);
+    DestroyLayerDevice(layer);
+}
@@ -0,0 +1,185 @@
+// memory_type_policy_test.cpp - Memory type remapping is per resource and layout aware
+
+#include <cstdlib>
+#include <initializer_list>
+#include <thread>
+
+#include "memory_budget.h"
+#include "memory_type_policy.h"
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+constexpr VkMemoryPropertyFlags kDL = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+constexpr VkMemoryPropertyFlags kHV = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+constexpr VkMemoryPropertyFlags kHC = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+constexpr VkMemoryPropertyFlags kHCached = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+constexpr VkDeviceSize kGiB = VkDeviceSize{1} << 30;
+constexpr VkDeviceSize kResourceSize = VkDeviceSize{64} << 10;
+
+struct HeapDump {
+    VkDeviceSize size;
+    VkMemoryHeapFlags flags;
+};
+
+struct TypeDump {
+    VkMemoryPropertyFlags flags;
+    uint32_t heap;
+};
+
+VkPhysicalDeviceMemoryProperties Layout(std::initializer_list<HeapDump> heaps,
+                                        std::initializer_list<TypeDump> types) {
+    VkPhysicalDeviceMemoryProperties properties{};
+    for (const HeapDump& heap : heaps) {
+        properties.memoryHeaps[properties.memoryHeapCount++] = {heap.size, heap.flags};
+    }
+    for (const TypeDump& type : types) {
+        properties.memoryTypes[properties.memoryTypeCount++] = {type.flags, type.heap};
+    }
+    return properties;
+}
+
+// The Xclipse layout the mock driver reports: one heap, plain host types
+// listed before their device-local aliases
+VkPhysicalDeviceMemoryProperties UmaWithHostTypes() {
+    return Layout({{8 * kGiB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}},
+                  {{kDL, 0}, {kHV | kHC, 0}, {kHV | kHC | kHCached, 0}, {kDL | kHV | kHC, 0},
+                   {kDL | kHV | kHC | kHCached, 0}});
+}
+
+// A discrete card: VRAM, system RAM, and a small BAR window into VRAM
+VkPhysicalDeviceMemoryProperties DiscreteWithBar() {
+    return Layout({{8 * kGiB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}, {16 * kGiB, 0},
+                   {256 << 20, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}},
+                  {{kDL, 0}, {kHV | kHC, 1}, {kHV | kHC | kHCached, 1}, {kDL | kHV | kHC, 2}});
+}
+
+// A UMA driver that marks every type device-local
+VkPhysicalDeviceMemoryProperties UmaAllDeviceLocal() {
+    return Layout({{8 * kGiB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT}},
+                  {{kDL, 0}, {kDL | kHV | kHC, 0}, {kDL | kHV | kHC | kHCached, 0}});
+}
+
+// A policy and budget tracker over one layout, with no driver behind them
+struct Policy {
+    explicit Policy(const VkPhysicalDeviceMemoryProperties& properties)
+        : budget(VK_NULL_HANDLE, InstanceDispatch{}, properties, false),
+          policy(properties) {}
+
+    uint32_t Allocate(uint32_t type, VkDeviceSize size = kResourceSize, const void* next = nullptr) {
+        VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, next};
+        info.allocationSize = size;
+        info.memoryTypeIndex = type;
+        return policy.Select(info, budget);
+    }
+
+    void Query(uint32_t memory_type_bits, VkDeviceSize size = kResourceSize) {
+        policy.OnResourceRequirements(VkMemoryRequirements{size, 256, memory_type_bits});
+    }
+
+    MemoryBudgetTracker budget;
+    MemoryTypePolicy policy;
+};
+
+} // namespace
+
+XCLIPSE_TEST(QueriedResourceMovesToDeviceLocalAlias) {
+    Policy policy(UmaWithHostTypes());
+    policy.Query(0b11111);
+    EXPECT_EQ(policy.Allocate(1), 3u);  // upload
+    policy.Query(0b11111);
+    EXPECT_EQ(policy.Allocate(2), 4u);  // readback keeps the CPU cache
+    policy.Query(0b11111);
+    EXPECT_EQ(policy.Allocate(0), 0u);  // already device-local
+}
+
+XCLIPSE_TEST(AllocationWithoutQueryKeepsItsType) {
+    Policy policy(UmaWithHostTypes());
+    EXPECT_EQ(policy.Allocate(1), 1u);
+}
+
+XCLIPSE_TEST(BlockAllocationKeepsItsType) {
+    // Sub-allocators query one resource, then allocate a block for many
+    Policy policy(UmaWithHostTypes());
+    policy.Query(0b11111);
+    EXPECT_EQ(policy.Allocate(1, 256 * kResourceSize), 1u);
+}
+
+XCLIPSE_TEST(TargetOutsideResourceBitsKeepsItsType) {
+    // Another resource's mask allowing type 3 must not matter
+    Policy policy(UmaWithHostTypes());
+    policy.Query(0b11111, 2 * kResourceSize);
+    policy.Query(0b00110);
+    EXPECT_EQ(policy.Allocate(1), 1u);
+}
+
+XCLIPSE_TEST(QueryMatchesOneAllocation) {
+    Policy policy(UmaWithHostTypes());
+    policy.Query(0b11111);
+    EXPECT_EQ(policy.Allocate(1), 3u);
+    EXPECT_EQ(policy.Allocate(1), 1u);
+}
+
+XCLIPSE_TEST(CreateInfoQueryClearsThePendingQuery) {
+    Policy policy(UmaWithHostTypes());
+    policy.Query(0b11111);
+    policy.policy.ForgetPendingQuery();
+    EXPECT_EQ(policy.Allocate(1), 1u);
+}
+
+XCLIPSE_TEST(QueryOnAnotherThreadDoesNotMatch) {
+    Policy policy(UmaWithHostTypes());
+    std::thread([&] { policy.Query(0b11111); }).join();
+    EXPECT_EQ(policy.Allocate(1), 1u);
+}
+
+XCLIPSE_TEST(ImportedMemoryKeepsItsType) {
+    Policy policy(UmaWithHostTypes());
+    VkImportMemoryFdInfoKHR import{VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR};
+    policy.Query(0b11111);
+    EXPECT_EQ(policy.Allocate(1, kResourceSize, &import), 1u);
+}
+
+XCLIPSE_TEST(DiscreteLayoutIsNeverRemapped) {
+    // Moving staging into the BAR window would spend scarce VRAM
+    Policy policy(DiscreteWithBar());
+    for (uint32_t type = 0; type < 4; ++type) {
+        policy.Query(0b1111);
+        EXPECT_EQ(policy.Allocate(type), type);
+    }
+}
+
+XCLIPSE_TEST(AllDeviceLocalLayoutIsNeverRemapped) {
+    Policy policy(UmaAllDeviceLocal());
+    for (uint32_t type = 0; type < 3; ++type) {
+        policy.Query(0b111);
+        EXPECT_EQ(policy.Allocate(type), type);
+    }
+}
+
+XCLIPSE_TEST(LayerRemapsOnlyTheQueriedAllocation) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_REMAP_MEMORY_TYPES", "1", 1);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    VkMemoryRequirements requirements{};
+    layer.Get<PFN_vkGetBufferMemoryRequirements>("vkGetBufferMemoryRequirements")(
+        layer.device, FakeHandle<VkBuffer>(0x51), &requirements);
+
+    auto allocate = layer.Get<PFN_vkAllocateMemory>("vkAllocateMemory");
+    VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    info.allocationSize = requirements.size;
+    info.memoryTypeIndex = 1;
+    VkDeviceMemory memory[2] = {};
+    EXPECT_EQ(allocate(layer.device, &info, nullptr, &memory[0]), VK_SUCCESS);
+    EXPECT_EQ(allocate(layer.device, &info, nullptr, &memory[1]), VK_SUCCESS);
+
+    ASSERT_TRUE(Mock().allocations.size() >= 2);
+    EXPECT_EQ(Mock().allocations[Mock().allocations.size() - 2].memory_type, 3u);
+    EXPECT_EQ(Mock().allocations.back().memory_type, 1u);
+    DestroyLayerDevice(layer);
+}
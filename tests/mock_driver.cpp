@@ -0,0 +1,1123 @@
+// mock_driver.cpp - Fake loader and driver for host tests of the layer
+
+#include "mock_driver.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+
+#include <unistd.h>
+
+#include "vk_layer_interface.h"
+
+// The layer's exports; VK_NO_PROTOTYPES hides the loader's declarations
+extern "C" {
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo*, const VkAllocationCallbacks*,
+                                                VkInstance*);
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance, const VkAllocationCallbacks*);
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo*,
+                                              const VkAllocationCallbacks*, VkDevice*);
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice, const VkAllocationCallbacks*);
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice, const char*);
+}
+
+namespace {
+
+MockDriver g_mock;
+// Parallel compiles and the async compute tests reach the mock from
+// several threads
+std::mutex g_mutex;
+
+// Stand-ins for the loader's dispatch tables; only their addresses matter
+alignas(64) void* g_instance_table[8];
+alignas(64) void* g_device_tables[kMaxMockDevices][8];
+
+MockDriver::Device* FindDevice(VkDevice device) {
+    for (MockDriver::Device& entry : g_mock.devices) {
+        if (entry.handle == device) return &entry;
+    }
+    return nullptr;
+}
+
+void* DeviceTable(VkDevice device) {
+    MockDriver::Device* entry = FindDevice(device);
+    return entry ? g_device_tables[entry->table] : nullptr;
+}
+
+template <typename Handle>
+Handle NewHandle() {
+    g_mock.next_handle += 0x10;
+    return FakeHandle<Handle>(g_mock.next_handle);
+}
+
+VkPipeline NewPipeline() {
+    if (g_mock.recycled_pipelines.empty()) {
+        return NewHandle<VkPipeline>();
+    }
+    VkPipeline pipeline = g_mock.recycled_pipelines.front();
+    g_mock.recycled_pipelines.erase(g_mock.recycled_pipelines.begin());
+    return pipeline;
+}
+
+template <typename Handle>
+Handle NewDispatchable(void* table) {
+    g_mock.objects.push_back(std::make_unique<MockDriver::Dispatchable>(MockDriver::Dispatchable{table}));
+    return reinterpret_cast<Handle>(g_mock.objects.back().get());
+}
+
+template <typename Struct>
+const Struct* FindInChain(const void* next, VkStructureType type) {
+    for (auto* header = static_cast<const VkBaseInStructure*>(next); header; header = header->pNext) {
+        if (header->sType == type) return reinterpret_cast<const Struct*>(header);
+    }
+    return nullptr;
+}
+
+template <typename Struct>
+Struct* FindInOutChain(void* next, VkStructureType type) {
+    for (auto* header = static_cast<VkBaseOutStructure*>(next); header; header = header->pNext) {
+        if (header->sType == type) return reinterpret_cast<Struct*>(header);
+    }
+    return nullptr;
+}
+
+void RecordCommand(VkCommandBuffer command_buffer, const char* name) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.commands.push_back({command_buffer, name});
+}
+
+// Every submitted signal completes at once
+void Signal(VkSemaphore semaphore, uint64_t value) {
+    uint64_t& current = g_mock.semaphore_values[semaphore];
+    current = std::max(current, value);
+}
+
+// --- Instance level ---
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateInstance(const VkInstanceCreateInfo* pCreateInfo,
+                                                  const VkAllocationCallbacks*, VkInstance* pInstance) {
+    g_mock.api_version = pCreateInfo->pApplicationInfo ? pCreateInfo->pApplicationInfo->apiVersion
+                                                       : VK_API_VERSION_1_0;
+    g_mock.enabled_instance_extensions.assign(
+        pCreateInfo->ppEnabledExtensionNames,
+        pCreateInfo->ppEnabledExtensionNames + pCreateInfo->enabledExtensionCount);
+    g_mock.instance = NewDispatchable<VkInstance>(g_instance_table);
+    // Physical devices share their instance's dispatch table
+    g_mock.physical_device = NewDispatchable<VkPhysicalDevice>(g_instance_table);
+    *pInstance = g_mock.instance;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyInstance(VkInstance, const VkAllocationCallbacks*) {
+    g_mock.instance = VK_NULL_HANDLE;
+    g_mock.physical_device = VK_NULL_HANDLE;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockEnumerateDeviceExtensionProperties(
+    VkPhysicalDevice, const char*, uint32_t* pPropertyCount, VkExtensionProperties* pProperties) {
+    uint32_t count = static_cast<uint32_t>(g_mock.device_extensions.size());
+    if (!pProperties) {
+        *pPropertyCount = count;
+        return VK_SUCCESS;
+    }
+    uint32_t written = std::min(*pPropertyCount, count);
+    for (uint32_t i = 0; i < written; ++i) {
+        pProperties[i] = {};
+        std::strncpy(pProperties[i].extensionName, g_mock.device_extensions[i].c_str(),
+                     VK_MAX_EXTENSION_NAME_SIZE - 1);
+        pProperties[i].specVersion = 1;
+    }
+    *pPropertyCount = written;
+    return written < count ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetPhysicalDeviceProperties(VkPhysicalDevice,
+                                                           VkPhysicalDeviceProperties* pProperties) {
+    *pProperties = g_mock.properties;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetPhysicalDeviceProperties2(VkPhysicalDevice,
+                                                            VkPhysicalDeviceProperties2* pProperties) {
+    pProperties->properties = g_mock.properties;
+    if (auto* subgroup = FindInOutChain<VkPhysicalDeviceSubgroupSizeControlProperties>(
+            pProperties->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES)) {
+        void* next = subgroup->pNext;
+        *subgroup = g_mock.subgroup_size_control;
+        subgroup->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES;
+        subgroup->pNext = next;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetPhysicalDeviceMemoryProperties(
+    VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties) {
+    *pMemoryProperties = g_mock.memory_properties;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetPhysicalDeviceMemoryProperties2(
+    VkPhysicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties) {
+    pMemoryProperties->memoryProperties = g_mock.memory_properties;
+    if (auto* budget = FindInOutChain<VkPhysicalDeviceMemoryBudgetPropertiesEXT>(
+            pMemoryProperties->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT)) {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (uint32_t heap = 0; heap < g_mock.memory_properties.memoryHeapCount; ++heap) {
+            budget->heapBudget[heap] = g_mock.memory_properties.memoryHeaps[heap].size;
+            budget->heapUsage[heap] = 0;
+        }
+        for (auto [memory, index] : g_mock.live_allocations) {
+            const MockAllocation& allocation = g_mock.allocations[index];
+            budget->heapUsage[g_mock.memory_properties.memoryTypes[allocation.memory_type].heapIndex] +=
+                allocation.size;
+        }
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetPhysicalDeviceQueueFamilyProperties(
+    VkPhysicalDevice, uint32_t* pCount, VkQueueFamilyProperties* pProperties) {
+    uint32_t count = static_cast<uint32_t>(g_mock.queue_families.size());
+    if (!pProperties) {
+        *pCount = count;
+        return;
+    }
+    *pCount = std::min(*pCount, count);
+    std::copy_n(g_mock.queue_families.begin(), *pCount, pProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+                                                const VkAllocationCallbacks*, VkDevice* pDevice) {
+    g_mock.enabled_device_extensions.assign(
+        pCreateInfo->ppEnabledExtensionNames,
+        pCreateInfo->ppEnabledExtensionNames + pCreateInfo->enabledExtensionCount);
+    for (const std::string& name : g_mock.enabled_device_extensions) {
+        if (std::find(g_mock.device_extensions.begin(), g_mock.device_extensions.end(), name) ==
+            g_mock.device_extensions.end()) {
+            return VK_ERROR_EXTENSION_NOT_PRESENT;
+        }
+    }
+
+    // The first dispatch table no live device uses
+    uint32_t table = 0;
+    while (table < kMaxMockDevices &&
+           std::any_of(g_mock.devices.begin(), g_mock.devices.end(),
+                       [table](const MockDriver::Device& entry) { return entry.table == table; })) {
+        table++;
+    }
+    if (table == kMaxMockDevices) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    MockDriver::Device device{NewDispatchable<VkDevice>(g_device_tables[table]), table, {}};
+    g_mock.created_queues.clear();
+    for (uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; ++i) {
+        const VkDeviceQueueCreateInfo& info = pCreateInfo->pQueueCreateInfos[i];
+        if (info.queueFamilyIndex >= g_mock.queue_families.size() ||
+            info.queueCount > g_mock.queue_families[info.queueFamilyIndex].queueCount) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        g_mock.created_queues[info.queueFamilyIndex] = info.queueCount;
+        for (uint32_t index = 0; index < info.queueCount; ++index) {
+            // A real driver leaves the loader magic here; the loader or
+            // the layer's set-loader-data callback fills it in
+            device.queues[{info.queueFamilyIndex, index}] = NewDispatchable<VkQueue>(nullptr);
+        }
+    }
+    g_mock.devices.push_back(std::move(device));
+    *pDevice = g_mock.devices.back().handle;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockSetDeviceLoaderData(VkDevice device, void* object) {
+    static_cast<MockDriver::Dispatchable*>(object)->loader_data = DeviceTable(device);
+    return VK_SUCCESS;
+}
+
+// --- Device level ---
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyDevice(VkDevice device, const VkAllocationCallbacks*) {
+    std::erase_if(g_mock.devices, [device](const MockDriver::Device& entry) { return entry.handle == device; });
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetDeviceQueue(VkDevice device, uint32_t family, uint32_t index, VkQueue* pQueue) {
+    *pQueue = VK_NULL_HANDLE;
+    if (MockDriver::Device* entry = FindDevice(device)) {
+        auto it = entry->queues.find({family, index});
+        if (it != entry->queues.end()) *pQueue = it->second;
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetDeviceQueue2(VkDevice device, const VkDeviceQueueInfo2* pQueueInfo,
+                                               VkQueue* pQueue) {
+    MockGetDeviceQueue(device, pQueueInfo->queueFamilyIndex, pQueueInfo->queueIndex, pQueue);
+}
+
+// Applies pipeline_results to element i of a batch. Returns false when the
+// element fails; an early-return batch then fails every later one as well.
+template <typename CreateInfo>
+bool CreatePipelineElement(const CreateInfo* infos, uint32_t i, VkPipeline* pipelines, VkResult& result,
+                           bool& early_return) {
+    if (early_return) {
+        pipelines[i] = VK_NULL_HANDLE;
+        return false;
+    }
+    auto injected = g_mock.pipeline_results.find(infos[i].layout);
+    if (injected == g_mock.pipeline_results.end() || injected->second == VK_SUCCESS) {
+        return true;
+    }
+    pipelines[i] = VK_NULL_HANDLE;
+    if (result >= 0 && (injected->second < 0 || result == VK_SUCCESS)) {
+        result = injected->second;
+    }
+    early_return = (infos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT) != 0;
+    return false;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateGraphicsPipelines(
+    VkDevice, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks*, VkPipeline* pPipelines) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    VkResult result = VK_SUCCESS;
+    bool early_return = false;
+    for (uint32_t i = 0; i < createInfoCount; ++i) {
+        if (!CreatePipelineElement(pCreateInfos, i, pPipelines, result, early_return)) {
+            continue;
+        }
+        const VkGraphicsPipelineCreateInfo& info = pCreateInfos[i];
+        MockPipeline pipeline{};
+        pipeline.handle = pPipelines[i] = NewPipeline();
+        pipeline.cache = pipelineCache;
+        pipeline.layout = info.layout;
+        pipeline.batch = createInfoCount;
+        pipeline.cull_mode = info.pRasterizationState ? info.pRasterizationState->cullMode : 0;
+        pipeline.samples = info.pMultisampleState ? info.pMultisampleState->rasterizationSamples
+                                                  : VK_SAMPLE_COUNT_1_BIT;
+        if (auto* feedback = FindInChain<VkPipelineCreationFeedbackCreateInfo>(
+                info.pNext, VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO)) {
+            pipeline.feedback_chained = true;
+            feedback->pPipelineCreationFeedback->flags = VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+            feedback->pPipelineCreationFeedback->duration = 2'000'000;
+        }
+        g_mock.pipelines.push_back(pipeline);
+    }
+    return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateComputePipelines(
+    VkDevice, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+    const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks*, VkPipeline* pPipelines) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    VkResult result = VK_SUCCESS;
+    bool early_return = false;
+    for (uint32_t i = 0; i < createInfoCount; ++i) {
+        if (!CreatePipelineElement(pCreateInfos, i, pPipelines, result, early_return)) {
+            continue;
+        }
+        const VkComputePipelineCreateInfo& info = pCreateInfos[i];
+        MockPipeline pipeline{};
+        pipeline.handle = pPipelines[i] = NewPipeline();
+        pipeline.cache = pipelineCache;
+        pipeline.layout = info.layout;
+        pipeline.batch = createInfoCount;
+        pipeline.compute = true;
+        if (auto* required = FindInChain<VkPipelineShaderStageRequiredSubgroupSizeCreateInfo>(
+                info.stage.pNext, VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO)) {
+            pipeline.required_subgroup_size = required->requiredSubgroupSize;
+        }
+        if (auto* feedback = FindInChain<VkPipelineCreationFeedbackCreateInfo>(
+                info.pNext, VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO)) {
+            pipeline.feedback_chained = true;
+            feedback->pPipelineCreationFeedback->flags = VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+            feedback->pPipelineCreationFeedback->duration = 1'000'000;
+        }
+        g_mock.pipelines.push_back(pipeline);
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyPipeline(VkDevice, VkPipeline pipeline, const VkAllocationCallbacks*) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.destroyed_pipelines.push_back(pipeline);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo* pCreateInfo,
+                                                      const VkAllocationCallbacks*, VkShaderModule* pShaderModule) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.shader_code.emplace_back(pCreateInfo->pCode, pCreateInfo->pCode + pCreateInfo->codeSize / 4);
+    *pShaderModule = NewHandle<VkShaderModule>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyShaderModule(VkDevice, VkShaderModule, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreatePipelineCache(VkDevice, const VkPipelineCacheCreateInfo* pCreateInfo,
+                                                       const VkAllocationCallbacks*, VkPipelineCache* pCache) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.pipeline_cache_initial_size = pCreateInfo->initialDataSize;
+    *pCache = NewHandle<VkPipelineCache>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyPipelineCache(VkDevice, VkPipelineCache, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockGetPipelineCacheData(VkDevice, VkPipelineCache, size_t* pDataSize,
+                                                        void* pData) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (!pData) {
+        *pDataSize = g_mock.pipeline_cache_data.size();
+        return VK_SUCCESS;
+    }
+    size_t size = std::min(*pDataSize, g_mock.pipeline_cache_data.size());
+    std::memcpy(pData, g_mock.pipeline_cache_data.data(), size);
+    *pDataSize = size;
+    return size < g_mock.pipeline_cache_data.size() ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo,
+                                                  const VkAllocationCallbacks*, VkDeviceMemory* pMemory) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (pAllocateInfo->memoryTypeIndex >= g_mock.memory_properties.memoryTypeCount) {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    MockAllocation allocation{};
+    allocation.handle = NewHandle<VkDeviceMemory>();
+    allocation.memory_type = pAllocateInfo->memoryTypeIndex;
+    allocation.size = pAllocateInfo->allocationSize;
+    allocation.dedicated = FindInChain<VkMemoryDedicatedAllocateInfo>(
+                               pAllocateInfo->pNext, VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO) != nullptr;
+    g_mock.live_allocations[allocation.handle] = g_mock.allocations.size();
+    g_mock.allocations.push_back(allocation);
+    *pMemory = allocation.handle;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_mock.live_allocations.find(memory);
+    if (it != g_mock.live_allocations.end()) {
+        g_mock.allocations[it->second].freed = true;
+        g_mock.live_allocations.erase(it);
+    }
+    g_mock.memory_contents.erase(memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset,
+                                             VkDeviceSize, VkMemoryMapFlags, void** ppData) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const MockAllocation* allocation = g_mock.FindAllocation(memory);
+    if (!allocation) return VK_ERROR_MEMORY_MAP_FAILED;
+    std::unique_ptr<uint8_t[]>& contents = g_mock.memory_contents[memory];
+    if (!contents) {
+        contents.reset(new uint8_t[allocation->size]());
+    }
+    g_mock.map_calls++;
+    *ppData = contents.get() + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockUnmapMemory(VkDevice, VkDeviceMemory) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.unmap_calls++;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockFlushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockBindBufferMemory2(VkDevice, uint32_t, const VkBindBufferMemoryInfo*) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockBindImageMemory2(VkDevice, uint32_t, const VkBindImageMemoryInfo*) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateImage(VkDevice, const VkImageCreateInfo*, const VkAllocationCallbacks*,
+                                               VkImage* pImage) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    *pImage = NewHandle<VkImage>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyImage(VkDevice, VkImage, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR void VKAPI_CALL MockGetBufferMemoryRequirements(VkDevice, VkBuffer,
+                                                           VkMemoryRequirements* pMemoryRequirements) {
+    *pMemoryRequirements = g_mock.buffer_requirements;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetImageMemoryRequirements(VkDevice, VkImage,
+                                                          VkMemoryRequirements* pMemoryRequirements) {
+    *pMemoryRequirements = g_mock.image_requirements;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetBufferMemoryRequirements2(VkDevice, const VkBufferMemoryRequirementsInfo2*,
+                                                            VkMemoryRequirements2* pMemoryRequirements) {
+    pMemoryRequirements->memoryRequirements = g_mock.buffer_requirements;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockGetImageMemoryRequirements2(VkDevice, const VkImageMemoryRequirementsInfo2*,
+                                                           VkMemoryRequirements2* pMemoryRequirements) {
+    pMemoryRequirements->memoryRequirements = g_mock.image_requirements;
+    if (auto* dedicated = FindInOutChain<VkMemoryDedicatedRequirements>(
+            pMemoryRequirements->pNext, VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS)) {
+        dedicated->prefersDedicatedAllocation = g_mock.image_requires_dedicated;
+        dedicated->requiresDedicatedAllocation = g_mock.image_requires_dedicated;
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits,
+                                               VkFence fence) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // Submitting to a destroyed device is the layer's bug, not a submit
+    if (!g_mock.FindQueueDevice(queue)) return VK_ERROR_DEVICE_LOST;
+    uint32_t call = g_mock.submit_calls++;
+    for (uint32_t i = 0; i < submitCount; ++i) {
+        const VkSubmitInfo& info = pSubmits[i];
+        auto* timeline = FindInChain<VkTimelineSemaphoreSubmitInfo>(
+            info.pNext, VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
+        MockSubmit submit{};
+        submit.call = call;
+        submit.queue = queue;
+        submit.fence = i + 1 == submitCount ? fence : VK_NULL_HANDLE;
+        submit.command_buffers.assign(info.pCommandBuffers, info.pCommandBuffers + info.commandBufferCount);
+        for (uint32_t w = 0; w < info.waitSemaphoreCount; ++w) {
+            submit.wait_semaphores.push_back(info.pWaitSemaphores[w]);
+            submit.wait_stages.push_back(info.pWaitDstStageMask[w]);
+            submit.wait_values.push_back(timeline && w < timeline->waitSemaphoreValueCount
+                                             ? timeline->pWaitSemaphoreValues[w] : 0);
+        }
+        for (uint32_t s = 0; s < info.signalSemaphoreCount; ++s) {
+            uint64_t value = timeline && s < timeline->signalSemaphoreValueCount
+                                 ? timeline->pSignalSemaphoreValues[s] : 1;
+            submit.signal_semaphores.push_back(info.pSignalSemaphores[s]);
+            submit.signal_values.push_back(value);
+            Signal(info.pSignalSemaphores[s], value);
+        }
+        g_mock.submits.push_back(std::move(submit));
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockQueueSubmit2(VkQueue queue, uint32_t submitCount, const VkSubmitInfo2* pSubmits,
+                                                VkFence fence) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // Submitting to a destroyed device is the layer's bug, not a submit
+    if (!g_mock.FindQueueDevice(queue)) return VK_ERROR_DEVICE_LOST;
+    uint32_t call = g_mock.submit_calls++;
+    for (uint32_t i = 0; i < submitCount; ++i) {
+        const VkSubmitInfo2& info = pSubmits[i];
+        MockSubmit submit{};
+        submit.call = call;
+        submit.queue = queue;
+        submit.submit2 = true;
+        submit.fence = i + 1 == submitCount ? fence : VK_NULL_HANDLE;
+        for (uint32_t c = 0; c < info.commandBufferInfoCount; ++c) {
+            submit.command_buffers.push_back(info.pCommandBufferInfos[c].commandBuffer);
+        }
+        for (uint32_t w = 0; w < info.waitSemaphoreInfoCount; ++w) {
+            submit.wait_semaphores.push_back(info.pWaitSemaphoreInfos[w].semaphore);
+            submit.wait_values.push_back(info.pWaitSemaphoreInfos[w].value);
+            submit.wait_stages.push_back(info.pWaitSemaphoreInfos[w].stageMask);
+        }
+        for (uint32_t s = 0; s < info.signalSemaphoreInfoCount; ++s) {
+            const VkSemaphoreSubmitInfo& signal = info.pSignalSemaphoreInfos[s];
+            submit.signal_semaphores.push_back(signal.semaphore);
+            submit.signal_values.push_back(signal.value);
+            Signal(signal.semaphore, signal.value ? signal.value : 1);
+        }
+        g_mock.submits.push_back(std::move(submit));
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockQueueWaitIdle(VkQueue) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.queue_wait_idles++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockDeviceWaitIdle(VkDevice) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.device_wait_idles++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockWaitForFences(VkDevice, uint32_t, const VkFence*, VkBool32, uint64_t) {
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockWaitSemaphores(VkDevice, const VkSemaphoreWaitInfo* pWaitInfo, uint64_t) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    bool any = pWaitInfo->flags & VK_SEMAPHORE_WAIT_ANY_BIT;
+    uint32_t reached = 0;
+    for (uint32_t i = 0; i < pWaitInfo->semaphoreCount; ++i) {
+        reached += g_mock.semaphore_values[pWaitInfo->pSemaphores[i]] >= pWaitInfo->pValues[i];
+    }
+    bool done = any ? reached > 0 : reached == pWaitInfo->semaphoreCount;
+    return done ? VK_SUCCESS : VK_TIMEOUT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockGetSemaphoreCounterValue(VkDevice, VkSemaphore semaphore, uint64_t* pValue) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    *pValue = g_mock.semaphore_values[semaphore];
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo* pCreateInfo,
+                                                   const VkAllocationCallbacks*, VkSemaphore* pSemaphore) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    *pSemaphore = NewHandle<VkSemaphore>();
+    auto* type = FindInChain<VkSemaphoreTypeCreateInfo>(pCreateInfo->pNext,
+                                                        VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO);
+    g_mock.semaphore_values[*pSemaphore] = type ? type->initialValue : 0;
+    g_mock.live_semaphores++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks*) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (semaphore != VK_NULL_HANDLE && g_mock.semaphore_values.erase(semaphore)) {
+        g_mock.live_semaphores--;
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo* pCreateInfo,
+                                                     const VkAllocationCallbacks*, VkCommandPool* pCommandPool) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    *pCommandPool = NewHandle<VkCommandPool>();
+    g_mock.command_pool_families[*pCommandPool] = pCreateInfo->queueFamilyIndex;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyCommandPool(VkDevice, VkCommandPool commandPool,
+                                                  const VkAllocationCallbacks*) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.command_pool_families.erase(commandPool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+                                                          VkCommandBuffer* pCommandBuffers) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i) {
+        pCommandBuffers[i] = NewDispatchable<VkCommandBuffer>(DeviceTable(device));
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockFreeCommandBuffers(VkDevice, VkCommandPool, uint32_t, const VkCommandBuffer*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockBeginCommandBuffer(VkCommandBuffer commandBuffer,
+                                                      const VkCommandBufferBeginInfo*) {
+    RecordCommand(commandBuffer, "BeginCommandBuffer");
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockEndCommandBuffer(VkCommandBuffer commandBuffer) {
+    RecordCommand(commandBuffer, "EndCommandBuffer");
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdDraw(VkCommandBuffer commandBuffer, uint32_t, uint32_t, uint32_t, uint32_t) {
+    RecordCommand(commandBuffer, "CmdDraw");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdDispatch(VkCommandBuffer commandBuffer, uint32_t, uint32_t, uint32_t) {
+    RecordCommand(commandBuffer, "CmdDispatch");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer, VkBuffer, uint32_t,
+                                             const VkBufferCopy*) {
+    RecordCommand(commandBuffer, "CmdCopyBuffer");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdBeginRenderPass(VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo*,
+                                                  VkSubpassContents) {
+    RecordCommand(commandBuffer, "CmdBeginRenderPass");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdEndRenderPass(VkCommandBuffer commandBuffer) {
+    RecordCommand(commandBuffer, "CmdEndRenderPass");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdPipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags,
+                                                  VkPipelineStageFlags, VkDependencyFlags, uint32_t,
+                                                  const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*,
+                                                  uint32_t, const VkImageMemoryBarrier*) {
+    RecordCommand(commandBuffer, "CmdPipelineBarrier");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo*) {
+    RecordCommand(commandBuffer, "CmdPipelineBarrier2");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool, uint32_t, uint32_t) {
+    RecordCommand(commandBuffer, "CmdResetQueryPool");
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits,
+                                                 VkQueryPool queryPool, uint32_t query) {
+    RecordCommand(commandBuffer, "CmdWriteTimestamp");
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.timestamps[{queryPool, query}] = (g_mock.gpu_clock += 1000);
+}
+
+VKAPI_ATTR void VKAPI_CALL MockCmdWriteTimestamp2(VkCommandBuffer commandBuffer, VkPipelineStageFlags2,
+                                                  VkQueryPool queryPool, uint32_t query) {
+    RecordCommand(commandBuffer, "CmdWriteTimestamp2");
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.timestamps[{queryPool, query}] = (g_mock.gpu_clock += 1000);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo*,
+                                                   const VkAllocationCallbacks*, VkQueryPool* pQueryPool) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    *pQueryPool = NewHandle<VkQueryPool>();
+    g_mock.live_query_pools++;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL MockDestroyQueryPool(VkDevice, VkQueryPool queryPool, const VkAllocationCallbacks*) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (queryPool != VK_NULL_HANDLE) {
+        g_mock.live_query_pools--;
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockGetQueryPoolResults(VkDevice, VkQueryPool queryPool, uint32_t firstQuery,
+                                                       uint32_t queryCount, size_t, void* pData,
+                                                       VkDeviceSize stride, VkQueryResultFlags flags) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    bool availability = flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+    bool all_available = true;
+    for (uint32_t i = 0; i < queryCount; ++i) {
+        auto it = g_mock.timestamps.find({queryPool, firstQuery + i});
+        bool available = it != g_mock.timestamps.end();
+        all_available = all_available && available;
+        auto* result = reinterpret_cast<uint64_t*>(static_cast<uint8_t*>(pData) + i * stride);
+        if (available) result[0] = it->second;
+        if (availability) result[1] = available;
+    }
+    return all_available ? VK_SUCCESS : VK_NOT_READY;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL MockQueuePresentKHR(VkQueue, const VkPresentInfoKHR*) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.presents++;
+    return VK_SUCCESS;
+}
+
+// Per-device copies of a few entry points, so tests can tell which
+// device's table the layer called through
+
+void RecordRoute(uint32_t table, const void* object, const char* name) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_mock.routed_calls.push_back({table, object, name});
+}
+
+template <uint32_t kTable>
+VKAPI_ATTR VkResult VKAPI_CALL RoutedDeviceWaitIdle(VkDevice device) {
+    RecordRoute(kTable, device, "DeviceWaitIdle");
+    return MockDeviceWaitIdle(device);
+}
+
+template <uint32_t kTable>
+VKAPI_ATTR VkResult VKAPI_CALL RoutedQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits,
+                                                 VkFence fence) {
+    RecordRoute(kTable, queue, "QueueSubmit");
+    return MockQueueSubmit(queue, submitCount, pSubmits, fence);
+}
+
+template <uint32_t kTable>
+VKAPI_ATTR VkResult VKAPI_CALL RoutedQueueWaitIdle(VkQueue queue) {
+    RecordRoute(kTable, queue, "QueueWaitIdle");
+    return MockQueueWaitIdle(queue);
+}
+
+template <uint32_t kTable>
+VKAPI_ATTR void VKAPI_CALL RoutedCmdDraw(VkCommandBuffer commandBuffer, uint32_t vertexCount,
+                                         uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+    RecordRoute(kTable, commandBuffer, "CmdDraw");
+    MockCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+// Not intercepted by the layer, which hands out the next link's pointer
+template <uint32_t kTable>
+VKAPI_ATTR VkResult VKAPI_CALL RoutedCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo,
+                                                     const VkAllocationCallbacks* pAllocator,
+                                                     VkSemaphore* pSemaphore) {
+    RecordRoute(kTable, device, "CreateSemaphore");
+    return MockCreateSemaphore(device, pCreateInfo, pAllocator, pSemaphore);
+}
+
+struct MockProc {
+    std::string_view name;
+    PFN_vkVoidFunction proc;
+};
+
+#define MOCK_PROC(name) {"vk" #name, reinterpret_cast<PFN_vkVoidFunction>(Mock##name)}
+
+const MockProc kInstanceProcs[] = {
+    MOCK_PROC(CreateInstance),
+    MOCK_PROC(DestroyInstance),
+    MOCK_PROC(EnumerateDeviceExtensionProperties),
+    MOCK_PROC(GetPhysicalDeviceProperties),
+    MOCK_PROC(GetPhysicalDeviceProperties2),
+    MOCK_PROC(GetPhysicalDeviceMemoryProperties),
+    MOCK_PROC(GetPhysicalDeviceMemoryProperties2),
+    {"vkGetPhysicalDeviceProperties2KHR", reinterpret_cast<PFN_vkVoidFunction>(MockGetPhysicalDeviceProperties2)},
+    {"vkGetPhysicalDeviceMemoryProperties2KHR",
+     reinterpret_cast<PFN_vkVoidFunction>(MockGetPhysicalDeviceMemoryProperties2)},
+    MOCK_PROC(GetPhysicalDeviceQueueFamilyProperties),
+    MOCK_PROC(CreateDevice),
+};
+
+const MockProc kDeviceProcs[] = {
+    MOCK_PROC(DestroyDevice),
+    MOCK_PROC(GetDeviceQueue),
+    MOCK_PROC(GetDeviceQueue2),
+    MOCK_PROC(CreateGraphicsPipelines),
+    MOCK_PROC(CreateComputePipelines),
+    MOCK_PROC(DestroyPipeline),
+    MOCK_PROC(CreateShaderModule),
+    MOCK_PROC(DestroyShaderModule),
+    MOCK_PROC(CreatePipelineCache),
+    MOCK_PROC(DestroyPipelineCache),
+    MOCK_PROC(GetPipelineCacheData),
+    MOCK_PROC(AllocateMemory),
+    MOCK_PROC(FreeMemory),
+    MOCK_PROC(MapMemory),
+    MOCK_PROC(UnmapMemory),
+    MOCK_PROC(FlushMappedMemoryRanges),
+    {"vkInvalidateMappedMemoryRanges", reinterpret_cast<PFN_vkVoidFunction>(MockFlushMappedMemoryRanges)},
+    MOCK_PROC(BindBufferMemory),
+    MOCK_PROC(BindImageMemory),
+    MOCK_PROC(BindBufferMemory2),
+    MOCK_PROC(BindImageMemory2),
+    MOCK_PROC(CreateImage),
+    MOCK_PROC(DestroyImage),
+    MOCK_PROC(GetBufferMemoryRequirements),
+    MOCK_PROC(GetImageMemoryRequirements),
+    MOCK_PROC(GetBufferMemoryRequirements2),
+    MOCK_PROC(GetImageMemoryRequirements2),
+    MOCK_PROC(QueueSubmit),
+    MOCK_PROC(QueueSubmit2),
+    MOCK_PROC(QueueWaitIdle),
+    MOCK_PROC(DeviceWaitIdle),
+    MOCK_PROC(WaitForFences),
+    MOCK_PROC(WaitSemaphores),
+    MOCK_PROC(GetSemaphoreCounterValue),
+    MOCK_PROC(CreateSemaphore),
+    MOCK_PROC(DestroySemaphore),
+    MOCK_PROC(CreateCommandPool),
+    MOCK_PROC(DestroyCommandPool),
+    MOCK_PROC(AllocateCommandBuffers),
+    MOCK_PROC(FreeCommandBuffers),
+    MOCK_PROC(BeginCommandBuffer),
+    MOCK_PROC(EndCommandBuffer),
+    MOCK_PROC(CmdDraw),
+    MOCK_PROC(CmdDispatch),
+    MOCK_PROC(CmdCopyBuffer),
+    MOCK_PROC(CmdBeginRenderPass),
+    MOCK_PROC(CmdEndRenderPass),
+    MOCK_PROC(CmdPipelineBarrier),
+    MOCK_PROC(CmdPipelineBarrier2),
+    MOCK_PROC(CmdResetQueryPool),
+    MOCK_PROC(CmdWriteTimestamp),
+    MOCK_PROC(CmdWriteTimestamp2),
+    MOCK_PROC(CreateQueryPool),
+    MOCK_PROC(DestroyQueryPool),
+    MOCK_PROC(GetQueryPoolResults),
+    MOCK_PROC(QueuePresentKHR),
+};
+
+#undef MOCK_PROC
+
+#define ROUTED_PROC(name, table) {"vk" #name, reinterpret_cast<PFN_vkVoidFunction>(Routed##name<table>)}
+#define ROUTED_PROCS(table)                                                      \
+    {ROUTED_PROC(DeviceWaitIdle, table), ROUTED_PROC(QueueSubmit, table),        \
+     ROUTED_PROC(QueueWaitIdle, table), ROUTED_PROC(CmdDraw, table),             \
+     ROUTED_PROC(CreateSemaphore, table)}
+
+const MockProc kRoutedProcs[kMaxMockDevices][5] = {ROUTED_PROCS(0), ROUTED_PROCS(1)};
+
+#undef ROUTED_PROCS
+#undef ROUTED_PROC
+
+template <size_t kCount>
+PFN_vkVoidFunction FindProc(const MockProc (&procs)[kCount], const char* name) {
+    for (const MockProc& proc : procs) {
+        if (proc.name == name) return proc.proc;
+    }
+    return nullptr;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL MockGetDeviceProcAddr(VkDevice device, const char* pName) {
+    if (MockDriver::Device* entry = FindDevice(device)) {
+        if (PFN_vkVoidFunction proc = FindProc(kRoutedProcs[entry->table], pName)) return proc;
+    }
+    return FindProc(kDeviceProcs, pName);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL MockGetInstanceProcAddr(VkInstance, const char* pName) {
+    if (PFN_vkVoidFunction proc = FindProc(kInstanceProcs, pName)) return proc;
+    return FindProc(kDeviceProcs, pName);
+}
+
+VkMemoryType MemoryType(VkMemoryPropertyFlags flags) {
+    return {flags, 0};
+}
+
+} // namespace
+
+uint32_t MockDriver::CountCommands(const char* name) const {
+    return static_cast<uint32_t>(std::count_if(commands.begin(), commands.end(),
+                                               [name](const MockCommand& command) { return command.name == name; }));
+}
+
+uint32_t MockDriver::CountCommands(VkCommandBuffer command_buffer, const char* name) const {
+    return static_cast<uint32_t>(std::count_if(commands.begin(), commands.end(), [&](const MockCommand& command) {
+        return command.command_buffer == command_buffer && command.name == name;
+    }));
+}
+
+const MockAllocation* MockDriver::FindAllocation(VkDeviceMemory memory) const {
+    auto it = live_allocations.find(memory);
+    return it != live_allocations.end() ? &allocations[it->second] : nullptr;
+}
+
+const MockDriver::Device* MockDriver::FindDevice(VkDevice device) const {
+    auto it = std::find_if(devices.begin(), devices.end(),
+                           [device](const Device& entry) { return entry.handle == device; });
+    return it != devices.end() ? &*it : nullptr;
+}
+
+const MockDriver::Device* MockDriver::FindQueueDevice(VkQueue queue) const {
+    for (const Device& device : devices) {
+        for (const auto& [index, handle] : device.queues) {
+            if (handle == queue) return &device;
+        }
+    }
+    return nullptr;
+}
+
+MockDriver& Mock() {
+    return g_mock;
+}
+
+void ResetMock() {
+    g_mock = MockDriver();
+
+    VkPhysicalDeviceProperties& properties = g_mock.properties;
+    properties.apiVersion = VK_API_VERSION_1_3;
+    properties.driverVersion = VK_MAKE_VERSION(2, 0, 0);
+    properties.vendorID = 0x144d;
+    properties.deviceID = 0x0940;
+    properties.deviceType = VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU;
+    std::strcpy(properties.deviceName, "Mock Xclipse 940");
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+        properties.pipelineCacheUUID[i] = static_cast<uint8_t>(i + 1);
+    }
+    properties.limits.maxMemoryAllocationCount = 4096;
+    properties.limits.bufferImageGranularity = 64;
+    properties.limits.nonCoherentAtomSize = 64;
+    properties.limits.maxComputeWorkGroupInvocations = 1024;
+    properties.limits.timestampComputeAndGraphics = VK_TRUE;
+    properties.limits.timestampPeriod = 1.0f;
+
+    // One device-local heap, as on the phone: every type is the same RAM
+    VkPhysicalDeviceMemoryProperties& memory = g_mock.memory_properties;
+    memory.memoryHeapCount = 1;
+    memory.memoryHeaps[0] = {8ull << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    memory.memoryTypeCount = 5;
+    memory.memoryTypes[0] = MemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    memory.memoryTypes[1] = MemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    memory.memoryTypes[2] = MemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    memory.memoryTypes[3] = MemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    memory.memoryTypes[4] = MemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+
+    g_mock.subgroup_size_control.minSubgroupSize = 32;
+    g_mock.subgroup_size_control.maxSubgroupSize = 64;
+    g_mock.subgroup_size_control.maxComputeWorkgroupSubgroups = 32;
+    g_mock.subgroup_size_control.requiredSubgroupSizeStages = VK_SHADER_STAGE_COMPUTE_BIT |
+                                                              VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    g_mock.queue_families = {
+        {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 2, 64, {1, 1, 1}},
+        {VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 4, 64, {1, 1, 1}},
+        {VK_QUEUE_TRANSFER_BIT, 1, 0, {1, 1, 1}},
+    };
+
+    g_mock.device_extensions = {
+        VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME,
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+        VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+        VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    };
+
+    g_mock.buffer_requirements = {64 << 10, 256, (1u << memory.memoryTypeCount) - 1};
+    g_mock.image_requirements = {1 << 20, 4096, 0b11001};
+    g_mock.pipeline_cache_data.assign(256, 0xab);
+}
+
+const std::string& TestDataDirectory() {
+    static std::string directory = [] {
+        char path[] = "/tmp/xclipse_test.XXXXXX";
+        return std::string(mkdtemp(path) ? path : "/tmp");
+    }();
+    return directory;
+}
+
+void ResetLayerEnvironment() {
+    std::vector<std::string> names;
+    for (char** variable = environ; *variable; ++variable) {
+        std::string_view entry = *variable;
+        if (entry.substr(0, 8) == "XCLIPSE_") {
+            names.emplace_back(entry.substr(0, entry.find('=')));
+        }
+    }
+    for (const std::string& name : names) {
+        unsetenv(name.c_str());
+    }
+    setenv("XCLIPSE_CACHE_DIR", TestDataDirectory().c_str(), 1);
+    setenv("XCLIPSE_PROFILE", "/dev/null", 1);
+}
+
+PFN_vkVoidFunction LayerDevice::GetProc(const char* name) const {
+    return vkGetDeviceProcAddr(device, name);
+}
+
+VkQueue LayerDevice::Queue(uint32_t family, uint32_t index) const {
+    VkQueue queue = VK_NULL_HANDLE;
+    Get<PFN_vkGetDeviceQueue>("vkGetDeviceQueue")(device, family, index, &queue);
+    // The loader fills in the dispatch pointer of every queue it returns
+    if (queue) MockSetDeviceLoaderData(device, queue);
+    return queue;
+}
+
+VkCommandPool LayerDevice::CreateCommandPool(uint32_t family) const {
+    VkCommandPoolCreateInfo info{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    info.queueFamilyIndex = family;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    Get<PFN_vkCreateCommandPool>("vkCreateCommandPool")(device, &info, nullptr, &pool);
+    return pool;
+}
+
+VkCommandBuffer LayerDevice::AllocateCommandBuffer(VkCommandPool pool) const {
+    VkCommandBufferAllocateInfo info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    info.commandPool = pool;
+    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.commandBufferCount = 1;
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    Get<PFN_vkAllocateCommandBuffers>("vkAllocateCommandBuffers")(device, &info, &command_buffer);
+    return command_buffer;
+}
+
+VkSemaphore LayerDevice::CreateTimelineSemaphore() const {
+    VkSemaphoreTypeCreateInfo type{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    type.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    VkSemaphoreCreateInfo info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &type};
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    Get<PFN_vkCreateSemaphore>("vkCreateSemaphore")(device, &info, nullptr, &semaphore);
+    return semaphore;
+}
+
+namespace {
+
+// The device half of CreateLayerDevice, on layer.physical_device
+bool CreateDevice(LayerDevice& layer, const LayerDeviceOptions& options) {
+    std::vector<std::vector<float>> priorities;
+    std::vector<VkDeviceQueueCreateInfo> queue_infos;
+    for (auto [family, count] : options.queues) {
+        priorities.emplace_back(count, 1.0f);
+        VkDeviceQueueCreateInfo info{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+        info.queueFamilyIndex = family;
+        info.queueCount = count;
+        info.pQueuePriorities = priorities.back().data();
+        queue_infos.push_back(info);
+    }
+
+    VkLayerDeviceCreateInfo loader_data{};
+    loader_data.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO;
+    loader_data.pNext = options.device_features;
+    loader_data.function = VK_LOADER_DATA_CALLBACK;
+    loader_data.u.pfnSetDeviceLoaderData = MockSetDeviceLoaderData;
+
+    VkLayerDeviceLink device_link{};
+    device_link.pfnNextGetInstanceProcAddr = MockGetInstanceProcAddr;
+    device_link.pfnNextGetDeviceProcAddr = MockGetDeviceProcAddr;
+    VkLayerDeviceCreateInfo device_chain{};
+    device_chain.sType = VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO;
+    device_chain.pNext = &loader_data;
+    device_chain.function = VK_LAYER_LINK_INFO;
+    device_chain.u.pLayerInfo = &device_link;
+
+    VkDeviceCreateInfo device_info{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, &device_chain};
+    device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_infos.size());
+    device_info.pQueueCreateInfos = queue_infos.data();
+    device_info.enabledExtensionCount = static_cast<uint32_t>(options.device_extensions.size());
+    device_info.ppEnabledExtensionNames = options.device_extensions.data();
+    return vkCreateDevice(layer.physical_device, &device_info, nullptr, &layer.device) == VK_SUCCESS;
+}
+
+} // namespace
+
+bool CreateLayerDevice(LayerDevice& layer, const LayerDeviceOptions& options) {
+    VkApplicationInfo application{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+    application.pApplicationName = "mock-app";
+    application.pEngineName = "mock-engine";
+    application.apiVersion = options.api_version;
+
+    VkLayerInstanceLink instance_link{};
+    instance_link.pfnNextGetInstanceProcAddr = MockGetInstanceProcAddr;
+    VkLayerInstanceCreateInfo instance_chain{};
+    instance_chain.sType = VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO;
+    instance_chain.function = VK_LAYER_LINK_INFO;
+    instance_chain.u.pLayerInfo = &instance_link;
+
+    VkInstanceCreateInfo instance_info{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO, &instance_chain};
+    instance_info.pApplicationInfo = &application;
+    instance_info.enabledExtensionCount = static_cast<uint32_t>(options.instance_extensions.size());
+    instance_info.ppEnabledExtensionNames = options.instance_extensions.data();
+    if (vkCreateInstance(&instance_info, nullptr, &layer.instance) != VK_SUCCESS) {
+        return false;
+    }
+    layer.physical_device = g_mock.physical_device;
+    if (!CreateDevice(layer, options)) {
+        vkDestroyInstance(layer.instance, nullptr);
+        layer = LayerDevice();
+        return false;
+    }
+    return true;
+}
+
+bool CreateSecondLayerDevice(const LayerDevice& first, LayerDevice& second, const LayerDeviceOptions& options) {
+    second = LayerDevice();
+    second.physical_device = first.physical_device;
+    if (!CreateDevice(second, options)) {
+        second = LayerDevice();
+        return false;
+    }
+    return true;
+}
+
+void DestroyLayerDevice(LayerDevice& layer) {
+    if (layer.device) {
+        vkDestroyDevice(layer.device, nullptr);
+    }
+    if (layer.instance) {
+        vkDestroyInstance(layer.instance, nullptr);
+    }
+    layer = LayerDevice();
+}
@@ -0,0 +1,193 @@
+// mock_driver.h - Fake loader and driver for host tests of the layer
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// The mock plays both ends of the layer: it builds the loader's create-info
+// chains and sits behind the layer as the next link. Tests describe the
+// device before creating it and inspect what reached the "driver" after.
+// Up to kMaxMockDevices devices at a time, each with its own loader
+// dispatch table and next-layer entry points; state is process-global like
+// the layer's own.
+
+constexpr uint32_t kMaxMockDevices = 2;
+
+struct MockPipeline {
+    VkPipeline handle;
+    VkPipelineCache cache;
+    VkPipelineLayout layout;
+    uint32_t batch;  // createInfoCount of the driver call that created it
+    bool compute;
+    bool feedback_chained;  // a VkPipelineCreationFeedbackCreateInfo reached the driver
+    VkCullModeFlags cull_mode;
+    VkSampleCountFlagBits samples;
+    uint32_t required_subgroup_size;  // of the compute stage; 0 when none was chained
+};
+
+struct MockAllocation {
+    VkDeviceMemory handle;
+    uint32_t memory_type;
+    VkDeviceSize size;
+    bool dedicated;
+    bool freed;
+};
+
+struct MockSubmit {
+    uint32_t call;  // submits with the same call index reached the driver together
+    VkQueue queue;
+    bool submit2;
+    VkFence fence;
+    std::vector<VkCommandBuffer> command_buffers;
+    std::vector<VkSemaphore> wait_semaphores;
+    std::vector<uint64_t> wait_values;
+    std::vector<VkPipelineStageFlags2> wait_stages;
+    std::vector<VkSemaphore> signal_semaphores;
+    std::vector<uint64_t> signal_values;
+};
+
+struct MockCommand {
+    VkCommandBuffer command_buffer;
+    std::string name;  // entry point without the vk prefix, e.g. "CmdDraw"
+};
+
+// A call that reached the driver through one device's next-layer entry
+// points. Only the calls the routing tests look at are recorded.
+struct MockRoutedCall {
+    uint32_t table;  // index of the device whose entry point was called
+    const void* object;  // the dispatchable handle it was called with
+    std::string name;  // entry point without the vk prefix
+};
+
+struct MockDriver {
+    // Device description, set before CreateLayerDevice
+    VkPhysicalDeviceProperties properties{};
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    VkPhysicalDeviceSubgroupSizeControlProperties subgroup_size_control{};
+    std::vector<VkQueueFamilyProperties> queue_families;
+    std::vector<std::string> device_extensions;
+    VkMemoryRequirements buffer_requirements{};
+    VkMemoryRequirements image_requirements{};
+    bool image_requires_dedicated{false};  // reported by vkGetImageMemoryRequirements2
+    std::vector<uint8_t> pipeline_cache_data;  // what vkGetPipelineCacheData returns
+    // Handed out by the next pipeline creations before any new handle, as
+    // a driver reusing freed handles would
+    std::vector<VkPipeline> recycled_pipelines;
+    // What creating a pipeline with the given layout returns instead of
+    // VK_SUCCESS. A failed element's handle is VK_NULL_HANDLE; a call
+    // returns its first error by index, else its first other result.
+    std::unordered_map<VkPipelineLayout, VkResult> pipeline_results;
+
+    // What reached the driver
+    uint32_t api_version{0};
+    std::vector<std::string> enabled_instance_extensions;
+    std::vector<std::string> enabled_device_extensions;
+    std::map<uint32_t, uint32_t> created_queues;  // family -> count
+    size_t pipeline_cache_initial_size{0};
+    std::vector<MockPipeline> pipelines;
+    std::vector<VkPipeline> destroyed_pipelines;
+    std::vector<std::vector<uint32_t>> shader_code;  // per vkCreateShaderModule
+    std::vector<MockAllocation> allocations;
+    uint32_t submit_calls{0};
+    std::vector<MockSubmit> submits;
+    std::vector<MockCommand> commands;
+    uint32_t map_calls{0};
+    uint32_t unmap_calls{0};
+    uint32_t presents{0};
+    uint32_t queue_wait_idles{0};
+    uint32_t device_wait_idles{0};
+    uint32_t live_semaphores{0};
+    uint32_t live_query_pools{0};
+    std::vector<MockRoutedCall> routed_calls;
+
+    // Driver-side object state
+    struct Dispatchable {
+        void* loader_data;
+    };
+    std::vector<std::unique_ptr<Dispatchable>> objects;
+    VkInstance instance{VK_NULL_HANDLE};
+    VkPhysicalDevice physical_device{VK_NULL_HANDLE};
+    struct Device {
+        VkDevice handle;
+        uint32_t table;  // its dispatch table and entry points, below kMaxMockDevices
+        std::map<std::pair<uint32_t, uint32_t>, VkQueue> queues;
+    };
+    std::vector<Device> devices;  // live ones
+    std::unordered_map<VkCommandPool, uint32_t> command_pool_families;
+    std::unordered_map<VkSemaphore, uint64_t> semaphore_values;
+    std::unordered_map<VkDeviceMemory, size_t> live_allocations;  // index into allocations
+    std::unordered_map<VkDeviceMemory, std::unique_ptr<uint8_t[]>> memory_contents;
+    std::map<std::pair<VkQueryPool, uint32_t>, uint64_t> timestamps;
+    uint64_t next_handle{0x1000};
+    uint64_t gpu_clock{0};
+
+    uint32_t CountCommands(const char* name) const;
+    uint32_t CountCommands(VkCommandBuffer command_buffer, const char* name) const;
+    const MockAllocation* FindAllocation(VkDeviceMemory memory) const;
+    const Device* FindDevice(VkDevice device) const;
+    const Device* FindQueueDevice(VkQueue queue) const;
+};
+
+MockDriver& Mock();
+
+// Back to the default device: a UMA GPU with three queue families
+// (graphics+compute, compute, transfer) and the extensions the layer uses.
+// Only call with no device alive.
+void ResetMock();
+
+// Clears every XCLIPSE_* variable and points the data directory at a fresh
+// temporary one, so tests see defaults and leave nothing behind
+void ResetLayerEnvironment();
+const std::string& TestDataDirectory();
+
+struct LayerDeviceOptions {
+    uint32_t api_version{VK_API_VERSION_1_3};
+    std::vector<const char*> instance_extensions;
+    std::vector<const char*> device_extensions;
+    const void* device_features{nullptr};  // pNext chain of the device create info
+    std::vector<std::pair<uint32_t, uint32_t>> queues{{0, 1}};  // family, count
+};
+
+// An instance and device created through the layer's exported entry points
+struct LayerDevice {
+    VkInstance instance{VK_NULL_HANDLE};
+    VkPhysicalDevice physical_device{VK_NULL_HANDLE};
+    VkDevice device{VK_NULL_HANDLE};
+
+    // The layer's device-level entry point, null if it does not resolve
+    template <typename Proc>
+    Proc Get(const char* name) const {
+        return reinterpret_cast<Proc>(GetProc(name));
+    }
+    PFN_vkVoidFunction GetProc(const char* name) const;
+
+    VkQueue Queue(uint32_t family, uint32_t index = 0) const;
+    VkCommandPool CreateCommandPool(uint32_t family) const;
+    VkCommandBuffer AllocateCommandBuffer(VkCommandPool pool) const;
+    VkSemaphore CreateTimelineSemaphore() const;
+};
+
+bool CreateLayerDevice(LayerDevice& layer, const LayerDeviceOptions& options = {});
+// Another device on first's instance and physical device. second.instance
+// stays null, so destroy second before first.
+bool CreateSecondLayerDevice(const LayerDevice& first, LayerDevice& second,
+                             const LayerDeviceOptions& options = {});
+void DestroyLayerDevice(LayerDevice& layer);
+
+// Made-up handles for objects the layer never creates itself
+template <typename Handle>
+Handle FakeHandle(uint64_t value) {
+    if constexpr (std::is_pointer_v<Handle>) {
+        return reinterpret_cast<Handle>(static_cast<uintptr_t>(value));
+    } else {
+        return static_cast<Handle>(value);
+    }
+}
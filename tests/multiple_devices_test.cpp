@@ -0,0 +1,132 @@
+// multiple_devices_test.cpp - Two devices alive at once, each on its own dispatch table
+
+#include <iterator>
+#include <string>
+
+#include "mock_driver.h"
+#include "pipeline_registry.h"
+#include "test_harness.h"
+#include "xclipse_wrapper.h"
+
+namespace {
+
+void Reset() {
+    ResetMock();
+    ResetLayerEnvironment();
+}
+
+uint32_t TableOf(const LayerDevice& layer) {
+    const MockDriver::Device* device = Mock().FindDevice(layer.device);
+    return device ? device->table : kMaxMockDevices;
+}
+
+// Makes the routed calls through one device: the device itself, one of its
+// queues, one of its command buffers, and an entry point the layer does not
+// intercept
+void CallThrough(const LayerDevice& layer) {
+    VkQueue queue = layer.Queue(0);
+    VkCommandBuffer command_buffer = layer.AllocateCommandBuffer(layer.CreateCommandPool(0));
+
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    layer.Get<PFN_vkBeginCommandBuffer>("vkBeginCommandBuffer")(command_buffer, &begin);
+    layer.Get<PFN_vkCmdDraw>("vkCmdDraw")(command_buffer, 3, 1, 0, 0);
+    layer.Get<PFN_vkEndCommandBuffer>("vkEndCommandBuffer")(command_buffer);
+
+    VkSubmitInfo submit{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &command_buffer;
+    layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit")(queue, 1, &submit, VK_NULL_HANDLE);
+    layer.Get<PFN_vkQueueWaitIdle>("vkQueueWaitIdle")(queue);
+    layer.Get<PFN_vkDeviceWaitIdle>("vkDeviceWaitIdle")(layer.device);
+
+    VkSemaphoreCreateInfo semaphore_info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    layer.Get<PFN_vkCreateSemaphore>("vkCreateSemaphore")(layer.device, &semaphore_info, nullptr, &semaphore);
+}
+
+// Every routed call went through table, and all of them arrived
+bool RoutedThrough(uint32_t table) {
+    const char* expected[] = {"CmdDraw", "QueueSubmit", "QueueWaitIdle", "DeviceWaitIdle", "CreateSemaphore"};
+    const auto& calls = Mock().routed_calls;
+    if (calls.size() != std::size(expected)) return false;
+    for (size_t i = 0; i < calls.size(); ++i) {
+        if (calls[i].table != table || calls[i].name != expected[i]) return false;
+    }
+    return true;
+}
+
+VkPipeline CreatePipeline(const LayerDevice& layer) {
+    VkGraphicsPipelineCreateInfo info{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    info.layout = FakeHandle<VkPipelineLayout>(0x77);
+    info.renderPass = FakeHandle<VkRenderPass>(0x78);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines")(
+        layer.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline);
+    return pipeline;
+}
+
+} // namespace
+
+XCLIPSE_TEST(EachDeviceCallsItsOwnNextLayer) {
+    Reset();
+    LayerDevice first;
+    LayerDevice second;
+    ASSERT_TRUE(CreateLayerDevice(first));
+    ASSERT_TRUE(CreateSecondLayerDevice(first, second));
+    ASSERT_TRUE(TableOf(first) != TableOf(second));
+
+    CallThrough(first);
+    EXPECT_TRUE(RoutedThrough(TableOf(first)));
+
+    Mock().routed_calls.clear();
+    CallThrough(second);
+    EXPECT_TRUE(RoutedThrough(TableOf(second)));
+
+    // State the layer keeps per device stays with its device
+    CreatePipeline(first);
+    CreatePipeline(first);
+    CreatePipeline(second);
+    EXPECT_EQ(xclipse::GetPipelineStats(first.device).created, uint64_t{2});
+    EXPECT_EQ(xclipse::GetPipelineStats(second.device).created, uint64_t{1});
+
+    DestroyLayerDevice(second);
+    DestroyLayerDevice(first);
+}
+
+XCLIPSE_TEST(DestroyingOneDeviceLeavesTheOther) {
+    Reset();
+    LayerDevice first;
+    LayerDevice second;
+    ASSERT_TRUE(CreateLayerDevice(first));
+    ASSERT_TRUE(CreateSecondLayerDevice(first, second));
+    CreatePipeline(first);
+    uint32_t first_table = TableOf(first);
+
+    // Destroy the first device but keep its instance, which the second
+    // one was created on
+    LayerDevice destroyed = first;
+    first.Get<PFN_vkDestroyDevice>("vkDestroyDevice")(first.device, nullptr);
+    first.device = VK_NULL_HANDLE;
+
+    // The layer forgot it: nothing resolves through its handle any more
+    EXPECT_TRUE(destroyed.GetProc("vkCreateSemaphore") == nullptr);
+    EXPECT_EQ(xclipse::GetPipelineStats(destroyed.device).created, uint64_t{0});
+
+    Mock().routed_calls.clear();
+    CallThrough(second);
+    EXPECT_TRUE(RoutedThrough(TableOf(second)));
+    EXPECT_EQ(Mock().submits.size(), size_t{1});
+
+    // A new device takes over the freed dispatch table and starts clean
+    LayerDevice third;
+    ASSERT_TRUE(CreateSecondLayerDevice(first, third));
+    EXPECT_EQ(TableOf(third), first_table);
+    EXPECT_EQ(xclipse::GetPipelineStats(third.device).created, uint64_t{0});
+    Mock().routed_calls.clear();
+    CallThrough(third);
+    EXPECT_TRUE(RoutedThrough(first_table));
+
+    DestroyLayerDevice(third);
+    DestroyLayerDevice(second);
+    DestroyLayerDevice(first);
+}
@@ -0,0 +1,147 @@
+// optimized_paths_test.cpp - The hot entry points reach the layer's own paths
+
+#include <cstdlib>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+void Reset() {
+    ResetMock();
+    ResetLayerEnvironment();
+}
+
+VkGraphicsPipelineCreateInfo GraphicsInfo() {
+    VkGraphicsPipelineCreateInfo info{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    info.layout = FakeHandle<VkPipelineLayout>(0x77);
+    info.renderPass = FakeHandle<VkRenderPass>(0x78);
+    return info;
+}
+
+VkResult Allocate(const LayerDevice& layer, uint32_t memory_type, VkDeviceSize size, VkDeviceMemory* memory) {
+    VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    info.allocationSize = size;
+    info.memoryTypeIndex = memory_type;
+    return layer.Get<PFN_vkAllocateMemory>("vkAllocateMemory")(layer.device, &info, nullptr, memory);
+}
+
+} // namespace
+
+XCLIPSE_TEST(EntryPointsResolveThroughLayer) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    // The layer's own functions, not the mock's
+    EXPECT_NE(layer.GetProc("vkCreateGraphicsPipelines"), nullptr);
+    EXPECT_NE(layer.GetProc("vkAllocateMemory"), nullptr);
+    EXPECT_NE(layer.GetProc("vkQueueSubmit"), nullptr);
+    EXPECT_EQ(layer.GetProc("vkNotAFunction"), nullptr);
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(GraphicsPipelinesGetCacheAndFeedback) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+    VkGraphicsPipelineCreateInfo infos[2] = {GraphicsInfo(), GraphicsInfo()};
+    VkPipeline pipelines[2] = {};
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 2, infos, nullptr, pipelines), VK_SUCCESS);
+
+    ASSERT_TRUE(Mock().pipelines.size() == 2);
+    for (const MockPipeline& pipeline : Mock().pipelines) {
+        // A cache-less app compiles through the layer's persistent cache
+        EXPECT_NE(pipeline.cache, VK_NULL_HANDLE);
+        EXPECT_TRUE(pipeline.feedback_chained);
+    }
+    EXPECT_EQ(pipelines[0], Mock().pipelines[0].handle);
+    EXPECT_EQ(pipelines[1], Mock().pipelines[1].handle);
+
+    // An app-managed cache is passed through untouched
+    VkPipelineCache app_cache = FakeHandle<VkPipelineCache>(0xcace);
+    EXPECT_EQ(create(layer.device, app_cache, 1, infos, nullptr, pipelines), VK_SUCCESS);
+    EXPECT_EQ(Mock().pipelines.back().cache, app_cache);
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(AllocationsAreRoundedToCacheLines) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    EXPECT_EQ(Allocate(layer, 0, 1000, &memory), VK_SUCCESS);
+    const MockAllocation* allocation = Mock().FindAllocation(memory);
+    ASSERT_TRUE(allocation != nullptr);
+    EXPECT_EQ(allocation->size, VkDeviceSize{1024});
+
+    layer.Get<PFN_vkFreeMemory>("vkFreeMemory")(layer.device, memory, nullptr);
+    EXPECT_EQ(Mock().FindAllocation(memory), nullptr);
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(SmallAllocationsAreSuballocated) {
+    Reset();
+    setenv("XCLIPSE_SUBALLOCATE_MEMORY", "1", 1);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    VkDeviceMemory memory[16] = {};
+    for (VkDeviceMemory& handle : memory) {
+        EXPECT_EQ(Allocate(layer, 1, 4096, &handle), VK_SUCCESS);
+    }
+    // One shared block, none of the app's handles
+    EXPECT_EQ(Mock().allocations.size(), size_t{1});
+    for (VkDeviceMemory handle : memory) {
+        EXPECT_EQ(Mock().FindAllocation(handle), nullptr);
+    }
+
+    auto free_memory = layer.Get<PFN_vkFreeMemory>("vkFreeMemory");
+    for (VkDeviceMemory handle : memory) {
+        free_memory(layer.device, handle, nullptr);
+    }
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(FencelessSubmitsAreBatched) {
+    Reset();
+    setenv("XCLIPSE_BATCH_SUBMITS", "1", 1);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    VkQueue queue = layer.Queue(0);
+    auto submit = layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit");
+    VkSubmitInfo info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(submit(queue, 1, &info, VK_NULL_HANDLE), VK_SUCCESS);
+    }
+    EXPECT_EQ(Mock().submit_calls, 0u);
+
+    // The fenced submit carries the held ones with it
+    VkFence fence = FakeHandle<VkFence>(0xfe);
+    EXPECT_EQ(submit(queue, 1, &info, fence), VK_SUCCESS);
+    EXPECT_EQ(Mock().submit_calls, 1u);
+    EXPECT_EQ(Mock().submits.size(), size_t{5});
+    EXPECT_EQ(Mock().submits.back().fence, fence);
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(SubmitsPassThroughByDefault) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    VkQueue queue = layer.Queue(0);
+    VkSubmitInfo info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    EXPECT_EQ(layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit")(queue, 1, &info, VK_NULL_HANDLE), VK_SUCCESS);
+    EXPECT_EQ(Mock().submit_calls, 1u);
+
+    DestroyLayerDevice(layer);
+}
@@ -0,0 +1,237 @@
+// parallel_pipelines_test.cpp - Batched pipeline creation fanned out over the compile pool
+
+#include <cstdlib>
+#include <vector>
+
+#include "mock_driver.h"
+#include "pipeline_registry.h"
+#include "test_harness.h"
+#include "xclipse_wrapper.h"
+
+namespace {
+
+void Reset(bool parallel) {
+    ResetMock();
+    ResetLayerEnvironment();
+    if (parallel) {
+        setenv("XCLIPSE_PARALLEL_PIPELINES", "1", 1);
+    }
+}
+
+// Each element gets its own layout, which is how the mock tells the
+// elements of a batch apart once they are compiled out of order
+VkPipelineLayout Layout(uint32_t index) {
+    return FakeHandle<VkPipelineLayout>(0x7700 + index);
+}
+
+std::vector<VkGraphicsPipelineCreateInfo> GraphicsInfos(uint32_t count) {
+    std::vector<VkGraphicsPipelineCreateInfo> infos(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        infos[i] = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+        infos[i].layout = Layout(i);
+        infos[i].renderPass = FakeHandle<VkRenderPass>(0x78);
+        infos[i].basePipelineIndex = -1;
+    }
+    return infos;
+}
+
+std::vector<VkComputePipelineCreateInfo> ComputeInfos(uint32_t count) {
+    std::vector<VkComputePipelineCreateInfo> infos(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        infos[i] = {VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+        infos[i].stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+        infos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        infos[i].stage.module = FakeHandle<VkShaderModule>(0x5a);
+        infos[i].stage.pName = "main";
+        infos[i].layout = Layout(i);
+        infos[i].basePipelineIndex = -1;
+    }
+    return infos;
+}
+
+const MockPipeline* FindMockPipeline(VkPipeline handle) {
+    for (const MockPipeline& pipeline : Mock().pipelines) {
+        if (pipeline.handle == handle) return &pipeline;
+    }
+    return nullptr;
+}
+
+// Every driver call created exactly one pipeline
+bool AllFannedOut() {
+    for (const MockPipeline& pipeline : Mock().pipelines) {
+        if (pipeline.batch != 1) return false;
+    }
+    return !Mock().pipelines.empty();
+}
+
+// One driver call created the whole batch
+bool OneDriverCall(uint32_t count) {
+    for (const MockPipeline& pipeline : Mock().pipelines) {
+        if (pipeline.batch != count) return false;
+    }
+    return !Mock().pipelines.empty();
+}
+
+// pipelines[i] is the driver's pipeline for element i, or null where the
+// driver was told to fail element i
+bool SlotsMatch(const VkPipeline* pipelines, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i) {
+        bool fails = Mock().pipeline_results.count(Layout(i)) != 0;
+        if (fails) {
+            if (pipelines[i] != VK_NULL_HANDLE) return false;
+            continue;
+        }
+        const MockPipeline* pipeline = FindMockPipeline(pipelines[i]);
+        if (!pipeline || pipeline->layout != Layout(i)) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+XCLIPSE_TEST(BatchesAreCompiledOnePipelinePerDriverCall) {
+    Reset(true);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    auto infos = GraphicsInfos(6);
+    VkPipeline pipelines[6] = {};
+    auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 6, infos.data(), nullptr, pipelines), VK_SUCCESS);
+
+    EXPECT_EQ(Mock().pipelines.size(), size_t{6});
+    EXPECT_TRUE(AllFannedOut());
+    EXPECT_TRUE(SlotsMatch(pipelines, 6));
+    EXPECT_EQ(xclipse::GetPipelineStats(layer.device).created, uint64_t{6});
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(FailedElementsAreNullAndTheFirstErrorWins) {
+    for (bool parallel : {true, false}) {
+        Reset(parallel);
+        LayerDevice layer;
+        ASSERT_TRUE(CreateLayerDevice(layer));
+        Mock().pipeline_results[Layout(1)] = VK_PIPELINE_COMPILE_REQUIRED;
+        Mock().pipeline_results[Layout(2)] = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        Mock().pipeline_results[Layout(4)] = VK_ERROR_OUT_OF_HOST_MEMORY;
+
+        auto graphics = GraphicsInfos(5);
+        VkPipeline pipelines[5] = {};
+        auto create_graphics = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+        EXPECT_EQ(create_graphics(layer.device, VK_NULL_HANDLE, 5, graphics.data(), nullptr, pipelines),
+                  VK_ERROR_OUT_OF_DEVICE_MEMORY);
+        EXPECT_TRUE(parallel ? AllFannedOut() : OneDriverCall(5));
+        EXPECT_TRUE(SlotsMatch(pipelines, 5));
+
+        Mock().pipelines.clear();
+        auto compute = ComputeInfos(5);
+        auto create_compute = layer.Get<PFN_vkCreateComputePipelines>("vkCreateComputePipelines");
+        EXPECT_EQ(create_compute(layer.device, VK_NULL_HANDLE, 5, compute.data(), nullptr, pipelines),
+                  VK_ERROR_OUT_OF_DEVICE_MEMORY);
+        EXPECT_TRUE(parallel ? AllFannedOut() : OneDriverCall(5));
+        EXPECT_TRUE(SlotsMatch(pipelines, 5));
+
+        // Only the elements that succeeded are registered
+        PipelineRegistryStats stats = xclipse::GetPipelineStats(layer.device);
+        EXPECT_EQ(stats.created, uint64_t{4});
+        EXPECT_EQ(stats.live, uint64_t{4});
+
+        DestroyLayerDevice(layer);
+    }
+}
+
+XCLIPSE_TEST(CompileRequiredIsReturnedWithoutErrors) {
+    for (bool parallel : {true, false}) {
+        Reset(parallel);
+        LayerDevice layer;
+        ASSERT_TRUE(CreateLayerDevice(layer));
+        Mock().pipeline_results[Layout(0)] = VK_PIPELINE_COMPILE_REQUIRED;
+        Mock().pipeline_results[Layout(3)] = VK_PIPELINE_COMPILE_REQUIRED;
+
+        auto infos = GraphicsInfos(4);
+        for (VkGraphicsPipelineCreateInfo& info : infos) {
+            info.flags = VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT;
+        }
+        VkPipeline pipelines[4] = {};
+        auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+        EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 4, infos.data(), nullptr, pipelines),
+                  VK_PIPELINE_COMPILE_REQUIRED);
+        EXPECT_TRUE(parallel ? AllFannedOut() : OneDriverCall(4));
+        EXPECT_TRUE(SlotsMatch(pipelines, 4));
+        EXPECT_EQ(xclipse::GetPipelineStats(layer.device).created, uint64_t{2});
+
+        DestroyLayerDevice(layer);
+    }
+}
+
+XCLIPSE_TEST(SerialOnlyBatchesBypassThePool) {
+    Reset(true);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+    VkPipeline pipelines[3] = {};
+
+    // A derivative of an earlier element of the same batch
+    auto infos = GraphicsInfos(3);
+    infos[0].flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+    infos[2].flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+    infos[2].basePipelineIndex = 0;
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 3, infos.data(), nullptr, pipelines), VK_SUCCESS);
+    EXPECT_TRUE(OneDriverCall(3));
+
+    // Early return: elements after a failure must not be compiled
+    Mock().pipelines.clear();
+    Mock().pipeline_results[Layout(1)] = VK_PIPELINE_COMPILE_REQUIRED;
+    infos = GraphicsInfos(3);
+    for (VkGraphicsPipelineCreateInfo& info : infos) {
+        info.flags = VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT |
+                     VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT;
+    }
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 3, infos.data(), nullptr, pipelines),
+              VK_PIPELINE_COMPILE_REQUIRED);
+    EXPECT_TRUE(OneDriverCall(3));
+    EXPECT_EQ(Mock().pipelines.size(), size_t{1});
+    EXPECT_NE(pipelines[0], VK_NULL_HANDLE);
+    EXPECT_EQ(pipelines[1], VK_NULL_HANDLE);
+    EXPECT_EQ(pipelines[2], VK_NULL_HANDLE);
+    Mock().pipeline_results.clear();
+
+    // App allocation callbacks, which need not be thread-safe
+    Mock().pipelines.clear();
+    infos = GraphicsInfos(3);
+    VkAllocationCallbacks allocator{};
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 3, infos.data(), &allocator, pipelines), VK_SUCCESS);
+    EXPECT_TRUE(OneDriverCall(3));
+
+    // An app-owned cache, which may be externally synchronized
+    Mock().pipelines.clear();
+    VkPipelineCache app_cache = FakeHandle<VkPipelineCache>(0xcace);
+    EXPECT_EQ(create(layer.device, app_cache, 3, infos.data(), nullptr, pipelines), VK_SUCCESS);
+    EXPECT_TRUE(OneDriverCall(3));
+
+    // A derivative of an existing pipeline has no ordering to keep
+    Mock().pipelines.clear();
+    infos[1].flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+    infos[1].basePipelineHandle = pipelines[0];
+    infos[1].basePipelineIndex = -1;
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 3, infos.data(), nullptr, pipelines), VK_SUCCESS);
+    EXPECT_TRUE(AllFannedOut());
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(BatchesStaySerialByDefault) {
+    Reset(false);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    auto infos = ComputeInfos(4);
+    VkPipeline pipelines[4] = {};
+    auto create = layer.Get<PFN_vkCreateComputePipelines>("vkCreateComputePipelines");
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 4, infos.data(), nullptr, pipelines), VK_SUCCESS);
+    EXPECT_TRUE(OneDriverCall(4));
+    EXPECT_TRUE(SlotsMatch(pipelines, 4));
+
+    DestroyLayerDevice(layer);
+}
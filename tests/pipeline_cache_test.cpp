@@ -0,0 +1,103 @@
+// pipeline_cache_test.cpp - The persistent pipeline cache is kept per device
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+std::vector<std::string> DataFiles() {
+    std::vector<std::string> files;
+    if (DIR* dir = opendir(TestDataDirectory().c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') files.emplace_back(entry->d_name);
+        }
+        closedir(dir);
+    }
+    return files;
+}
+
+void Reset() {
+    ResetMock();
+    ResetLayerEnvironment();
+    for (const std::string& file : DataFiles()) {
+        unlink((TestDataDirectory() + "/" + file).c_str());
+    }
+}
+
+// Compiles one pipeline through the layer's cache and tears the device
+// down, which saves the cache
+void RunOnce() {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    VkGraphicsPipelineCreateInfo info{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines")(
+        layer.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline);
+    DestroyLayerDevice(layer);
+}
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+XCLIPSE_TEST(CacheFileIsNamedAfterTheDevice) {
+    Reset();
+    RunOnce();
+
+    std::vector<std::string> files = DataFiles();
+    bool found = false;
+    for (const std::string& file : files) {
+        found |= EndsWith(file, ".144d-0940-0102030405060708090a0b0c0d0e0f10.xcpc");
+        // Every temporary was renamed into place
+        EXPECT_FALSE(file.find(".xcpc.") != std::string::npos);
+    }
+    EXPECT_TRUE(found);
+}
+
+XCLIPSE_TEST(CacheIsReloadedOnTheSameDevice) {
+    Reset();
+    RunOnce();
+    RunOnce();
+    EXPECT_EQ(Mock().pipeline_cache_initial_size, Mock().pipeline_cache_data.size());
+}
+
+XCLIPSE_TEST(OtherDevicesKeepTheirOwnCache) {
+    Reset();
+    RunOnce();
+
+    // A different GPU in the same process starts empty and gets its own file
+    ResetMock();
+    Mock().properties.deviceID = 0x0941;
+    Mock().pipeline_cache_data.assign(512, 0xcd);
+    RunOnce();
+    EXPECT_EQ(Mock().pipeline_cache_initial_size, size_t{0});
+
+    uint32_t caches = 0;
+    for (const std::string& file : DataFiles()) {
+        caches += EndsWith(file, ".xcpc");
+    }
+    EXPECT_EQ(caches, 2u);
+
+    // ...and did not overwrite the first device's cache
+    ResetMock();
+    RunOnce();
+    EXPECT_EQ(Mock().pipeline_cache_initial_size, Mock().pipeline_cache_data.size());
+}
+
+XCLIPSE_TEST(NewDriverBuildDiscardsTheCache) {
+    Reset();
+    RunOnce();
+
+    ResetMock();
+    Mock().properties.pipelineCacheUUID[0] = 0xff;
+    RunOnce();
+    EXPECT_EQ(Mock().pipeline_cache_initial_size, size_t{0});
+}
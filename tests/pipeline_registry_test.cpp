@@ -0,0 +1,139 @@
+// pipeline_registry_test.cpp - Pipeline lifecycle counts through the layer's entry points
+
+#include "mock_driver.h"
+#include "pipeline_registry.h"
+#include "test_harness.h"
+#include "xclipse_wrapper.h"
+
+namespace {
+
+void Reset() {
+    ResetMock();
+    ResetLayerEnvironment();
+}
+
+VkGraphicsPipelineCreateInfo GraphicsInfo() {
+    VkGraphicsPipelineCreateInfo info{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+    info.layout = FakeHandle<VkPipelineLayout>(0x77);
+    info.renderPass = FakeHandle<VkRenderPass>(0x78);
+    return info;
+}
+
+VkComputePipelineCreateInfo ComputeInfo() {
+    VkComputePipelineCreateInfo info{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    info.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = FakeHandle<VkShaderModule>(0x5a);
+    info.stage.pName = "main";
+    info.layout = FakeHandle<VkPipelineLayout>(0x77);
+    return info;
+}
+
+} // namespace
+
+XCLIPSE_TEST(CreatedAndDestroyedPipelinesAreCounted) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    auto create_graphics = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+    auto create_compute = layer.Get<PFN_vkCreateComputePipelines>("vkCreateComputePipelines");
+    auto destroy = layer.Get<PFN_vkDestroyPipeline>("vkDestroyPipeline");
+
+    VkGraphicsPipelineCreateInfo graphics[3] = {GraphicsInfo(), GraphicsInfo(), GraphicsInfo()};
+    VkComputePipelineCreateInfo compute[2] = {ComputeInfo(), ComputeInfo()};
+    VkPipeline pipelines[5] = {};
+    EXPECT_EQ(create_graphics(layer.device, VK_NULL_HANDLE, 3, graphics, nullptr, pipelines), VK_SUCCESS);
+    EXPECT_EQ(create_compute(layer.device, VK_NULL_HANDLE, 2, compute, nullptr, pipelines + 3), VK_SUCCESS);
+
+    PipelineRegistryStats stats = xclipse::GetPipelineStats(layer.device);
+    EXPECT_EQ(stats.created, uint64_t{5});
+    EXPECT_EQ(stats.live, uint64_t{5});
+    EXPECT_EQ(stats.destroyed, uint64_t{0});
+    EXPECT_EQ(stats.replaced, uint64_t{0});
+
+    destroy(layer.device, pipelines[1], nullptr);
+    destroy(layer.device, pipelines[3], nullptr);
+    // Destroying null is valid and does not count
+    destroy(layer.device, VK_NULL_HANDLE, nullptr);
+
+    stats = xclipse::GetPipelineStats(layer.device);
+    EXPECT_EQ(stats.created, uint64_t{5});
+    EXPECT_EQ(stats.live, uint64_t{3});
+    EXPECT_EQ(stats.destroyed, uint64_t{2});
+    // Every destroy still reaches the driver
+    ASSERT_TRUE(Mock().destroyed_pipelines.size() == 3);
+    EXPECT_EQ(Mock().destroyed_pipelines[0], pipelines[1]);
+    EXPECT_EQ(Mock().destroyed_pipelines[1], pipelines[3]);
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(UnknownHandlesAreNotCountedAsDestroyed) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+    auto destroy = layer.Get<PFN_vkDestroyPipeline>("vkDestroyPipeline");
+
+    VkGraphicsPipelineCreateInfo info = GraphicsInfo();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline), VK_SUCCESS);
+    destroy(layer.device, pipeline, nullptr);
+    // A second destroy of the same handle is the app's bug, not a pipeline
+    destroy(layer.device, pipeline, nullptr);
+
+    PipelineRegistryStats stats = xclipse::GetPipelineStats(layer.device);
+    EXPECT_EQ(stats.created, uint64_t{1});
+    EXPECT_EQ(stats.destroyed, uint64_t{1});
+    EXPECT_EQ(stats.live, uint64_t{0});
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(RecycledHandlesAreCountedAsReplaced) {
+    Reset();
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    auto create = layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines");
+
+    VkGraphicsPipelineCreateInfo info = GraphicsInfo();
+    VkPipeline first = VK_NULL_HANDLE;
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 1, &info, nullptr, &first), VK_SUCCESS);
+
+    // The driver hands the same handle out again without a destroy the
+    // layer saw
+    Mock().recycled_pipelines.push_back(first);
+    VkPipeline second = VK_NULL_HANDLE;
+    EXPECT_EQ(create(layer.device, VK_NULL_HANDLE, 1, &info, nullptr, &second), VK_SUCCESS);
+    EXPECT_EQ(second, first);
+
+    PipelineRegistryStats stats = xclipse::GetPipelineStats(layer.device);
+    EXPECT_EQ(stats.created, uint64_t{2});
+    EXPECT_EQ(stats.replaced, uint64_t{1});
+    EXPECT_EQ(stats.live, uint64_t{1});
+
+    DestroyLayerDevice(layer);
+}
+
+XCLIPSE_TEST(RegistryGrowsAndShrinksUnderChurn) {
+    PipelineRegistry registry;
+    // Sequential driver ids, as some drivers hand out
+    for (uint64_t i = 1; i <= 5000; ++i) {
+        registry.Insert(FakeHandle<VkPipeline>(i));
+    }
+    for (uint64_t i = 1; i <= 5000; i += 2) {
+        EXPECT_TRUE(registry.Erase(FakeHandle<VkPipeline>(i)));
+    }
+    // Backward-shift deletion must keep the survivors reachable
+    bool survivors_found = true;
+    for (uint64_t i = 2; i <= 5000; i += 2) {
+        survivors_found &= registry.Erase(FakeHandle<VkPipeline>(i));
+    }
+    EXPECT_TRUE(survivors_found);
+    EXPECT_FALSE(registry.Erase(FakeHandle<VkPipeline>(2)));
+
+    PipelineRegistryStats stats = registry.Stats();
+    EXPECT_EQ(stats.created, uint64_t{5000});
+    EXPECT_EQ(stats.destroyed, uint64_t{5000});
+    EXPECT_EQ(stats.live, uint64_t{0});
+}
@@ -0,0 +1,236 @@
+// pipeline_rules_test.cpp - Profile pipeline rules: parsing, matching and rewriting create infos
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "mock_driver.h"
+#include "pipeline_rules.h"
+#include "scratch_arena.h"
+#include "test_harness.h"
+
+namespace {
+
+PipelineRule Rule(const char* text) {
+    PipelineRule rule;
+    EXPECT_TRUE(ParsePipelineRule(text, rule));
+    return rule;
+}
+
+PipelineRules Rules(std::initializer_list<const char*> texts) {
+    std::vector<PipelineRule> rules;
+    for (const char* text : texts) {
+        rules.push_back(Rule(text));
+    }
+    return PipelineRules(std::move(rules), false);
+}
+
+// A graphics pipeline whose state structs the test can inspect afterwards
+struct Pipeline {
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    VkPipelineRasterizationStateCreateInfo rasterization{
+        VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+    VkPipelineMultisampleStateCreateInfo multisample{
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+    VkGraphicsPipelineCreateInfo info{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+
+    Pipeline(VkCullModeFlags cull_mode, VkSampleCountFlagBits samples) {
+        stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        rasterization.cullMode = cull_mode;
+        multisample.rasterizationSamples = samples;
+        info.stageCount = 2;
+        info.pStages = stages;
+        info.pRasterizationState = &rasterization;
+        info.pMultisampleState = &multisample;
+    }
+};
+
+std::string WriteProfile(const std::string& text) {
+    std::string path = TestDataDirectory() + "/pipeline_rules.conf";
+    if (FILE* file = std::fopen(path.c_str(), "w")) {
+        std::fwrite(text.data(), 1, text.size(), file);
+        std::fclose(file);
+    }
+    return path;
+}
+
+} // namespace
+
+XCLIPSE_TEST(ParsesCriteriaAndOverrides) {
+    PipelineRule rule = Rule("fingerprint=9C41e07a5d3b2f18 cull=none samples=8 -> samples=4 depth_bias=0");
+    EXPECT_EQ(rule.match_fields, uint32_t{PipelineRule::kFingerprint | PipelineRule::kCullMode |
+                                          PipelineRule::kSamples});
+    EXPECT_EQ(rule.match.fingerprint, 0x9c41e07a5d3b2f18ull);
+    EXPECT_EQ(rule.match.cull_mode, VkCullModeFlags{VK_CULL_MODE_NONE});
+    EXPECT_EQ(rule.match.samples, VK_SAMPLE_COUNT_8_BIT);
+    EXPECT_EQ(rule.override_fields, uint32_t{PipelineRule::kSamples | PipelineRule::kDepthBias});
+    EXPECT_EQ(rule.overrides.samples, VK_SAMPLE_COUNT_4_BIT);
+
+    // No criteria matches everything
+    rule = Rule("-> cull=both subgroup_size=32");
+    EXPECT_EQ(rule.match_fields, 0u);
+    EXPECT_EQ(rule.overrides.cull_mode, VkCullModeFlags{VK_CULL_MODE_FRONT_AND_BACK});
+    EXPECT_EQ(rule.overrides.subgroup_size, 32u);
+
+    rule = Rule("shader=0b5c840bec9e6d6c726ca7d7d69feb86 -> subgroup_size=0");
+    EXPECT_EQ(rule.match_fields, uint32_t{PipelineRule::kShader});
+    EXPECT_EQ(rule.match.shader.high, 0x0b5c840bec9e6d6cull);
+    EXPECT_EQ(rule.match.shader.low, 0x726ca7d7d69feb86ull);
+}
+
+XCLIPSE_TEST(RejectsMalformedRules) {
+    PipelineRule rule;
+    EXPECT_FALSE(ParsePipelineRule("cull=none", rule));               // no arrow
+    EXPECT_FALSE(ParsePipelineRule("cull=none ->", rule));            // no override
+    EXPECT_FALSE(ParsePipelineRule("-> samples=3", rule));
+    EXPECT_FALSE(ParsePipelineRule("-> cull=sideways", rule));
+    EXPECT_FALSE(ParsePipelineRule("-> fingerprint=1", rule));        // criteria only
+    EXPECT_FALSE(ParsePipelineRule("depth_clamp=1 -> cull=none", rule));  // overrides only
+    EXPECT_FALSE(ParsePipelineRule("fingerprint=12345678123456789 -> cull=none", rule));
+    EXPECT_FALSE(ParsePipelineRule("shader=0b5c -> cull=none", rule));
+    EXPECT_FALSE(ParsePipelineRule("-> subgroup_size=48", rule));
+    EXPECT_FALSE(ParsePipelineRule("-> cull", rule));
+}
+
+XCLIPSE_TEST(FingerprintIgnoresHandlesAndDynamicStateOrder) {
+    Pipeline a(VK_CULL_MODE_BACK_BIT, VK_SAMPLE_COUNT_1_BIT);
+    Pipeline b(VK_CULL_MODE_BACK_BIT, VK_SAMPLE_COUNT_1_BIT);
+    a.stages[0].module = FakeHandle<VkShaderModule>(0x100);
+    b.stages[0].module = FakeHandle<VkShaderModule>(0x200);
+    a.info.layout = FakeHandle<VkPipelineLayout>(0x300);
+
+    VkDynamicState forward[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkDynamicState backward[] = {VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_VIEWPORT};
+    VkPipelineDynamicStateCreateInfo dynamic_a{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+    dynamic_a.dynamicStateCount = 2;
+    dynamic_a.pDynamicStates = forward;
+    VkPipelineDynamicStateCreateInfo dynamic_b = dynamic_a;
+    dynamic_b.pDynamicStates = backward;
+    a.info.pDynamicState = &dynamic_a;
+    b.info.pDynamicState = &dynamic_b;
+    EXPECT_EQ(PipelineFingerprint(a.info), PipelineFingerprint(b.info));
+
+    b.rasterization.cullMode = VK_CULL_MODE_NONE;
+    EXPECT_NE(PipelineFingerprint(a.info), PipelineFingerprint(b.info));
+
+    // Multisample state is not read with rasterizer discard on
+    Pipeline c(VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_1_BIT);
+    Pipeline d(VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_4_BIT);
+    c.rasterization.rasterizerDiscardEnable = VK_TRUE;
+    d.rasterization.rasterizerDiscardEnable = VK_TRUE;
+    EXPECT_EQ(PipelineFingerprint(c.info), PipelineFingerprint(d.info));
+}
+
+XCLIPSE_TEST(OverridesGoIntoCopiesNotTheAppsStructs) {
+    PipelineRules rules = Rules({"cull=none samples=8 -> samples=4 cull=back depth_clamp=1"});
+    Pipeline pipeline(VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_8_BIT);
+    ScratchArena::Scope scope;
+    VkGraphicsPipelineCreateInfo info = pipeline.info;
+    rules.Apply(info, nullptr, 0, 0, scope.arena());
+
+    EXPECT_NE(info.pRasterizationState, &pipeline.rasterization);
+    EXPECT_NE(info.pMultisampleState, &pipeline.multisample);
+    EXPECT_EQ(info.pRasterizationState->cullMode, VkCullModeFlags{VK_CULL_MODE_BACK_BIT});
+    EXPECT_EQ(info.pRasterizationState->depthClampEnable, VkBool32{VK_TRUE});
+    EXPECT_EQ(info.pMultisampleState->rasterizationSamples, VK_SAMPLE_COUNT_4_BIT);
+    EXPECT_EQ(pipeline.rasterization.cullMode, VkCullModeFlags{VK_CULL_MODE_NONE});
+    EXPECT_EQ(pipeline.multisample.rasterizationSamples, VK_SAMPLE_COUNT_8_BIT);
+}
+
+XCLIPSE_TEST(UnmatchedPipelinesAreLeftAlone) {
+    PipelineRules rules = Rules({"cull=front -> cull=none", "samples=2 -> samples=1"});
+    Pipeline pipeline(VK_CULL_MODE_BACK_BIT, VK_SAMPLE_COUNT_4_BIT);
+    ScratchArena::Scope scope;
+    VkGraphicsPipelineCreateInfo info = pipeline.info;
+    EXPECT_EQ(rules.Apply(info, nullptr, 0, 16, scope.arena()), 16u);
+    EXPECT_EQ(info.pRasterizationState, &pipeline.rasterization);
+    EXPECT_EQ(info.pMultisampleState, &pipeline.multisample);
+}
+
+XCLIPSE_TEST(LaterRulesWinAndCriteriaSeeTheAppsState) {
+    // The second rule matches cull=none even though the first changed it
+    PipelineRules rules = Rules({"-> cull=back subgroup_size=64", "cull=none -> cull=front"});
+    Pipeline pipeline(VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_1_BIT);
+    ScratchArena::Scope scope;
+    VkGraphicsPipelineCreateInfo info = pipeline.info;
+    EXPECT_EQ(rules.Apply(info, nullptr, 0, 0, scope.arena()), 64u);
+    EXPECT_EQ(info.pRasterizationState->cullMode, VkCullModeFlags{VK_CULL_MODE_FRONT_BIT});
+}
+
+XCLIPSE_TEST(CriteriaOnMissingStateNeverMatch) {
+    PipelineRules rules = Rules({"samples=1 -> cull=none", "cull=none -> samples=4"});
+    Pipeline pipeline(VK_CULL_MODE_BACK_BIT, VK_SAMPLE_COUNT_1_BIT);
+    // Rasterizer discard: the multisample state is not there to match
+    pipeline.rasterization.rasterizerDiscardEnable = VK_TRUE;
+    ScratchArena::Scope scope;
+    VkGraphicsPipelineCreateInfo info = pipeline.info;
+    rules.Apply(info, nullptr, 0, 0, scope.arena());
+    EXPECT_EQ(info.pRasterizationState, &pipeline.rasterization);
+
+    // No rasterization state: nothing to match or override it with
+    Pipeline mesh(VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_1_BIT);
+    mesh.info.pRasterizationState = nullptr;
+    info = mesh.info;
+    rules.Apply(info, nullptr, 0, 0, scope.arena());
+    EXPECT_TRUE(info.pRasterizationState == nullptr);
+    EXPECT_EQ(info.pMultisampleState, &mesh.multisample);
+}
+
+XCLIPSE_TEST(FingerprintAndShaderCriteria) {
+    Pipeline pipeline(VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_1_BIT);
+    char rule[96];
+    std::snprintf(rule, sizeof(rule), "fingerprint=%016llx -> cull=back",
+                  static_cast<unsigned long long>(PipelineFingerprint(pipeline.info)));
+    ShaderHash fragment{0x0b5c840bec9e6d6cull, 0x726ca7d7d69feb86ull};
+    PipelineRules rules = Rules({rule, "shader=0b5c840bec9e6d6c726ca7d7d69feb86 -> samples=2"});
+
+    ShaderHash shaders[2] = {ShaderHash{1, 2}, fragment};
+    ScratchArena::Scope scope;
+    VkGraphicsPipelineCreateInfo info = pipeline.info;
+    rules.Apply(info, shaders, 2, 0, scope.arena());
+    EXPECT_EQ(info.pRasterizationState->cullMode, VkCullModeFlags{VK_CULL_MODE_BACK_BIT});
+    EXPECT_EQ(info.pMultisampleState->rasterizationSamples, VK_SAMPLE_COUNT_2_BIT);
+
+    // Without the fragment shader only the fingerprint rule applies
+    info = pipeline.info;
+    rules.Apply(info, shaders, 1, 0, scope.arena());
+    EXPECT_EQ(info.pMultisampleState, &pipeline.multisample);
+}
+
+XCLIPSE_TEST(ComputePipelinesOnlyMatchOnShaders) {
+    PipelineRules rules = Rules({"shader=0b5c840bec9e6d6c726ca7d7d69feb86 -> subgroup_size=32",
+                                 "cull=none -> subgroup_size=128"});
+    EXPECT_EQ(rules.ApplyCompute(ShaderHash{0x0b5c840bec9e6d6cull, 0x726ca7d7d69feb86ull}, 64), 32u);
+    EXPECT_EQ(rules.ApplyCompute(ShaderHash{3, 4}, 64), 64u);
+    // An unknown shader never matches a shader criterion, even one of zero
+    PipelineRules zero = Rules({"shader=00000000000000000000000000000000 -> subgroup_size=8"});
+    EXPECT_EQ(zero.ApplyCompute(ShaderHash{}, 0), 0u);
+}
+
+XCLIPSE_TEST(ProfileRulesReachTheDriver) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_PROFILE", WriteProfile("pipeline = cull=none samples=8 -> cull=back samples=4\n").c_str(), 1);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+
+    Pipeline pipelines[2] = {{VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_8_BIT},
+                             {VK_CULL_MODE_NONE, VK_SAMPLE_COUNT_1_BIT}};
+    VkGraphicsPipelineCreateInfo infos[2] = {pipelines[0].info, pipelines[1].info};
+    VkPipeline handles[2] = {};
+    EXPECT_EQ(layer.Get<PFN_vkCreateGraphicsPipelines>("vkCreateGraphicsPipelines")(
+                  layer.device, VK_NULL_HANDLE, 2, infos, nullptr, handles),
+              VK_SUCCESS);
+
+    ASSERT_TRUE(Mock().pipelines.size() == 2);
+    EXPECT_EQ(Mock().pipelines[0].cull_mode, VkCullModeFlags{VK_CULL_MODE_BACK_BIT});
+    EXPECT_EQ(Mock().pipelines[0].samples, VK_SAMPLE_COUNT_4_BIT);
+    EXPECT_EQ(Mock().pipelines[1].cull_mode, VkCullModeFlags{VK_CULL_MODE_NONE});
+    EXPECT_EQ(Mock().pipelines[1].samples, VK_SAMPLE_COUNT_1_BIT);
+    // The app's create infos are untouched
+    EXPECT_EQ(infos[0].pRasterizationState, &pipelines[0].rasterization);
+    EXPECT_EQ(pipelines[0].multisample.rasterizationSamples, VK_SAMPLE_COUNT_8_BIT);
+    DestroyLayerDevice(layer);
+}
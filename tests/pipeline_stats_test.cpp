@@ -0,0 +1,111 @@
+// pipeline_stats_test.cpp - Compile latency histograms and the background report
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "mock_driver.h"
+#include "pipeline_stats.h"
+#include "test_harness.h"
+
+namespace {
+
+constexpr uint64_t kTestIntervalNs = 5 * 1000 * 1000;
+
+std::string ReadFile(const std::string& path) {
+    std::string contents;
+    if (FILE* file = std::fopen(path.c_str(), "r")) {
+        char buffer[512];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            contents.append(buffer, n);
+        }
+        std::fclose(file);
+    }
+    return contents;
+}
+
+// Polls for what the background thread writes, for up to two seconds
+std::string WaitForFile(const std::string& path) {
+    for (int i = 0; i < 200; ++i) {
+        std::string contents = ReadFile(path);
+        if (!contents.empty()) return contents;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return {};
+}
+
+std::string StatsPath(const char* name) {
+    std::string path = TestDataDirectory() + "/" + name;
+    unlink(path.c_str());
+    return path;
+}
+
+} // namespace
+
+XCLIPSE_TEST(PercentilesComeFromBuckets) {
+    LatencyHistogram histogram;
+    for (uint64_t micros = 1; micros <= 100; ++micros) {
+        histogram.Record(micros * 1000);
+    }
+    LatencySnapshot snapshot = histogram.Snapshot();
+    EXPECT_EQ(snapshot.count, 100u);
+    EXPECT_EQ(snapshot.max_ns, 100'000u);
+    // Bucket edges are at most 25% above the true value
+    EXPECT_GE(snapshot.PercentileMicros(0.5), 50u);
+    EXPECT_LE(snapshot.PercentileMicros(0.5), 63u);
+    EXPECT_EQ(snapshot.PercentileMicros(1.0), 100u);
+}
+
+XCLIPSE_TEST(RecordDoesNotWriteTheReport) {
+    std::string path = StatsPath("record.txt");
+    {
+        // An interval the test never reaches: only Dump() may write
+        PipelineCompileStats stats(path);
+        stats.Record(VK_PIPELINE_BIND_POINT_GRAPHICS, CacheOutcome::kMiss, 2'000'000);
+        EXPECT_TRUE(ReadFile(path).empty());
+        stats.Dump();
+    }
+    EXPECT_NE(ReadFile(path).find("graphics cache-miss: n=1"), std::string::npos);
+}
+
+XCLIPSE_TEST(BackgroundThreadWritesTheReport) {
+    std::string path = StatsPath("background.txt");
+    PipelineCompileStats stats(path, kTestIntervalNs);
+    stats.Record(VK_PIPELINE_BIND_POINT_COMPUTE, CacheOutcome::kHit, 300'000);
+    std::string report = WaitForFile(path);
+    EXPECT_NE(report.find("compute all: n=1"), std::string::npos);
+    EXPECT_NE(report.find("compute cache-hit: n=1"), std::string::npos);
+}
+
+XCLIPSE_TEST(IdleIntervalsWriteNothing) {
+    std::string path = StatsPath("idle.txt");
+    {
+        PipelineCompileStats stats(path, kTestIntervalNs);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_TRUE(ReadFile(path).empty());
+}
+
+XCLIPSE_TEST(BackgroundReportRunsOnTheDumperThread) {
+    std::atomic<int> runs{0};
+    std::atomic<bool> on_caller{false};
+    std::thread::id caller = std::this_thread::get_id();
+    {
+        PipelineCompileStats stats(StatsPath("report.txt"), PipelineCompileStats::kDumpIntervalNs,
+                                   BackgroundReport{[&] {
+                                       on_caller = on_caller || std::this_thread::get_id() == caller;
+                                       runs++;
+                                   }, kTestIntervalNs});
+        for (int i = 0; i < 200 && runs < 3; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    // Keeps its own interval, well inside the compile report's
+    EXPECT_TRUE(runs >= 3);
+    EXPECT_FALSE(on_caller);
+}
@@ -0,0 +1,321 @@
+// shader_modules_test.cpp - SPIR-V hashing, module tracking, dumps and replacements
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "layer_paths.h"
+#include "mock_driver.h"
+#include "shader_modules.h"
+#include "spirv_hash.h"
+#include "test_harness.h"
+
+namespace {
+
+constexpr uint32_t kSpirvMagic = 0x07230203;
+
+// Deterministic words starting with the SPIR-V magic number
+std::vector<uint32_t> Blob(size_t words, uint32_t seed = kSpirvMagic) {
+    std::vector<uint32_t> blob(words);
+    uint32_t x = seed;
+    for (uint32_t& word : blob) {
+        word = x;
+        x = x * 1664525u + 1013904223u;
+    }
+    blob[0] = kSpirvMagic;
+    return blob;
+}
+
+// The hash written out one lane at a time, as the scalar build computes it
+ShaderHash ReferenceHash(const void* code, size_t size) {
+    constexpr uint64_t kKeys[4] = {0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull,
+                                   0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull};
+    constexpr uint64_t kPrime32 = 0x9E3779B1ull;
+    constexpr uint64_t kPrime64a = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t kPrime64b = 0xC2B2AE3D27D4EB4Full;
+    uint64_t acc[4] = {kPrime32, kPrime64a, kPrime64b, kPrime64a ^ kPrime64b};
+    auto stripe = [&](const uint8_t* data) {
+        uint64_t words[4];
+        std::memcpy(words, data, sizeof(words));
+        for (size_t lane = 0; lane < 4; ++lane) {
+            uint64_t keyed = words[lane] ^ kKeys[lane];
+            acc[lane] += words[lane ^ 1] + (keyed & 0xFFFFFFFFu) * (keyed >> 32);
+        }
+    };
+    auto avalanche = [](uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDull;
+        value ^= value >> 33;
+        value *= 0xC4CEB9FE1A85EC53ull;
+        return value ^ (value >> 33);
+    };
+    auto rotate = [](uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); };
+
+    const uint8_t* data = static_cast<const uint8_t*>(code);
+    size_t stripes = size / 32;
+    for (size_t i = 0; i < stripes; ++i) {
+        stripe(data + i * 32);
+        if (i % 16 == 15) {
+            for (size_t lane = 0; lane < 4; ++lane) {
+                acc[lane] = ((acc[lane] ^ (acc[lane] >> 47)) ^ kKeys[lane]) * kPrime32;
+            }
+        }
+    }
+    if (size % 32) {
+        uint8_t last[32] = {};
+        std::memcpy(last, data + stripes * 32, size % 32);
+        stripe(last);
+    }
+    uint64_t length = size;
+    ShaderHash hash;
+    hash.low = avalanche(acc[0] ^ rotate(acc[1], 17) ^ rotate(acc[2], 31) ^ rotate(acc[3], 47) ^
+                         length * kPrime64a);
+    hash.high = avalanche(acc[3] + rotate(acc[2], 13) + rotate(acc[1], 29) + rotate(acc[0], 43) +
+                          (length ^ hash.low) * kPrime64b);
+    return hash;
+}
+
+VkShaderModuleCreateInfo ModuleInfo(const std::vector<uint32_t>& code) {
+    VkShaderModuleCreateInfo info{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+    info.codeSize = code.size() * sizeof(uint32_t);
+    info.pCode = code.data();
+    return info;
+}
+
+std::string FreshDirectory(const char* name) {
+    std::string path = TestDataDirectory() + "/" + name;
+    mkdir(path.c_str(), 0700);
+    return path;
+}
+
+void WriteWords(const std::string& path, const std::vector<uint32_t>& words, size_t bytes) {
+    if (FILE* file = std::fopen(path.c_str(), "wb")) {
+        std::fwrite(words.data(), 1, bytes, file);
+        std::fclose(file);
+    }
+}
+
+bool FileExists(const std::string& path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0;
+}
+
+} // namespace
+
+XCLIPSE_TEST(VectorHashMatchesTheScalarOne) {
+    std::vector<uint32_t> blob = Blob(4096);
+    // Around the tail and the 16-stripe scramble boundaries
+    for (size_t size : {0, 4, 20, 28, 32, 36, 508, 512, 516, 1024, 4096, 16380, 16384}) {
+        EXPECT_TRUE(HashSpirv(blob.data(), size) == ReferenceHash(blob.data(), size));
+    }
+}
+
+XCLIPSE_TEST(HashIsStableAcrossBuilds) {
+    // Replacement files and profile rules are named after these values
+    std::vector<uint32_t> blob = Blob(4096);
+    EXPECT_EQ(ShaderHashToHex(HashSpirv(blob.data(), 20)), std::string("33ffaf323328690b315cd6b5f45964d1"));
+    EXPECT_EQ(ShaderHashToHex(HashSpirv(blob.data(), 16384)),
+              std::string("d57106a27419eb7f557b68eb2ae897df"));
+    EXPECT_EQ(ShaderHashToHex(HashSpirv(nullptr, 0)), std::string("01c8b21bcb21d7e1aaa470b627b29a95"));
+}
+
+XCLIPSE_TEST(TrailingZerosChangeTheHash) {
+    std::vector<uint32_t> zeros(16, 0);
+    EXPECT_FALSE(HashSpirv(zeros.data(), 4) == HashSpirv(zeros.data(), 8));
+    EXPECT_FALSE(HashSpirv(zeros.data(), 32) == HashSpirv(zeros.data(), 64));
+
+    std::vector<uint32_t> a = Blob(64);
+    std::vector<uint32_t> b = a;
+    b[63] ^= 1;
+    EXPECT_FALSE(HashSpirv(a.data(), 256) == HashSpirv(b.data(), 256));
+}
+
+XCLIPSE_TEST(HexRoundTrips) {
+    ShaderHash hash{0x0b5c840bec9e6d6cull, 0x726ca7d7d69feb86ull};
+    std::string hex = ShaderHashToHex(hash);
+    EXPECT_EQ(hex, std::string("0b5c840bec9e6d6c726ca7d7d69feb86"));
+    ShaderHash parsed;
+    EXPECT_TRUE(ParseShaderHash(hex, parsed));
+    EXPECT_TRUE(parsed == hash);
+    EXPECT_TRUE(ParseShaderHash("0B5C840BEC9E6D6C726CA7D7D69FEB86", parsed));
+    EXPECT_TRUE(parsed == hash);
+
+    ShaderHash untouched{1, 2};
+    EXPECT_FALSE(ParseShaderHash("0b5c840bec9e6d6c726ca7d7d69feb8", untouched));
+    EXPECT_FALSE(ParseShaderHash("0b5c840bec9e6d6c726ca7d7d69feb8g", untouched));
+    EXPECT_TRUE(untouched == (ShaderHash{1, 2}));
+}
+
+XCLIPSE_TEST(TrackerRemembersModuleHashes) {
+    ShaderModuleTracker tracker("", "");
+    std::vector<uint32_t> code = Blob(64);
+    std::vector<uint32_t> replacement;
+    ShaderHash hash = tracker.Prepare(ModuleInfo(code), replacement);
+    EXPECT_TRUE(hash == HashSpirv(code.data(), code.size() * sizeof(uint32_t)));
+    EXPECT_TRUE(replacement.empty());
+
+    VkShaderModule module = FakeHandle<VkShaderModule>(0x5000);
+    tracker.Insert(module, hash);
+    VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    stage.module = module;
+    EXPECT_TRUE(tracker.HashStage(stage) == hash);
+
+    // A handle that comes back after a destroy is a different shader
+    tracker.Erase(module);
+    EXPECT_TRUE(tracker.HashStage(stage).IsZero());
+
+    // VK_KHR_maintenance5: the module's create info is chained to the stage
+    VkShaderModuleCreateInfo inline_info = ModuleInfo(code);
+    stage.module = VK_NULL_HANDLE;
+    stage.pNext = &inline_info;
+    EXPECT_TRUE(tracker.HashStage(stage) == hash);
+}
+
+XCLIPSE_TEST(TrackerKeepsModulesThroughChurn) {
+    ShaderModuleTracker tracker("", "");
+    VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    auto hash_of = [&](uint64_t id) {
+        stage.module = FakeHandle<VkShaderModule>(id);
+        return tracker.HashStage(stage);
+    };
+
+    // Grows past several rebuilds, then churns so erased slots pile up
+    for (uint64_t id = 1; id <= 3000; ++id) {
+        tracker.Insert(FakeHandle<VkShaderModule>(id), ShaderHash{id, ~id});
+    }
+    for (uint64_t round = 0; round < 10; ++round) {
+        for (uint64_t id = 1 + round * 300; id <= 300 + round * 300; ++id) {
+            tracker.Erase(FakeHandle<VkShaderModule>(id));
+            tracker.Insert(FakeHandle<VkShaderModule>(id + 3000), ShaderHash{id + 3000, ~(id + 3000)});
+        }
+    }
+
+    bool all_found = true;
+    for (uint64_t id = 3001; id <= 6000; ++id) {
+        all_found &= hash_of(id) == (ShaderHash{id, ~id});
+    }
+    EXPECT_TRUE(all_found);
+    bool all_erased = true;
+    for (uint64_t id = 1; id <= 3000; ++id) {
+        all_erased &= hash_of(id).IsZero();
+    }
+    EXPECT_TRUE(all_erased);
+}
+
+XCLIPSE_TEST(TrackerLookupsRaceWithModuleCreation) {
+    ShaderModuleTracker tracker("", "");
+    constexpr uint64_t kStable = 64;
+    for (uint64_t id = 1; id <= kStable; ++id) {
+        tracker.Insert(FakeHandle<VkShaderModule>(id), ShaderHash{id, id});
+    }
+
+    // Compile threads keep looking the stable modules up while the app
+    // creates enough others to force rebuilds underneath them
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> wrong{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&] {
+            VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+            while (!done.load(std::memory_order_relaxed)) {
+                for (uint64_t id = 1; id <= kStable; ++id) {
+                    stage.module = FakeHandle<VkShaderModule>(id);
+                    if (!(tracker.HashStage(stage) == ShaderHash{id, id})) {
+                        wrong.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        });
+    }
+    for (uint64_t id = kStable + 1; id <= 20000; ++id) {
+        tracker.Insert(FakeHandle<VkShaderModule>(id), ShaderHash{id, id});
+        if (id % 3 == 0) {
+            tracker.Erase(FakeHandle<VkShaderModule>(id));
+        }
+    }
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(wrong.load(), uint64_t{0});
+}
+
+XCLIPSE_TEST(DumpWritesEachShaderOnce) {
+    std::string directory = TestDataDirectory() + "/dump";
+    ShaderModuleTracker tracker("", directory);
+    std::vector<uint32_t> code = Blob(32);
+    std::vector<uint32_t> replacement;
+    ShaderHash hash = tracker.Prepare(ModuleInfo(code), replacement);
+
+    std::string path = directory + "/" + ShaderHashToHex(hash) + ".spv";
+    struct stat st{};
+    ASSERT_TRUE(stat(path.c_str(), &st) == 0);
+    EXPECT_EQ(static_cast<size_t>(st.st_size), code.size() * sizeof(uint32_t));
+
+    // The same code again is not rewritten
+    unlink(path.c_str());
+    tracker.Prepare(ModuleInfo(code), replacement);
+    EXPECT_FALSE(FileExists(path));
+}
+
+XCLIPSE_TEST(ReplacementsComeFromTheDirectory) {
+    std::string directory = FreshDirectory("replacements");
+    std::vector<uint32_t> original = Blob(32);
+    std::vector<uint32_t> broken = Blob(32, 7);
+    std::vector<uint32_t> replacement_code = Blob(48, 11);
+    ShaderHash original_hash = HashSpirv(original.data(), original.size() * sizeof(uint32_t));
+    ShaderHash broken_hash = HashSpirv(broken.data(), broken.size() * sizeof(uint32_t));
+    WriteWords(directory + "/" + ShaderHashToHex(original_hash) + ".spv", replacement_code,
+               replacement_code.size() * sizeof(uint32_t));
+    // Not a whole number of words
+    WriteWords(directory + "/" + ShaderHashToHex(broken_hash) + ".spv", replacement_code, 22);
+    WriteWords(directory + "/notahash.spv", replacement_code, 64);
+
+    ShaderModuleTracker tracker(directory, "");
+    std::vector<uint32_t> replacement;
+    // The hash stays the original's, so rules keep matching the app's shader
+    EXPECT_TRUE(tracker.Prepare(ModuleInfo(original), replacement) == original_hash);
+    EXPECT_TRUE(replacement == replacement_code);
+
+    replacement.clear();
+    tracker.Prepare(ModuleInfo(broken), replacement);
+    EXPECT_TRUE(replacement.empty());
+
+    tracker.Prepare(ModuleInfo(Blob(32, 99)), replacement);
+    EXPECT_TRUE(replacement.empty());
+}
+
+XCLIPSE_TEST(LayerCreatesReplacedModules) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_REPLACE_SHADERS", "1", 1);
+    std::string directory = FreshDirectory((GetProcessName() + ".shaders").c_str());
+    std::vector<uint32_t> original = Blob(40, 3);
+    std::vector<uint32_t> replacement_code = Blob(24, 5);
+    WriteWords(directory + "/" +
+                   ShaderHashToHex(HashSpirv(original.data(), original.size() * sizeof(uint32_t))) + ".spv",
+               replacement_code, replacement_code.size() * sizeof(uint32_t));
+
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    auto create = layer.Get<PFN_vkCreateShaderModule>("vkCreateShaderModule");
+    VkShaderModuleCreateInfo info = ModuleInfo(original);
+    VkShaderModule module = VK_NULL_HANDLE;
+    EXPECT_EQ(create(layer.device, &info, nullptr, &module), VK_SUCCESS);
+    ASSERT_TRUE(Mock().shader_code.size() == 1);
+    EXPECT_TRUE(Mock().shader_code[0] == replacement_code);
+
+    std::vector<uint32_t> other = Blob(40, 4);
+    info = ModuleInfo(other);
+    EXPECT_EQ(create(layer.device, &info, nullptr, &module), VK_SUCCESS);
+    ASSERT_TRUE(Mock().shader_code.size() == 2);
+    EXPECT_TRUE(Mock().shader_code[1] == other);
+    DestroyLayerDevice(layer);
+}
@@ -0,0 +1,97 @@
+// submit_batcher_test.cpp - Held submits always reach the driver, in order
+
+#include <cstdlib>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+bool CreateBatchingDevice(LayerDevice& layer) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_BATCH_SUBMITS", "1", 1);
+    LayerDeviceOptions options;
+    options.queues = {{0, 2}};
+    return CreateLayerDevice(layer, options);
+}
+
+void SubmitCommandBuffer(const LayerDevice& layer, VkQueue queue, VkCommandBuffer command_buffer) {
+    VkSubmitInfo info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &command_buffer;
+    EXPECT_EQ(layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit")(queue, 1, &info, VK_NULL_HANDLE), VK_SUCCESS);
+}
+
+} // namespace
+
+XCLIPSE_TEST(HeldSubmitsAreFlushedBeforeDeviceDestroy) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateBatchingDevice(layer));
+    VkQueue queue = layer.Queue(0);
+    VkCommandBuffer first = FakeHandle<VkCommandBuffer>(0xc1);
+    VkCommandBuffer second = FakeHandle<VkCommandBuffer>(0xc2);
+    SubmitCommandBuffer(layer, queue, first);
+    SubmitCommandBuffer(layer, queue, second);
+    EXPECT_EQ(Mock().submit_calls, 0u);
+
+    // The mock rejects submits once the device is gone, so these reached
+    // it first, and the layer waited for them before destroying it
+    DestroyLayerDevice(layer);
+    EXPECT_EQ(Mock().submit_calls, 1u);
+    ASSERT_TRUE(Mock().submits.size() == 2);
+    EXPECT_EQ(Mock().submits[0].command_buffers[0], first);
+    EXPECT_EQ(Mock().submits[1].command_buffers[0], second);
+    EXPECT_EQ(Mock().device_wait_idles, 1u);
+}
+
+XCLIPSE_TEST(HeldSubmit2IsFlushedBeforeDeviceDestroy) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateBatchingDevice(layer));
+    VkCommandBufferSubmitInfo command_buffer{VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+    command_buffer.commandBuffer = FakeHandle<VkCommandBuffer>(0xc3);
+    VkSubmitInfo2 info{VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+    info.commandBufferInfoCount = 1;
+    info.pCommandBufferInfos = &command_buffer;
+    EXPECT_EQ(layer.Get<PFN_vkQueueSubmit2>("vkQueueSubmit2")(layer.Queue(0), 1, &info, VK_NULL_HANDLE),
+              VK_SUCCESS);
+    EXPECT_EQ(Mock().submit_calls, 0u);
+
+    DestroyLayerDevice(layer);
+    ASSERT_TRUE(Mock().submits.size() == 1);
+    EXPECT_TRUE(Mock().submits[0].submit2);
+}
+
+XCLIPSE_TEST(HostWaitsFlushHeldSubmits) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateBatchingDevice(layer));
+    VkQueue queue = layer.Queue(0);
+
+    SubmitCommandBuffer(layer, queue, FakeHandle<VkCommandBuffer>(0xc4));
+    EXPECT_EQ(layer.Get<PFN_vkDeviceWaitIdle>("vkDeviceWaitIdle")(layer.device), VK_SUCCESS);
+    EXPECT_EQ(Mock().submit_calls, 1u);
+
+    SubmitCommandBuffer(layer, queue, FakeHandle<VkCommandBuffer>(0xc5));
+    EXPECT_EQ(layer.Get<PFN_vkQueueWaitIdle>("vkQueueWaitIdle")(queue), VK_SUCCESS);
+    EXPECT_EQ(Mock().submit_calls, 2u);
+
+    DestroyLayerDevice(layer);
+    EXPECT_EQ(Mock().submits.size(), size_t{2});
+}
+
+XCLIPSE_TEST(SubmitOnAnotherQueueFlushesFirst) {
+    LayerDevice layer;
+    ASSERT_TRUE(CreateBatchingDevice(layer));
+    VkQueue first = layer.Queue(0, 0);
+    VkQueue second = layer.Queue(0, 1);
+
+    SubmitCommandBuffer(layer, first, FakeHandle<VkCommandBuffer>(0xc6));
+    // A binary semaphore signalled by the held submit may be waited on here
+    SubmitCommandBuffer(layer, second, FakeHandle<VkCommandBuffer>(0xc7));
+    ASSERT_TRUE(Mock().submits.size() >= 1);
+    EXPECT_EQ(Mock().submits[0].queue, first);
+
+    DestroyLayerDevice(layer);
+    ASSERT_TRUE(Mock().submits.size() == 2);
+    EXPECT_EQ(Mock().submits[1].queue, second);
+}
@@ -0,0 +1,130 @@
+// submit_paths_test.cpp - Every submit path delivers the app's work through the same entry point
+
+#include <cstdlib>
+
+#include "mock_driver.h"
+#include "test_harness.h"
+
+namespace {
+
+struct Device {
+    LayerDevice layer;
+    VkQueue queue{VK_NULL_HANDLE};
+    VkCommandBuffer dispatch{VK_NULL_HANDLE};
+    VkCommandBuffer draw{VK_NULL_HANDLE};
+};
+
+VkCommandBuffer Record(const LayerDevice& layer, VkCommandPool pool, bool draw) {
+    VkCommandBuffer command_buffer = layer.AllocateCommandBuffer(pool);
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    layer.Get<PFN_vkBeginCommandBuffer>("vkBeginCommandBuffer")(command_buffer, &begin);
+    if (draw) {
+        layer.Get<PFN_vkCmdDraw>("vkCmdDraw")(command_buffer, 3, 1, 0, 0);
+    } else {
+        layer.Get<PFN_vkCmdDispatch>("vkCmdDispatch")(command_buffer, 8, 8, 1);
+    }
+    layer.Get<PFN_vkEndCommandBuffer>("vkEndCommandBuffer")(command_buffer);
+    return command_buffer;
+}
+
+bool CreateDevice(Device& device, const char* option) {
+    ResetMock();
+    ResetLayerEnvironment();
+    if (option) setenv(option, "1", 1);
+    VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    features12.timelineSemaphore = VK_TRUE;
+    LayerDeviceOptions options;
+    options.device_features = &features12;
+    if (!CreateLayerDevice(device.layer, options)) return false;
+
+    device.queue = device.layer.Queue(0);
+    VkCommandPool pool = device.layer.CreateCommandPool(0);
+    device.dispatch = Record(device.layer, pool, false);
+    device.draw = Record(device.layer, pool, true);
+    return true;
+}
+
+VkResult Submit(const Device& device, VkCommandBuffer command_buffer, bool submit2) {
+    if (submit2) {
+        VkCommandBufferSubmitInfo command_buffer_info{VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO};
+        command_buffer_info.commandBuffer = command_buffer;
+        VkSubmitInfo2 info{VK_STRUCTURE_TYPE_SUBMIT_INFO_2};
+        info.commandBufferInfoCount = 1;
+        info.pCommandBufferInfos = &command_buffer_info;
+        return device.layer.Get<PFN_vkQueueSubmit2>("vkQueueSubmit2")(device.queue, 1, &info, VK_NULL_HANDLE);
+    }
+    VkSubmitInfo info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    info.commandBufferCount = 1;
+    info.pCommandBuffers = &command_buffer;
+    return device.layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit")(device.queue, 1, &info, VK_NULL_HANDLE);
+}
+
+// The driver-side submit that carried command_buffer, or null
+const MockSubmit* FindSubmit(VkCommandBuffer command_buffer) {
+    for (const MockSubmit& submit : Mock().submits) {
+        for (VkCommandBuffer submitted : submit.command_buffers) {
+            if (submitted == command_buffer) return &submit;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+XCLIPSE_TEST(PlainPathKeepsQueueAndEntryPoint) {
+    for (bool submit2 : {false, true}) {
+        Device device;
+        ASSERT_TRUE(CreateDevice(device, nullptr));
+        EXPECT_EQ(Submit(device, device.dispatch, submit2), VK_SUCCESS);
+        EXPECT_EQ(Mock().submit_calls, 1u);
+        const MockSubmit* submit = FindSubmit(device.dispatch);
+        ASSERT_TRUE(submit != nullptr);
+        EXPECT_EQ(submit->queue, device.queue);
+        EXPECT_EQ(submit->submit2, submit2);
+        DestroyLayerDevice(device.layer);
+    }
+}
+
+XCLIPSE_TEST(BatchedPathKeepsEntryPoint) {
+    for (bool submit2 : {false, true}) {
+        Device device;
+        ASSERT_TRUE(CreateDevice(device, "XCLIPSE_BATCH_SUBMITS"));
+        EXPECT_EQ(Submit(device, device.dispatch, submit2), VK_SUCCESS);
+        EXPECT_EQ(Submit(device, device.draw, submit2), VK_SUCCESS);
+        EXPECT_EQ(Mock().submit_calls, 0u);
+        EXPECT_EQ(device.layer.Get<PFN_vkQueueWaitIdle>("vkQueueWaitIdle")(device.queue), VK_SUCCESS);
+        EXPECT_EQ(Mock().submit_calls, 1u);
+        const MockSubmit* submit = FindSubmit(device.draw);
+        ASSERT_TRUE(submit != nullptr);
+        EXPECT_EQ(submit->submit2, submit2);
+        DestroyLayerDevice(device.layer);
+    }
+}
+
+XCLIPSE_TEST(AsyncPathOffloadsDispatchesAndJoinsDraws) {
+    for (bool submit2 : {false, true}) {
+        Device device;
+        ASSERT_TRUE(CreateDevice(device, "XCLIPSE_ASYNC_COMPUTE"));
+        EXPECT_EQ(Submit(device, device.dispatch, submit2), VK_SUCCESS);
+        const MockSubmit* offloaded = FindSubmit(device.dispatch);
+        ASSERT_TRUE(offloaded != nullptr);
+        EXPECT_NE(offloaded->queue, device.queue);
+        EXPECT_EQ(offloaded->submit2, submit2);
+
+        // Signalling a fence covers the offloaded work, so the draw waits on it
+        VkFence fence = FakeHandle<VkFence>(0xfe);
+        VkSubmitInfo info{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+        info.commandBufferCount = 1;
+        info.pCommandBuffers = &device.draw;
+        EXPECT_EQ(device.layer.Get<PFN_vkQueueSubmit>("vkQueueSubmit")(device.queue, 1, &info, fence),
+                  VK_SUCCESS);
+        const MockSubmit* joined = FindSubmit(device.draw);
+        ASSERT_TRUE(joined != nullptr);
+        EXPECT_EQ(joined->queue, device.queue);
+        ASSERT_TRUE(Mock().submits.size() >= 2);
+        const MockSubmit& wait = Mock().submits[Mock().submits.size() - 2];
+        EXPECT_EQ(wait.queue, device.queue);
+        EXPECT_EQ(wait.wait_semaphores.size(), size_t{1});
+        DestroyLayerDevice(device.layer);
+    }
+}
@@ -0,0 +1,65 @@
+// test_harness.h - Minimal test runner for the host tests
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// The layer builds without exceptions, so a failed expectation is counted
+// and reported instead of thrown; the test keeps running. Each test file is
+// its own executable and gets main() from test_main.cpp.
+namespace xclipse_test {
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& Registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline uint32_t& Failures() {
+    static uint32_t failures = 0;
+    return failures;
+}
+
+struct Registration {
+    Registration(const char* name, void (*run)()) { Registry().push_back({name, run}); }
+};
+
+inline void Fail(const char* file, int line, const char* expression) {
+    std::fprintf(stderr, "%s:%d: expected %s\n", file, line, expression);
+    Failures()++;
+}
+
+} // namespace xclipse_test
+
+#define XCLIPSE_TEST(name)                                                          \
+    static void name();                                                             \
+    static const xclipse_test::Registration name##_registration(#name, name);       \
+    static void name()
+
+#define EXPECT_TRUE(condition)                                                      \
+    do {                                                                            \
+        if (!(condition)) xclipse_test::Fail(__FILE__, __LINE__, #condition);       \
+    } while (0)
+
+#define EXPECT_FALSE(condition) EXPECT_TRUE(!(condition))
+#define EXPECT_EQ(a, b) EXPECT_TRUE((a) == (b))
+#define EXPECT_NE(a, b) EXPECT_TRUE((a) != (b))
+#define EXPECT_LT(a, b) EXPECT_TRUE((a) < (b))
+#define EXPECT_LE(a, b) EXPECT_TRUE((a) <= (b))
+#define EXPECT_GT(a, b) EXPECT_TRUE((a) > (b))
+#define EXPECT_GE(a, b) EXPECT_TRUE((a) >= (b))
+
+// For preconditions the rest of the test cannot run without
+#define ASSERT_TRUE(condition)                                                      \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            xclipse_test::Fail(__FILE__, __LINE__, #condition);                     \
+            return;                                                                 \
+        }                                                                           \
+    } while (0)
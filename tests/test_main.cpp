@@ -0,0 +1,13 @@
+// test_main.cpp - Runs every registered test of one test executable
+
+#include "test_harness.h"
+
+int main() {
+    for (const xclipse_test::TestCase& test : xclipse_test::Registry()) {
+        uint32_t failures = xclipse_test::Failures();
+        test.run();
+        std::fprintf(stderr, "[%s] %s\n", xclipse_test::Failures() == failures ? "pass" : "FAIL",
+                     test.name);
+    }
+    return xclipse_test::Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+// trace_test.cpp - Layer calls are exported as a Chrome JSON trace
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "layer_paths.h"
+#include "mock_driver.h"
+#include "test_harness.h"
+#include "trace.h"
+
+// The tracer is process-wide and stays on once enabled, so the tests run
+// in this order: off, enabled through the layer, then recorded directly.
+
+namespace {
+
+std::string TracePath() {
+    return TestDataDirectory() + "/" + GetProcessName() + ".trace.json";
+}
+
+std::string ReadFile(const std::string& path) {
+    std::string contents;
+    if (FILE* file = std::fopen(path.c_str(), "r")) {
+        char buffer[4096];
+        size_t n;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            contents.append(buffer, n);
+        }
+        std::fclose(file);
+    }
+    return contents;
+}
+
+uint32_t CountOf(const std::string& text, const std::string& needle) {
+    uint32_t count = 0;
+    for (size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+void AllocateAndFree(const LayerDevice& layer) {
+    VkMemoryAllocateInfo info{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    info.allocationSize = 4096;
+    info.memoryTypeIndex = 0;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    EXPECT_EQ(layer.Get<PFN_vkAllocateMemory>("vkAllocateMemory")(layer.device, &info, nullptr, &memory),
+              VK_SUCCESS);
+    layer.Get<PFN_vkFreeMemory>("vkFreeMemory")(layer.device, memory, nullptr);
+}
+
+} // namespace
+
+XCLIPSE_TEST(OffByDefault) {
+    ResetMock();
+    ResetLayerEnvironment();
+    unlink(TracePath().c_str());
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    AllocateAndFree(layer);
+    DestroyLayerDevice(layer);
+    EXPECT_FALSE(Tracer::Enabled());
+    EXPECT_TRUE(ReadFile(TracePath()).empty());
+}
+
+XCLIPSE_TEST(LayerCallsAreExportedAtDeviceDestroy) {
+    ResetMock();
+    ResetLayerEnvironment();
+    setenv("XCLIPSE_TRACE", "1", 1);
+    LayerDevice layer;
+    ASSERT_TRUE(CreateLayerDevice(layer));
+    EXPECT_TRUE(Tracer::Enabled());
+    AllocateAndFree(layer);
+    layer.Get<PFN_vkQueueWaitIdle>("vkQueueWaitIdle")(layer.Queue(0));
+    DestroyLayerDevice(layer);
+
+    std::string trace = ReadFile(TracePath());
+    EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), size_t{0});
+    EXPECT_NE(trace.find("\"name\":\"process_name\",\"ph\":\"M\""), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"vkAllocateMemory\",\"cat\":\"memory\",\"ph\":\"X\""),
+              std::string::npos);
+    EXPECT_NE(trace.find("\"args\":{\"bytes\":4096}"), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"vkFreeMemory\""), std::string::npos);
+    EXPECT_NE(trace.find("{\"name\":\"vkQueueWaitIdle\""), std::string::npos);
+    EXPECT_EQ(trace.substr(trace.size() - 4), std::string("\n]}\n"));
+}
+
+XCLIPSE_TEST(FullRingKeepsTheNewestEvents) {
+    // A thread of its own starts with an empty ring
+    constexpr uint64_t kFirstArg = 1'000'000;
+    constexpr uint32_t kExtra = 10;
+    std::thread([] {
+        for (uint64_t i = 0; i < Tracer::kEventsPerThread + kExtra; ++i) {
+            Tracer::Shared().Record(TraceEvent::kWaitSemaphores, 100 + i, 200 + i, kFirstArg + i);
+        }
+    }).join();
+    Tracer::Shared().Export();
+
+    std::string trace = ReadFile(TracePath());
+    EXPECT_EQ(CountOf(trace, "\"semaphores\":"), Tracer::kEventsPerThread);
+    EXPECT_EQ(trace.find("\"semaphores\":" + std::to_string(kFirstArg) + "}"), std::string::npos);
+    EXPECT_EQ(trace.find("\"semaphores\":" + std::to_string(kFirstArg + kExtra - 1) + "}"),
+              std::string::npos);
+    EXPECT_NE(trace.find("\"semaphores\":" + std::to_string(kFirstArg + kExtra) + "}"),
+              std::string::npos);
+    EXPECT_NE(trace.find("\"semaphores\":" +
+                         std::to_string(kFirstArg + Tracer::kEventsPerThread + kExtra - 1) + "}"),
+              std::string::npos);
+    // Durations are end minus start, in microseconds
+    EXPECT_NE(trace.find("\"dur\":0.100"), std::string::npos);
+}
+
+XCLIPSE_TEST(ConcurrentThreadsLoseNothing) {
+    constexpr uint32_t kThreads = 4;
+    constexpr uint32_t kEvents = 500;
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([t] {
+            for (uint32_t i = 0; i < kEvents; ++i) {
+                Tracer::Shared().Record(TraceEvent::kWaitForFences, i, i + 1, 2'000'000 + t * kEvents + i);
+            }
+        });
+    }
+    // Exporting while they record only ever leaves events out
+    Tracer::Shared().Export();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    Tracer::Shared().Export();
+
+    std::string trace = ReadFile(TracePath());
+    EXPECT_EQ(CountOf(trace, "\"fences\":"), kThreads * kEvents);
+    for (uint32_t t = 0; t < kThreads; ++t) {
+        EXPECT_NE(trace.find("\"fences\":" + std::to_string(2'000'000 + t * kEvents) + "}"),
+                  std::string::npos);
+    }
+}
+
+XCLIPSE_TEST(PeriodicExportSkipsIdleIntervals) {
+    Tracer::Shared().Export();
+    unlink(TracePath().c_str());
+    // Nothing recorded since the last export: nothing to write
+    Tracer::Shared().ExportIfRecorded();
+    EXPECT_TRUE(ReadFile(TracePath()).empty());
+
+    Tracer::Shared().Record(TraceEvent::kQueuePresent, 100, 200, 0);
+    Tracer::Shared().ExportIfRecorded();
+    EXPECT_NE(ReadFile(TracePath()).find("{\"name\":\"vkQueuePresentKHR\""), std::string::npos);
+}